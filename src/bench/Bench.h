@@ -0,0 +1,62 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <chrono>
+#include <stdio.h>
+
+//===============================================================
+// Tiny harness for the CPU-side benchmarks.  Every benchmark is a
+// plain function registered in the table in BenchMain.cpp; results
+// go to stdout.
+
+class BenchTimer
+{
+public:
+	BenchTimer() { reset(); }
+
+	void reset() { mStart = std::chrono::high_resolution_clock::now(); }
+
+	// Seconds elapsed since construction or the last reset().
+	double seconds()const
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - mStart).count();
+	}
+
+private:
+	std::chrono::high_resolution_clock::time_point mStart;
+};
+
+// Runs func repeatedly for at least minSeconds (and at least once) and
+// returns the average seconds per call.
+template <typename F>
+double BenchRepeat(F func, double minSeconds = 0.25)
+{
+	int runs = 0;
+	BenchTimer timer;
+	do
+	{
+		func();
+		++runs;
+	} while (timer.seconds() < minSeconds);
+
+	return timer.seconds() / runs;
+}
+
+void BenchTriGrid();
+void BenchHeightmap();
+void BenchWaves();
+void BenchWaveField();
+void BenchOcean();
+void BenchPalette();
+void BenchMath();
+void BenchSkeleton();
+void BenchTransform();
+void BenchInstances();
+void BenchAnimation();
+void BenchSkinning();
+void BenchXFile();
+void BenchMeshCache();
+void BenchSimplify();
+void BenchVertexCompress();
+void BenchMeshlets();
+void BenchNormals();
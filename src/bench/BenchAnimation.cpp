@@ -0,0 +1,146 @@
+#include "Bench.h"
+#include "AnimationClip.h"
+#include <algorithm>
+
+namespace
+{
+	const int   NUM_BONES = 64;
+	const float FPS = 30.0f;
+	const int   NUM_FRAMES = 301;   // Ten seconds.
+
+	// Raw keys for a clip on a 64-bone rig: every joint swings about its
+	// own axis with its own period, the root walks forward and bobs, and
+	// one bone in eight slides along its bone axis; the rest keep their
+	// bind positions, as in most real rigs.
+	void MakeRawClip(float speed, std::vector<D3DXVECTOR3>& positions, std::vector<D3DXQUATERNION>& rotations)
+	{
+		positions.resize(NUM_FRAMES * NUM_BONES);
+		rotations.resize(NUM_FRAMES * NUM_BONES);
+
+		for (int f = 0; f < NUM_FRAMES; ++f)
+		{
+			float t = f / FPS;
+			for (int b = 0; b < NUM_BONES; ++b)
+			{
+				D3DXVECTOR3 pos(b == 0 ? 0.0f : 2.0f, 0.0f, 0.0f);
+				if (b == 0)
+					pos = D3DXVECTOR3(0.0f, 0.2f*sinf(6.0f*speed*t), 1.5f*speed*t);
+				else if (b % 8 == 0)
+					pos.x += 0.3f*sinf(speed*t + b);
+
+				D3DXVECTOR3 axis(sinf(0.7f*b), cosf(1.3f*b), 0.5f);
+				D3DXVec3Normalize(&axis, &axis);
+				float angle = 0.8f*sinf(speed*(1.0f + 0.05f*b)*t + 0.37f*b);
+
+				D3DXQUATERNION q;
+				D3DXQuaternionRotationAxis(&q, &axis, angle);
+
+				positions[f*NUM_BONES + b] = pos;
+				rotations[f*NUM_BONES + b] = q;
+			}
+		}
+	}
+
+	// Angle between two rotations, whatever the signs of the quaternions.
+	double RotationError(const D3DXQUATERNION& a, const D3DXQUATERNION& b)
+	{
+		double s = D3DXQuaternionDot(&a, &b) < 0.0f ? -1.0 : 1.0;
+		double dx = a.x - s*b.x, dy = a.y - s*b.y, dz = a.z - s*b.z, dw = a.w - s*b.w;
+		double chord = sqrt(dx*dx + dy*dy + dz*dz + dw*dw);
+		return 4.0 * asin(chord < 2.0 ? 0.5*chord : 1.0);
+	}
+
+	// Simple stream of times spread over the clip.
+	float SampleTime(int i, float duration)
+	{
+		return fmodf(i * 0.618034f * duration, duration);
+	}
+}
+
+void BenchAnimation()
+{
+	std::vector<D3DXVECTOR3> positions, positions2;
+	std::vector<D3DXQUATERNION> rotations, rotations2;
+	MakeRawClip(2.0f, positions, rotations);
+	MakeRawClip(3.0f, positions2, rotations2);
+
+	const double seconds = (NUM_FRAMES - 1) / FPS;
+	const double rawBytesPerSecond = NUM_FRAMES * NUM_BONES * (sizeof(D3DXVECTOR3) + sizeof(D3DXQUATERNION)) / seconds;
+
+	printf("%d bones, %d frames at %.0f fps; raw float keys take %.0f bytes per clip-second\n\n",
+		NUM_BONES, NUM_FRAMES, FPS, rawBytesPerSecond);
+	printf("%10s %10s %10s %10s %14s %8s %12s %12s %12s\n", "rot bound", "pos bound", "rot keys", "pos keys",
+		"bytes/clip-s", "ratio", "max rot err", "max pos err", "simd diff");
+
+	struct Bound { float rotation, position; };
+	const Bound bounds[] =
+	{
+		{ 0.0f,    0.0f },
+		{ 0.001f,  0.001f },
+		{ 0.005f,  0.005f },
+		{ 0.02f,   0.02f },
+	};
+
+	AnimationClip clip, clip2;
+	SkeletonPose pose;
+	for (int i = 0; i < sizeof(bounds)/sizeof(bounds[0]); ++i)
+	{
+		clip.build(NUM_BONES, NUM_FRAMES, FPS, &positions[0], &rotations[0], bounds[i].rotation, bounds[i].position);
+
+		// Error against the raw keys at every frame, and the SIMD sampler
+		// against the scalar one.
+		double maxRotError = 0.0, maxPosError = 0.0, maxSimdDiff = 0.0;
+		for (int f = 0; f < NUM_FRAMES; ++f)
+		{
+			clip.sample(f / FPS, &pose);
+			for (int b = 0; b < NUM_BONES; ++b)
+			{
+				D3DXVECTOR3 p;
+				D3DXQUATERNION q;
+				clip.sampleBone(b, f / FPS, &p, &q);
+
+				D3DXVECTOR3 d = p - positions[f*NUM_BONES + b];
+				maxPosError = std::max(maxPosError, (double)D3DXVec3Length(&d));
+				maxRotError = std::max(maxRotError, RotationError(q, rotations[f*NUM_BONES + b]));
+
+				float simd[7] = { pose.posX[b], pose.posY[b], pose.posZ[b], pose.rotX[b], pose.rotY[b], pose.rotZ[b], pose.rotW[b] };
+				float scalar[7] = { p.x, p.y, p.z, q.x, q.y, q.z, q.w };
+				for (int c = 0; c < 7; ++c)
+					maxSimdDiff = std::max(maxSimdDiff, (double)fabsf(simd[c] - scalar[c]));
+			}
+		}
+
+		printf("%10.3f %10.3f %10d %10d %14.0f %7.1fx %12.2e %12.2e %12.2e\n",
+			bounds[i].rotation, bounds[i].position, clip.getNumRotationKeys(), clip.getNumPositionKeys(),
+			clip.getSizeInBytes() / seconds, rawBytesPerSecond * seconds / clip.getSizeInBytes(),
+			maxRotError, maxPosError, maxSimdDiff);
+	}
+
+	// Sampling throughput on the middle setting.
+	clip.build(NUM_BONES, NUM_FRAMES, FPS, &positions[0], &rotations[0], 0.005f, 0.005f);
+	clip2.build(NUM_BONES, NUM_FRAMES, FPS, &positions2[0], &rotations2[0], 0.005f, 0.005f);
+	float duration = clip.getDuration();
+
+	int i = 0;
+	double scalarSeconds = BenchRepeat([&] {
+		float t = SampleTime(i++, duration);
+		for (int b = 0; b < NUM_BONES; ++b)
+		{
+			D3DXVECTOR3 p;
+			D3DXQUATERNION q;
+			clip.sampleBone(b, t, &p, &q);
+			pose.posX[b] = p.x; pose.posY[b] = p.y; pose.posZ[b] = p.z;
+			pose.rotX[b] = q.x; pose.rotY[b] = q.y; pose.rotZ[b] = q.z; pose.rotW[b] = q.w;
+		}
+	});
+	double sampleSeconds = BenchRepeat([&] { clip.sample(SampleTime(i++, duration), &pose); });
+	double blendSeconds  = BenchRepeat([&] {
+		float t = SampleTime(i++, duration);
+		BlendClips(clip, t, clip2, t, 0.3f, &pose);
+	});
+
+	printf("\n%-28s %14s %14s\n", "sampling (5 mrad bound)", "ns/pose", "bones/us");
+	printf("%-28s %14.0f %14.1f\n", "scalar sampleBone",   scalarSeconds * 1e9, NUM_BONES / (scalarSeconds * 1e6));
+	printf("%-28s %14.0f %14.1f\n", "SIMD sample",         sampleSeconds * 1e9, NUM_BONES / (sampleSeconds * 1e6));
+	printf("%-28s %14.0f %14.1f\n", "SIMD BlendClips (2 clips)", blendSeconds * 1e9, NUM_BONES / (blendSeconds * 1e6));
+}
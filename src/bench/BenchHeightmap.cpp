@@ -0,0 +1,105 @@
+#include "Bench.h"
+#include "Heightmap.h"
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+static double WorkingSetMB()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return pmc.WorkingSetSize / (1024.0 * 1024.0);
+}
+
+// Writes an n x n little-endian 16-bit RAW heightmap of rolling hills,
+// one row at a time so the generator itself stays small.
+static bool WriteTestRAW(const std::wstring& filename, int n)
+{
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_WRITE, 0, 0,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	std::vector<WORD> row(n);
+	DWORD bytes = (DWORD)(n * sizeof(WORD));
+	bool ok = true;
+	for (int i = 0; i < n && ok; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+			row[j] = (WORD)(32767.5f + 16000.0f*sinf(0.002f*j)*cosf(0.003f*i) + 8000.0f*sinf(0.031f*(i+j)));
+
+		DWORD written = 0;
+		ok = WriteFile(file, &row[0], bytes, &written, 0) && written == bytes;
+	}
+
+	CloseHandle(file);
+	return ok;
+}
+
+void BenchHeightmap()
+{
+	// Opening and building a tile should cost the same whatever the map
+	// size; only the file on disk grows.
+	const int sizes[] = { 1025, 4097, 8193 };
+	const int tile = 257;
+
+	wchar_t tempDir[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempDir);
+
+	std::vector<D3DXVECTOR3> positions(tile*tile);
+	std::vector<D3DXVECTOR3> normals(tile*tile);
+
+	printf("%6s %10s %10s %14s %12s %12s\n", "map", "file MB", "open ms", "tile Mv/s", "WS open MB", "WS tile MB");
+
+	for (int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s)
+	{
+		int n = sizes[s];
+
+		std::wstring filename = std::wstring(tempDir) + L"bench_heightmap_" + std::to_wstring(n) + L".r16";
+		if (!WriteTestRAW(filename, n))
+		{
+			printf("%6d could not write test file\n", n);
+			continue;
+		}
+
+		double wsBefore = WorkingSetMB();
+
+		Heightmap map;
+		BenchTimer timer;
+		bool opened = map.openRAW(filename);
+		double openMs = timer.seconds() * 1000.0;
+
+		if (!opened)
+		{
+			printf("%6d could not open test file\n", n);
+			DeleteFileW(filename.c_str());
+			continue;
+		}
+		map.setHeightScale(200.0f, -100.0f);
+
+		double wsOpen = WorkingSetMB() - wsBefore;
+
+		// Walk tiles across the map so every call touches fresh pages.
+		int tilesPerSide = (n - 1) / (tile - 1);
+		int next = 0;
+		bool mapped = true;
+		double perTile = BenchRepeat([&] {
+			int t  = next++ % (tilesPerSide*tilesPerSide);
+			int r0 = (t / tilesPerSide) * (tile - 1);
+			int c0 = (t % tilesPerSide) * (tile - 1);
+			mapped = map.buildTile(r0, c0, tile, tile, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f),
+				&positions[0], &normals[0]) && mapped;
+		});
+		if (!mapped)
+			printf("%6d could not map every tile\n", n);
+
+		double wsTile = WorkingSetMB() - wsBefore;
+
+		printf("%6d %10.1f %10.3f %14.1f %12.1f %12.1f\n", n,
+			(double)n*n*sizeof(WORD) / (1024.0*1024.0), openMs,
+			(double)tile*tile / perTile * 1e-6, wsOpen, wsTile);
+
+		map.close();
+		DeleteFileW(filename.c_str());
+	}
+}
@@ -0,0 +1,89 @@
+#include "Bench.h"
+#include "Skeleton.h"
+#include "ThreadPool.h"
+
+// A rig of numBones bones: a chain like the robot arm when branchy is
+// false, else a tree where bone i hangs off bone (i-1)/2.
+static void BuildRig(Skeleton& skeleton, int numBones, bool branchy)
+{
+	skeleton = Skeleton();
+	for (int i = 0; i < numBones; ++i)
+	{
+		int parent = i == 0 ? -1 : (branchy ? (i - 1) / 2 : i - 1);
+		skeleton.addBone(parent, D3DXVECTOR3(i == 0 ? 0.0f : 2.0f, 0.0f, 0.0f));
+	}
+}
+
+// Every joint of instance i at frame f gets its own angle about z, as
+// if each rig played its own animation.
+static void PoseInstances(Skeleton* instances, int begin, int end, int frame)
+{
+	D3DXVECTOR3 zAxis(0.0f, 0.0f, 1.0f);
+	for (int i = begin; i < end; ++i)
+	{
+		for (int b = 0; b < instances[i].numBones(); ++b)
+		{
+			D3DXQUATERNION q;
+			D3DXQuaternionRotationAxis(&q, &zAxis, 0.001f * (frame + 3*i + 7*b));
+			instances[i].setRotation(b, q);
+		}
+	}
+}
+
+void BenchInstances()
+{
+	struct Rig { const char* name; int numBones; bool branchy; int numInstances; };
+	const Rig rigs[] =
+	{
+		{ "5-bone arm",   5,   false, 4096 },
+		{ "64-bone tree", 64,  true,  1024 },
+	};
+	const int threadCounts[] = { 1, 2, 4, 8, 16 };
+
+	for (int r = 0; r < sizeof(rigs)/sizeof(rigs[0]); ++r)
+	{
+		const Rig& rig = rigs[r];
+		const int n = rig.numInstances;
+
+		std::vector<Skeleton> instances(n);
+		for (int i = 0; i < n; ++i)
+			BuildRig(instances[i], rig.numBones, rig.branchy);
+
+		// Serial reference for the determinism check.
+		PoseInstances(&instances[0], 0, n, 0);
+		UpdateSkeletons(&instances[0], n, 0);
+		std::vector<D3DXMATRIX> reference;
+		for (int i = 0; i < n; ++i)
+			reference.insert(reference.end(), instances[i].getToWorldArray(), instances[i].getToWorldArray() + rig.numBones);
+
+		printf("%d instances of a %s (pose + update per frame)\n", n, rig.name);
+		printf("%8s %16s %10s\n", "threads", "instances/ms", "identical");
+
+		for (int t = 0; t < sizeof(threadCounts)/sizeof(threadCounts[0]); ++t)
+		{
+			ThreadPool pool(threadCounts[t] - 1);
+
+			int frame = 0;
+			double seconds = BenchRepeat([&] {
+				++frame;
+				pool.parallelFor(n, 64, [&](int begin, int end) { PoseInstances(&instances[0], begin, end, frame); });
+				UpdateSkeletons(&instances[0], n, &pool);
+			});
+
+			// Pose frame 0 again and compare with the serial result bit
+			// for bit.
+			pool.parallelFor(n, 64, [&](int begin, int end) { PoseInstances(&instances[0], begin, end, 0); });
+			UpdateSkeletons(&instances[0], n, &pool);
+
+			bool identical = true;
+			for (int i = 0; i < n; ++i)
+			{
+				identical = identical && memcmp(instances[i].getToWorldArray(), &reference[i*rig.numBones],
+					rig.numBones * sizeof(D3DXMATRIX)) == 0;
+			}
+
+			printf("%8d %16.1f %10s\n", threadCounts[t], n / (seconds * 1e3), identical ? "yes" : "NO");
+		}
+		printf("\n");
+	}
+}
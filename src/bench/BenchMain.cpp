@@ -0,0 +1,62 @@
+//=============================================================================
+// BenchMain.cpp
+//
+// Console driver for the CPU-side benchmarks.
+//
+// Usage: Bench_Release.exe [name ...]   (no arguments runs everything)
+//=============================================================================
+
+#include "Bench.h"
+#include <string.h>
+
+struct BenchEntry
+{
+	const char* name;
+	void (*func)();
+};
+
+static const BenchEntry gBenches[] =
+{
+	{ "trigrid",   BenchTriGrid },
+	{ "heightmap", BenchHeightmap },
+	{ "waves",     BenchWaves },
+	{ "wavefield", BenchWaveField },
+	{ "ocean",     BenchOcean },
+	{ "palette",   BenchPalette },
+	{ "math",      BenchMath },
+	{ "skeleton",  BenchSkeleton },
+	{ "transform", BenchTransform },
+	{ "instances", BenchInstances },
+	{ "animation", BenchAnimation },
+	{ "skinning",  BenchSkinning },
+	{ "xfile",     BenchXFile },
+	{ "meshcache", BenchMeshCache },
+	{ "simplify",  BenchSimplify },
+	{ "vcompress", BenchVertexCompress },
+	{ "meshlets",  BenchMeshlets },
+	{ "normals",   BenchNormals },
+};
+
+int main(int argc, char* argv[])
+{
+	const int numBenches = sizeof(gBenches) / sizeof(gBenches[0]);
+
+	for (int i = 0; i < numBenches; ++i)
+	{
+		bool run = (argc < 2);
+		for (int a = 1; a < argc; ++a)
+		{
+			if (strcmp(argv[a], gBenches[i].name) == 0)
+				run = true;
+		}
+
+		if (run)
+		{
+			printf("== %s ==\n", gBenches[i].name);
+			gBenches[i].func();
+			printf("\n");
+		}
+	}
+
+	return 0;
+}
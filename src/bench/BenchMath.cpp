@@ -0,0 +1,166 @@
+#include "Bench.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+// Scalar reference versions, written the obvious way; these are what a
+// straight port of the D3DX calls without SIMD would look like.
+static void RefMultiply(Mat4* out, const Mat4* a, const Mat4* b)
+{
+	Mat4 r;
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			r.m[i][j] = a->m[i][0]*b->m[0][j] + a->m[i][1]*b->m[1][j]
+			          + a->m[i][2]*b->m[2][j] + a->m[i][3]*b->m[3][j];
+	*out = r;
+}
+
+static void RefTransformCoord(Vec3* out, const Vec3* v, const Mat4* m)
+{
+	float x = v->x*m->_11 + v->y*m->_21 + v->z*m->_31 + m->_41;
+	float y = v->x*m->_12 + v->y*m->_22 + v->z*m->_32 + m->_42;
+	float z = v->x*m->_13 + v->y*m->_23 + v->z*m->_33 + m->_43;
+	float w = v->x*m->_14 + v->y*m->_24 + v->z*m->_34 + m->_44;
+	*out = Vec3(x/w, y/w, z/w);
+}
+
+static float MaxDiff(const float* a, const float* b, int count)
+{
+	float maxDiff = 0.0f;
+	for (int i = 0; i < count; ++i)
+		maxDiff = std::max(maxDiff, fabsf(a[i] - b[i]));
+	return maxDiff;
+}
+
+// ref <= 0 means there is no separate scalar version.
+static void PrintRow(const char* name, int count, double d3dx, double ref, double simd, float err)
+{
+	char refText[32] = "-";
+	if (ref > 0.0)
+		sprintf_s(refText, "%.2f", ref / count * 1e9);
+	printf("%-22s %10.2f %10s %10.2f %12.2e\n", name,
+		d3dx / count * 1e9, refText, simd / count * 1e9, err);
+}
+
+void BenchMath()
+{
+	const int numMats = 4096;
+	const int numPoints = 1 << 20;
+
+	// World*view*proj-like matrices: rotations, a translation and a
+	// projection, so the w divide is exercised.  The camera is far
+	// enough back that every point is in front of it.
+	Mat4 view, proj;
+	Vec3 eye(50.0f, 150.0f, -200.0f), target(0.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f);
+	Mat4LookAtLH(&view, &eye, &target, &up);
+	Mat4PerspectiveFovLH(&proj, D3DX_PI * 0.25f, 4.0f/3.0f, 1.0f, 1000.0f);
+	Mat4 viewProj = view * proj;
+
+	std::vector<Mat4> world(numMats), out(numMats), outRef(numMats), outD3DX(numMats);
+	for (int i = 0; i < numMats; ++i)
+	{
+		Mat4 ry, rx, t;
+		Mat4RotationY(&ry, i * 0.01f);
+		Mat4RotationX(&rx, i * 0.003f);
+		Mat4Translation(&t, (float)(i % 64), (float)(i % 7), (float)(i / 64));
+		world[i] = ry * rx * t;
+	}
+
+	std::vector<Vec3> points(numPoints), pts(numPoints), ptsRef(numPoints), ptsD3DX(numPoints);
+	for (int i = 0; i < numPoints; ++i)
+		points[i] = Vec3((float)(i % 1024) * 0.1f - 51.2f, (float)(i % 7) - 3.0f, (float)(i / 1024) * 0.1f - 51.2f);
+
+	printf("%-22s %10s %10s %10s %12s\n", "ns per element", "D3DX", "scalar", "SimdMath", "max |diff|");
+
+	// Matrix multiply.
+	double d3dx = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			D3DXMatrixMultiply(&AsD3DX(outD3DX[i]), &AsD3DX(world[i]), &AsD3DX(viewProj));
+	});
+	double ref = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			RefMultiply(&outRef[i], &world[i], &viewProj);
+	});
+	double simd = BenchRepeat([&] { Mat4MultiplyArray(&out[0], &world[0], &viewProj, numMats); });
+	PrintRow("Mat4Multiply", numMats, d3dx, ref, simd,
+		MaxDiff(&out[0]._11, &outD3DX[0]._11, numMats*16));
+
+	// Inverse.
+	d3dx = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			D3DXMatrixInverse(&AsD3DX(outD3DX[i]), 0, &AsD3DX(world[i]));
+	});
+	simd = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			Mat4Inverse(&out[i], 0, &world[i]);
+	});
+	PrintRow("Mat4Inverse", numMats, d3dx, 0.0, simd,
+		MaxDiff(&out[0]._11, &outD3DX[0]._11, numMats*16));
+
+	// Point transforms: AoS through the stride API, then SoA.
+	d3dx = BenchRepeat([&] {
+		D3DXVec3TransformCoordArray(&AsD3DX(ptsD3DX[0]), sizeof(Vec3),
+			&AsD3DX(points[0]), sizeof(Vec3), &AsD3DX(viewProj), numPoints);
+	});
+	ref = BenchRepeat([&] {
+		for (int i = 0; i < numPoints; ++i)
+			RefTransformCoord(&ptsRef[i], &points[i], &viewProj);
+	});
+	simd = BenchRepeat([&] {
+		Vec3TransformCoordArray(&pts[0], sizeof(Vec3), &points[0], sizeof(Vec3), &viewProj, numPoints);
+	});
+	PrintRow("Vec3TransformCoord", numPoints, d3dx, ref, simd,
+		MaxDiff(&pts[0].x, &ptsD3DX[0].x, numPoints*3));
+
+	std::vector<float> x(numPoints), y(numPoints), z(numPoints);
+	for (int i = 0; i < numPoints; ++i)
+	{
+		x[i] = points[i].x;
+		y[i] = points[i].y;
+		z[i] = points[i].z;
+	}
+	std::vector<float> ox(numPoints), oy(numPoints), oz(numPoints);
+	simd = BenchRepeat([&] {
+		Vec3TransformCoordSoA(&ox[0], &oy[0], &oz[0], &x[0], &y[0], &z[0], &viewProj, numPoints);
+	});
+	float err = 0.0f;
+	for (int i = 0; i < numPoints; ++i)
+	{
+		err = std::max(err, fabsf(ox[i] - ptsD3DX[i].x));
+		err = std::max(err, fabsf(oy[i] - ptsD3DX[i].y));
+		err = std::max(err, fabsf(oz[i] - ptsD3DX[i].z));
+	}
+	PrintRow("Vec3TransformCoordSoA", numPoints, d3dx, ref, simd, err);
+
+	// Quaternion slerp and conversion.
+	std::vector<Quat> qa(numMats), qb(numMats), q(numMats), qD3DX(numMats);
+	for (int i = 0; i < numMats; ++i)
+	{
+		QuatRotationMatrix(&qa[i], &world[i]);
+		QuatRotationMatrix(&qb[i], &world[(i * 17) % numMats]);
+	}
+	d3dx = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			D3DXQuaternionSlerp(&AsD3DX(qD3DX[i]), &AsD3DX(qa[i]), &AsD3DX(qb[i]), 0.3f);
+	});
+	simd = BenchRepeat([&] {
+		for (int i = 0; i < numMats; ++i)
+			QuatSlerp(&q[i], &qa[i], &qb[i], 0.3f);
+	});
+	PrintRow("QuatSlerp", numMats, d3dx, 0.0, simd,
+		MaxDiff(&q[0].x, &qD3DX[0].x, numMats*4));
+
+	// Round trips that need no D3DX: M*inverse(M) and quaternion -> matrix.
+	float invErr = 0.0f, quatErr = 0.0f;
+	for (int i = 0; i < numMats; ++i)
+	{
+		Mat4 inv, prod, identity, rot;
+		Mat4Inverse(&inv, 0, &world[i]);
+		Mat4Multiply(&prod, &world[i], &inv);
+		invErr = std::max(invErr, MaxDiff(&prod._11, &Mat4Identity(&identity)->_11, 16));
+
+		Mat4RotationQuaternion(&rot, &qa[i]);
+		for (int r = 0; r < 3; ++r)
+			quatErr = std::max(quatErr, MaxDiff(rot.m[r], world[i].m[r], 3));
+	}
+	printf("\nmax |M*inverse(M) - I| = %.2e, max |rotation(quat(M)) - M| = %.2e\n", invErr, quatErr);
+}
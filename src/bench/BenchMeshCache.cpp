@@ -0,0 +1,109 @@
+#include "Bench.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+void BenchMeshCache()
+{
+	// The demo meshes as XFileDemo, BoundingBoxDemo and RobotArmDemo
+	// load them, relative to bin/<platform> like the demos' own paths.
+	const wchar_t* files[] = {
+		L"../../src/chap14/XFileDemo/Dwarf.x",
+		L"../../src/chap14/XFileDemo/skullocc.x",
+		L"../../src/chap14/XFileDemo/bigship1.x",
+		L"../../src/chap14/XFileDemo/car.x",
+		L"../../src/chap14/BoundingBoxDemo/tiger.x",
+		L"../../src/chap15/RobotArmDemo/bone.x",
+	};
+	const int lodCounts[] = { 1, 4 };
+
+	// The device-free part of a mesh's startup, without and with its
+	// cache: "build" is BuildMeshLevels (parse, normals, LOD chain,
+	// OptimizeMesh), which every launch did before the cache; "load" is
+	// hashing the .x file and LoadMeshCache (map, check, copy).  The
+	// caches go to the temp directory, leaving the assets alone.
+	wchar_t tempDir[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempDir);
+
+	printf("%-12s %6s %8s %9s %10s %10s %8s\n", "file", "levels", "tris", "cache KB", "build ms", "load ms", "speedup");
+
+	double totalBuild[2] = { 0.0, 0.0 }, totalLoad[2] = { 0.0, 0.0 };
+	for (int i = 0; i < sizeof(files)/sizeof(files[0]); ++i)
+	{
+		std::wstring path(files[i]);
+		std::wstring leaf = path.substr(path.rfind(L'/') + 1);
+		std::string name(leaf.begin(), leaf.end());
+
+		MappedFile file;
+		if (!file.open(path))
+		{
+			printf("%-12s failed: could not open file\n", name.c_str());
+			continue;
+		}
+
+		for (int l = 0; l < sizeof(lodCounts)/sizeof(lodCounts[0]); ++l)
+		{
+			int numLods = lodCounts[l];
+
+			std::vector<MeshCacheLevel> levels;
+			std::vector<Material> materials;
+			std::vector<std::string> textureNames;
+			std::string error;
+			bool built = true;
+			double build = BenchRepeat([&] {
+				materials.clear();
+				textureNames.clear();
+				built = BuildMeshLevels(file.getData(), file.getSize(), numLods, levels, materials, textureNames, &error);
+			});
+			if (!built)
+			{
+				printf("%-12s failed: %s\n", name.c_str(), error.c_str());
+				break;
+			}
+
+			std::wstring cacheFilename = std::wstring(tempDir) + L"bench_" + leaf + L".mcache";
+			unsigned __int64 sourceHash = HashBytes(file.getData(), file.getSize());
+			if (!SaveMeshCache(cacheFilename, sourceHash, file.getSize(), numLods, levels, materials, textureNames))
+			{
+				printf("%-12s could not write cache\n", name.c_str());
+				break;
+			}
+
+			DWORD numTris = (DWORD)levels[0].attributes.size();
+			size_t numLevels = levels.size();
+			size_t cacheBytes = 0;
+			{
+				MappedFile cache;
+				if (cache.open(cacheFilename))
+					cacheBytes = cache.getSize();
+			}
+
+			bool loaded = true;
+			double load = BenchRepeat([&] {
+				materials.clear();
+				textureNames.clear();
+				loaded = LoadMeshCache(cacheFilename, HashBytes(file.getData(), file.getSize()), file.getSize(),
+					numLods, levels, materials, textureNames);
+			});
+			DeleteFileW(cacheFilename.c_str());
+
+			if (!loaded || levels.size() != numLevels)
+			{
+				printf("%-12s could not read back its cache\n", name.c_str());
+				break;
+			}
+
+			printf("%-12s %6u %8u %9.1f %10.3f %10.3f %7.1fx\n", name.c_str(), (unsigned)numLevels, numTris,
+				cacheBytes / 1024.0, build * 1000.0, load * 1000.0, build / load);
+			totalBuild[l] += build;
+			totalLoad[l]  += load;
+		}
+	}
+
+	for (int l = 0; l < sizeof(lodCounts)/sizeof(lodCounts[0]); ++l)
+	{
+		if (totalLoad[l] > 0.0)
+			printf("\nall files, %d lod%s: build %.2f ms, load %.2f ms, %.1fx", lodCounts[l], lodCounts[l] > 1 ? "s" : "",
+				totalBuild[l] * 1000.0, totalLoad[l] * 1000.0, totalBuild[l] / totalLoad[l]);
+	}
+	printf("\n");
+}
@@ -0,0 +1,221 @@
+#include "Bench.h"
+#include "XFile.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+
+namespace
+{
+	// Faces sorted by subset and put in cache order, as AssetLoader
+	// leaves them.
+	struct MeshletSource
+	{
+		std::vector<XFileVertex> vertices;
+		std::vector<DWORD> indices;
+		std::vector<D3DXATTRIBUTERANGE> table;
+		BoundingSphere bounds;
+	};
+
+	void Prepare(XFileMesh& mesh, MeshletSource& source)
+	{
+		DWORD numFaces = (DWORD)mesh.attributes.size();
+		DWORD numMaterials = (DWORD)mesh.materials.size();
+
+		std::vector<DWORD> faceStart(numMaterials + 1, 0);
+		for (DWORD i = 0; i < numFaces; ++i)
+			++faceStart[mesh.attributes[i] + 1];
+		for (DWORD i = 0; i < numMaterials; ++i)
+			faceStart[i + 1] += faceStart[i];
+
+		source.indices.resize(numFaces * 3);
+		std::vector<DWORD> next(faceStart.begin(), faceStart.end() - 1);
+		for (DWORD i = 0; i < numFaces; ++i)
+		{
+			DWORD f = next[mesh.attributes[i]]++;
+			for (int k = 0; k < 3; ++k)
+				source.indices[f*3 + k] = mesh.indices[i*3 + k];
+		}
+
+		for (DWORD a = 0; a < numMaterials; ++a)
+		{
+			if (faceStart[a + 1] == faceStart[a])
+				continue;
+
+			D3DXATTRIBUTERANGE range = { a, faceStart[a], faceStart[a + 1] - faceStart[a], 0, 0 };
+			source.table.push_back(range);
+		}
+
+		source.vertices.swap(mesh.vertices);
+		DWORD numUsed = OptimizeMesh(&source.indices[0], &source.table[0], (DWORD)source.table.size(),
+			&source.vertices[0], (DWORD)source.vertices.size(), sizeof(XFileVertex));
+		source.vertices.resize(numUsed);
+
+		AABB box;
+		for (DWORD v = 0; v < numUsed; ++v)
+		{
+			const D3DXVECTOR3& p = *(const D3DXVECTOR3*)source.vertices[v].pos;
+			D3DXVec3Minimize(&box.minPt, &box.minPt, &p);
+			D3DXVec3Maximize(&box.maxPt, &box.maxPt, &p);
+		}
+		source.bounds.pos = box.center();
+		D3DXVECTOR3 halfExtent = 0.5f * (box.maxPt - box.minPt);
+		source.bounds.radius = D3DXVec3Length(&halfExtent);
+	}
+
+	struct View
+	{
+		D3DXPLANE planes[6];
+		D3DXVECTOR3 eyePos;
+	};
+
+	// Views from all round the mesh, either far enough to frame all of
+	// it or close and aimed to one side so part of it is off screen.
+	void BuildViews(const BoundingSphere& bounds, bool close, View* views, int numViews)
+	{
+		D3DXMATRIX proj;
+		D3DXMatrixPerspectiveFovLH(&proj, D3DX_PI * 0.25f, 4.0f/3.0f, bounds.radius * 0.01f, bounds.radius * 10.0f);
+
+		for (int i = 0; i < numViews; ++i)
+		{
+			float theta = 2.0f * D3DX_PI * i / numViews;
+			float phi   = (i % 2 ? 0.3f : -0.2f) * D3DX_PI;
+			float distance = bounds.radius * (close ? 1.6f : 3.0f);
+
+			D3DXVECTOR3 dir(cosf(phi) * cosf(theta), sinf(phi), cosf(phi) * sinf(theta));
+			D3DXVECTOR3 eye = bounds.pos + distance * dir;
+			D3DXVECTOR3 target = bounds.pos;
+			if (close)
+				target += 0.6f * bounds.radius * D3DXVECTOR3(-sinf(theta), 0.0f, cosf(theta));
+
+			D3DXMATRIX view;
+			D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
+			D3DXMatrixLookAtLH(&view, &eye, &target, &up);
+			ExtractFrustumPlanes(view * proj, views[i].planes);
+			views[i].eyePos = eye;
+		}
+	}
+
+	// How many triangles face away from the eye, the most any backface
+	// culling could drop.
+	DWORD CountBackFacing(const MeshletSource& source, const D3DXVECTOR3& eyePos)
+	{
+		DWORD count = 0;
+		for (size_t i = 0; i < source.indices.size(); i += 3)
+		{
+			const D3DXVECTOR3& p0 = *(const D3DXVECTOR3*)source.vertices[source.indices[i + 0]].pos;
+			const D3DXVECTOR3& p1 = *(const D3DXVECTOR3*)source.vertices[source.indices[i + 1]].pos;
+			const D3DXVECTOR3& p2 = *(const D3DXVECTOR3*)source.vertices[source.indices[i + 2]].pos;
+
+			D3DXVECTOR3 e1 = p1 - p0;
+			D3DXVECTOR3 e2 = p2 - p0;
+			D3DXVECTOR3 n, toEye = eyePos - p0;
+			D3DXVec3Cross(&n, &e1, &e2);
+			count += D3DXVec3Dot(&n, &toEye) <= 0.0f;
+		}
+		return count;
+	}
+}
+
+void BenchMeshlets()
+{
+	const wchar_t* files[] = {
+		L"../../src/chap14/XFileDemo/skullocc.x",
+		L"../../src/chap14/XFileDemo/bigship1.x",
+		L"../../src/chap14/XFileDemo/Dwarf.x",
+		L"../../src/chap14/XFileDemo/car.x",
+	};
+	const int NUM_VIEWS = 16;
+
+	// Meshlets of at most 64 vertices and 124 triangles.  The views'
+	// figures are averages over NUM_VIEWS: meshlets culled by each test
+	// and drawn, then the triangles culled, and those facing away, which
+	// is all that per-triangle backface culling could drop.
+	printf("%-12s %6s %8s %8s %7s %7s %9s  %-5s %8s %8s %8s %8s %8s %9s %9s\n", "file", "tris", "meshlets",
+		"tris/ml", "vtx/ml", "cone%", "build ms", "view", "frust%", "back%", "drawn%", "tricull%", "backtri%",
+		"cull us", "+copy us");
+
+	for (int i = 0; i < sizeof(files)/sizeof(files[0]); ++i)
+	{
+		std::wstring path(files[i]);
+		std::string name(path.begin() + path.rfind(L'/') + 1, path.end());
+
+		XFileMesh mesh;
+		std::string error;
+		if (!LoadXFileMesh(path, &mesh, &error))
+		{
+			printf("%-12s failed: %s\n", name.c_str(), error.c_str());
+			continue;
+		}
+
+		MeshletSource source;
+		Prepare(mesh, source);
+		DWORD numTriangles = (DWORD)source.indices.size() / 3;
+
+		std::vector<Meshlet> meshlets;
+		std::vector<DWORD> meshletIndices;
+		double seconds = BenchRepeat([&] {
+			BuildMeshlets(&source.indices[0], &source.table[0], (DWORD)source.table.size(),
+				(const D3DXVECTOR3*)source.vertices[0].pos, (DWORD)source.vertices.size(), sizeof(XFileVertex),
+				meshlets, meshletIndices);
+		});
+
+		DWORD numMeshlets = (DWORD)meshlets.size();
+		DWORD numVertices = 0, numCones = 0;
+		for (DWORD m = 0; m < numMeshlets; ++m)
+		{
+			numVertices += meshlets[m].numVertices;
+			numCones += meshlets[m].coneCutoff < 1.0f;
+		}
+
+		printf("%-12s %6u %8u %8.1f %7.1f %7.1f %9.3f", name.c_str(), numTriangles, numMeshlets,
+			(float)numTriangles / numMeshlets, (float)numVertices / numMeshlets,
+			100.0f * numCones / numMeshlets, seconds * 1000.0);
+
+		std::vector<DWORD> out(meshletIndices.size());
+		std::vector<D3DXATTRIBUTERANGE> ranges(source.table.size());
+		for (int close = 0; close < 2; ++close)
+		{
+			View views[NUM_VIEWS];
+			BuildViews(source.bounds, close != 0, views, NUM_VIEWS);
+
+			DWORD frustumCulled = 0, backfaceCulled = 0, drawn = 0, backFacing = 0;
+			for (int v = 0; v < NUM_VIEWS; ++v)
+			{
+				MeshletCullStats stats;
+				CullMeshlets(&meshlets[0], numMeshlets, &meshletIndices[0], &source.table[0], (DWORD)source.table.size(),
+					views[v].planes, views[v].eyePos, &out[0], &ranges[0], &stats);
+				frustumCulled  += stats.numFrustumCulled;
+				backfaceCulled += stats.numBackfaceCulled;
+				drawn          += stats.numTrianglesDrawn;
+				backFacing     += CountBackFacing(source, views[v].eyePos);
+			}
+
+			// The tests alone, then with the surviving indices copied out.
+			DWORD visible = 0;
+			double cullSeconds = BenchRepeat([&] {
+				visible = 0;
+				for (int v = 0; v < NUM_VIEWS; ++v)
+				{
+					for (DWORD m = 0; m < numMeshlets; ++m)
+						visible += IsMeshletVisible(meshlets[m], views[v].planes, views[v].eyePos);
+				}
+			}) / NUM_VIEWS;
+
+			double copySeconds = BenchRepeat([&] {
+				for (int v = 0; v < NUM_VIEWS; ++v)
+				{
+					CullMeshlets(&meshlets[0], numMeshlets, &meshletIndices[0], &source.table[0], (DWORD)source.table.size(),
+						views[v].planes, views[v].eyePos, &out[0], &ranges[0]);
+				}
+			}) / NUM_VIEWS;
+
+			float total = (float)numMeshlets * NUM_VIEWS;
+			float totalTriangles = (float)numTriangles * NUM_VIEWS;
+			if (close)
+				printf("%-12s %6s %8s %8s %7s %7s %9s", "", "", "", "", "", "", "");
+			printf("  %-5s %8.1f %8.1f %8.1f %8.1f %8.1f %9.2f %9.2f\n", close ? "close" : "orbit",
+				100.0f * frustumCulled / total, 100.0f * backfaceCulled / total, 100.0f * visible / total,
+				100.0f * (1.0f - drawn / totalTriangles), 100.0f * backFacing / totalTriangles,
+				cullSeconds * 1e6, copySeconds * 1e6);
+		}
+	}
+}
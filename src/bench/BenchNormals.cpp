@@ -0,0 +1,169 @@
+#include "Bench.h"
+#include "TriGrid.h"
+#include "ThreadPool.h"
+#include "Normals.h"
+#include <algorithm>
+
+namespace
+{
+	// Serial scatter over the faces, the way D3DXComputeNormals-style
+	// code usually does it, with an exact acos for the angles.  The
+	// reference for both timing and error.
+	void ComputeNormalsReference(const std::vector<D3DXVECTOR3>& positions, const std::vector<DWORD>& indices,
+		NormalWeighting weighting, std::vector<D3DXVECTOR3>& normals)
+	{
+		normals.assign(positions.size(), D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const D3DXVECTOR3& p0 = positions[indices[i + 0]];
+			const D3DXVECTOR3& p1 = positions[indices[i + 1]];
+			const D3DXVECTOR3& p2 = positions[indices[i + 2]];
+
+			D3DXVECTOR3 e1 = p1 - p0, e2 = p2 - p0, e3 = p2 - p1;
+			D3DXVECTOR3 n;
+			D3DXVec3Cross(&n, &e1, &e2);
+			if (weighting == NORMALS_AREA_WEIGHTED)
+			{
+				for (int k = 0; k < 3; ++k)
+					normals[indices[i + k]] += n;
+				continue;
+			}
+
+			float length = D3DXVec3Length(&n);
+			if (length == 0.0f)
+				continue;
+			n /= length;
+
+			float l1 = D3DXVec3Length(&e1), l2 = D3DXVec3Length(&e2), l3 = D3DXVec3Length(&e3);
+			float c[3] = {
+				 D3DXVec3Dot(&e1, &e2) / (l1 * l2),
+				-D3DXVec3Dot(&e1, &e3) / (l1 * l3),
+				 D3DXVec3Dot(&e2, &e3) / (l2 * l3)
+			};
+			for (int k = 0; k < 3; ++k)
+				normals[indices[i + k]] += acosf(std::max(-1.0f, std::min(1.0f, c[k]))) * n;
+		}
+
+		for (size_t v = 0; v < normals.size(); ++v)
+		{
+			if (D3DXVec3LengthSq(&normals[v]) > 0.0f)
+				D3DXVec3Normalize(&normals[v], &normals[v]);
+		}
+	}
+
+	// Largest angle in degrees between matching unit normals, from the
+	// chord between them; acos of their dot can't resolve small angles.
+	float MaxErrorDegrees(const std::vector<D3DXVECTOR3>& a, const std::vector<D3DXVECTOR3>& b)
+	{
+		float maxChord = 0.0f;
+		for (size_t v = 0; v < a.size(); ++v)
+		{
+			D3DXVECTOR3 d = a[v] - b[v];
+			maxChord = std::max(maxChord, D3DXVec3Length(&d));
+		}
+		return D3DXToDegree(2.0f * asinf(std::min(1.0f, 0.5f * maxChord)));
+	}
+
+	// Rolling hills, plus terraces with steep risers so the smoothing
+	// angle has creases to find.
+	float Height(int r, int c, bool terraced)
+	{
+		float x = (float)c, z = (float)r;
+		float h = 30.0f * sinf(0.013f*x) * cosf(0.011f*z) + 4.0f * sinf(0.07f*x + 0.3f) * sinf(0.05f*z);
+		return terraced ? 6.0f * floorf(h / 6.0f) : h;
+	}
+}
+
+void BenchNormals()
+{
+	// 708x708 vertices is just over a million triangles.
+	const int n = 708;
+	const float dx = 1.0f;
+	const float dz = 1.0f;
+
+	ThreadPool pool;
+
+	std::vector<D3DXVECTOR3> positions((size_t)n * n);
+	std::vector<DWORD> indices((size_t)(n-1) * (n-1) * 6);
+	std::vector<float> heights((size_t)n * n);
+	GenTriGrid(n, n, dx, dz, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &positions[0], &indices[0]);
+	for (int r = 0; r < n; ++r)
+	{
+		for (int c = 0; c < n; ++c)
+		{
+			heights[r*n + c] = Height(r, c, false);
+			positions[r*n + c].y = heights[r*n + c];
+		}
+	}
+
+	DWORD numVertices = (DWORD)positions.size();
+	DWORD numIndices = (DWORD)indices.size();
+	double numTris = numIndices / 3.0;
+
+	VertexFaceAdjacency adjacency;
+	double adjacencySeconds = BenchRepeat([&] {
+		BuildVertexFaceAdjacency(&indices[0], numIndices, numVertices, adjacency);
+	});
+	double weldedSeconds = BenchRepeat([&] {
+		BuildVertexFaceAdjacency(&indices[0], numIndices, numVertices, adjacency, &positions[0], sizeof(D3DXVECTOR3));
+	});
+	printf("%.0f triangles, %u vertices; adjacency %.1f ms, welded by position %.1f ms\n\n",
+		numTris, numVertices, adjacencySeconds * 1000.0, weldedSeconds * 1000.0);
+
+	// Million triangles a second through each path.  The indexed mesh
+	// uses the welded adjacency, the grids none at all.  Errors are
+	// against the scalar reference's normals.
+	printf("%-8s %-6s %10s %10s %10s %10s\n", "input", "weight", "ref Mt/s", "serial", "mt Mt/s", "max deg");
+
+	const char* inputs[] = { "indexed", "grid", "height" };
+	const char* weights[] = { "angle", "area" };
+	std::vector<D3DXVECTOR3> reference, normals(numVertices);
+	for (int w = 0; w < 2; ++w)
+	{
+		NormalWeighting weighting = w == 0 ? NORMALS_ANGLE_WEIGHTED : NORMALS_AREA_WEIGHTED;
+		double ref = BenchRepeat([&] {
+			ComputeNormalsReference(positions, indices, weighting, reference);
+		});
+
+		for (int i = 0; i < 3; ++i)
+		{
+			auto run = [&](ThreadPool* p) {
+				if (i == 0)
+					ComputeVertexNormals(&positions[0], sizeof(D3DXVECTOR3), numVertices, &indices[0], numIndices,
+						adjacency, &normals[0], sizeof(D3DXVECTOR3), weighting, p);
+				else if (i == 1)
+					ComputeGridNormals(&positions[0], sizeof(D3DXVECTOR3), n, n, &normals[0], sizeof(D3DXVECTOR3), weighting, p);
+				else
+					ComputeHeightGridNormals(&heights[0], n, n, dx, dz, &normals[0], sizeof(D3DXVECTOR3), weighting, p);
+			};
+			double serial = BenchRepeat([&] { run(0); });
+			double mt = BenchRepeat([&] { run(&pool); });
+
+			printf("%-8s %-6s %10.1f %10.1f %10.1f %10.2e\n", inputs[i], weights[w],
+				numTris / ref * 1e-6, numTris / serial * 1e-6, numTris / mt * 1e-6,
+				MaxErrorDegrees(normals, reference));
+		}
+	}
+
+	// Creases: the terraced grid split at a 45 degree smoothing angle.
+	for (int r = 0; r < n; ++r)
+	{
+		for (int c = 0; c < n; ++c)
+			positions[r*n + c].y = Height(r, c, true);
+	}
+
+	std::vector<DWORD> splitIndices;
+	std::vector<DWORD> remap;
+	DWORD numSplit = 0;
+	auto split = [&](ThreadPool* p) {
+		splitIndices = indices;
+		numSplit = ComputeVertexNormalsSplit(&positions[0], sizeof(D3DXVECTOR3), numVertices,
+			&splitIndices[0], numIndices, D3DXToRadian(45.0f), remap, normals, NORMALS_ANGLE_WEIGHTED, p);
+	};
+	double splitSerial = BenchRepeat([&] { split(0); });
+	double splitMT = BenchRepeat([&] { split(&pool); });
+
+	printf("\nsplit at 45 deg: %u -> %u vertices, serial %.1f Mt/s, mt %.1f Mt/s\n",
+		numVertices, numSplit, numTris / splitSerial * 1e-6, numTris / splitMT * 1e-6);
+	printf("(%d threads)\n", pool.numThreads());
+}
@@ -0,0 +1,65 @@
+#include "Bench.h"
+#include "FFT.h"
+#include "Ocean.h"
+#include "ThreadPool.h"
+#include <thread>
+#include <algorithm>
+
+void BenchOcean()
+{
+	int hw = (int)std::thread::hardware_concurrency();
+	if (hw < 1) hw = 1;
+
+	// One complex inverse 2D FFT, then a whole ocean update (spectrum
+	// plus three FFTs), on 1, 2, 4, ... threads.
+	printf("%6s %8s %12s %14s\n", "size", "threads", "FFT ms", "update ms");
+
+	const int sizes[] = { 256, 512 };
+	for (int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s)
+	{
+		int n = sizes[s];
+		FFTPlan plan(n);
+
+		std::vector<float> re(n*n), im(n*n);
+		for (int i = 0; i < n*n; ++i)
+		{
+			re[i] = (float)((i * 7919) % 1000) * 0.001f - 0.5f;
+			im[i] = (float)((i * 104729) % 1000) * 0.001f - 0.5f;
+		}
+
+		for (int threads = 1; threads <= hw; threads *= 2)
+		{
+			ThreadPool pool(threads - 1);
+
+			double fft = BenchRepeat([&] { plan.transform2D(&re[0], &im[0], true, &pool); });
+
+			Ocean ocean(n, (float)n, OceanParams(), &pool);
+			float t = 0.0f;
+			double update = BenchRepeat([&] { ocean.update(t += 0.016f); });
+
+			printf("%6d %8d %12.3f %14.3f\n", n, threads, fft * 1000.0, update * 1000.0);
+		}
+	}
+
+	// Round trip accuracy: inverse(forward(x)) / n^2 against x.
+	const int n = 256;
+	FFTPlan plan(n);
+	std::vector<float> re(n*n), im(n*n);
+	for (int i = 0; i < n*n; ++i)
+	{
+		re[i] = sinf(0.37f*i);
+		im[i] = cosf(0.11f*i);
+	}
+	std::vector<float> re0 = re, im0 = im;
+
+	plan.transform2D(&re[0], &im[0], false);
+	plan.transform2D(&re[0], &im[0], true);
+
+	float maxErr = 0.0f;
+	for (int i = 0; i < n*n; ++i)
+	{
+		maxErr = std::max(maxErr, fabsf(re[i] / (n*n) - re0[i]));
+		maxErr = std::max(maxErr, fabsf(im[i] / (n*n) - im0[i]));
+	}
+	printf("256x256 round trip max error %.3g\n", maxErr);
+}
@@ -0,0 +1,88 @@
+#include "Bench.h"
+#include "HeightPalette.h"
+#include "WaveField.h"
+
+// The original GetColorFromHeight, as a CPU port would have it.
+static D3DCOLOR ColorFromHeightChain(float y)
+{
+	float absy = fabsf(y);
+	if (absy <= 0.2f) return D3DCOLOR_XRGB(0, 0, 0);
+	else if (absy <= 0.4f) return D3DCOLOR_XRGB(0, 0, 255);
+	else if (absy <= 0.6f) return D3DCOLOR_XRGB(0, 255, 0);
+	else if (absy <= 0.8f) return D3DCOLOR_XRGB(255, 0, 0);
+	else return D3DCOLOR_XRGB(255, 255, 0);
+}
+
+// The same chain generalized to any number of bands.
+static D3DCOLOR ColorFromHeightSearch(const std::vector<HeightBand>& bands, float y)
+{
+	float absy = fabsf(y);
+	for (size_t b = 0; b + 1 < bands.size(); ++b)
+	{
+		if (absy <= bands[b].maxHeight)
+			return bands[b].color;
+	}
+	return bands.back().color;
+}
+
+void BenchPalette()
+{
+	// Real wave heights, so the branches see the demo's distribution.
+	const int side = 1025;
+	const int n = side*side;
+
+	WaveField field(side, side, 0.05f, 0.05f, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+	field.update(3.0f);
+	const float* heights = field.getHeights();
+
+	std::vector<D3DCOLOR> colors(n);
+
+	double chain = BenchRepeat([&] {
+		for (int i = 0; i < n; ++i)
+			colors[i] = ColorFromHeightChain(heights[i]);
+	});
+	printf("%d samples, 5-band if/else chain: %.2f ns/sample\n\n", n, chain / n * 1e9);
+
+	printf("%6s %14s %14s\n", "bands", "search ns", "LUT ns");
+
+	const int bandCounts[] = { 5, 16, 64, 256 };
+	for (int c = 0; c < sizeof(bandCounts)/sizeof(bandCounts[0]); ++c)
+	{
+		int numBands = bandCounts[c];
+
+		std::vector<HeightBand> bands(numBands);
+		for (int b = 0; b < numBands; ++b)
+		{
+			bands[b].maxHeight = b + 1 < numBands ? (b + 1) * 1.0f / (numBands - 1) : FLT_MAX;
+			bands[b].color = D3DCOLOR_XRGB(b * 255 / numBands, 255 - b * 255 / numBands, (b * 37) & 255);
+		}
+
+		HeightPalette palette(&bands[0], numBands, 1.0f);
+
+		double search = BenchRepeat([&] {
+			for (int i = 0; i < n; ++i)
+				colors[i] = ColorFromHeightSearch(bands, heights[i]);
+		});
+		double lut = BenchRepeat([&] { palette.lookup(heights, n, &colors[0]); });
+
+		printf("%6d %14.2f %14.2f\n", numBands, search / n * 1e9, lut / n * 1e9);
+	}
+
+	// The five demo bands: how many samples land in a different band
+	// because of the 1/256 quantization.
+	const HeightBand demoBands[] =
+	{
+		{ 0.2f, D3DCOLOR_XRGB(0,   0,   0)   },
+		{ 0.4f, D3DCOLOR_XRGB(0,   0,   255) },
+		{ 0.6f, D3DCOLOR_XRGB(0,   255, 0)   },
+		{ 0.8f, D3DCOLOR_XRGB(255, 0,   0)   },
+		{ FLT_MAX, D3DCOLOR_XRGB(255, 255, 0) },
+	};
+	HeightPalette palette(demoBands, 5, 1.0f);
+	palette.lookup(heights, n, &colors[0]);
+
+	int differ = 0;
+	for (int i = 0; i < n; ++i)
+		differ += colors[i] != ColorFromHeightChain(heights[i]);
+	printf("\ndemo palette vs chain: %d of %d samples differ (|y| within 1/256 of a band edge)\n", differ, n);
+}
@@ -0,0 +1,146 @@
+#include "Bench.h"
+#include "XFile.h"
+#include "MeshSimplify.h"
+#include "Normals.h"
+#include "ThreadPool.h"
+#include "TriGrid.h"
+#include <algorithm>
+
+namespace
+{
+	// Edges with no face along them the other way: a mesh's border.
+	DWORD CountOpenEdges(const std::vector<DWORD>& indices)
+	{
+		std::vector<unsigned __int64> edges(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			DWORD a = indices[i];
+			DWORD b = indices[i % 3 == 2 ? i - 2 : i + 1];
+			edges[i] = (unsigned __int64)a << 32 | b;
+		}
+		std::sort(edges.begin(), edges.end());
+
+		DWORD open = 0;
+		for (size_t i = 0; i < edges.size(); ++i)
+		{
+			unsigned __int64 opposite = edges[i] << 32 | edges[i] >> 32;
+			if (!std::binary_search(edges.begin(), edges.end(), opposite))
+				++open;
+		}
+		return open;
+	}
+
+	// A flat strip two vertices wide in one subset, so every vertex is
+	// on the border and may only collapse along it: every level should
+	// have half the faces of the one before.  Falling short means the
+	// open edge loops have come apart.
+	void CheckOpenBorder()
+	{
+		const int rows = 2;
+		const int cols = 257;
+		std::vector<D3DXVECTOR3> positions(rows * cols);
+		std::vector<DWORD> indices((rows-1) * (cols-1) * 6);
+		GenTriGrid(rows, cols, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &positions[0], &indices[0]);
+
+		std::vector<VertexPNT> vertices(rows * cols);
+		for (int i = 0; i < rows * cols; ++i)
+		{
+			vertices[i].pos    = positions[i];
+			vertices[i].normal = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+			vertices[i].tex0   = D3DXVECTOR2(positions[i].x / cols, positions[i].z / cols);
+		}
+		std::vector<DWORD> attributes((rows-1) * (cols-1) * 2, 0);
+
+		LodSource source;
+		source.vertices    = &vertices[0];
+		source.numVertices = (DWORD)vertices.size();
+		source.indices     = &indices[0];
+		source.attributes  = &attributes[0];
+		source.numFaces    = (DWORD)attributes.size();
+
+		const int numLevels = 6;
+		std::vector<LodLevel> levels;
+		BuildLodChain(source, levels, numLevels);
+
+		bool halves = levels.size() == numLevels;
+		printf("open border, %dx%d strip: levels (tris, border edges)", rows, cols);
+		for (size_t l = 0; l < levels.size(); ++l)
+		{
+			DWORD numFaces = (DWORD)levels[l].attributes.size();
+			printf(" %u (%u)", numFaces, CountOpenEdges(levels[l].indices));
+			if (l > 0 && numFaces > (DWORD)levels[l-1].attributes.size() / 2)
+				halves = false;
+		}
+		printf(" %s\n\n", halves ? "ok" : "FAILED");
+	}
+}
+
+void BenchSimplify()
+{
+	const wchar_t* files[] = {
+		L"../../src/chap14/XFileDemo/Dwarf.x",
+		L"../../src/chap14/XFileDemo/skullocc.x",
+		L"../../src/chap14/XFileDemo/bigship1.x",
+		L"../../src/chap14/XFileDemo/car.x",
+		L"../../src/chap14/BoundingBoxDemo/tiger.x",
+		L"../../src/chap15/RobotArmDemo/bone.x",
+	};
+	const int numFiles = sizeof(files)/sizeof(files[0]);
+
+	XFileMesh meshes[numFiles];
+	LodSource sources[numFiles];
+	int numSources = 0;
+	DWORD totalTris = 0;
+
+	CheckOpenBorder();
+
+	// Chains of four levels, each half the one before, as the demos
+	// ask AssetLoader for.
+	printf("%-12s %8s %8s %9s %10s  %s\n", "file", "verts", "tris", "ms", "Mtris/s", "levels (tris, error)");
+	for (int i = 0; i < numFiles; ++i)
+	{
+		std::wstring path(files[i]);
+		std::string name(path.begin() + path.rfind(L'/') + 1, path.end());
+
+		XFileMesh& mesh = meshes[numSources];
+		std::string error;
+		if (!LoadXFileMesh(path, &mesh, &error))
+		{
+			printf("%-12s failed: %s\n", name.c_str(), error.c_str());
+			continue;
+		}
+		if (!mesh.hasNormals)
+			ComputeXFileNormals(mesh);
+
+		LodSource& source = sources[numSources++];
+		source.vertices    = (const VertexPNT*)&mesh.vertices[0];
+		source.numVertices = (DWORD)mesh.vertices.size();
+		source.indices     = (const DWORD*)&mesh.indices[0];     // unsigned int, 32 bits like DWORD.
+		source.attributes  = (const DWORD*)&mesh.attributes[0];
+		source.numFaces    = (DWORD)mesh.attributes.size();
+		totalTris += source.numFaces;
+
+		std::vector<LodLevel> levels;
+		double seconds = BenchRepeat([&] { BuildLodChain(source, levels); });
+
+		printf("%-12s %8u %8u %9.3f %10.3f ", name.c_str(), source.numVertices, source.numFaces,
+			seconds * 1000.0, source.numFaces / (seconds * 1e6));
+		for (size_t l = 1; l < levels.size(); ++l)
+			printf(" %u (%.4f)", (unsigned)levels[l].attributes.size(), levels[l].error);
+		printf("\n");
+	}
+
+	// Every mesh at once, one per task, as a level loading many meshes
+	// would build them.
+	printf("\nall %d meshes, %u tris\n", numSources, totalTris);
+	printf("%8s %9s %10s\n", "threads", "ms", "Mtris/s");
+
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	std::vector<LodLevel> chains[numFiles];
+	for (int t = 0; t < sizeof(threadCounts)/sizeof(threadCounts[0]); ++t)
+	{
+		ThreadPool pool(threadCounts[t] - 1);
+		double seconds = BenchRepeat([&] { BuildLodChains(sources, chains, numSources, &pool); });
+		printf("%8d %9.3f %10.3f\n", threadCounts[t], seconds * 1000.0, totalTris / (seconds * 1e6));
+	}
+}
@@ -0,0 +1,156 @@
+#include "Bench.h"
+#include "Skeleton.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+// Deterministic pseudo-random numbers for the tree shapes and poses.
+static unsigned gSeed = 12345;
+static unsigned NextRandom()
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return gSeed >> 8;
+}
+
+static float RandomAngle()
+{
+	return (NextRandom() % 6283) * 0.001f;
+}
+
+// Builds a skeleton of numBones bones, either one chain (the robot arm
+// taken to extremes) or a random tree where each bone hangs off any
+// earlier bone, and poses every bone.
+static void BuildSkeleton(Skeleton& skeleton, int numBones, bool chain)
+{
+	skeleton = Skeleton();
+	for (int i = 0; i < numBones; ++i)
+	{
+		int parent = i == 0 ? -1 : (chain ? i - 1 : (int)(NextRandom() % i));
+
+		D3DXVECTOR3 axis((float)(NextRandom() % 100) + 1.0f, (float)(NextRandom() % 100), (float)(NextRandom() % 100));
+		D3DXVECTOR3 pos(1.0f, 0.0f, 0.0f);
+		Quat q;
+		QuatRotationAxis(&q, &FromD3DX(axis), RandomAngle() * 0.05f);
+		skeleton.addBone(parent, pos, AsD3DX(q));
+	}
+}
+
+// What the demo used to do: every bone multiplies its way up the whole
+// parent chain, O(depth) per bone.
+static void UpdateByChainWalk(const Skeleton& skeleton, std::vector<D3DXMATRIX>& toWorld)
+{
+	int n = skeleton.numBones();
+	for (int i = 0; i < n; ++i)
+	{
+		Mat4 M = FromD3DX(skeleton.getToParent(i));
+		for (int p = skeleton.getParent(i); p >= 0; p = skeleton.getParent(p))
+			Mat4Multiply(&M, &M, &FromD3DX(skeleton.getToParent(p)));
+		Mat4Multiply(&FromD3DX(toWorld[i]), &M, &FromD3DX(skeleton.getRootTransform()));
+	}
+}
+
+void BenchSkeleton()
+{
+	printf("%8s %16s %16s %16s %12s\n", "bones", "chain ns/bone", "walk ns/bone", "tree ns/bone", "max rel diff");
+
+	const int boneCounts[] = { 5, 50, 500, 1000, 5000, 10000 };
+	for (int c = 0; c < sizeof(boneCounts)/sizeof(boneCounts[0]); ++c)
+	{
+		int n = boneCounts[c];
+
+		Skeleton chain;
+		BuildSkeleton(chain, n, true);
+		double chainTime = BenchRepeat([&] { chain.updateAll(); });
+
+		// The chain walk is quadratic; keep its timing short.
+		std::vector<D3DXMATRIX> walked(n);
+		double walkTime = BenchRepeat([&] { UpdateByChainWalk(chain, walked); }, 0.05);
+
+		// Both multiply out the same chain, in a different order, so the
+		// rounding differs more the deeper the chain.
+		float err = 0.0f;
+		for (int i = 0; i < n; ++i)
+		{
+			const float* a = &chain.getToWorld(i)._11;
+			const float* b = &walked[i]._11;
+			for (int k = 0; k < 16; ++k)
+				err = std::max(err, fabsf(a[k] - b[k]) / std::max(1.0f, fabsf(b[k])));
+		}
+
+		Skeleton tree;
+		BuildSkeleton(tree, n, false);
+		double treeTime = BenchRepeat([&] { tree.updateAll(); });
+
+		printf("%8d %16.2f %16.2f %16.2f %12.2e\n", n,
+			chainTime / n * 1e9, walkTime / n * 1e9, treeTime / n * 1e9, err);
+	}
+
+	// Incremental updates: one joint of a 10,000 bone random tree moves
+	// per frame, as in the demo.  Compare against rebuilding everything,
+	// and check the cached matrices match a full rebuild.
+	{
+		const int n = 10000;
+		const int frames = 1000;
+
+		Skeleton tree;
+		BuildSkeleton(tree, n, false);
+		tree.update();
+
+		std::vector<int> moved(frames);
+		for (int f = 0; f < frames; ++f)
+			moved[f] = NextRandom() % n;
+
+		D3DXQUATERNION q(0.0f, 0.0f, 0.0f, 1.0f);
+		long long localUpdates = 0, worldUpdates = 0;
+		BenchTimer timer;
+		for (int f = 0; f < frames; ++f)
+		{
+			tree.setRotation(moved[f], q);
+			tree.update();
+			localUpdates += tree.getNumLocalUpdates();
+			worldUpdates += tree.getNumWorldUpdates();
+		}
+		double incremental = timer.seconds() / frames;
+
+		std::vector<D3DXMATRIX> cached(tree.getToWorldArray(), tree.getToWorldArray() + n);
+		double full = BenchRepeat([&] { tree.updateAll(); });
+
+		float err = 0.0f;
+		for (int i = 0; i < n; ++i)
+		{
+			for (int k = 0; k < 16; ++k)
+				err = std::max(err, fabsf((&cached[i]._11)[k] - (&tree.getToWorld(i)._11)[k]));
+		}
+
+		printf("\n%d bones, one joint moved per frame: %.2f us/frame incremental "
+			"(%.1f local, %.1f world updates per frame), %.2f us/frame full, max |diff| %.2e\n",
+			n, incremental * 1e6, (double)localUpdates / frames, (double)worldUpdates / frames,
+			full * 1e6, err);
+	}
+
+	// Ordering an arbitrary tree: shuffle a random tree's bone indices
+	// and sort it back into parent-first order.
+	const int n = 10000;
+	std::vector<int> parents(n), shuffled(n), position(n), order(n);
+	for (int i = 0; i < n; ++i)
+	{
+		parents[i] = i == 0 ? -1 : (int)(NextRandom() % i);
+		position[i] = i;
+	}
+	for (int i = n - 1; i > 0; --i)
+		std::swap(position[i], position[NextRandom() % (i + 1)]);
+	for (int i = 0; i < n; ++i)
+		shuffled[position[i]] = parents[i] < 0 ? -1 : position[parents[i]];
+
+	bool sorted = false;
+	double sortTime = BenchRepeat([&] { sorted = SortBonesTopologically(&shuffled[0], n, &order[0]); });
+
+	std::vector<int> rank(n);
+	for (int i = 0; i < n; ++i)
+		rank[order[i]] = i;
+	bool parentFirst = sorted;
+	for (int i = 0; i < n; ++i)
+		parentFirst = parentFirst && (shuffled[i] < 0 || rank[shuffled[i]] < rank[i]);
+
+	printf("\nSortBonesTopologically, %d bones: %.2f ns/bone, parent-first order %s\n",
+		n, sortTime / n * 1e9, parentFirst ? "ok" : "FAILED");
+}
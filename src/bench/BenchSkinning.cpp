@@ -0,0 +1,184 @@
+#include "Bench.h"
+#include "SkinnedMesh.h"
+#include "Skeleton.h"
+#include "ThreadPool.h"
+#include "Vertex.h"
+#include <algorithm>
+
+namespace
+{
+	const int   NUM_BONES = 32;
+	const float BONE_LENGTH = 2.0f;
+	const int   RING_SEGMENTS = 32;
+
+	// A tube along x around a chain of bones, like a tentacle: rings of
+	// RING_SEGMENTS vertices, each weighted to the bones whose centers
+	// lie within a falloff radius that varies along the tube, so vertices
+	// have anywhere from one to four influences.
+	void BuildTube(int numRings, std::vector<VertexPNT>& verts,
+		std::vector<WORD>& boneIndices, std::vector<float>& weights)
+	{
+		int n = numRings * RING_SEGMENTS;
+		verts.resize(n);
+		boneIndices.assign(n * SKIN_MAX_INFLUENCES, 0);
+		weights.assign(n * SKIN_MAX_INFLUENCES, 0.0f);
+
+		float length = NUM_BONES * BONE_LENGTH;
+		for (int r = 0; r < numRings; ++r)
+		{
+			float x = length * r / (numRings - 1);
+			float radius = 0.6f + 1.4f * (0.5f + 0.5f * sinf(0.37f * r));
+
+			for (int s = 0; s < RING_SEGMENTS; ++s)
+			{
+				int v = r*RING_SEGMENTS + s;
+				float a = 2.0f * D3DX_PI * s / RING_SEGMENTS;
+				verts[v].pos    = D3DXVECTOR3(x, cosf(a), sinf(a));
+				verts[v].normal = D3DXVECTOR3(0.0f, cosf(a), sinf(a));
+				verts[v].tex0   = D3DXVECTOR2(x / length, (float)s / RING_SEGMENTS);
+
+				int count = 0;
+				for (int b = 0; b < NUM_BONES && count < SKIN_MAX_INFLUENCES; ++b)
+				{
+					float d = fabsf(x - (b + 0.5f) * BONE_LENGTH) / BONE_LENGTH;
+					if (d < radius || (b == NUM_BONES - 1 && count == 0))
+					{
+						boneIndices[v*SKIN_MAX_INFLUENCES + count] = (WORD)b;
+						weights[v*SKIN_MAX_INFLUENCES + count] = std::max(radius - d, 0.01f);
+						++count;
+					}
+				}
+			}
+		}
+	}
+
+	// The chain posed with every joint bent a little about z and y.
+	void PoseChain(Skeleton& skeleton, float t)
+	{
+		skeleton = Skeleton();
+		for (int b = 0; b < NUM_BONES; ++b)
+		{
+			D3DXVECTOR3 axis(0.0f, sinf(0.3f*b), 1.0f);
+			D3DXVec3Normalize(&axis, &axis);
+			D3DXQUATERNION q;
+			D3DXQuaternionRotationAxis(&q, &axis, 0.15f * sinf(t + 0.4f*b));
+			skeleton.addBone(b - 1, D3DXVECTOR3(b == 0 ? 0.0f : BONE_LENGTH, 0.0f, 0.0f), q);
+		}
+		skeleton.update();
+	}
+
+	// One vertex at a time, with the whole matrix blended in the
+	// obvious order; the reference for SkinnedMesh.
+	void SkinScalar(const std::vector<VertexPNT>& verts, const std::vector<WORD>& boneIndices,
+		const std::vector<float>& weights, const D3DXMATRIX* palette, std::vector<VertexPN>& out)
+	{
+		out.resize(verts.size());
+		for (size_t v = 0; v < verts.size(); ++v)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+				sum += weights[v*SKIN_MAX_INFLUENCES + k];
+
+			float M[4][4] = {};
+			for (int k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+			{
+				float w = weights[v*SKIN_MAX_INFLUENCES + k] / sum;
+				const D3DXMATRIX& P = palette[boneIndices[v*SKIN_MAX_INFLUENCES + k]];
+				for (int r = 0; r < 4; ++r)
+					for (int c = 0; c < 4; ++c)
+						M[r][c] += w * P.m[r][c];
+			}
+
+			const D3DXVECTOR3& p = verts[v].pos;
+			const D3DXVECTOR3& n = verts[v].normal;
+			D3DXVECTOR3 q, m;
+			for (int c = 0; c < 3; ++c)
+			{
+				q[c] = p.x*M[0][c] + p.y*M[1][c] + p.z*M[2][c] + M[3][c];
+				m[c] = n.x*M[0][c] + n.y*M[1][c] + n.z*M[2][c];
+			}
+			D3DXVec3Normalize(&m, &m);
+
+			out[v] = VertexPN(q, m);
+		}
+	}
+}
+
+void BenchSkinning()
+{
+	// Bind pose: the chain straight along x.  Offsets take mesh space to
+	// each bone's local space.
+	Skeleton bind;
+	PoseChain(bind, 0.0f);
+	for (int b = 0; b < NUM_BONES; ++b)
+		bind.setRotation(b, D3DXQUATERNION(0.0f, 0.0f, 0.0f, 1.0f));
+	bind.update();
+
+	std::vector<D3DXMATRIX> offsets(NUM_BONES);
+	for (int b = 0; b < NUM_BONES; ++b)
+		D3DXMatrixInverse(&offsets[b], 0, &bind.getToWorld(b));
+
+	Skeleton pose;
+	PoseChain(pose, 1.0f);
+	std::vector<D3DXMATRIX> palette(NUM_BONES);
+	BuildSkinPalette(pose, &offsets[0], &palette[0]);
+
+	printf("%d-bone chain, up to %d influences per vertex\n", NUM_BONES, SKIN_MAX_INFLUENCES);
+	printf("%10s %12s %14s %14s %12s %12s\n", "vertices", "influences", "scalar Mv/s", "SIMD Mv/s",
+		"max pos diff", "max nrm diff");
+
+	const int ringCounts[] = { 64, 512, 8192 };
+	std::vector<VertexPNT> verts;
+	std::vector<WORD> boneIndices;
+	std::vector<float> weights;
+	std::vector<VertexPN> reference;
+	SkinnedMesh mesh;
+
+	for (int i = 0; i < sizeof(ringCounts)/sizeof(ringCounts[0]); ++i)
+	{
+		BuildTube(ringCounts[i], verts, boneIndices, weights);
+		int n = (int)verts.size();
+		mesh.setVertices(n, &verts[0], sizeof(VertexPNT), &boneIndices[0], &weights[0], SKIN_MAX_INFLUENCES);
+
+		int numInfluences = 0;
+		for (size_t k = 0; k < weights.size(); ++k)
+			numInfluences += weights[k] > 0.0f;
+
+		double scalarSeconds = BenchRepeat([&] { SkinScalar(verts, boneIndices, weights, &palette[0], reference); });
+		double simdSeconds   = BenchRepeat([&] { mesh.skin(&palette[0]); });
+
+		double maxPosDiff = 0.0, maxNormalDiff = 0.0;
+		for (int v = 0; v < n; ++v)
+		{
+			maxPosDiff = std::max(maxPosDiff, (double)fabsf(mesh.getPositionX()[v] - reference[v].pos.x));
+			maxPosDiff = std::max(maxPosDiff, (double)fabsf(mesh.getPositionY()[v] - reference[v].pos.y));
+			maxPosDiff = std::max(maxPosDiff, (double)fabsf(mesh.getPositionZ()[v] - reference[v].pos.z));
+			maxNormalDiff = std::max(maxNormalDiff, (double)fabsf(mesh.getNormalX()[v] - reference[v].normal.x));
+			maxNormalDiff = std::max(maxNormalDiff, (double)fabsf(mesh.getNormalY()[v] - reference[v].normal.y));
+			maxNormalDiff = std::max(maxNormalDiff, (double)fabsf(mesh.getNormalZ()[v] - reference[v].normal.z));
+		}
+
+		printf("%10d %12.2f %14.1f %14.1f %12.2e %12.2e\n", n, (double)numInfluences / n,
+			n / (scalarSeconds * 1e6), n / (simdSeconds * 1e6), maxPosDiff, maxNormalDiff);
+	}
+
+	// Thread scaling on the largest mesh.
+	printf("\n%10s %14s %12s\n", "threads", "SIMD Mv/s", "identical");
+	std::vector<float> serialX(mesh.getPositionX(), mesh.getPositionX() + mesh.getNumVertices());
+	std::vector<float> serialNX(mesh.getNormalX(), mesh.getNormalX() + mesh.getNumVertices());
+
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	for (int t = 0; t < sizeof(threadCounts)/sizeof(threadCounts[0]); ++t)
+	{
+		ThreadPool pool(threadCounts[t] - 1);
+		SkinnedMesh parallel(&pool);
+		parallel.setVertices((int)verts.size(), &verts[0], sizeof(VertexPNT), &boneIndices[0], &weights[0], SKIN_MAX_INFLUENCES);
+
+		double seconds = BenchRepeat([&] { parallel.skin(&palette[0]); });
+		bool identical =
+			memcmp(parallel.getPositionX(), &serialX[0], serialX.size() * sizeof(float)) == 0 &&
+			memcmp(parallel.getNormalX(), &serialNX[0], serialNX.size() * sizeof(float)) == 0;
+
+		printf("%10d %14.1f %12s\n", threadCounts[t], verts.size() / (seconds * 1e6), identical ? "yes" : "NO");
+	}
+}
@@ -0,0 +1,86 @@
+#include "Bench.h"
+#include "Transform.h"
+#include <algorithm>
+
+// count transforms of the given class: rotations about varying axes and
+// translations, times a uniform scale, or times a non-uniform one.
+static void BuildTransforms(std::vector<Transform>& transforms, int count, AffineClass affineClass)
+{
+	transforms.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		D3DXMATRIX R, T, S;
+		D3DXVECTOR3 axis(1.0f + (i % 5), (float)(i % 7) - 3.0f, 0.5f * (i % 3));
+		D3DXMatrixRotationAxis(&R, &axis, i * 0.013f);
+		D3DXMatrixTranslation(&T, (float)(i % 64), (float)(i % 9), -(float)(i / 64));
+
+		if (affineClass == AFFINE_RIGID)
+			D3DXMatrixIdentity(&S);
+		else if (affineClass == AFFINE_UNIFORM_SCALE)
+			D3DXMatrixScaling(&S, 0.5f + (i % 4), 0.5f + (i % 4), 0.5f + (i % 4));
+		else
+			D3DXMatrixScaling(&S, 1.0f, 2.0f + (i % 3), 0.5f);
+
+		transforms[i] = Transform(S * R * T);
+	}
+}
+
+void BenchTransform()
+{
+	const int n = 4096;
+	const char* names[] = { "rigid", "uniform scale", "general" };
+
+	printf("%-14s %12s %12s %12s %12s %10s\n", "class", "D3DX ns", "classify ns",
+		"normal ns", "max |diff|", "detected");
+
+	std::vector<Transform> transforms;
+	std::vector<D3DXMATRIX> fast(n), reference(n);
+	for (int c = AFFINE_RIGID; c <= AFFINE_GENERAL; ++c)
+	{
+		BuildTransforms(transforms, n, (AffineClass)c);
+
+		int detected = 0;
+		for (int i = 0; i < n; ++i)
+			detected += transforms[i].getClass() == c;
+
+		double d3dx = BenchRepeat([&] {
+			for (int i = 0; i < n; ++i)
+			{
+				D3DXMatrixInverse(&reference[i], 0, &transforms[i].getMatrix());
+				D3DXMatrixTranspose(&reference[i], &reference[i]);
+			}
+		});
+		double classify = BenchRepeat([&] {
+			for (int i = 0; i < n; ++i)
+				transforms[i] = Transform(transforms[i].getMatrix());
+		});
+		double normal = BenchRepeat([&] { ComputeNormalMatrices(&transforms[0], n, &fast[0]); });
+
+		float err = 0.0f;
+		for (int i = 0; i < n; ++i)
+		{
+			for (int k = 0; k < 16; ++k)
+				err = std::max(err, fabsf((&fast[i]._11)[k] - (&reference[i]._11)[k]));
+		}
+
+		printf("%-14s %12.2f %12.2f %12.2f %12.2e %5d/%d\n", names[c],
+			d3dx / n * 1e9, classify / n * 1e9, normal / n * 1e9, err, detected, n);
+	}
+
+	// A planar shadow projection is singular; its normal matrix falls
+	// back to cofactors, which still map the plane's normal to itself.
+	D3DXMATRIX S;
+	D3DXVECTOR4 lightDirection(0.577f, -0.577f, 0.577f, 0.0f);
+	D3DXPLANE groundPlane(0.0f, -1.0f, 0.0f, 0.0f);
+	D3DXMatrixShadow(&S, &lightDirection, &groundPlane);
+
+	Transform shadow(S);
+	D3DXMATRIX N;
+	shadow.getNormalMatrix(&N);
+
+	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f), upW;
+	D3DXVec3TransformNormal(&upW, &up, &N);
+	D3DXVec3Normalize(&upW, &upW);
+	printf("\nshadow matrix: class %s, ground normal maps to (%.3f, %.3f, %.3f)\n",
+		names[shadow.getClass()], upW.x, upW.y, upW.z);
+}
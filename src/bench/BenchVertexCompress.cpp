@@ -0,0 +1,104 @@
+#include "Bench.h"
+#include "VertexCompress.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// VertexPNTQ16 a vertex at a time from the public scalar pieces, as the
+// reference for timing and output parity.
+static short QuantizeReference(float x, float bias, float scale)
+{
+	float u = (x - bias) * (scale > 0.0f ? 1.0f / scale : 0.0f) + 32768.0f;
+	u = std::min(std::max(u, 0.0f), 65535.0f);
+	return (short)((int)(u + 0.5f) - 32768);
+}
+
+static void CompressReference(const VertexPNT* src, DWORD numVertices, const VertexQuantization& q, VertexPNTQ16* dst)
+{
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		dst[i].pos[0] = QuantizeReference(src[i].pos.x, q.posBias.x, q.posScale.x);
+		dst[i].pos[1] = QuantizeReference(src[i].pos.y, q.posBias.y, q.posScale.y);
+		dst[i].pos[2] = QuantizeReference(src[i].pos.z, q.posBias.z, q.posScale.z);
+		dst[i].pos[3] = 0;
+
+		float e[2];
+		EncodeOctahedral(src[i].normal, e);
+		dst[i].normal[0] = (short)((int)(e[0] * 32767.0f + 32767.5f) - 32767);
+		dst[i].normal[1] = (short)((int)(e[1] * 32767.0f + 32767.5f) - 32767);
+
+		dst[i].tex0[0] = FloatToHalf(src[i].tex0.x);
+		dst[i].tex0[1] = FloatToHalf(src[i].tex0.y);
+	}
+}
+
+// A rolling height grid like the terrain and wave demos draw, with
+// analytic normals and texture coordinates tiled across it.
+static void BuildGrid(int size, std::vector<VertexPNT>& vertices)
+{
+	vertices.resize(size * size);
+	for (int i = 0; i < size; ++i)
+	{
+		for (int j = 0; j < size; ++j)
+		{
+			float x = (j - size * 0.5f) * 0.5f;
+			float z = (i - size * 0.5f) * 0.5f;
+			float y = 3.0f * sinf(0.05f * x) * cosf(0.07f * z);
+
+			D3DXVECTOR3 n(-0.15f * cosf(0.05f * x) * cosf(0.07f * z), 1.0f, 0.21f * sinf(0.05f * x) * sinf(0.07f * z));
+			D3DXVec3Normalize(&n, &n);
+
+			VertexPNT& v = vertices[i * size + j];
+			v.pos    = D3DXVECTOR3(x, y, z);
+			v.normal = n;
+			v.tex0   = D3DXVECTOR2(j / 8.0f, i / 8.0f);
+		}
+	}
+}
+
+void BenchVertexCompress()
+{
+	const int sizes[] = { 256, 1024, 2048 };
+
+	printf("%-10s %-6s %6s %9s %10s %8s %10s %8s %9s\n", "grid", "format", "bytes", "ms",
+		"Mverts/s", "GB/s", "pos max", "nrm max", "identical");
+
+	for (int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s)
+	{
+		int size = sizes[s];
+		std::vector<VertexPNT> vertices;
+		BuildGrid(size, vertices);
+		DWORD n = (DWORD)vertices.size();
+
+		char name[32];
+		sprintf_s(name, "%dx%d", size, size);
+
+		VertexQuantization q = ComputeVertexQuantization(&vertices[0], n);
+		std::vector<VertexPNT> decoded(n);
+		std::vector<VertexPNTQ16> q16(n), reference(n);
+		std::vector<VertexPNTQ12> q12(n);
+
+		// Bandwidth counts the VertexPNTs read and the result written.
+		double seconds = BenchRepeat([&] { CompressReference(&vertices[0], n, q, &reference[0]); });
+		DecompressVertices(&reference[0], n, q, &decoded[0]);
+		VertexErrorStats e = MeasureVertexError(&vertices[0], &decoded[0], n);
+		printf("%-10s %-6s %6u %9.3f %10.1f %8.2f %10.6f %8.3f %9s\n", name, "scalar", (unsigned)sizeof(VertexPNTQ16),
+			seconds * 1000.0, n / (seconds * 1e6), n * (32.0 + sizeof(VertexPNTQ16)) / (seconds * 1e9),
+			e.maxPos, e.maxNormal, "-");
+
+		seconds = BenchRepeat([&] { CompressVertices(&vertices[0], n, q, &q16[0]); });
+		bool identical = memcmp(&q16[0], &reference[0], n * sizeof(VertexPNTQ16)) == 0;
+		DecompressVertices(&q16[0], n, q, &decoded[0]);
+		e = MeasureVertexError(&vertices[0], &decoded[0], n);
+		printf("%-10s %-6s %6u %9.3f %10.1f %8.2f %10.6f %8.3f %9s\n", name, "q16", (unsigned)sizeof(VertexPNTQ16),
+			seconds * 1000.0, n / (seconds * 1e6), n * (32.0 + sizeof(VertexPNTQ16)) / (seconds * 1e9),
+			e.maxPos, e.maxNormal, identical ? "yes" : "NO");
+
+		seconds = BenchRepeat([&] { CompressVertices(&vertices[0], n, q, &q12[0]); });
+		DecompressVertices(&q12[0], n, q, &decoded[0]);
+		e = MeasureVertexError(&vertices[0], &decoded[0], n);
+		printf("%-10s %-6s %6u %9.3f %10.1f %8.2f %10.6f %8.3f %9s\n", name, "q12", (unsigned)sizeof(VertexPNTQ12),
+			seconds * 1000.0, n / (seconds * 1e6), n * (32.0 + sizeof(VertexPNTQ12)) / (seconds * 1e9),
+			e.maxPos, e.maxNormal, "-");
+	}
+}
@@ -0,0 +1,104 @@
+#include "Bench.h"
+#include "WaveField.h"
+#include "TriGrid.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Largest difference between the field's heights and the color.fx
+// formula evaluated in double precision at time t.
+static double MaxHeightError(const WaveField& field, const std::vector<D3DXVECTOR3>& pos, float t)
+{
+	double maxErr = 0.0;
+	for (size_t s = 0; s < pos.size(); ++s)
+	{
+		double d = sqrt((double)pos[s].x*pos[s].x + (double)pos[s].z*pos[s].z);
+		double h = 0.0;
+		for (int i = 0; i < field.getNumWaves(); ++i)
+		{
+			const RadialWave& w = field.getWave(i);
+			h += w.amplitude * sin(w.waveNumber*d - (double)t*w.angularFreq + w.phase);
+		}
+		maxErr = std::max(maxErr, fabs(h - field.getHeights()[s]));
+	}
+	return maxErr;
+}
+
+// The straightforward loop the engine replaces: sqrtf and sinf per
+// sample per wave, one thread.
+static void ReferenceHeights(const WaveField& field, const std::vector<D3DXVECTOR3>& pos, float t, float* out)
+{
+	for (size_t s = 0; s < pos.size(); ++s)
+	{
+		float d = sqrtf(pos[s].x*pos[s].x + pos[s].z*pos[s].z);
+		float h = 0.0f;
+		for (int i = 0; i < field.getNumWaves(); ++i)
+		{
+			const RadialWave& w = field.getWave(i);
+			h += w.amplitude * sinf(w.waveNumber*d - t*w.angularFreq + w.phase);
+		}
+		out[s] = h;
+	}
+}
+
+void BenchWaveField()
+{
+	const int sizes[] = { 1025, 2049 };
+
+	ThreadPool pool;
+
+	printf("%6s %8s %8s %10s %10s %12s\n", "grid", "threads", "normals", "ms/frame", "Msamp/s", "vs sinf");
+
+	for (int g = 0; g < sizeof(sizes)/sizeof(sizes[0]); ++g)
+	{
+		int n = sizes[g];
+
+		std::vector<D3DXVECTOR3> pos(n*n);
+		GenTriGridVerts(n, n, 0.05f, 0.05f, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &pos[0]);
+
+		WaveField serial(n, n, 0.05f, 0.05f, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+		WaveField threaded(n, n, 0.05f, 0.05f, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &pool);
+
+		std::vector<float> ref(n*n);
+		float t = 0.0f;
+		double reference = BenchRepeat([&] { ReferenceHeights(serial, pos, t += 0.016f, &ref[0]); });
+
+		for (int normals = 0; normals < 2; ++normals)
+		{
+			WaveField* fields[] = { &serial, &threaded };
+			for (int f = 0; f < 2; ++f)
+			{
+				WaveField& field = *fields[f];
+				double perFrame = BenchRepeat([&] { field.update(t += 0.016f, normals != 0); });
+
+				printf("%6d %8d %8s %10.2f %10.1f %11.1fx\n", n,
+					f == 0 ? 1 : pool.numThreads(), normals ? "yes" : "no",
+					perFrame * 1000.0, (double)n*n / perFrame * 1e-6, reference / perFrame);
+			}
+		}
+
+		// Accuracy, early on and after a long run.
+		const float times[] = { 0.5f, 3600.25f };
+		for (int i = 0; i < 2; ++i)
+		{
+			threaded.update(times[i]);
+			printf("       t = %-8g max |h - exact| = %.3g (bound %.3g)\n", times[i],
+				MaxHeightError(threaded, pos, times[i]), threaded.getMaxHeightError());
+		}
+	}
+
+	// Point queries, e.g. one per floating object.
+	WaveField field(3, 3, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+	field.update(10.0f);
+
+	const int numQueries = 100000;
+	float sum = 0.0f;
+	double perBatch = BenchRepeat([&] {
+		for (int q = 0; q < numQueries; ++q)
+		{
+			float x = (float)(q % 317) * 0.1f - 15.0f;
+			float z = (float)(q % 331) * 0.1f - 16.0f;
+			sum += field.heightAt(x, z) + field.normalAt(x, z).y;
+		}
+	});
+	printf("heightAt + normalAt: %.1f ns/query (checksum %g)\n", perBatch / numQueries * 1e9, sum);
+}
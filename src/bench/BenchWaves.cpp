@@ -0,0 +1,75 @@
+#include "Bench.h"
+#include "TriGrid.h"
+#include <algorithm>
+
+// CPU stand-in for the three ColoredWavesDemo vertex shaders: the same
+// per-vertex arithmetic, timed over a large grid.
+
+static const float a[2] = {0.8f, 0.2f};
+static const float k[2] = {1.0f, 8.0f};
+static const float w[2] = {1.0f, 8.0f};
+static const float p[2] = {0.0f, 1.0f};
+
+static void WavesAnalytic(const D3DXVECTOR3* pos, int n, float t, float* out)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		float d = sqrtf(pos[i].x*pos[i].x + pos[i].z*pos[i].z);
+		out[i] = a[0]*sinf(k[0]*d - t*w[0] + p[0]) + a[1]*sinf(k[1]*d - t*w[1] + p[1]);
+	}
+}
+
+static void WavesDistance(const float* dist, int n, float t, float* out)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		float d = dist[i];
+		out[i] = a[0]*sinf(k[0]*d - t*w[0] + p[0]) + a[1]*sinf(k[1]*d - t*w[1] + p[1]);
+	}
+}
+
+static void WavesPhase(const D3DXVECTOR2* phase, int n, float t, float* out)
+{
+	float t0 = t*w[0];
+	float t1 = t*w[1];
+	for (int i = 0; i < n; ++i)
+		out[i] = a[0]*sinf(phase[i].x - t0) + a[1]*sinf(phase[i].y - t1);
+}
+
+void BenchWaves()
+{
+	const int side = 1025;
+	const int n = side*side;
+
+	std::vector<D3DXVECTOR3> pos(n);
+	GenTriGridVerts(side, side, 0.1f, 0.1f, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &pos[0]);
+
+	std::vector<float>       dist(n);
+	std::vector<D3DXVECTOR2> phase(n);
+	for (int i = 0; i < n; ++i)
+	{
+		dist[i] = sqrtf(pos[i].x*pos[i].x + pos[i].z*pos[i].z);
+		phase[i] = D3DXVECTOR2(k[0]*dist[i] + p[0], k[1]*dist[i] + p[1]);
+	}
+
+	std::vector<float> ref(n), heights(n);
+	WavesAnalytic(&pos[0], n, 1.5f, &ref[0]);
+
+	float time = 0.0f;
+	double analytic = BenchRepeat([&] { WavesAnalytic(&pos[0], n, time += 0.01f, &heights[0]); });
+	double distance = BenchRepeat([&] { WavesDistance(&dist[0], n, time += 0.01f, &heights[0]); });
+	double phased   = BenchRepeat([&] { WavesPhase(&phase[0], n, time += 0.01f, &heights[0]); });
+
+	// The phase form folds p[i] in early, so it differs by rounding only.
+	WavesPhase(&phase[0], n, 1.5f, &heights[0]);
+	float maxErr = 0.0f;
+	for (int i = 0; i < n; ++i)
+		maxErr = std::max(maxErr, fabsf(heights[i] - ref[i]));
+
+	printf("%d vertices\n", n);
+	printf("%-10s %12s %14s\n", "mode", "ns/vertex", "bytes/vertex");
+	printf("%-10s %12.2f %14d\n", "analytic", analytic / n * 1e9, (int)sizeof(D3DXVECTOR3));
+	printf("%-10s %12.2f %14d\n", "distance", distance / n * 1e9, (int)(sizeof(D3DXVECTOR3) + sizeof(float)));
+	printf("%-10s %12.2f %14d\n", "phase",    phased   / n * 1e9, (int)(sizeof(D3DXVECTOR3) + sizeof(D3DXVECTOR2)));
+	printf("max |phase - analytic| = %g\n", maxErr);
+}
@@ -0,0 +1,59 @@
+#include "Bench.h"
+#include "XFile.h"
+#include "MappedFile.h"
+
+void BenchXFile()
+{
+	// Every .x file the demos ship, relative to bin/<platform> like the
+	// demos' own paths.
+	const wchar_t* files[] = {
+		L"../../src/chap14/XFileDemo/Dwarf.x",
+		L"../../src/chap14/XFileDemo/skullocc.x",
+		L"../../src/chap14/XFileDemo/bigship1.x",
+		L"../../src/chap14/XFileDemo/car.x",
+		L"../../src/chap14/BoundingBoxDemo/tiger.x",
+		L"../../src/chap15/RobotArmDemo/bone.x",
+	};
+
+	printf("%-12s %6s %9s %9s %8s %8s %8s %9s %9s\n", "file", "format", "file KB", "data KB",
+		"verts", "tris", "subsets", "ms", "MB/s");
+
+	double textBytes = 0.0, textSeconds = 0.0;
+	for (int i = 0; i < sizeof(files)/sizeof(files[0]); ++i)
+	{
+		std::wstring path(files[i]);
+		std::string name(path.begin() + path.rfind(L'/') + 1, path.end());
+
+		MappedFile file;
+		XFileMesh mesh;
+		std::string error;
+		if (!file.open(path) || !ParseXFile(file.getData(), file.getSize(), &mesh, &error))
+		{
+			printf("%-12s failed: %s\n", name.c_str(), error.empty() ? "could not open file" : error.c_str());
+			continue;
+		}
+
+		// Compressed files also report the size they inflate to, which is
+		// what the tokenizer reads.
+		const unsigned char* header = file.getData();
+		std::string format((const char*)header + 8, 4);
+		bool zip = format == "tzip" || format == "bzip";
+		size_t dataBytes = zip ? (header[16] | header[17] << 8 | header[18] << 16 | header[19] << 24) - 16 : file.getSize() - 16;
+
+		double seconds = BenchRepeat([&] { ParseXFile(file.getData(), file.getSize(), &mesh); });
+
+		printf("%-12s %6s %9.1f %9.1f %8u %8u %8u %9.3f %9.1f\n", name.c_str(), format.c_str(),
+			file.getSize() / 1024.0, dataBytes / 1024.0, (unsigned)mesh.vertices.size(),
+			(unsigned)mesh.indices.size() / 3, (unsigned)mesh.materials.size(),
+			seconds * 1000.0, file.getSize() / (seconds * 1e6));
+
+		if (format == "txt ")
+		{
+			textBytes += file.getSize();
+			textSeconds += seconds;
+		}
+	}
+
+	if (textSeconds > 0.0)
+		printf("\ntext files overall: %.1f MB/s\n", textBytes / (textSeconds * 1e6));
+}
@@ -1,5 +1,6 @@
 #include "d3dApp.h"
 #include "gfxStats.h"
+#include "TextureCache.h"
 
 class PageFlipDemo : public D3DApp
 {
@@ -43,7 +44,7 @@ PageFlipDemo::PageFlipDemo(HINSTANCE hInstance, std::wstring winCaption, D3DDEVT
 	mGfxStats = new GfxStats();
 
 	HR(D3DXCreateSprite(gd3dDevice, &mSprite));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap05/PageFlipDemo/fireatlas.bmp", &mFrames));
+	HR(LoadTextureCached(L"../../src/chap05/PageFlipDemo/fireatlas.bmp", &mFrames));
 	mSpriteCenter = D3DXVECTOR3(32.0f, 32.0f, 0.0f);
 
 	mCurrFrame = 0;
@@ -2,8 +2,31 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "TriGrid.h"
+#include "Ocean.h"
+#include "ThreadPool.h"
+#include "HeightPalette.h"
 #include <string.h>
 
+// How the vertex shader gets the distance term of the radial waves.
+enum WaveMode
+{
+	WAVE_ANALYTIC,  // sqrt(x*x + z*z) per vertex per frame.
+	WAVE_DISTANCE,  // Distance read from a second vertex stream.
+	WAVE_PHASE,     // k[i]*d + p[i] read from a second vertex stream.
+	WAVE_OCEAN      // FFT ocean heights written by the CPU every frame.
+};
+
+// Colors by |y|, sampled into the palette texture.
+const HeightBand gWaveBands[] =
+{
+	{ 0.2f, D3DCOLOR_XRGB(0,   0,   0)   },
+	{ 0.4f, D3DCOLOR_XRGB(0,   0,   255) },
+	{ 0.6f, D3DCOLOR_XRGB(0,   255, 0)   },
+	{ 0.8f, D3DCOLOR_XRGB(255, 0,   0)   },
+	{ FLT_MAX, D3DCOLOR_XRGB(255, 255, 0) },
+};
+
 class ColoredWavesDemo : public D3DApp
 {
 public:
@@ -18,6 +41,8 @@ public:
 
 private:
 	void buildGeoBuffers();
+	void updateOceanVB();
+	void buildPalette();
 	void buildFX();
 	void buildProjMtx();
 	void buildViewMtx();
@@ -28,13 +53,22 @@ private:
 
 	DWORD mNumVertices;
 	DWORD mNumTriangles;
+	std::vector<TriGridChunk> mGridChunks;
 
 	IDirect3DVertexBuffer9 *mVB;
+	IDirect3DVertexBuffer9 *mWaveVB;
+	IDirect3DVertexBuffer9 *mOceanVB;
 	IDirect3DIndexBuffer9  *mIB;
+	IDirect3DTexture9      *mPaletteTex;
+	HeightPalette          *mPalette;
 	ID3DXEffect            *mFX;
-	D3DXHANDLE              mhTech;
+	D3DXHANDLE              mhTech[4];
 	D3DXHANDLE              mhWVP;
 	D3DXHANDLE              mhTime;
+	WaveMode                mWaveMode;
+
+	ThreadPool *mThreadPool;
+	Ocean      *mOcean;
 
 	float mCameraRotationY;
 	float mCameraRadius;
@@ -73,8 +107,24 @@ ColoredWavesDemo::ColoredWavesDemo(HINSTANCE hInstance, std::wstring winCaption)
 	mCameraRotationY = 1.2 * D3DX_PI;
 	mCameraHeight    = 5.0f;
 
-	buildGeoBuffers();
+	mWaveMode = WAVE_PHASE;
+
+	// One texel per grid cell, so the 100x100 grid shows the 64x64 m
+	// patch tiling.
+	OceanParams params;
+	params.windSpeed  = 6.0f;
+	params.windDir    = D3DXVECTOR2(1.0f, 0.5f);
+	params.amplitude  = 0.001f;
+	params.choppiness = 0.8f;
+
+	mThreadPool = new ThreadPool();
+	mOcean      = new Ocean(64, 64.0f, params, mThreadPool);
+	mOceanVB    = 0;
+
+	// The wave terms stream is built from the effect's parameters.
+	buildPalette();
 	buildFX();
+	buildGeoBuffers();
 
 	onResetDevice();
 
@@ -84,10 +134,16 @@ ColoredWavesDemo::ColoredWavesDemo(HINSTANCE hInstance, std::wstring winCaption)
 ColoredWavesDemo::~ColoredWavesDemo()
 {
 	SafeDelete(mGfxStats);
+	SafeDelete(mOcean);
+	SafeDelete(mThreadPool);
 
 	SafeRelease(mVB);
+	SafeRelease(mWaveVB);
+	SafeRelease(mOceanVB);
 	SafeRelease(mIB);
 	SafeRelease(mFX);
+	SafeRelease(mPaletteTex);
+	SafeDelete(mPalette);
 
 	DestroyAllVertexDeclarations();
 }
@@ -103,6 +159,9 @@ bool ColoredWavesDemo::checkDeviceCaps()
 	if (caps.PixelShaderVersion < D3DPS_VERSION(2,0))
 		return false;
 
+	if (caps.MaxStreams < 2)
+		return false;
+
 	return true;
 
 	return true;
@@ -112,6 +171,9 @@ void ColoredWavesDemo::onLostDevice()
 {
 	mGfxStats->onLostDevice();
 	HR(mFX->OnLostDevice());
+
+	// Dynamic buffers live in the default pool.
+	SafeRelease(mOceanVB);
 }
 
 void ColoredWavesDemo::onResetDevice()
@@ -119,6 +181,9 @@ void ColoredWavesDemo::onResetDevice()
 	mGfxStats->onResetDevice();
 	HR(mFX->OnResetDevice());
 
+	HR(gd3dDevice->CreateVertexBuffer(mNumVertices * sizeof(VertexPos),
+		D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT, &mOceanVB, 0));
+
 	buildProjMtx();
 }
 
@@ -138,6 +203,18 @@ void ColoredWavesDemo::updateScene(float dt)
 	if (gDInput->keyDown(DIK_S))
 		mCameraHeight -= 25.0f * dt;
 
+	if (gDInput->keyDown(DIK_1))
+		mWaveMode = WAVE_ANALYTIC;
+	if (gDInput->keyDown(DIK_2))
+		mWaveMode = WAVE_DISTANCE;
+	if (gDInput->keyDown(DIK_3))
+		mWaveMode = WAVE_PHASE;
+	if (gDInput->keyDown(DIK_4))
+		mWaveMode = WAVE_OCEAN;
+
+	if (mWaveMode == WAVE_OCEAN)
+		updateOceanVB();
+
 	// divide by 50 to make mouse less sensitive
 	mCameraRotationY += gDInput->mouseDX() / 50.0f;
 	mCameraRadius    += gDInput->mouseDY() / 50.0f;
@@ -156,11 +233,19 @@ void ColoredWavesDemo::drawScene()
 	HR(gd3dDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(255,255,255), 1.0f, 0));
 	HR(gd3dDevice->BeginScene());
 
-	HR(gd3dDevice->SetStreamSource(0, mVB, 0, sizeof(VertexPos)));
+	HR(gd3dDevice->SetStreamSource(0, mWaveMode == WAVE_OCEAN ? mOceanVB : mVB, 0, sizeof(VertexPos)));
 	HR(gd3dDevice->SetIndices(mIB));
-	HR(gd3dDevice->SetVertexDeclaration(VertexPos::Decl));
+	if (mWaveMode == WAVE_ANALYTIC || mWaveMode == WAVE_OCEAN)
+	{
+		HR(gd3dDevice->SetVertexDeclaration(VertexPos::Decl));
+	}
+	else
+	{
+		HR(gd3dDevice->SetStreamSource(1, mWaveVB, 0, sizeof(VertexWaveTerms)));
+		HR(gd3dDevice->SetVertexDeclaration(VertexWaveTerms::Decl));
+	}
 
-	HR(mFX->SetTechnique(mhTech));
+	HR(mFX->SetTechnique(mhTech[mWaveMode]));
 	HR(mFX->SetMatrix(mhWVP, &(mView*mProj)));
 
 	UINT numPasses = 0;
@@ -168,11 +253,14 @@ void ColoredWavesDemo::drawScene()
 	for (UINT i = 0; i < numPasses; ++i)
 	{
 		HR(mFX->BeginPass(i));
-		HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, mNumVertices, 0, mNumTriangles));
+		for (size_t c = 0; c < mGridChunks.size(); ++c)
+			DrawTriGridChunk(mGridChunks[c]);
 		HR(mFX->EndPass());
 	}
 	HR(mFX->End());
 
+	HR(gd3dDevice->SetStreamSource(1, 0, 0, 0));
+
 	mGfxStats->display(D3DCOLOR_XRGB(0,0,0));
 	HR(gd3dDevice->EndScene());
 	HR(gd3dDevice->Present(0, 0, 0, 0));
@@ -180,29 +268,62 @@ void ColoredWavesDemo::drawScene()
 
 void ColoredWavesDemo::buildGeoBuffers()
 {
-	std::vector<D3DXVECTOR3> verts;
-	std::vector<DWORD> indices;
+	TriGridGeometry grid;
+	BuildTriGrid(100, 100, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f),
+		Supports32BitIndices(100 * 100), grid);
 
-	GenTriGrid(100, 100, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f), verts, indices);
-
-	mNumVertices  = 100*100;
-	mNumTriangles = 99*99*2;
+	mGridChunks   = grid.chunks;
+	mNumVertices  = grid.numVertices();
+	mNumTriangles = grid.numTriangles();
 
 	HR(gd3dDevice->CreateVertexBuffer(mNumVertices * sizeof(VertexPos),
 		D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &mVB, 0));
 
 	VertexPos *v = 0;
 	HR(mVB->Lock(0, 0, (void**)&v, 0));
-	for (DWORD i = 0; i < mNumVertices; ++i) v[i] = verts[i];
+	for (DWORD i = 0; i < mNumVertices; ++i) v[i] = grid.verts[i];
 	HR(mVB->Unlock());
 
-	HR(gd3dDevice->CreateIndexBuffer(mNumTriangles*3*sizeof(WORD), D3DUSAGE_WRITEONLY,
-		D3DFMT_INDEX16, D3DPOOL_MANAGED, &mIB, 0));
+	// The terms of the wave arguments that do not depend on time only
+	// need computing once.
+	float k[2], p[2];
+	HR(mFX->GetFloatArray(mFX->GetParameterByName(0, "k"), k, 2));
+	HR(mFX->GetFloatArray(mFX->GetParameterByName(0, "p"), p, 2));
+
+	HR(gd3dDevice->CreateVertexBuffer(mNumVertices * sizeof(VertexWaveTerms),
+		D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &mWaveVB, 0));
+
+	VertexWaveTerms *t = 0;
+	HR(mWaveVB->Lock(0, 0, (void**)&t, 0));
+	for (DWORD i = 0; i < mNumVertices; ++i)
+	{
+		const D3DXVECTOR3& pos = grid.verts[i];
+		float d = sqrtf(pos.x*pos.x + pos.z*pos.z);
+		t[i] = VertexWaveTerms(d, D3DXVECTOR2(k[0]*d + p[0], k[1]*d + p[1]));
+	}
+	HR(mWaveVB->Unlock());
 
-	WORD *k = 0;
-	HR(mIB->Lock(0, 0, (void**)&k, 0));
-	for (DWORD i = 0; i < mNumTriangles*3; ++i) k[i] = (WORD)indices[i];
-	HR(mIB->Unlock());
+	CreateTriGridIndexBuffer(grid, &mIB);
+}
+
+void ColoredWavesDemo::updateOceanVB()
+{
+	mOcean->update(mTime);
+
+	// The 100x100 grid fits in a single chunk, so its vertices are in
+	// plain row-major order, which is what writeGrid produces.
+	VertexPos *v = 0;
+	HR(mOceanVB->Lock(0, 0, (void**)&v, D3DLOCK_DISCARD));
+	mOcean->writeGrid(100, 100, D3DXVECTOR3(0.0f, 0.0f, 0.0f), &v->pos, 0);
+	HR(mOceanVB->Unlock());
+}
+
+void ColoredWavesDemo::buildPalette()
+{
+	// |y| is quantized to 1/256 over [0, 1); everything higher is in the
+	// last band anyway.
+	mPalette = new HeightPalette(gWaveBands, sizeof(gWaveBands)/sizeof(gWaveBands[0]), 1.0f);
+	mPalette->createTexture(&mPaletteTex);
 }
 
 void ColoredWavesDemo::buildFX()
@@ -213,9 +334,15 @@ void ColoredWavesDemo::buildFX()
 	if (errors)
 		MessageBoxA(0, (char*)errors->GetBufferPointer(), 0, 0);
 
-	mhTech = mFX->GetTechniqueByName("ColorTech");
+	mhTech[WAVE_ANALYTIC] = mFX->GetTechniqueByName("ColorTech");
+	mhTech[WAVE_DISTANCE] = mFX->GetTechniqueByName("ColorDistTech");
+	mhTech[WAVE_PHASE]    = mFX->GetTechniqueByName("ColorPhaseTech");
+	mhTech[WAVE_OCEAN]    = mFX->GetTechniqueByName("ColorHeightTech");
 	mhWVP  = mFX->GetParameterByName(0, "gWVP");
 	mhTime = mFX->GetParameterByName(0, "gTime");
+
+	HR(mFX->SetTexture(mFX->GetParameterByName(0, "gPaletteTex"), mPaletteTex));
+	HR(mFX->SetFloat(mFX->GetParameterByName(0, "gPaletteScale"), mPalette->getTexScale()));
 }
 
 void ColoredWavesDemo::buildProjMtx()
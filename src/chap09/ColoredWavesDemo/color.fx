@@ -1,10 +1,28 @@
 uniform extern float4x4 gWVP;
 uniform extern float gTime;
 
-static float a[2] = {0.8f, 0.2f};  // amplitudes
-static float k[2] = {1.0f, 8.0f};  // angular wave numbers
-static float w[2] = {1.0f, 8.0f};  // angular frequency
-static float p[2] = {0.0f, 1.0f};  // phase shifts
+// Height palette (HeightPalette on the CPU side): texel |y|*gPaletteScale
+// holds the color of the band |y| falls in, so the lookup costs the
+// same for any number of bands.
+uniform extern texture gPaletteTex;
+uniform extern float   gPaletteScale;
+
+sampler PaletteS = sampler_state
+{
+	Texture = <gPaletteTex>;
+	MinFilter = POINT;
+	MagFilter = POINT;
+	MipFilter = NONE;
+	AddressU = CLAMP;
+	AddressV = CLAMP;
+};
+
+// Not static, so the application can read k and p back to build the
+// precomputed stream from the same numbers the shader uses.
+uniform float a[2] = {0.8f, 0.2f};  // amplitudes
+uniform float k[2] = {1.0f, 8.0f};  // angular wave numbers
+uniform float w[2] = {1.0f, 8.0f};  // angular frequency
+uniform float p[2] = {0.0f, 1.0f};  // phase shifts
 
 float SumOfRadialSineWaves(float x, float z)
 {
@@ -19,20 +37,33 @@ float SumOfRadialSineWaves(float x, float z)
 	return sum;
 }
 
-float4 GetColorFromHeight(float y)
+// Same waves, with the distance d = sqrt(x*x + z*z) computed once per
+// vertex on the CPU instead of every frame.
+float SumOfRadialSineWavesDist(float d)
+{
+	float sum = 0.0f;
+	for (int i = 0; i < 2; ++i)
+		sum += a[i]*sin(k[i]*d - gTime*w[i] + p[i]);
+
+	return sum;
+}
+
+// Same waves, with the constant part k[i]*d + p[i] of each argument
+// precomputed, leaving one multiply-add and one sin per wave.
+float SumOfRadialSineWavesPhase(float2 phase)
+{
+	return a[0]*sin(phase.x - gTime*w[0]) + a[1]*sin(phase.y - gTime*w[1]);
+}
+
+float GetPaletteCoord(float y)
 {
-	float absy = abs(y);
-	if (absy <= 0.2f) return float4(0.0f, 0.0f, 0.0f, 1.0f);
-	else if (absy <= 0.4f) return float4(0.0f, 0.0f, 1.0f, 1.0f);
-	else if (absy <= 0.6f) return float4(0.0f, 1.0f, 0.0f, 1.0f);
-	else if (absy <= 0.8f) return float4(1.0f, 0.0f, 0.0f, 1.0f);
-	else return float4(1.0f, 1.0f, 0.0f, 1.0f);
+	return abs(y) * gPaletteScale;
 }
 
 struct OutputVS
 {
-	float4 posH  : POSITION0;
-	float4 color : COLOR0;
+	float4 posH    : POSITION0;
+	float  palette : TEXCOORD0;
 };
 
 OutputVS ColorVS(float3 posL : POSITION0, float4 c : COLOR0)
@@ -40,13 +71,40 @@ OutputVS ColorVS(float3 posL : POSITION0, float4 c : COLOR0)
 	OutputVS outVS = (OutputVS)0;
 	posL.y = SumOfRadialSineWaves(posL.x, posL.z);
 	outVS.posH  = mul(float4(posL, 1.0f), gWVP);
-	outVS.color = GetColorFromHeight(posL.y);
+	outVS.palette = GetPaletteCoord(posL.y);
+	return outVS;
+}
+
+OutputVS ColorDistVS(float3 posL : POSITION0, float dist : TEXCOORD0)
+{
+	OutputVS outVS = (OutputVS)0;
+	posL.y = SumOfRadialSineWavesDist(dist);
+	outVS.posH  = mul(float4(posL, 1.0f), gWVP);
+	outVS.palette = GetPaletteCoord(posL.y);
+	return outVS;
+}
+
+OutputVS ColorPhaseVS(float3 posL : POSITION0, float2 phase : TEXCOORD1)
+{
+	OutputVS outVS = (OutputVS)0;
+	posL.y = SumOfRadialSineWavesPhase(phase);
+	outVS.posH  = mul(float4(posL, 1.0f), gWVP);
+	outVS.palette = GetPaletteCoord(posL.y);
+	return outVS;
+}
+
+// Heights already in the vertices (the CPU ocean).
+OutputVS ColorHeightVS(float3 posL : POSITION0)
+{
+	OutputVS outVS = (OutputVS)0;
+	outVS.posH  = mul(float4(posL, 1.0f), gWVP);
+	outVS.palette = GetPaletteCoord(posL.y);
 	return outVS;
 }
 
-float4 ColorPS(float4 c : COLOR0) : COLOR
+float4 ColorPS(float palette : TEXCOORD0) : COLOR
 {
-	return c;
+	return tex2D(PaletteS, float2(palette, 0.5f));
 }
 
 technique ColorTech
@@ -56,6 +114,39 @@ technique ColorTech
 		vertexShader = compile vs_2_0 ColorVS();
 		pixelShader  = compile ps_2_0 ColorPS();
 
+		FillMode = Wireframe;
+	}
+}
+
+technique ColorDistTech
+{
+	pass P0
+	{
+		vertexShader = compile vs_2_0 ColorDistVS();
+		pixelShader  = compile ps_2_0 ColorPS();
+
+		FillMode = Wireframe;
+	}
+}
+
+technique ColorPhaseTech
+{
+	pass P0
+	{
+		vertexShader = compile vs_2_0 ColorPhaseVS();
+		pixelShader  = compile ps_2_0 ColorPS();
+
+		FillMode = Wireframe;
+	}
+}
+
+technique ColorHeightTech
+{
+	pass P0
+	{
+		vertexShader = compile vs_2_0 ColorHeightVS();
+		pixelShader  = compile ps_2_0 ColorPS();
+
 		FillMode = Wireframe;
 	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "TextureCache.h"
 #include <string.h>
 
 class CrateDemo : public D3DApp
@@ -103,7 +104,7 @@ CrateDemo::CrateDemo(HINSTANCE hInstance, std::wstring winCaption)
 
 	D3DXMatrixIdentity(&mWorld);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap11/CrateDemo/crate.jpg", &mCrateTex));
+	HR(LoadTextureCached(L"../../src/chap11/CrateDemo/crate.jpg", &mCrateTex));
 	
 	buildBoxGeometry();
 	buildFX();
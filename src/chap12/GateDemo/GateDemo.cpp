@@ -3,6 +3,8 @@
 #include "gfxStats.h"
 #include <list>
 #include "Vertex.h"
+#include "TriGrid.h"
+#include "TextureCache.h"
 
 class GateDemo : public D3DApp
 {
@@ -31,6 +33,7 @@ private:
 
 	DWORD mNumGridVertices;
 	DWORD mNumGridTriangles;
+	std::vector<TriGridChunk> mGridChunks;
 	
 	IDirect3DVertexBuffer9* mGridVB;
 	IDirect3DIndexBuffer9*  mGridIB;
@@ -123,8 +126,8 @@ GateDemo::GateDemo(HINSTANCE hInstance, std::wstring winCaption)
 	D3DXMatrixIdentity(&mGroundWorld);
 	D3DXMatrixIdentity(&mGateWorld);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap12/GateDemo/ground0.dds", &mGroundTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap12/GateDemo/gatea.dds", &mGateTex));
+	HR(LoadTextureCached(L"../../src/chap12/GateDemo/ground0.dds", &mGroundTex));
+	HR(LoadTextureCached(L"../../src/chap12/GateDemo/gatea.dds", &mGateTex));
 
 	buildGridGeometry();
 	buildGateGeometry();
@@ -245,15 +248,19 @@ void GateDemo::drawScene()
 
 void GateDemo::buildGridGeometry()
 {
-	std::vector<D3DXVECTOR3> verts;
-	std::vector<DWORD> indices;
-
-	GenTriGrid(100, 100, 1.0f, 1.0f, 
-		D3DXVECTOR3(0.0f, 0.0f, 0.0f), verts, indices);
+	// BuildTriGrid keeps 16-bit indices when the grid fits.  Larger grids
+	// get 32-bit indices if the device can address them, and are split
+	// into 16-bit addressable chunks if not.
+	const int numVertRows = 100;
+	const int numVertCols = 100;
+	TriGridGeometry grid;
+	BuildTriGrid(numVertRows, numVertCols, 1.0f, 1.0f, D3DXVECTOR3(0.0f, 0.0f, 0.0f),
+		Supports32BitIndices(numVertRows * numVertCols), grid);
 
 	// Save vertex count and triangle count for DrawIndexedPrimitive arguments.
-	mNumGridVertices  = 100*100;
-	mNumGridTriangles = 99*99*2;
+	mGridChunks       = grid.chunks;
+	mNumGridVertices  = grid.numVertices();
+	mNumGridTriangles = grid.numTriangles();
 
 	// Obtain a pointer to a new vertex buffer.
 	HR(gd3dDevice->CreateVertexBuffer(mNumGridVertices * sizeof(VertexPNT), 
@@ -265,34 +272,26 @@ void GateDemo::buildGridGeometry()
 	HR(mGridVB->Lock(0, 0, (void**)&v, 0));
 
 	float texScale = 0.2f;
-	for(int i = 0; i < 100; ++i)
+	for(size_t c = 0; c < grid.chunks.size(); ++c)
 	{
-		for(int j = 0; j < 100; ++j)
+		const TriGridChunk& chunk = grid.chunks[c];
+		for(int i = 0; i < chunk.numRows; ++i)
 		{
-			DWORD index = i * 100 + j;
-			v[index].pos    = verts[index];
-			v[index].normal = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
-			v[index].tex0 = D3DXVECTOR2((float)j, (float)i) * texScale;
+			for(int j = 0; j < chunk.numCols; ++j)
+			{
+				DWORD index = chunk.baseVertex + i * chunk.numCols + j;
+				v[index].pos    = grid.verts[index];
+				v[index].normal = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+				v[index].tex0 = D3DXVECTOR2((float)(chunk.firstCol + j), (float)(chunk.firstRow + i)) * texScale;
+			}
 		}
 	}
 
 	HR(mGridVB->Unlock());
 
 
-	// Obtain a pointer to a new index buffer.
-	HR(gd3dDevice->CreateIndexBuffer(mNumGridTriangles*3*sizeof(WORD), D3DUSAGE_WRITEONLY,
-		D3DFMT_INDEX16, D3DPOOL_MANAGED, &mGridIB, 0));
-
-	// Now lock it to obtain a pointer to its internal data, and write the
-	// grid's index data.
-
-	WORD* k = 0;
-	HR(mGridIB->Lock(0, 0, (void**)&k, 0));
-
-	for(DWORD i = 0; i < mNumGridTriangles*3; ++i)
-		k[i] = (WORD)indices[i];
-
-	HR(mGridIB->Unlock());
+	// Create the index buffer in whatever format the grid needs.
+	CreateTriGridIndexBuffer(grid, &mGridIB);
 }
 
 void GateDemo::buildGateGeometry()
@@ -402,7 +401,8 @@ void GateDemo::drawGround()
 	for (UINT i = 0; i < numPasses; ++i)
 	{
 		HR(mFX->BeginPass(i));
-		HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, mNumGridVertices, 0, mNumGridTriangles));
+		for(size_t c = 0; c < mGridChunks.size(); ++c)
+			DrawTriGridChunk(mGridChunks[c]);
 		HR(mFX->EndPass());
 	}
 	HR(mFX->End());
@@ -2,6 +2,7 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "TextureCache.h"
 #include <string.h>
 
 class TeapotDemo : public D3DApp
@@ -118,8 +119,8 @@ TeapotDemo::TeapotDemo(HINSTANCE hInstance, std::wstring winCaption)
 	D3DXMatrixTranslation(&mCrateWorld, 0.0f, 0.0f, 2.0f);
 	D3DXMatrixIdentity(&mTeapotWorld);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap12/TeapotWithTexAlpha/crate.jpg", &mCrateTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap12/TeapotWithTexAlpha/bricka.dds", &mTeapotTex));
+	HR(LoadTextureCached(L"../../src/chap12/TeapotWithTexAlpha/crate.jpg", &mCrateTex));
+	HR(LoadTextureCached(L"../../src/chap12/TeapotWithTexAlpha/bricka.dds", &mTeapotTex));
 	
 	HR(D3DXCreateTeapot(gd3dDevice, &mTeapot, 0));
 
@@ -2,6 +2,7 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "TextureCache.h"
 #include <string.h>
 
 class StencilMirrorDemo : public D3DApp
@@ -115,10 +116,10 @@ StencilMirrorDemo::StencilMirrorDemo(HINSTANCE hInstance, std::wstring winCaptio
 	D3DXMatrixIdentity(&mRoomWorld);
 	D3DXMatrixTranslation(&mTeapotWorld, 0.0f, 3.0f, -6.0f);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilMirror/checkboard.dds", &mFloorTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilMirror/brick2.dds", &mWallTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilMirror/ice.dds", &mMirrorTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilMirror/brick1.dds", &mTeapotTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilMirror/checkboard.dds", &mFloorTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilMirror/brick2.dds", &mWallTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilMirror/ice.dds", &mMirrorTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilMirror/brick1.dds", &mTeapotTex));
 	
 	HR(D3DXCreateTeapot(gd3dDevice, &mTeapot, 0));
 
@@ -2,6 +2,8 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "Transform.h"
+#include "TextureCache.h"
 #include <string.h>
 
 class StencilShadowDemo : public D3DApp
@@ -68,8 +70,8 @@ private:
 	float mCameraRadius;
 	float mCameraHeight;
 
-	D3DXMATRIX mRoomWorld;
-	D3DXMATRIX mTeapotWorld;
+	Transform mRoomWorld;
+	Transform mTeapotWorld;
 
 	D3DXMATRIX mView;
 	D3DXMATRIX mProj;
@@ -120,13 +122,15 @@ StencilShadowDemo::StencilShadowDemo(HINSTANCE hInstance, std::wstring winCaptio
 	mShadowMtrl.spec      = BLACK;
 	mShadowMtrl.specPower = 1.0f;
 
-	D3DXMatrixIdentity(&mRoomWorld);
-	D3DXMatrixTranslation(&mTeapotWorld, 0.0f, 3.0f, -6.0f);
+	// The room stays at the identity; the teapot sits in front of it.
+	D3DXMATRIX T;
+	D3DXMatrixTranslation(&T, 0.0f, 3.0f, -6.0f);
+	mTeapotWorld = Transform(T, AFFINE_RIGID);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilShadow/checkboard.dds", &mFloorTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilShadow/brick2.dds", &mWallTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilShadow/ice.dds", &mMirrorTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap13/StencilShadow/brick1.dds", &mTeapotTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilShadow/checkboard.dds", &mFloorTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilShadow/brick2.dds", &mWallTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilShadow/ice.dds", &mMirrorTex));
+	HR(LoadTextureCached(L"../../src/chap13/StencilShadow/brick1.dds", &mTeapotTex));
 	
 	HR(D3DXCreateTeapot(gd3dDevice, &mTeapot, 0));
 
@@ -349,13 +353,12 @@ void StencilShadowDemo::buildProjMtx()
 
 void StencilShadowDemo::drawRoom()
 {
-	HR(mFX->SetMatrix(mhWVP, &(mRoomWorld*mView*mProj)));
+	HR(mFX->SetMatrix(mhWVP, &(mRoomWorld.getMatrix()*mView*mProj)));
 
 	D3DXMATRIX worldInvTrans;
-	D3DXMatrixInverse(&worldInvTrans, 0, &mRoomWorld);
-	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+	mRoomWorld.getNormalMatrix(&worldInvTrans);
 	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
-	HR(mFX->SetMatrix(mhWorld, &mRoomWorld));
+	HR(mFX->SetMatrix(mhWorld, &mRoomWorld.getMatrix()));
 
 	HR(gd3dDevice->SetVertexDeclaration(VertexPNT::Decl));
 	HR(gd3dDevice->SetStreamSource(0, mRoomVB, 0, sizeof(VertexPNT)));
@@ -383,13 +386,12 @@ void StencilShadowDemo::drawRoom()
 
 void StencilShadowDemo::drawMirror()
 {
-	HR(mFX->SetMatrix(mhWVP, &(mRoomWorld*mView*mProj)));
+	HR(mFX->SetMatrix(mhWVP, &(mRoomWorld.getMatrix()*mView*mProj)));
 	
 	D3DXMATRIX worldInvTrans;
-	D3DXMatrixInverse(&worldInvTrans, 0, &mRoomWorld);
-	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+	mRoomWorld.getNormalMatrix(&worldInvTrans);
 	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
-	HR(mFX->SetMatrix(mhWorld, &mRoomWorld));
+	HR(mFX->SetMatrix(mhWorld, &mRoomWorld.getMatrix()));
 	HR(mFX->SetTexture(mhTex, mMirrorTex));
 
 	HR(gd3dDevice->SetVertexDeclaration(VertexPNT::Decl));
@@ -411,12 +413,13 @@ void StencilShadowDemo::drawTeapot()
 	// Cylindrically interpolate texture coordinates
 	HR(gd3dDevice->SetRenderState(D3DRS_WRAP0, D3DWRAPCOORD_0));
 
-	HR(mFX->SetMatrix(mhWVP, &(mTeapotWorld*mView*mProj)));
+	// Rigid for the teapot and its reflection; only the shadow
+	// projection needs the general (and, being singular, cofactor) path.
+	HR(mFX->SetMatrix(mhWVP, &(mTeapotWorld.getMatrix()*mView*mProj)));
 	D3DXMATRIX worldInvTrans;
-	D3DXMatrixInverse(&worldInvTrans, 0, &mTeapotWorld);
-	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+	mTeapotWorld.getNormalMatrix(&worldInvTrans);
 	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
-	HR(mFX->SetMatrix(mhWorld, &mTeapotWorld));
+	HR(mFX->SetMatrix(mhWorld, &mTeapotWorld.getMatrix()));
 	HR(mFX->SetTexture(mhTex, mTeapotTex));
 
 	UINT numPasses = 0;
@@ -465,10 +468,10 @@ void StencilShadowDemo::drawReflectedTeapot()
 	D3DXMatrixReflect(&R, &plane);
 
 	// Save the original teapot world matrix.
-	D3DXMATRIX oldTeapotWorld = mTeapotWorld;
+	Transform oldTeapotWorld = mTeapotWorld;
 
 	// Add reflection transform.
-	mTeapotWorld = mTeapotWorld * R;
+	mTeapotWorld = mTeapotWorld * Transform(R, AFFINE_RIGID);
 
 	// Reflect light vector also.
 	D3DXVECTOR3 oldLightVecW = mLightVecW;
@@ -515,10 +518,10 @@ void StencilShadowDemo::drawTeapotShadow()
 	D3DXMatrixTranslation(&eps, 0.0f, 0.001f, 0.0f);
 
 	// Save the original teapot world matrix
-	D3DXMATRIX oldTeapotWorld = mTeapotWorld;
+	Transform oldTeapotWorld = mTeapotWorld;
 
 	// Add shadow projection transform
-	mTeapotWorld = mTeapotWorld * S * eps;
+	mTeapotWorld = mTeapotWorld * Transform(S * eps, AFFINE_GENERAL);
 
 	// Alpha blend the shadow
 	HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, true));
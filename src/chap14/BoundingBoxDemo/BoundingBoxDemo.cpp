@@ -2,6 +2,10 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "AssetLoader.h"
+#include "MeshSimplify.h"
+#include "Meshlets.h"
+#include "Transform.h"
 #include <string.h>
 
 class BoundingBoxDemo : public D3DApp
@@ -18,22 +22,28 @@ public:
 
 private:
 	void buildFX();
+	void buildBoundingBox();
+	void buildMeshlets();
 	void buildViewMtx();
 	void buildProjMtx();
 
 private:
 	GfxStats *mGfxStats;
 	
-	ID3DXMesh* mMesh;
-	std::vector<Material> mMtrl;
-	std::vector<IDirect3DTexture9*> mTex;
+	AssetLoader*  mLoader;
+	MeshAsset*    mMesh;
+	TextureAsset* mWhiteTex;
+	int           mLod;  // Index into mMesh->lods drawn this frame.
 
-	IDirect3DTexture9* mWhiteTex;
+	// One per level of detail, culled each frame; built once the ship
+	// has loaded.
+	std::vector<MeshletMesh*> mMeshlets;
 
+	// Built once the ship has loaded.
 	ID3DXMesh* mBox;
 	Material   mBoxMtrl;
 	AABB       mBoundingBox;
-	D3DXMATRIX mBoundingBoxOffset;
+	Transform  mBoundingBoxOffset;
 
 	ID3DXEffect *mFX;
 	D3DXHANDLE   mhTech;
@@ -50,8 +60,9 @@ private:
 	float mCameraRotationY;
 	float mCameraRadius;
 	float mCameraHeight;
+	D3DXVECTOR3 mEyePos;
 
-	D3DXMATRIX mWorld;
+	Transform mWorld;
 
 	D3DXMATRIX mView;
 	D3DXMATRIX mProj;
@@ -92,30 +103,13 @@ BoundingBoxDemo::BoundingBoxDemo(HINSTANCE hInstance, std::wstring winCaption)
 	mLight.diffuse = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 	mLight.spec    = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 
-	LoadXFile(L"../../src/chap14/BoundingBoxDemo/bigship1.x", &mMesh, mMtrl, mTex);
-	D3DXMatrixIdentity(&mWorld);
-
-	// Compute the bounding box
-	VertexPNT *v = 0;
-	HR(mMesh->LockVertexBuffer(0, (void**)&v));
-
-	HR(D3DXComputeBoundingBox(&v[0].pos, mMesh->GetNumVertices(),
-		sizeof(VertexPNT), &mBoundingBox.minPt, &mBoundingBox.maxPt));
-
-	HR(mMesh->UnlockVertexBuffer());
-
-	// Build a box mesh so that we can render the bounding box visually
-	float width  = mBoundingBox.maxPt.x - mBoundingBox.minPt.x;
-	float height = mBoundingBox.maxPt.y - mBoundingBox.minPt.y;
-	float depth  = mBoundingBox.maxPt.z - mBoundingBox.minPt.z;
-	HR(D3DXCreateBox(gd3dDevice, width, height, depth, &mBox, 0));
-
-	// It is possible that the mesh was not centered about the origin
-	// when it was modeled. But the bounding box mesh is built around the
-	// origin. So offset the boudning box (mesh) center so that it
-	// matches the true mathematical bounding box center.
-	D3DXVECTOR3 center = mBoundingBox.center();
-	D3DXMatrixTranslation(&mBoundingBoxOffset, center.x, center.y, center.z);
+	// The ship loads in the background; the loader's placeholders are
+	// drawn until it arrives.
+	mLoader   = new AssetLoader();
+	mMesh     = mLoader->loadMesh(L"../../src/chap14/BoundingBoxDemo/bigship1.x", 4);
+	mWhiteTex = mLoader->loadTexture(L"../../src/chap14/BoundingBoxDemo/whitetex.dds");
+	mBox      = 0;
+	mLod      = 0;
 
 	// Define the box material -- make semi-transparent
 	mBoxMtrl.ambient    = D3DXCOLOR(0.0f, 0.0f, 1.0f, 1.0f);
@@ -123,14 +117,6 @@ BoundingBoxDemo::BoundingBoxDemo(HINSTANCE hInstance, std::wstring winCaption)
 	mBoxMtrl.spec       = D3DXCOLOR(0.5f, 0.5f, 0.5f, 1.0f);
 	mBoxMtrl.specPower  = 8.0f;
 
-	// Create the white dummy texture
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap14/BoundingBoxDemo/whitetex.dds", &mWhiteTex));
-
-	mGfxStats->addVertices(mMesh->GetNumVertices());
-	mGfxStats->addTriangles(mMesh->GetNumFaces());
-	mGfxStats->addVertices(mBox->GetNumVertices());
-	mGfxStats->addTriangles(mBox->GetNumFaces());
-
 	buildFX();
 	
 	onResetDevice();
@@ -141,14 +127,10 @@ BoundingBoxDemo::~BoundingBoxDemo()
 	SafeDelete(mGfxStats);
 
 	SafeRelease(mFX);
-	for (int i = 0; i < mTex.size(); ++i)
-	{
-		SafeRelease(mTex[i]);
-	}
-
-	SafeRelease(mWhiteTex);
-	SafeRelease(mMesh);
+	SafeDelete(mLoader);
 	SafeRelease(mBox);
+	for (size_t i = 0; i < mMeshlets.size(); ++i)
+		delete mMeshlets[i];
 
 	DestroyAllVertexDeclarations();
 }
@@ -171,6 +153,9 @@ void BoundingBoxDemo::onLostDevice()
 {
 	mGfxStats->onLostDevice();
 	HR(mFX->OnLostDevice());
+
+	for (size_t i = 0; i < mMeshlets.size(); ++i)
+		mMeshlets[i]->onLostDevice();
 }
 
 void BoundingBoxDemo::onResetDevice()
@@ -178,6 +163,9 @@ void BoundingBoxDemo::onResetDevice()
 	mGfxStats->onResetDevice();
 	HR(mFX->OnResetDevice());
 
+	for (size_t i = 0; i < mMeshlets.size(); ++i)
+		mMeshlets[i]->onResetDevice();
+
 	buildProjMtx();
 }
 
@@ -185,6 +173,15 @@ void BoundingBoxDemo::updateScene(float dt)
 {
 	mGfxStats->update(dt);
 
+	// Swap in whatever finished loading since the last frame.
+	mLoader->update();
+	mGfxStats->setLoadProgress(mLoader->getNumCompleted(), mLoader->getNumRequested());
+	if (mMesh->ready && !mMesh->failed && mBox == 0)
+	{
+		buildBoundingBox();
+		buildMeshlets();
+	}
+
 	gDInput->poll();
 
 	if (gDInput->keyDown(DIK_W))
@@ -203,6 +200,37 @@ void BoundingBoxDemo::updateScene(float dt)
 		mCameraRadius = 3.0f;
 
 	buildViewMtx();
+
+	// Draw the coarsest level of detail that stays within a pixel of
+	// the full mesh at the ship's distance.
+	mLod = 0;
+	if (mMesh->ready && !mMesh->failed)
+	{
+		D3DXVECTOR3 center = mMesh->box.center();
+		D3DXVec3TransformCoord(&center, &center, &mWorld.getMatrix());
+		D3DXVECTOR3 toMesh = center - mEyePos;
+		mLod = SelectLod(&mMesh->lodErrors[0], (int)mMesh->lodErrors.size(),
+			D3DXVec3Length(&toMesh), mProj._22, (float)md3dPP.BackBufferHeight);
+	}
+
+	// Only the parts of the ship in view and facing the camera are drawn.
+	DWORD numVertices = mMesh->lods[mLod]->GetNumVertices();
+	DWORD numTris     = mMesh->lods[mLod]->GetNumFaces();
+	if (!mMeshlets.empty())
+	{
+		mMeshlets[mLod]->update(mWorld.getMatrix(), mView*mProj, mEyePos);
+		numTris = mMeshlets[mLod]->getCullStats().numTrianglesDrawn;
+	}
+	DWORD fullResTris = mMesh->mesh->GetNumFaces();
+	if (mBox)
+	{
+		numVertices += mBox->GetNumVertices();
+		numTris     += mBox->GetNumFaces();
+		fullResTris += mBox->GetNumFaces();
+	}
+	mGfxStats->setVertexCount(numVertices);
+	mGfxStats->setTriCount(numTris);
+	mGfxStats->setFullResTriCount(fullResTris);
 }
 
 void BoundingBoxDemo::drawScene()
@@ -211,50 +239,56 @@ void BoundingBoxDemo::drawScene()
 	HR(gd3dDevice->BeginScene());
 
 	HR(mFX->SetValue(mhLight, &mLight, sizeof(DirLight)));
-	HR(mFX->SetMatrix(mhWVP, &(mWorld*mView*mProj)));
+	HR(mFX->SetMatrix(mhWVP, &(mWorld.getMatrix()*mView*mProj)));
 
+	// Both world transforms are rigid, so their normal matrices need no
+	// inverse.
 	D3DXMATRIX worldInvTrans;
-	D3DXMatrixInverse(&worldInvTrans, 0, &mWorld);
-	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+	mWorld.getNormalMatrix(&worldInvTrans);
 	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
-	HR(mFX->SetMatrix(mhWorld, &mWorld));
+	HR(mFX->SetMatrix(mhWorld, &mWorld.getMatrix()));
 
 	HR(mFX->SetTechnique(mhTech));
 	UINT numPasses = 0;
 	HR(mFX->Begin(&numPasses, 0));
 	HR(mFX->BeginPass(0));
 
-	for (int j = 0; j < mMtrl.size(); ++j)
+	for (int j = 0; j < mMesh->materials.size(); ++j)
 	{
-		HR(mFX->SetValue(mhMtrl, &mMtrl[j], sizeof(Material)));
+		HR(mFX->SetValue(mhMtrl, &mMesh->materials[j], sizeof(Material)));
 
-		if (mTex[j] != 0)
+		if (mMesh->textures[j] != 0)
 		{
-			HR(mFX->SetTexture(mhTex, mTex[j]));
+			HR(mFX->SetTexture(mhTex, mMesh->textures[j]->texture));
 		}
 		else
 		{
-			HR(mFX->SetTexture(mhTex, mWhiteTex));
+			HR(mFX->SetTexture(mhTex, mWhiteTex->texture));
 		}
 
 		HR(mFX->CommitChanges());
-		HR(mMesh->DrawSubset(j));
+		if (!mMeshlets.empty())
+			mMeshlets[mLod]->drawSubset(j);
+		else
+			HR(mMesh->lods[mLod]->DrawSubset(j));
 	}
 
 	// Draw the bounding box with alpha blending
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE));
-	HR(gd3dDevice->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA));
-	HR(gd3dDevice->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA));
-	HR(mFX->SetMatrix(mhWVP, &(mBoundingBoxOffset*mView*mProj)));
-	D3DXMatrixInverse(&worldInvTrans, 0, &mBoundingBoxOffset);
-	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
-	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
-	HR(mFX->SetMatrix(mhWorld, &mBoundingBoxOffset));
-	HR(mFX->SetValue(mhMtrl, &mBoxMtrl, sizeof(Material)));
-	HR(mFX->SetTexture(mhTex, mWhiteTex));
-	HR(mFX->CommitChanges());
-	HR(mBox->DrawSubset(0));
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, FALSE));
+	if (mBox)
+	{
+		HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE));
+		HR(gd3dDevice->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA));
+		HR(gd3dDevice->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA));
+		HR(mFX->SetMatrix(mhWVP, &(mBoundingBoxOffset.getMatrix()*mView*mProj)));
+		mBoundingBoxOffset.getNormalMatrix(&worldInvTrans);
+		HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
+		HR(mFX->SetMatrix(mhWorld, &mBoundingBoxOffset.getMatrix()));
+		HR(mFX->SetValue(mhMtrl, &mBoxMtrl, sizeof(Material)));
+		HR(mFX->SetTexture(mhTex, mWhiteTex->texture));
+		HR(mFX->CommitChanges());
+		HR(mBox->DrawSubset(0));
+		HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, FALSE));
+	}
 
 	HR(mFX->EndPass());
 	HR(mFX->End());
@@ -282,16 +316,43 @@ void BoundingBoxDemo::buildFX()
 	mhTex           = mFX->GetParameterByName(0, "gTex");
 }
 
+void BoundingBoxDemo::buildBoundingBox()
+{
+	// The loader computed the bounding box on its worker.
+	mBoundingBox = mMesh->box;
+
+	// Build a box mesh so that we can render the bounding box visually
+	float width  = mBoundingBox.maxPt.x - mBoundingBox.minPt.x;
+	float height = mBoundingBox.maxPt.y - mBoundingBox.minPt.y;
+	float depth  = mBoundingBox.maxPt.z - mBoundingBox.minPt.z;
+	HR(D3DXCreateBox(gd3dDevice, width, height, depth, &mBox, 0));
+
+	// It is possible that the mesh was not centered about the origin
+	// when it was modeled. But the bounding box mesh is built around the
+	// origin. So offset the boudning box (mesh) center so that it
+	// matches the true mathematical bounding box center.
+	D3DXVECTOR3 center = mBoundingBox.center();
+	D3DXMATRIX T;
+	D3DXMatrixTranslation(&T, center.x, center.y, center.z);
+	mBoundingBoxOffset = Transform(T, AFFINE_RIGID);
+}
+
+void BoundingBoxDemo::buildMeshlets()
+{
+	for (size_t i = 0; i < mMesh->lods.size(); ++i)
+		mMeshlets.push_back(new MeshletMesh(mMesh->lods[i]));
+}
+
 void BoundingBoxDemo::buildViewMtx()
 {
 	float x = mCameraRadius * cosf(mCameraRotationY);
 	float z = mCameraRadius * sinf(mCameraRotationY);
-	D3DXVECTOR3 pos(x, mCameraHeight, z);
+	mEyePos = D3DXVECTOR3(x, mCameraHeight, z);
 	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
 	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
-	D3DXMatrixLookAtLH(&mView, &pos, &target, &up);
+	D3DXMatrixLookAtLH(&mView, &mEyePos, &target, &up);
 
-	HR(mFX->SetValue(mhEyePos, &pos, sizeof(D3DXVECTOR3)));
+	HR(mFX->SetValue(mhEyePos, &mEyePos, sizeof(D3DXVECTOR3)));
 }
 
 void BoundingBoxDemo::buildProjMtx()
@@ -2,6 +2,8 @@
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "AssetLoader.h"
+#include "MeshSimplify.h"
 #include <string.h>
 
 class XFileDemo : public D3DApp
@@ -24,11 +26,10 @@ private:
 private:
 	GfxStats *mGfxStats;
 	
-	ID3DXMesh* mMesh;
-	std::vector<Material> mMtrl;
-	std::vector<IDirect3DTexture9*> mTex;
-
-	IDirect3DTexture9* mWhiteTex;
+	AssetLoader*  mLoader;
+	MeshAsset*    mMesh;
+	TextureAsset* mWhiteTex;
+	int           mLod;  // Index into mMesh->lods drawn this frame.
 
 	ID3DXEffect *mFX;
 	D3DXHANDLE   mhTech;
@@ -45,6 +46,7 @@ private:
 	float mCameraRotationY;
 	float mCameraRadius;
 	float mCameraHeight;
+	D3DXVECTOR3 mEyePos;
 
 	D3DXMATRIX mWorld;
 
@@ -87,14 +89,14 @@ XFileDemo::XFileDemo(HINSTANCE hInstance, std::wstring winCaption)
 	mLight.diffuse = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 	mLight.spec    = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 
-	LoadXFile(L"../../src/chap14/XFileDemo/Dwarf.x", &mMesh, mMtrl, mTex);
+	// The dwarf and its textures load in the background; the loader's
+	// placeholders are drawn until they arrive.
+	mLoader   = new AssetLoader();
+	mMesh     = mLoader->loadMesh(L"../../src/chap14/XFileDemo/Dwarf.x", 4);
+	mWhiteTex = mLoader->loadTexture(L"../../src/chap14/XFileDemo/whitetex.dds");
+	mLod      = 0;
 	D3DXMatrixIdentity(&mWorld);
 
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap14/XFileDemo/whitetex.dds", &mWhiteTex));
-
-	mGfxStats->addVertices(mMesh->GetNumVertices());
-	mGfxStats->addTriangles(mMesh->GetNumFaces());
-
 	buildFX();
 	
 	onResetDevice();
@@ -105,13 +107,7 @@ XFileDemo::~XFileDemo()
 	SafeDelete(mGfxStats);
 
 	SafeRelease(mFX);
-	for (int i = 0; i < mTex.size(); ++i)
-	{
-		SafeRelease(mTex[i]);
-	}
-
-	SafeRelease(mWhiteTex);
-	SafeRelease(mMesh);
+	SafeDelete(mLoader);
 
 	DestroyAllVertexDeclarations();
 }
@@ -148,6 +144,9 @@ void XFileDemo::updateScene(float dt)
 {
 	mGfxStats->update(dt);
 
+	// Swap in whatever finished loading since the last frame.
+	mLoader->update();
+	mGfxStats->setLoadProgress(mLoader->getNumCompleted(), mLoader->getNumRequested());
 	gDInput->poll();
 
 	if (gDInput->keyDown(DIK_W))
@@ -166,6 +165,20 @@ void XFileDemo::updateScene(float dt)
 		mCameraRadius = 2.0f;
 
 	buildViewMtx();
+
+	// Draw the coarsest level of detail that stays within a pixel of
+	// the full mesh at the dwarf's distance.
+	mLod = 0;
+	if (mMesh->ready && !mMesh->failed)
+	{
+		D3DXVECTOR3 toMesh = mMesh->box.center() - mEyePos;
+		mLod = SelectLod(&mMesh->lodErrors[0], (int)mMesh->lodErrors.size(),
+			D3DXVec3Length(&toMesh), mProj._22, (float)md3dPP.BackBufferHeight);
+	}
+
+	mGfxStats->setVertexCount(mMesh->lods[mLod]->GetNumVertices());
+	mGfxStats->setTriCount(mMesh->lods[mLod]->GetNumFaces());
+	mGfxStats->setFullResTriCount(mMesh->mesh->GetNumFaces());
 }
 
 void XFileDemo::drawScene()
@@ -187,21 +200,21 @@ void XFileDemo::drawScene()
 	HR(mFX->Begin(&numPasses, 0));
 	HR(mFX->BeginPass(0));
 
-	for (int j = 0; j < mMtrl.size(); ++j)
+	for (int j = 0; j < mMesh->materials.size(); ++j)
 	{
-		HR(mFX->SetValue(mhMtrl, &mMtrl[j], sizeof(Material)));
+		HR(mFX->SetValue(mhMtrl, &mMesh->materials[j], sizeof(Material)));
 
-		if (mTex[j] != 0)
+		if (mMesh->textures[j] != 0)
 		{
-			HR(mFX->SetTexture(mhTex, mTex[j]));
+			HR(mFX->SetTexture(mhTex, mMesh->textures[j]->texture));
 		}
 		else
 		{
-			HR(mFX->SetTexture(mhTex, mWhiteTex));
+			HR(mFX->SetTexture(mhTex, mWhiteTex->texture));
 		}
 
 		HR(mFX->CommitChanges());
-		HR(mMesh->DrawSubset(j));
+		HR(mMesh->lods[mLod]->DrawSubset(j));
 	}
 	HR(mFX->EndPass());
 	HR(mFX->End());
@@ -233,12 +246,12 @@ void XFileDemo::buildViewMtx()
 {
 	float x = mCameraRadius * cosf(mCameraRotationY);
 	float z = mCameraRadius * sinf(mCameraRotationY);
-	D3DXVECTOR3 pos(x, mCameraHeight, z);
+	mEyePos = D3DXVECTOR3(x, mCameraHeight, z);
 	D3DXVECTOR3 target(0.0f, 2.0f, 0.0f);
 	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
-	D3DXMatrixLookAtLH(&mView, &pos, &target, &up);
+	D3DXMatrixLookAtLH(&mView, &mEyePos, &target, &up);
 
-	HR(mFX->SetValue(mhEyePos, &pos, sizeof(D3DXVECTOR3)));
+	HR(mFX->SetValue(mhEyePos, &mEyePos, sizeof(D3DXVECTOR3)));
 }
 
 void XFileDemo::buildProjMtx()
@@ -7,25 +7,20 @@
 //           alter the height of the camera.
 //           Use '1', '2', '3', '4', and '5' keys to select the bone
 //           to rotate.  Use the 'A' and 'D' keys to rotate the bone.
+//           Press 'P' to play the two animation clips blended together
+//           and 'M' to go back to posing by hand; 'Q' and 'E' shift the
+//           blend between the clips.
 //=============================================================================
 
 #include "d3dApp.h"
 #include "directInput.h"
 #include "gfxStats.h"
 #include "Vertex.h"
+#include "Skeleton.h"
+#include "AnimationClip.h"
+#include "AssetLoader.h"
 #include <string.h>
-
-struct BoneFrame
-{
-	// Note: The root bone's "parent" frame is the world space
-
-	D3DXVECTOR3 pos;  // Relative to parent frame
-	float zAngle;     // Relative to parent frame
-
-	D3DXMATRIX toParentXForm;
-	D3DXMATRIX toWorldXForm;
-};
-
+#include <algorithm>
 
 class RobotArmDemo : public D3DApp
 {
@@ -44,7 +39,8 @@ private:
 	void buildViewMtx();
 	void buildProjMtx();
 
-	void buildBoneWorldTransforms();
+	void setBoneAngle(int bone, float angle);
+	void buildClips();
 
 private:
 	GfxStats *mGfxStats;
@@ -52,19 +48,29 @@ private:
 	// We only need one bone mesh. To draw several bones we just draw the
 	// same mesh several times, but with a different transformation
 	// applied so that it is drawn in a different place
-	ID3DXMesh* mBoneMesh;
-	std::vector<Material> mMtrl;
-	std::vector<IDirect3DTexture9*> mTex;
+	AssetLoader* mLoader;
+	MeshAsset*   mBoneMesh;
 
-	// Our robot arm has five bones.
+	// Our robot arm has five bones, each rotating about its parent's
+	// z-axis.
 	static const int NUM_BONES = 5;
-	BoneFrame mBones[NUM_BONES];
+	Skeleton mSkeleton;
+	float mBoneAngles[NUM_BONES];
+
+	// Two authored clips, a wave running down the arm and a curl, played
+	// blended together when mPlaying is set.
+	AnimationClip mWaveClip;
+	AnimationClip mCurlClip;
+	SkeletonPose  mPose;
+	bool  mPlaying;
+	float mAnimTime;
+	float mBlendWeight;
 
 	// Index into the bone array to the currently selected bone.
 	// The user can select a bone and rotate it.
 	int mBoneSelected;
 
-	IDirect3DTexture9* mWhiteTex;
+	TextureAsset* mWhiteTex;
 
 	ID3DXEffect *mFX;
 	D3DXHANDLE   mhTech;
@@ -123,34 +129,39 @@ RobotArmDemo::RobotArmDemo(HINSTANCE hInstance, std::wstring winCaption)
 	mLight.diffuse = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 	mLight.spec    = D3DXCOLOR(0.8f, 0.8f, 0.8f, 1.0f);
 
-	LoadXFile(L"../../src/chap15/RobotArmDemo/bone.x", &mBoneMesh, mMtrl, mTex);
+	// The bone mesh loads in the background; the loader's placeholders
+	// are drawn until it arrives.
+	mLoader   = new AssetLoader();
+	mBoneMesh = mLoader->loadMesh(L"../../src/chap15/RobotArmDemo/bone.x");
+	mWhiteTex = mLoader->loadTexture(L"../../src/chap15/RobotArmDemo/whitetex.dds");
 	D3DXMatrixIdentity(&mWorld);
 
-	// Create the white dummy texture
-	HR(D3DXCreateTextureFromFile(gd3dDevice, L"../../src/chap15/RobotArmDemo/whitetex.dds", &mWhiteTex));
-
 	// Initialize the bones relative to their parent frame.
-	// The root is special--its parent frame is the world space.
-	// As such, its position and angle are ignored--its 
-	// toWorldXForm should be set explicitly (that is, the world
-	// transform of the entire skeleton).
+	// The root is special--its parent frame is the world space,
+	// or rather the skeleton's root transform, which we use to
+	// shift the arm to the center of the scene.
 	//
 	// *------*------*------*------
 	//    0      1      2      3
 
+	mSkeleton.addBone(-1, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
 	for (int i = 1; i < NUM_BONES; ++i)
-	{
-		mBones[i].pos    = D3DXVECTOR3(2.0f, 0.0f, 0.0f);
-		mBones[i].zAngle = 0.0f;
-	}
-	mBones[0].pos    = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
-	mBones[0].zAngle = 0.0f;
+		mSkeleton.addBone(i - 1, D3DXVECTOR3(2.0f, 0.0f, 0.0f));
+
+	for (int i = 0; i < NUM_BONES; ++i)
+		setBoneAngle(i, 0.0f);
+
+	D3DXMATRIX T;
+	D3DXMatrixTranslation(&T, -NUM_BONES, 0.0f, 0.0f);
+	mSkeleton.setRootTransform(T);
 	
 	// Start off with the last(leaf) bone:
 	mBoneSelected = NUM_BONES - 1;
 
-	mGfxStats->addVertices(mBoneMesh->GetNumVertices() * NUM_BONES);
-	mGfxStats->addTriangles(mBoneMesh->GetNumFaces() * NUM_BONES);
+	buildClips();
+	mPlaying     = false;
+	mAnimTime    = 0.0f;
+	mBlendWeight = 0.5f;
 
 	buildFX();
 	
@@ -162,13 +173,7 @@ RobotArmDemo::~RobotArmDemo()
 	SafeDelete(mGfxStats);
 
 	SafeRelease(mFX);
-	for (int i = 0; i < mTex.size(); ++i)
-	{
-		SafeRelease(mTex[i]);
-	}
-
-	SafeRelease(mWhiteTex);
-	SafeRelease(mBoneMesh);
+	SafeDelete(mLoader);
 
 	DestroyAllVertexDeclarations();
 }
@@ -205,6 +210,12 @@ void RobotArmDemo::updateScene(float dt)
 {
 	mGfxStats->update(dt);
 
+	// Swap in whatever finished loading since the last frame.
+	mLoader->update();
+	mGfxStats->setLoadProgress(mLoader->getNumCompleted(), mLoader->getNumRequested());
+	mGfxStats->setVertexCount(mBoneMesh->mesh->GetNumVertices() * NUM_BONES);
+	mGfxStats->setTriCount(mBoneMesh->mesh->GetNumFaces() * NUM_BONES);
+
 	gDInput->poll();
 
 	if (gDInput->keyDown(DIK_W))
@@ -219,15 +230,45 @@ void RobotArmDemo::updateScene(float dt)
 	if (gDInput->keyDown(DIK_4)) mBoneSelected = 3;
 	if (gDInput->keyDown(DIK_5)) mBoneSelected = 4;
 
-	// Allow the user to rotate a bone
-	if (gDInput->keyDown(DIK_A))
-		mBones[mBoneSelected].zAngle += 1.0f * dt;
-	if (gDInput->keyDown(DIK_D))
-		mBones[mBoneSelected].zAngle -= 1.0f * dt;
+	if (gDInput->keyDown(DIK_P))
+		mPlaying = true;
+	if (gDInput->keyDown(DIK_M) && mPlaying)
+	{
+		// Back to the hand-set pose.
+		mPlaying = false;
+		for (int i = 0; i < NUM_BONES; ++i)
+			setBoneAngle(i, mBoneAngles[i]);
+	}
 
-	// If we rotate over 360 degrees, just roll back to 0
-	if (fabsf(mBones[mBoneSelected].zAngle) >= 2.0f*D3DX_PI)
-		mBones[mBoneSelected].zAngle = 0.0f;
+	if (mPlaying)
+	{
+		if (gDInput->keyDown(DIK_Q))
+			mBlendWeight = std::max(0.0f, mBlendWeight - 0.5f * dt);
+		if (gDInput->keyDown(DIK_E))
+			mBlendWeight = std::min(1.0f, mBlendWeight + 0.5f * dt);
+
+		// Both clips loop over the same period.
+		mAnimTime = fmodf(mAnimTime + dt, mWaveClip.getDuration());
+		BlendClips(mWaveClip, mAnimTime, mCurlClip, mAnimTime, mBlendWeight, &mPose);
+		mSkeleton.setPose(mPose);
+	}
+	else
+	{
+		// Allow the user to rotate a bone.  Only a bone that actually
+		// turns is handed to the skeleton, so untouched frames cost nothing.
+		float angle = mBoneAngles[mBoneSelected];
+		if (gDInput->keyDown(DIK_A))
+			angle += 1.0f * dt;
+		if (gDInput->keyDown(DIK_D))
+			angle -= 1.0f * dt;
+
+		// If we rotate over 360 degrees, just roll back to 0
+		if (fabsf(angle) >= 2.0f*D3DX_PI)
+			angle = 0.0f;
+
+		if (angle != mBoneAngles[mBoneSelected])
+			setBoneAngle(mBoneSelected, angle);
+	}
 
 	// divide by 50 to make mouse less sensitive
 	mCameraRotationY += gDInput->mouseDX() / 100.0f;
@@ -254,35 +295,32 @@ void RobotArmDemo::drawScene()
 	HR(mFX->Begin(&numPasses, 0));
 	HR(mFX->BeginPass(0));
 
-	buildBoneWorldTransforms();
-	D3DXMATRIX T;
-	D3DXMatrixTranslation(&T, -NUM_BONES, 0.0f, 0.0f);
+	// Only the bones below a joint that moved since the last frame are
+	// recomputed.
+	mSkeleton.update();
+	mGfxStats->setBoneUpdateCount(mSkeleton.getNumWorldUpdates(), NUM_BONES);
 	for (int i = 0; i < NUM_BONES; ++i)
 	{
-		// Append the transformation with a slight translation to better
-		// center the skeleton at the center of the scene.
-		mWorld = mBones[i].toWorldXForm * T;
+		// The root transform already centers the skeleton in the scene.
+		mWorld = mSkeleton.getToWorld(i);
 		HR(mFX->SetMatrix(mhWVP, &(mWorld*mView*mProj)));
-		D3DXMATRIX worldInvTrans;
-		D3DXMatrixInverse(&worldInvTrans, 0, &mWorld);
-		D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
-		HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
+		HR(mFX->SetMatrix(mhWorldInvTrans, &mSkeleton.getToWorldInvTrans(i)));
 		HR(mFX->SetMatrix(mhWorld, &mWorld));
-		for (int j = 0; j < mMtrl.size(); ++j)
+		for (int j = 0; j < mBoneMesh->materials.size(); ++j)
 		{
-			HR(mFX->SetValue(mhMtrl, &mMtrl[j], sizeof(Material)));
+			HR(mFX->SetValue(mhMtrl, &mBoneMesh->materials[j], sizeof(Material)));
 
-			if (mTex[j] != 0)
+			if (mBoneMesh->textures[j] != 0)
 			{
-				HR(mFX->SetTexture(mhTex, mTex[j]));
+				HR(mFX->SetTexture(mhTex, mBoneMesh->textures[j]->texture));
 			}
 			else
 			{
-				HR(mFX->SetTexture(mhTex, mWhiteTex));
+				HR(mFX->SetTexture(mhTex, mWhiteTex->texture));
 			}
 
 			HR(mFX->CommitChanges());
-			HR(mBoneMesh->DrawSubset(j));
+			HR(mBoneMesh->mesh->DrawSubset(j));
 		}
 	}
 
@@ -331,33 +369,47 @@ void RobotArmDemo::buildProjMtx()
 	D3DXMatrixPerspectiveFovLH(&mProj, D3DX_PI * 0.25f, w/h, 1.0f, 5000.0f);
 }
 
-void RobotArmDemo::buildBoneWorldTransforms()
+void RobotArmDemo::setBoneAngle(int bone, float angle)
 {
-	// First, construct the transformation matrix that transforms
-	// the i-th bone into the cooridinate system of its parent
+	// Each bone rotates about the z-axis of its parent frame.
+	mBoneAngles[bone] = angle;
 
-	D3DXMATRIX R, T;
-	D3DXVECTOR3 p;
-	for (int i = 0; i < NUM_BONES; ++i)
-	{
-		p = mBones[i].pos;
-		D3DXMatrixRotationZ(&R, mBones[i].zAngle);
-		D3DXMatrixTranslation(&T, p.x, p.y, p.z);
-		mBones[i].toParentXForm = R * T;
-	}
-
-	// Now, the i-th object's world transform is given by its
-	// to-parent transform, followed by its parent's to-parent transform,
-	// followed by its grandparent's to-parent transform, and
-	// so on, up to the root's to-parent transform.
+	D3DXVECTOR3 zAxis(0.0f, 0.0f, 1.0f);
+	D3DXQUATERNION q;
+	D3DXQuaternionRotationAxis(&q, &zAxis, angle);
+	mSkeleton.setRotation(bone, q);
+}
 
-	for (int i = 0; i < NUM_BONES; ++i)
+void RobotArmDemo::buildClips()
+{
+	// Keys for a four second loop at 30 frames per second, as an
+	// animation package would export them.  The bone offsets never
+	// change, so each position track compresses to a single key.
+	const int   NUM_FRAMES = 121;
+	const float FPS = 30.0f;
+
+	std::vector<D3DXVECTOR3>    positions(NUM_FRAMES * NUM_BONES);
+	std::vector<D3DXQUATERNION> wave(NUM_FRAMES * NUM_BONES);
+	std::vector<D3DXQUATERNION> curl(NUM_FRAMES * NUM_BONES);
+
+	D3DXVECTOR3 zAxis(0.0f, 0.0f, 1.0f);
+	for (int f = 0; f < NUM_FRAMES; ++f)
 	{
-		D3DXMatrixIdentity(&mBones[i].toWorldXForm);
-
-		for (int j = i; j >= 0; --j)
+		float phase = 2.0f * D3DX_PI * f / (NUM_FRAMES - 1);
+		for (int i = 0; i < NUM_BONES; ++i)
 		{
-			mBones[i].toWorldXForm *= mBones[j].toParentXForm;
+			positions[f*NUM_BONES + i] = D3DXVECTOR3(i == 0 ? 0.0f : 2.0f, 0.0f, 0.0f);
+
+			// Each joint follows the one before it a little later.
+			D3DXQuaternionRotationAxis(&wave[f*NUM_BONES + i], &zAxis, 0.5f * sinf(phase - 0.8f * i));
+
+			// Every joint bends the same way, closing the arm into a
+			// hook and opening it again.
+			D3DXQuaternionRotationAxis(&curl[f*NUM_BONES + i], &zAxis, 0.6f * (1.0f - cosf(phase)));
 		}
 	}
-}
\ No newline at end of file
+
+	// A thousandth of a radian is far below what can be seen on screen.
+	mWaveClip.build(NUM_BONES, NUM_FRAMES, FPS, &positions[0], &wave[0], 0.001f, 0.001f);
+	mCurlClip.build(NUM_BONES, NUM_FRAMES, FPS, &positions[0], &curl[0], 0.001f, 0.001f);
+}
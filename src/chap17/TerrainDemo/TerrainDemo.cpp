@@ -0,0 +1,338 @@
+//=============================================================================
+// TerrainDemo.cpp by Frank Luna (C) 2005 All Rights Reserved.
+//
+// Demonstrates geomipmapped terrain: each patch picks the coarsest LOD
+// whose error stays under a pixel tolerance, and the stats show the
+// triangles submitted against the full resolution count.
+//
+// Controls: Use mouse to orbit and zoom; use the 'W' and 'S' keys to 
+//           alter the height of the camera; use the 'E' and 'Q' keys
+//           to raise and lower the pixel error tolerance.
+//=============================================================================
+
+#include "d3dApp.h"
+#include "directInput.h"
+#include "gfxStats.h"
+#include <list>
+#include "Vertex.h"
+#include "Terrain.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+
+class TerrainDemo : public D3DApp
+{
+public:
+	TerrainDemo(HINSTANCE hInstance, std::wstring winCaption);
+	~TerrainDemo();
+
+	bool checkDeviceCaps();
+	void onLostDevice();
+	void onResetDevice();
+	void updateScene(float dt);
+	void drawScene();
+
+	// Helper methods
+	void buildTerrain();
+	void buildFX();
+	void buildViewMtx();
+	void buildProjMtx();
+
+private:
+	GfxStats* mGfxStats;
+
+	Terrain*           mTerrain;
+	IDirect3DTexture9* mGroundTex;
+
+	ID3DXEffect* mFX;
+	D3DXHANDLE   mhTech;
+	D3DXHANDLE   mhWVP;
+	D3DXHANDLE   mhWorldInvTrans;
+	D3DXHANDLE   mhLightVecW;
+	D3DXHANDLE   mhDiffuseMtrl;
+	D3DXHANDLE   mhDiffuseLight;
+	D3DXHANDLE   mhAmbientMtrl;
+	D3DXHANDLE   mhAmbientLight;
+	D3DXHANDLE   mhSpecularMtrl;
+	D3DXHANDLE   mhSpecularLight;
+	D3DXHANDLE   mhSpecularPower;
+	D3DXHANDLE   mhEyePos;
+	D3DXHANDLE   mhWorld;
+	D3DXHANDLE   mhTex;
+
+	D3DXVECTOR3 mLightVecW;
+	D3DXCOLOR   mAmbientMtrl;
+	D3DXCOLOR   mAmbientLight;
+	D3DXCOLOR   mDiffuseMtrl;
+	D3DXCOLOR   mDiffuseLight;
+	D3DXCOLOR   mSpecularMtrl;
+	D3DXCOLOR   mSpecularLight;
+	float       mSpecularPower;
+
+	float mCameraRotationY;
+	float mCameraRadius;
+	float mCameraHeight;
+	D3DXVECTOR3 mEyePos;
+
+	D3DXMATRIX mWorld;
+	D3DXMATRIX mView;
+	D3DXMATRIX mProj;
+};
+
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
+				   PSTR cmdLine, int showCmd)
+{
+	// Enable run-time memory check for debug builds.
+	#if defined(DEBUG) | defined(_DEBUG)
+		_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
+	#endif
+
+	TerrainDemo app(hInstance, L"Terrain Demo");
+	gd3dApp = &app;
+
+	DirectInput di(DISCL_NONEXCLUSIVE|DISCL_FOREGROUND, DISCL_NONEXCLUSIVE|DISCL_FOREGROUND);
+	gDInput = &di;
+
+	if (gd3dApp->checkDeviceCaps())
+		return gd3dApp->run();
+	else
+		return 0;
+}
+
+TerrainDemo::TerrainDemo(HINSTANCE hInstance, std::wstring winCaption)
+: D3DApp(hInstance, winCaption)
+{
+	mGfxStats = new GfxStats();
+	
+	mCameraRadius    = 300.0f;
+	mCameraRotationY = 1.2 * D3DX_PI;
+	mCameraHeight    = 120.0f;
+
+	mLightVecW     = D3DXVECTOR3(0.0, 0.707f, -0.707f);
+	mDiffuseMtrl   = D3DXCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
+	mDiffuseLight  = D3DXCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
+	mAmbientMtrl   = D3DXCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
+	mAmbientLight  = D3DXCOLOR(0.6f, 0.6f, 0.6f, 1.0f);
+	mSpecularMtrl  = D3DXCOLOR(0.4f, 0.4f, 0.4f, 1.0f);
+	mSpecularLight = D3DXCOLOR(1.0f, 1.0f, 1.0f, 1.0f);
+	mSpecularPower = 8.0f;
+
+	D3DXMatrixIdentity(&mWorld);
+
+	HR(LoadTextureCached(L"../../src/chap17/TerrainDemo/ground0.dds", &mGroundTex));
+
+	buildTerrain();
+	mGfxStats->setVertexCount(mTerrain->getNumVertices());
+	mGfxStats->setFullResTriCount(mTerrain->getNumFullResTriangles());
+
+	buildFX();
+
+	onResetDevice();
+
+	InitAllVertexDeclarations();
+}
+
+TerrainDemo::~TerrainDemo()
+{
+	delete mGfxStats;
+	delete mTerrain;
+	SafeRelease(mGroundTex);
+	SafeRelease(mFX);
+
+	DestroyAllVertexDeclarations();
+}
+
+bool TerrainDemo::checkDeviceCaps()
+{
+	D3DCAPS9 caps;
+	HR(gd3dDevice->GetDeviceCaps(&caps));
+
+	// Check for vertex shader version 2.0 support.
+	if( caps.VertexShaderVersion < D3DVS_VERSION(2, 0) )
+		return false;
+
+	// Check for pixel shader version 2.0 support.
+	if( caps.PixelShaderVersion < D3DPS_VERSION(2, 0) )
+		return false;
+
+	return true;
+}
+
+void TerrainDemo::onLostDevice()
+{
+	mGfxStats->onLostDevice();
+	HR(mFX->OnLostDevice());
+}
+
+void TerrainDemo::onResetDevice()
+{
+	mGfxStats->onResetDevice();
+	HR(mFX->OnResetDevice());
+
+
+	// The aspect ratio depends on the backbuffer dimensions, which can 
+	// possibly change after a reset.  So rebuild the projection matrix.
+	buildProjMtx();
+}
+
+void TerrainDemo::updateScene(float dt)
+{
+	mGfxStats->update(dt);
+
+	// Get snapshot of input devices.
+	gDInput->poll();
+
+	// Check input.
+	if( gDInput->keyDown(DIK_W) )	 
+		mCameraHeight   += 25.0f * dt;
+	if( gDInput->keyDown(DIK_S) )	 
+		mCameraHeight   -= 25.0f * dt;
+	if( gDInput->keyDown(DIK_E) )
+		mTerrain->setMaxPixelError(mTerrain->getMaxPixelError() + 4.0f * dt);
+	if( gDInput->keyDown(DIK_Q) && mTerrain->getMaxPixelError() > 0.5f )
+		mTerrain->setMaxPixelError(mTerrain->getMaxPixelError() - 4.0f * dt);
+
+	// Divide by 50 to make mouse less sensitive. 
+	mCameraRotationY += gDInput->mouseDX() / 100.0f;
+	mCameraRadius    += gDInput->mouseDY() / 2.0f;
+
+	// If we rotate over 360 degrees, just roll back to 0
+	if( fabsf(mCameraRotationY) >= 2.0f * D3DX_PI ) 
+		mCameraRotationY = 0.0f;
+
+	// Don't let radius get too small.
+	if( mCameraRadius < 5.0f )
+		mCameraRadius = 5.0f;
+	if( mCameraRadius > 1000.0f )
+		mCameraRadius = 1000.0f;
+
+	// The camera position/orientation relative to world space can 
+	// change every frame based on input, so we need to rebuild the
+	// view matrix every frame with the latest changes.
+	buildViewMtx();
+
+	// Pick patch LODs for the new camera.
+	float h = (float)md3dPP.BackBufferHeight;
+	mTerrain->update(mEyePos, mView*mProj, D3DX_PI * 0.25f, h);
+	mGfxStats->setTriCount(mTerrain->getNumTrianglesSubmitted());
+}
+
+
+void TerrainDemo::drawScene()
+{
+	// Clear the backbuffer and depth buffer.
+	HR(gd3dDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0xffeeeeee, 1.0f, 0));
+
+	HR(gd3dDevice->BeginScene());
+
+	// Setup the rendering FX
+	HR(mFX->SetTechnique(mhTech));
+
+	HR(mFX->SetMatrix(mhWVP, &(mWorld*mView*mProj)));
+	D3DXMATRIX worldInvTrans;
+	D3DXMatrixInverse(&worldInvTrans, 0, &mWorld);
+	D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+	HR(mFX->SetMatrix(mhWorldInvTrans, &worldInvTrans));
+	HR(mFX->SetValue(mhLightVecW, &mLightVecW, sizeof(D3DXVECTOR3)));
+	HR(mFX->SetValue(mhDiffuseMtrl, &mDiffuseMtrl, sizeof(D3DXCOLOR)));
+	HR(mFX->SetValue(mhDiffuseLight, &mDiffuseLight, sizeof(D3DXCOLOR)));
+	HR(mFX->SetValue(mhAmbientMtrl, &mAmbientMtrl, sizeof(D3DXCOLOR)));
+	HR(mFX->SetValue(mhAmbientLight, &mAmbientLight, sizeof(D3DXCOLOR)));
+	HR(mFX->SetValue(mhSpecularLight, &mSpecularLight, sizeof(D3DXCOLOR)));
+	HR(mFX->SetValue(mhSpecularMtrl, &mSpecularMtrl, sizeof(D3DXCOLOR)));
+	HR(mFX->SetFloat(mhSpecularPower, mSpecularPower));
+	HR(mFX->SetMatrix(mhWorld, &mWorld));
+	HR(mFX->SetTexture(mhTex, mGroundTex));
+
+	// Begin passes.
+	UINT numPasses = 0;
+	HR(mFX->Begin(&numPasses, 0));
+	for(UINT i = 0; i < numPasses; ++i)
+	{
+		HR(mFX->BeginPass(i));
+		mTerrain->draw();
+		HR(mFX->EndPass());
+	}
+	HR(mFX->End());
+
+	
+	mGfxStats->display(D3DCOLOR_XRGB(0,0,0));
+
+	HR(gd3dDevice->EndScene());
+
+	// Present the backbuffer.
+	HR(gd3dDevice->Present(0, 0, 0, 0));
+}
+
+void TerrainDemo::buildTerrain()
+{
+	// 1025x1025 vertices = 32x32 patches of 32x32 cells, about two million
+	// triangles at full resolution.
+	const int n = 1025;
+
+	std::vector<float> heights(n*n);
+	for(int i = 0; i < n; ++i)
+	{
+		for(int j = 0; j < n; ++j)
+		{
+			float x = (float)j;
+			float z = (float)i;
+
+			// Rolling hills with some smaller bumps on top.
+			heights[i*n+j] = 40.0f * sinf(0.011f*x) * cosf(0.013f*z)
+				+ 12.0f * sinf(0.05f*x + 0.7f) * sinf(0.043f*z)
+				+  2.0f * cosf(0.21f*x) * sinf(0.17f*z);
+		}
+	}
+
+	// The pool is only needed while the normals are computed.
+	ThreadPool pool;
+	mTerrain = new Terrain(n, n, 1.0f, 1.0f, &heights[0],
+		D3DXVECTOR3(0.0f, 0.0f, 0.0f), 32, 0.2f, &pool);
+}
+
+void TerrainDemo::buildFX()
+{
+	// Create the FX from a .fx file.
+	ID3DXBuffer* errors = 0;
+	HR(D3DXCreateEffectFromFile(gd3dDevice, L"../../src/chap17/TerrainDemo/DirLightTex.fx", 
+		0, 0, D3DXSHADER_DEBUG, 0, &mFX, &errors));
+	if( errors )
+		MessageBoxA(0, (char*)errors->GetBufferPointer(), 0, 0);
+
+	// Obtain handles.
+	mhTech          = mFX->GetTechniqueByName("DirLightTexTech");
+	mhWVP           = mFX->GetParameterByName(0, "gWVP");
+	mhWorldInvTrans = mFX->GetParameterByName(0, "gWorldInvTrans");
+	mhLightVecW     = mFX->GetParameterByName(0, "gLightVecW");
+	mhDiffuseMtrl   = mFX->GetParameterByName(0, "gDiffuseMtrl");
+	mhDiffuseLight  = mFX->GetParameterByName(0, "gDiffuseLight");
+	mhAmbientMtrl   = mFX->GetParameterByName(0, "gAmbientMtrl");
+	mhAmbientLight  = mFX->GetParameterByName(0, "gAmbientLight");
+	mhSpecularMtrl  = mFX->GetParameterByName(0, "gSpecularMtrl");
+	mhSpecularLight = mFX->GetParameterByName(0, "gSpecularLight");
+	mhSpecularPower = mFX->GetParameterByName(0, "gSpecularPower");
+	mhEyePos        = mFX->GetParameterByName(0, "gEyePosW");
+	mhWorld         = mFX->GetParameterByName(0, "gWorld");
+	mhTex           = mFX->GetParameterByName(0, "gTex");
+}
+
+void TerrainDemo::buildViewMtx()
+{
+	float x = mCameraRadius * cosf(mCameraRotationY);
+	float z = mCameraRadius * sinf(mCameraRotationY);
+	D3DXVECTOR3 pos(x, mCameraHeight, z);
+	mEyePos = pos;
+	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
+	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
+	D3DXMatrixLookAtLH(&mView, &pos, &target, &up);
+
+	HR(mFX->SetValue(mhEyePos, &pos, sizeof(D3DXVECTOR3)));
+}
+
+void TerrainDemo::buildProjMtx()
+{
+	float w = (float)md3dPP.BackBufferWidth;
+	float h = (float)md3dPP.BackBufferHeight;
+	D3DXMatrixPerspectiveFovLH(&mProj, D3DX_PI * 0.25f, w/h, 1.0f, 5000.0f);
+}
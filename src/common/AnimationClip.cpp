@@ -0,0 +1,462 @@
+#include "AnimationClip.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+	// The three smaller components of a unit quaternion are within
+	// +-1/sqrt(2); 15-bit codes step through that range.
+	const float ROT_RANGE = 0.70710678f;
+	const int   ROT_MAX_CODE = 32767;
+	const float ROT_STEP = 2.0f * ROT_RANGE / ROT_MAX_CODE;
+
+	const int   POS_MAX_CODE = 65535;
+
+	void EncodeRotation(const D3DXQUATERNION& q, unsigned short* key)
+	{
+		float c[4] = { q.x, q.y, q.z, q.w };
+		float len = sqrtf(c[0]*c[0] + c[1]*c[1] + c[2]*c[2] + c[3]*c[3]);
+
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (fabsf(c[i]) > fabsf(c[largest]))
+				largest = i;
+		}
+
+		// Bits 45-46 name the dropped component, then 15 bits for each
+		// of the others in x, y, z, w order.  Bit 47 is unused.
+		float scale = (c[largest] < 0.0f ? -1.0f : 1.0f) / len;
+		unsigned long long bits = (unsigned long long)largest << 45;
+		int shift = 30;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+
+			int code = (int)floorf((c[i]*scale + ROT_RANGE) / ROT_STEP + 0.5f);
+			code = std::max(0, std::min(code, ROT_MAX_CODE));
+			bits |= (unsigned long long)code << shift;
+			shift -= 15;
+		}
+
+		key[0] = (unsigned short)(bits >> 32);
+		key[1] = (unsigned short)(bits >> 16);
+		key[2] = (unsigned short)bits;
+	}
+
+	// The dropped component's index and the three codes, as floats ready
+	// for SIMD decoding.
+	void UnpackRotation(const unsigned short* key, float* largest, float* a, float* b, float* c)
+	{
+		unsigned long long bits = (unsigned long long)key[0] << 32 | (unsigned)key[1] << 16 | key[2];
+		*largest = (float)(int)((bits >> 45) & 3);
+		*a = (float)(int)((bits >> 30) & ROT_MAX_CODE);
+		*b = (float)(int)((bits >> 15) & ROT_MAX_CODE);
+		*c = (float)(int)(bits & ROT_MAX_CODE);
+	}
+
+	D3DXQUATERNION DecodeRotation(const unsigned short* key)
+	{
+		float largest, code[3];
+		UnpackRotation(key, &largest, &code[0], &code[1], &code[2]);
+
+		float c[4];
+		float sum = 0.0f;
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i == (int)largest)
+				continue;
+			c[i] = code[j++]*ROT_STEP - ROT_RANGE;
+			sum += c[i]*c[i];
+		}
+		c[(int)largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+
+		return D3DXQUATERNION(c[0], c[1], c[2], c[3]);
+	}
+
+	// Four quaternions from their unpacked codes (as UnpackRotation
+	// writes them, one lane each) into q[0..3] = x, y, z, w.
+	void DecodeRotations(SimdF4 largest, SimdF4 codeA, SimdF4 codeB, SimdF4 codeC, SimdF4* q)
+	{
+		SimdF4 step  = SimdSet1(ROT_STEP);
+		SimdF4 range = SimdSet1(ROT_RANGE);
+		SimdF4 a = SimdSub(SimdMul(codeA, step), range);
+		SimdF4 b = SimdSub(SimdMul(codeB, step), range);
+		SimdF4 c = SimdSub(SimdMul(codeC, step), range);
+
+		SimdF4 sum = SimdMulAdd(a, a, SimdMulAdd(b, b, SimdMul(c, c)));
+		SimdF4 l = SimdSqrt(SimdMax(SimdSub(SimdSet1(1.0f), sum), SimdSet1(0.0f)));
+
+		// The stored components fill the slots around the dropped one.
+		SimdF4 is0 = SimdCmpEq(largest, SimdSet1(0.0f));
+		SimdF4 is1 = SimdCmpEq(largest, SimdSet1(1.0f));
+		SimdF4 is2 = SimdCmpEq(largest, SimdSet1(2.0f));
+		SimdF4 is3 = SimdCmpEq(largest, SimdSet1(3.0f));
+
+		q[0] = SimdSelect(is0, l, a);
+		q[1] = SimdSelect(is0, a, SimdSelect(is1, l, b));
+		q[2] = SimdSelect(is2, l, SimdSelect(is3, c, b));
+		q[3] = SimdSelect(is3, l, c);
+	}
+
+	// Normalized (1-u)*a + u*b, through the shorter arc.
+	void Nlerp(const SimdF4* a, const SimdF4* b, SimdF4 u, SimdF4* out)
+	{
+		SimdF4 zero = SimdSet1(0.0f);
+		SimdF4 dot = SimdMulAdd(a[0], b[0], SimdMulAdd(a[1], b[1], SimdMulAdd(a[2], b[2], SimdMul(a[3], b[3]))));
+		SimdF4 ub = SimdSelect(SimdCmpLt(dot, zero), SimdSub(zero, u), u);
+		SimdF4 ua = SimdSub(SimdSet1(1.0f), u);
+
+		SimdF4 r[4];
+		for (int i = 0; i < 4; ++i)
+			r[i] = SimdMulAdd(a[i], ua, SimdMul(b[i], ub));
+
+		SimdF4 len2 = SimdMulAdd(r[0], r[0], SimdMulAdd(r[1], r[1], SimdMulAdd(r[2], r[2], SimdMul(r[3], r[3]))));
+		SimdF4 invLen = SimdDiv(SimdSet1(1.0f), SimdSqrt(len2));
+		for (int i = 0; i < 4; ++i)
+			out[i] = SimdMul(r[i], invLen);
+	}
+
+	D3DXQUATERNION NlerpScalar(const D3DXQUATERNION& a, const D3DXQUATERNION& b, float u)
+	{
+		float ub = D3DXQuaternionDot(&a, &b) < 0.0f ? -u : u;
+		D3DXQUATERNION r = a*(1.0f - u) + b*ub;
+		D3DXQuaternionNormalize(&r, &r);
+		return r;
+	}
+
+	// Frames of the keys a track keeps: just frame 0 if the track is
+	// constant, every frame if maxError is zero, and otherwise greedily
+	// the farthest next key that linear interpolation reaches without
+	// missing a frame in between by more than maxError, as measured by
+	// error(key0, key1, frame).  Quadratic in the longest run of dropped
+	// keys, which is fine for a load- or export-time step.
+	template <class ErrorFn>
+	void SelectKeys(int numFrames, bool constant, float maxError, ErrorFn error, std::vector<int>& keys)
+	{
+		keys.clear();
+		keys.push_back(0);
+		if (constant)
+			return;
+
+		int i = 0;
+		while (i < numFrames - 1)
+		{
+			int j = i + 1;
+			while (maxError > 0.0f && j + 1 < numFrames)
+			{
+				bool fits = true;
+				for (int f = i + 1; f <= j && fits; ++f)
+					fits = error(i, j + 1, f) <= maxError;
+				if (!fits)
+					break;
+				++j;
+			}
+			keys.push_back(j);
+			i = j;
+		}
+	}
+}
+
+AnimationClip::AnimationClip()
+	: mNumFrames(0), mFramesPerSecond(30.0f), mKeyGuessScale(0.0f)
+{
+}
+
+void AnimationClip::build(int numBones, int numFrames, float framesPerSecond,
+	const D3DXVECTOR3* positions, const D3DXQUATERNION* rotations,
+	float maxRotationError, float maxPositionError)
+{
+	// Key times are 16-bit frame numbers.
+	assert(numFrames >= 1 && numFrames <= 65536);
+
+	mNumFrames = numFrames;
+	mFramesPerSecond = framesPerSecond;
+	mKeyGuessScale = numFrames > 1 ? 1.0f / (numFrames - 1) : 0.0f;
+
+	mRotTracks.resize(numBones);
+	mPosTracks.resize(numBones);
+	mRotTimes.clear();
+	mRotKeys.clear();
+	mPosTimes.clear();
+	mPosKeys.clear();
+
+	std::vector<D3DXQUATERNION> rot(numFrames);
+	std::vector<D3DXVECTOR3> pos(numFrames);
+	std::vector<int> keys;
+
+	for (int b = 0; b < numBones; ++b)
+	{
+		// Rotations, normalized and each in the hemisphere of the one
+		// before so interpolating between them takes the short way.
+		bool constant = true;
+		for (int f = 0; f < numFrames; ++f)
+		{
+			const D3DXQUATERNION& q = rotations[f*numBones + b];
+			constant = constant && q == rotations[b];
+
+			D3DXQuaternionNormalize(&rot[f], &q);
+			if (f > 0 && D3DXQuaternionDot(&rot[f], &rot[f - 1]) < 0.0f)
+				rot[f] = -rot[f];
+		}
+
+		SelectKeys(numFrames, constant, maxRotationError, [&](int k0, int k1, int f)
+		{
+			D3DXQUATERNION q = NlerpScalar(rot[k0], rot[k1], (float)(f - k0) / (k1 - k0));
+			D3DXQUATERNION d = q - rot[f];
+			float chord = sqrtf(D3DXQuaternionDot(&d, &d));
+			return 4.0f * asinf(std::min(1.0f, 0.5f*chord));
+		}, keys);
+
+		mRotTracks[b].firstKey = (int)mRotTimes.size();
+		mRotTracks[b].numKeys  = (int)keys.size();
+		for (size_t k = 0; k < keys.size(); ++k)
+		{
+			unsigned short key[3];
+			EncodeRotation(rot[keys[k]], key);
+			mRotTimes.push_back((unsigned short)keys[k]);
+			mRotKeys.insert(mRotKeys.end(), key, key + 3);
+		}
+
+		// Positions.
+		constant = true;
+		for (int f = 0; f < numFrames; ++f)
+		{
+			pos[f] = positions[f*numBones + b];
+			constant = constant && pos[f] == pos[0];
+		}
+
+		SelectKeys(numFrames, constant, maxPositionError, [&](int k0, int k1, int f)
+		{
+			D3DXVECTOR3 p;
+			D3DXVec3Lerp(&p, &pos[k0], &pos[k1], (float)(f - k0) / (k1 - k0));
+			D3DXVECTOR3 d = p - pos[f];
+			return D3DXVec3Length(&d);
+		}, keys);
+
+		// Quantize over the box of the kept keys; a constant axis gets a
+		// zero step and comes back exact.
+		PositionTrack& track = mPosTracks[b];
+		track.firstKey = (int)mPosTimes.size();
+		track.numKeys  = (int)keys.size();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float lo = pos[keys[0]][axis], hi = lo;
+			for (size_t k = 1; k < keys.size(); ++k)
+			{
+				lo = std::min(lo, pos[keys[k]][axis]);
+				hi = std::max(hi, pos[keys[k]][axis]);
+			}
+			track.min[axis]  = lo;
+			track.step[axis] = (hi - lo) / POS_MAX_CODE;
+		}
+
+		for (size_t k = 0; k < keys.size(); ++k)
+		{
+			mPosTimes.push_back((unsigned short)keys[k]);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				int code = 0;
+				if (track.step[axis] > 0.0f)
+					code = (int)floorf((pos[keys[k]][axis] - track.min[axis]) / track.step[axis] + 0.5f);
+				mPosKeys.push_back((unsigned short)std::max(0, std::min(code, POS_MAX_CODE)));
+			}
+		}
+	}
+}
+
+float AnimationClip::getDuration()const
+{
+	return mNumFrames > 1 ? (mNumFrames - 1) / mFramesPerSecond : 0.0f;
+}
+
+int AnimationClip::getSizeInBytes()const
+{
+	return (int)(mRotTracks.size() * sizeof(Track) +
+		mPosTracks.size() * sizeof(PositionTrack) +
+		(mRotTimes.size() + mRotKeys.size() + mPosTimes.size() + mPosKeys.size()) * sizeof(unsigned short));
+}
+
+void AnimationClip::findKeys(const Track& track, const std::vector<unsigned short>& times,
+	float frame, int* k0, int* k1, float* u)const
+{
+	if (track.numKeys == 1)
+	{
+		*k0 = *k1 = track.firstKey;
+		*u = 0.0f;
+		return;
+	}
+
+	// The last key at or before frame, found by guessing from the
+	// track's average key spacing and walking from there.  Kept keys are
+	// spread fairly evenly over a clip, so the walk is usually zero or
+	// one step, and with every key kept the guess is exact.  The first
+	// key is at frame 0 and the last at the last frame, so the answer is
+	// always in [0, numKeys - 2] and the keys around frame are that one
+	// and the next.
+	const unsigned short* t = &times[track.firstKey];
+	int last = track.numKeys - 2;
+	int whole = (int)frame;
+	int lo = std::min((int)(frame * mKeyGuessScale * (track.numKeys - 1)), last);
+	while (lo > 0 && t[lo] > whole)
+		--lo;
+	while (lo < last && t[lo + 1] <= whole)
+		++lo;
+
+	*k0 = track.firstKey + lo;
+	*k1 = *k0 + 1;
+	*u = std::min(1.0f, (frame - t[lo]) / (t[lo + 1] - t[lo]));
+}
+
+struct AnimationClip::KeyBlock
+{
+	float rotCode[2][4][SAMPLE_BLOCK];  // Two keys, unpacked as by UnpackRotation.
+	float rotU[SAMPLE_BLOCK];
+	float posCode[2][3][SAMPLE_BLOCK];
+	float posMin[3][SAMPLE_BLOCK];
+	float posStep[3][SAMPLE_BLOCK];
+	float posU[SAMPLE_BLOCK];
+};
+
+void AnimationClip::gatherKeys(int begin, int count, float time, KeyBlock* block)const
+{
+	float frame = std::max(0.0f, std::min(time * mFramesPerSecond, (float)(mNumFrames - 1)));
+
+	for (int i = 0; i < ((count + 3) & ~3); ++i)
+	{
+		int b = std::min(begin + i, numBones() - 1);
+		int k[2];
+
+		findKeys(mRotTracks[b], mRotTimes, frame, &k[0], &k[1], &block->rotU[i]);
+		for (int j = 0; j < 2; ++j)
+		{
+			UnpackRotation(&mRotKeys[3*k[j]], &block->rotCode[j][0][i],
+				&block->rotCode[j][1][i], &block->rotCode[j][2][i], &block->rotCode[j][3][i]);
+		}
+
+		const PositionTrack& track = mPosTracks[b];
+		findKeys(track, mPosTimes, frame, &k[0], &k[1], &block->posU[i]);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			block->posCode[0][axis][i] = mPosKeys[3*k[0] + axis];
+			block->posCode[1][axis][i] = mPosKeys[3*k[1] + axis];
+			block->posMin[axis][i]  = track.min[axis];
+			block->posStep[axis][i] = track.step[axis];
+		}
+	}
+}
+
+void AnimationClip::sampleBlock(int begin, int count, float time, float* const* out)const
+{
+	KeyBlock block;
+	gatherKeys(begin, count, time, &block);
+
+	for (int i = 0; i < count; i += 4)
+	{
+		SimdF4 q0[4], q1[4], q[4];
+		DecodeRotations(SimdLoad(&block.rotCode[0][0][i]), SimdLoad(&block.rotCode[0][1][i]),
+			SimdLoad(&block.rotCode[0][2][i]), SimdLoad(&block.rotCode[0][3][i]), q0);
+		DecodeRotations(SimdLoad(&block.rotCode[1][0][i]), SimdLoad(&block.rotCode[1][1][i]),
+			SimdLoad(&block.rotCode[1][2][i]), SimdLoad(&block.rotCode[1][3][i]), q1);
+		Nlerp(q0, q1, SimdLoad(&block.rotU[i]), q);
+		for (int c = 0; c < 4; ++c)
+			SimdStore(out[3 + c] + i, q[c]);
+
+		SimdF4 u = SimdLoad(&block.posU[i]);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			SimdF4 lo   = SimdLoad(&block.posMin[axis][i]);
+			SimdF4 step = SimdLoad(&block.posStep[axis][i]);
+			SimdF4 p0 = SimdMulAdd(SimdLoad(&block.posCode[0][axis][i]), step, lo);
+			SimdF4 p1 = SimdMulAdd(SimdLoad(&block.posCode[1][axis][i]), step, lo);
+			SimdStore(out[axis] + i, SimdMulAdd(SimdSub(p1, p0), u, p0));
+		}
+	}
+}
+
+void AnimationClip::sample(float time, SkeletonPose* pose)const
+{
+	int n = numBones();
+	if (pose->numBones != n)
+		pose->resize(n);
+
+	for (int begin = 0; begin < n; begin += SAMPLE_BLOCK)
+	{
+		float* out[7] = { &pose->posX[begin], &pose->posY[begin], &pose->posZ[begin],
+			&pose->rotX[begin], &pose->rotY[begin], &pose->rotZ[begin], &pose->rotW[begin] };
+		sampleBlock(begin, std::min(SAMPLE_BLOCK, n - begin), time, out);
+	}
+}
+
+void AnimationClip::sampleBone(int bone, float time, D3DXVECTOR3* pos, D3DXQUATERNION* rot)const
+{
+	float frame = std::max(0.0f, std::min(time * mFramesPerSecond, (float)(mNumFrames - 1)));
+	int k0, k1;
+	float u;
+
+	findKeys(mRotTracks[bone], mRotTimes, frame, &k0, &k1, &u);
+	*rot = NlerpScalar(DecodeRotation(&mRotKeys[3*k0]), DecodeRotation(&mRotKeys[3*k1]), u);
+
+	const PositionTrack& track = mPosTracks[bone];
+	findKeys(track, mPosTimes, frame, &k0, &k1, &u);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float p0 = mPosKeys[3*k0 + axis] * track.step[axis] + track.min[axis];
+		float p1 = mPosKeys[3*k1 + axis] * track.step[axis] + track.min[axis];
+		(*pos)[axis] = (p1 - p0) * u + p0;
+	}
+}
+
+void BlendClips(const AnimationClip& a, float timeA,
+	const AnimationClip& b, float timeB, float weight, SkeletonPose* pose)
+{
+	assert(a.numBones() == b.numBones());
+
+	int n = a.numBones();
+	if (pose->numBones != n)
+		pose->resize(n);
+
+	// Each block of bones is sampled from both clips into scratch
+	// channels, then blended into the pose.
+	const int BLOCK = AnimationClip::SAMPLE_BLOCK;
+	float scratch[2][7][BLOCK];
+	float* outA[7];
+	float* outB[7];
+	for (int c = 0; c < 7; ++c)
+	{
+		outA[c] = scratch[0][c];
+		outB[c] = scratch[1][c];
+	}
+
+	SimdF4 w = SimdSet1(weight);
+	for (int begin = 0; begin < n; begin += BLOCK)
+	{
+		int count = std::min(BLOCK, n - begin);
+		a.sampleBlock(begin, count, timeA, outA);
+		b.sampleBlock(begin, count, timeB, outB);
+
+		float* dst[7] = { &pose->posX[begin], &pose->posY[begin], &pose->posZ[begin],
+			&pose->rotX[begin], &pose->rotY[begin], &pose->rotZ[begin], &pose->rotW[begin] };
+		for (int i = 0; i < count; i += 4)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				SimdF4 pa = SimdLoad(outA[axis] + i);
+				SimdF4 pb = SimdLoad(outB[axis] + i);
+				SimdStore(dst[axis] + i, SimdMulAdd(SimdSub(pb, pa), w, pa));
+			}
+
+			SimdF4 qa[4], qb[4], q[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				qa[c] = SimdLoad(outA[3 + c] + i);
+				qb[c] = SimdLoad(outB[3 + c] + i);
+			}
+			Nlerp(qa, qb, w, q);
+			for (int c = 0; c < 4; ++c)
+				SimdStore(dst[3 + c] + i, q[c]);
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Skeleton.h"
+
+//===============================================================
+// Compressed keyframe animation for a Skeleton.
+//
+// A clip is built from poses sampled at a fixed frame rate (the raw
+// keys an exporter writes) and holds one rotation track and one
+// position track per bone.  Keys are quantized to 48 bits each:
+//
+//   - rotations use "smallest three": the largest component of the
+//     unit quaternion is dropped (its sign is made positive, since q and
+//     -q are the same rotation) and rebuilt as sqrt(1 - a^2 - b^2 - c^2);
+//     the other three lie in [-1/sqrt(2), 1/sqrt(2)] and get 15 bits
+//     each, plus 2 bits for which component was dropped.  The error is
+//     below 1e-4 radians.
+//   - positions get 16 bits per axis over the bounding box of the
+//     track, so the error is 1/131070 of the track's extent per axis.
+//
+// A track whose raw keys never change keeps a single key.  With a
+// nonzero error bound, build() also drops every key that linear
+// interpolation between the kept keys reproduces to within the bound
+// (an angle in radians for rotations, a distance for positions), so
+// each track stores key times as well.  The bound applies to the raw
+// keys; quantization adds its own small error on top.
+//
+// Sampling finds the two keys around the time in each track, then
+// decodes, interpolates and normalizes four bones at a time with SIMD.
+// Rotations are interpolated with nlerp, which for keys this close
+// together is indistinguishable from slerp.  BlendClips samples two
+// clips for the same skeleton and blends them per bone the same way.
+
+class AnimationClip
+{
+public:
+	AnimationClip();
+
+	// Compresses numFrames poses of numBones bones sampled
+	// framesPerSecond times a second.  positions[f*numBones + b] and
+	// rotations[f*numBones + b] are the local transform of bone b in frame
+	// f.  Error bounds of zero keep every key.
+	void build(int numBones, int numFrames, float framesPerSecond,
+		const D3DXVECTOR3* positions, const D3DXQUATERNION* rotations,
+		float maxRotationError = 0.0f, float maxPositionError = 0.0f);
+
+	int   numBones()const           { return (int)mRotTracks.size(); }
+	int   getNumFrames()const       { return mNumFrames; }
+	float getFramesPerSecond()const { return mFramesPerSecond; }
+
+	// Time of the last frame; sampling clamps to [0, duration].
+	float getDuration()const;
+
+	// Keys kept over all tracks.
+	int getNumRotationKeys()const { return (int)mRotTimes.size(); }
+	int getNumPositionKeys()const { return (int)mPosTimes.size(); }
+
+	// Bytes of key data and track tables.
+	int getSizeInBytes()const;
+
+	// Local transforms of every bone at time, into pose (resized to
+	// numBones()).
+	void sample(float time, SkeletonPose* pose)const;
+
+	// One bone at time, without SIMD; the reference for sample().
+	void sampleBone(int bone, float time, D3DXVECTOR3* pos, D3DXQUATERNION* rot)const;
+
+private:
+	struct Track
+	{
+		int firstKey;  // Into the time and key arrays of its kind.
+		int numKeys;
+	};
+
+	struct PositionTrack : Track
+	{
+		float min[3];   // Dequantized position = min + key*step.
+		float step[3];
+	};
+
+	// The two keys of a track around frame and the weight of the
+	// second one.
+	void findKeys(const Track& track, const std::vector<unsigned short>& times,
+		float frame, int* k0, int* k1, float* u)const;
+
+	// Keys of up to SAMPLE_BLOCK bones from begin, gathered into one
+	// array per channel and then decoded four bones at a time into
+	// out[0..6] = posX, posY, posZ, rotX, rotY, rotZ, rotW (from begin).
+	// Gathering a whole block first keeps the SIMD loads clear of the
+	// scalar stores that fill them.  Lanes past the last bone repeat it.
+	static const int SAMPLE_BLOCK = 64;
+	struct KeyBlock;
+	void gatherKeys(int begin, int count, float time, KeyBlock* block)const;
+	void sampleBlock(int begin, int count, float time, float* const* out)const;
+
+	friend void BlendClips(const AnimationClip& a, float timeA,
+		const AnimationClip& b, float timeB, float weight, SkeletonPose* pose);
+
+private:
+	int   mNumFrames;
+	float mFramesPerSecond;
+	float mKeyGuessScale;  // 1 / (mNumFrames - 1), for findKeys.
+
+	std::vector<Track>         mRotTracks;
+	std::vector<PositionTrack> mPosTracks;
+
+	// Frame number of every kept key, and the keys themselves as three
+	// 16-bit words each.
+	std::vector<unsigned short> mRotTimes;
+	std::vector<unsigned short> mRotKeys;
+	std::vector<unsigned short> mPosTimes;
+	std::vector<unsigned short> mPosKeys;
+};
+
+// Samples a at timeA and b at timeB and blends the two poses per bone:
+// weight 0 gives a, 1 gives b.  Both clips must animate the same
+// skeleton.
+void BlendClips(const AnimationClip& a, float timeA,
+	const AnimationClip& b, float timeB, float weight, SkeletonPose* pose);
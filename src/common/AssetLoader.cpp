@@ -0,0 +1,579 @@
+#include "AssetLoader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "Vertex.h"
+#include <chrono>
+#include <codecvt>
+#include <locale>
+#include <string.h>
+
+//===============================================================
+// Jobs.  load() runs on a worker and must not touch the device or any
+// handle; create() runs in update() on the render thread and publishes
+// the result into the handle.
+
+struct AssetLoader::Job
+{
+	explicit Job(const std::wstring& fn) : filename(fn), failed(false) {}
+	virtual ~Job() {}
+
+	virtual void load(AssetLoader& loader) = 0;
+	virtual void create(AssetLoader& loader) = 0;
+
+	std::wstring filename;
+	std::string  error;
+	bool failed;
+};
+
+struct AssetLoader::MeshJob : public AssetLoader::Job
+{
+	MeshJob(const std::wstring& fn, MeshAsset* a, int lods) : Job(fn), asset(a), numLods(lods) {}
+
+	virtual void load(AssetLoader& loader) override;
+	virtual void create(AssetLoader& loader) override;
+
+	MeshAsset* asset;
+	int numLods;
+
+	std::vector<MeshCacheLevel> levels;  // Finest first.
+	std::vector<Material>       materials;
+	std::vector<std::string>    textureNames;  // Relative to the .x file.
+	std::vector<TextureAsset*>  textures;
+	AABB box;
+};
+
+struct AssetLoader::TextureJob : public AssetLoader::Job
+{
+	TextureJob(const std::wstring& fn, TextureAsset* a)
+		: Job(fn), asset(a), hash(0), format(D3DFMT_UNKNOWN), width(0), height(0), levels(0), blockBytes(0) {}
+
+	virtual void load(AssetLoader& loader) override;
+	virtual void create(AssetLoader& loader) override;
+
+	TextureAsset* asset;
+	std::vector<BYTE> data;  // The whole file.
+	unsigned __int64 hash;   // Of data, for gTextureCache.
+
+	// Set when data is a DDS file whose levels can be copied straight
+	// into a texture; D3DFMT_UNKNOWN sends the file through D3DX instead.
+	D3DFORMAT format;
+	UINT width;
+	UINT height;
+	UINT levels;
+	UINT blockBytes;  // Per 4x4 block for DXT formats, per pixel otherwise.
+};
+
+namespace
+{
+	const DWORD DDS_HEADER_SIZE  = 128;
+	const DWORD DDSD_MIPMAPCOUNT = 0x20000;
+	const DWORD DDPF_ALPHAPIXELS = 0x1;
+	const DWORD DDPF_FOURCC      = 0x4;
+	const DWORD DDPF_RGB         = 0x40;
+	const DWORD DDSCAPS2_CUBEMAP = 0x200;
+	const DWORD DDSCAPS2_VOLUME  = 0x200000;
+
+	DWORD ReadDWORD(const BYTE* p)
+	{
+		return p[0] | p[1] << 8 | p[2] << 16 | (DWORD)p[3] << 24;
+	}
+
+	// Rows and bytes per row of one mip level as a DDS file stores it;
+	// a DXT row is a row of 4x4 blocks.
+	void GetLevelLayout(D3DFORMAT format, UINT blockBytes, UINT width, UINT height,
+		UINT* rows, UINT* rowBytes)
+	{
+		if (format == D3DFMT_DXT1 || format == D3DFMT_DXT3 || format == D3DFMT_DXT5)
+		{
+			*rows     = (height + 3) / 4;
+			*rowBytes = (width + 3) / 4 * blockBytes;
+		}
+		else
+		{
+			*rows     = height;
+			*rowBytes = width * blockBytes;
+		}
+	}
+
+	// Reads the layout of a DDS file that a texture can take as is: a 2D
+	// power-of-two image with a full mip chain, in DXT1/3/5 or 32-bit RGB.
+	// D3DXCreateTextureFromFile would load anything else differently
+	// (rounding the size up, generating missing mips, converting the
+	// format), so those files are left to it.
+	bool ParseDDS(const BYTE* data, size_t size, D3DFORMAT* format, UINT* width, UINT* height,
+		UINT* levels, UINT* blockBytes)
+	{
+		if (size < DDS_HEADER_SIZE || memcmp(data, "DDS ", 4) != 0 || ReadDWORD(data + 4) != 124)
+			return false;
+
+		DWORD flags   = ReadDWORD(data + 8);
+		UINT  h       = ReadDWORD(data + 12);
+		UINT  w       = ReadDWORD(data + 16);
+		UINT  count   = flags & DDSD_MIPMAPCOUNT ? ReadDWORD(data + 28) : 1;
+		DWORD pfFlags = ReadDWORD(data + 80);
+		DWORD fourCC  = ReadDWORD(data + 84);
+		DWORD caps2   = ReadDWORD(data + 112);
+
+		if (w == 0 || h == 0 || w > 8192 || h > 8192 || (w & (w - 1)) != 0 || (h & (h - 1)) != 0 ||
+			(caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0)
+			return false;
+
+		UINT fullChain = 1;
+		for (UINT s = w > h ? w : h; s > 1; s >>= 1)
+			++fullChain;
+		if (count != fullChain)
+			return false;
+
+		if (pfFlags & DDPF_FOURCC)
+		{
+			if (fourCC == MAKEFOURCC('D','X','T','1'))
+			{
+				*format     = D3DFMT_DXT1;
+				*blockBytes = 8;
+			}
+			else if (fourCC == MAKEFOURCC('D','X','T','3'))
+			{
+				*format     = D3DFMT_DXT3;
+				*blockBytes = 16;
+			}
+			else if (fourCC == MAKEFOURCC('D','X','T','5'))
+			{
+				*format     = D3DFMT_DXT5;
+				*blockBytes = 16;
+			}
+			else
+				return false;
+		}
+		else if ((pfFlags & DDPF_RGB) && ReadDWORD(data + 88) == 32 &&
+			ReadDWORD(data + 92) == 0x00ff0000 && ReadDWORD(data + 96) == 0x0000ff00 &&
+			ReadDWORD(data + 100) == 0x000000ff)
+		{
+			bool alpha  = (pfFlags & DDPF_ALPHAPIXELS) && ReadDWORD(data + 104) == 0xff000000;
+			*format     = alpha ? D3DFMT_A8R8G8B8 : D3DFMT_X8R8G8B8;
+			*blockBytes = 4;
+		}
+		else
+			return false;
+
+		// Every level must be in the file.
+		unsigned long long total = 0;
+		for (UINT i = 0; i < count; ++i)
+		{
+			UINT rows, rowBytes;
+			GetLevelLayout(*format, *blockBytes, w >> i ? w >> i : 1, h >> i ? h >> i : 1, &rows, &rowBytes);
+			total += (unsigned long long)rows * rowBytes;
+		}
+		if (total > size - DDS_HEADER_SIZE)
+			return false;
+
+		*width  = w;
+		*height = h;
+		*levels = count;
+		return true;
+	}
+}
+
+void AssetLoader::MeshJob::load(AssetLoader& loader)
+{
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		error  = "could not open file";
+		failed = true;
+		return;
+	}
+
+	// The .x file's mesh cache, keyed on its contents as LoadXFileCached
+	// keys it, holds the whole LOD chain, so a hit skips the parse, the
+	// normals, the simplification and OptimizeMesh.  A miss writes a new
+	// cache (silently skipped if the directory is read-only).
+	unsigned __int64 sourceHash = HashBytes(file.getData(), file.getSize());
+	unsigned __int64 sourceSize = file.getSize();
+	std::wstring cacheFilename = GetMeshCacheFilename(filename);
+	if (!LoadMeshCache(cacheFilename, sourceHash, sourceSize, numLods, levels, materials, textureNames))
+	{
+		if (!BuildMeshLevels(file.getData(), file.getSize(), numLods, levels, materials, textureNames, &error))
+		{
+			failed = true;
+			return;
+		}
+		file.close();
+		SaveMeshCache(cacheFilename, sourceHash, sourceSize, numLods, levels, materials, textureNames);
+	}
+
+	const std::vector<VertexPNT>& vertices = levels[0].vertices;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		D3DXVec3Minimize(&box.minPt, &box.minPt, &vertices[i].pos);
+		D3DXVec3Maximize(&box.maxPt, &box.maxPt, &vertices[i].pos);
+	}
+
+	// Texture names are relative to the .x file.  Queue them now so they
+	// load alongside whatever else is pending.
+	std::wstring basepath;
+	size_t slash = filename.rfind(L'/');
+	if (slash != std::wstring::npos)
+		basepath = filename.substr(0, slash + 1);
+
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+	for (size_t i = 0; i < textureNames.size(); ++i)
+	{
+		const std::string& name = textureNames[i];
+		textures.push_back(name.empty() ? 0 : loader.requestTexture(basepath + converter.from_bytes(name)));
+	}
+}
+
+void AssetLoader::MeshJob::create(AssetLoader& loader)
+{
+	std::vector<ID3DXMesh*> meshes;
+	std::vector<float> lodErrors;
+	if (!failed)
+	{
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			ID3DXMesh* mesh = 0;
+			if (!CreateMeshFromLevel(levels[i], &mesh))
+			{
+				error  = "D3DXCreateMesh failed";
+				failed = true;
+				break;
+			}
+			meshes.push_back(mesh);
+			lodErrors.push_back(levels[i].lodError);
+		}
+
+		if (failed)
+		{
+			for (size_t i = 0; i < meshes.size(); ++i)
+				SafeRelease(meshes[i]);
+			meshes.clear();
+		}
+	}
+
+	if (!meshes.empty())
+	{
+		asset->mesh      = meshes[0];
+		asset->lods      = meshes;
+		asset->lodErrors = lodErrors;
+		asset->materials = materials;
+		asset->textures  = textures;
+		asset->box       = box;
+	}
+	asset->ready  = true;
+	asset->failed = failed;
+}
+
+void AssetLoader::TextureJob::load(AssetLoader& loader)
+{
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		error  = "could not open file";
+		failed = true;
+		return;
+	}
+
+	// Copying out of the mapping is what pulls the file in from disk,
+	// so that happens here rather than on the render thread.
+	data.assign(file.getData(), file.getData() + file.getSize());
+	hash = HashBytes(&data[0], data.size());
+
+	if (!ParseDDS(&data[0], data.size(), &format, &width, &height, &levels, &blockBytes))
+		format = D3DFMT_UNKNOWN;
+}
+
+void AssetLoader::TextureJob::create(AssetLoader& loader)
+{
+	// Another load of the same file, under any name, may already have
+	// made this texture.
+	IDirect3DTexture9* tex = 0;
+	if (!failed && gTextureCache)
+		tex = gTextureCache->find(filename, hash, data.size());
+
+	if (!failed && tex == 0)
+	{
+		if (format != D3DFMT_UNKNOWN &&
+			SUCCEEDED(gd3dDevice->CreateTexture(width, height, levels, 0, format, D3DPOOL_MANAGED, &tex, 0)))
+		{
+			const BYTE* src = &data[DDS_HEADER_SIZE];
+			for (UINT i = 0; i < levels; ++i)
+			{
+				UINT w = width >> i ? width >> i : 1;
+				UINT h = height >> i ? height >> i : 1;
+				UINT rows, rowBytes;
+				GetLevelLayout(format, blockBytes, w, h, &rows, &rowBytes);
+
+				D3DLOCKED_RECT r;
+				HR(tex->LockRect(i, &r, 0, 0));
+				BYTE* dst = (BYTE*)r.pBits;
+				for (UINT row = 0; row < rows; ++row)
+				{
+					memcpy(dst, src, rowBytes);
+					dst += r.Pitch;
+					src += rowBytes;
+				}
+				HR(tex->UnlockRect(i));
+			}
+		}
+		else if (FAILED(D3DXCreateTextureFromFileInMemory(gd3dDevice, &data[0], (UINT)data.size(), &tex)))
+		{
+			error  = "D3DXCreateTextureFromFileInMemory failed";
+			failed = true;
+		}
+
+		if (tex && gTextureCache)
+			gTextureCache->add(filename, hash, data.size(), tex);
+	}
+
+	if (tex)
+		asset->texture = tex;
+	asset->ready  = true;
+	asset->failed = failed;
+}
+
+//===============================================================
+// AssetLoader
+
+AssetLoader::AssetLoader(int numWorkers)
+	: mQuit(false), mNumRequested(0), mNumCompleted(0), mNumFailed(0),
+	mPlaceholderTex(0), mPlaceholderMesh(0)
+{
+	// 1x1 white, which textured shaders treat as "no texture".
+	HR(D3DXCreateTexture(gd3dDevice, 1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &mPlaceholderTex));
+	D3DLOCKED_RECT r;
+	HR(mPlaceholderTex->LockRect(0, &r, 0, 0));
+	*(DWORD*)r.pBits = 0xffffffff;
+	HR(mPlaceholderTex->UnlockRect(0));
+
+	// Unit box in VertexPNT format, so it draws with the same shaders as
+	// the meshes it stands in for.
+	D3DVERTEXELEMENT9 elements[MAX_FVF_DECL_SIZE];
+	UINT numElements = 0;
+	VertexPNT::Decl->GetDeclaration(elements, &numElements);
+
+	ID3DXMesh* box = 0;
+	HR(D3DXCreateBox(gd3dDevice, 1.0f, 1.0f, 1.0f, &box, 0));
+	HR(box->CloneMesh(D3DXMESH_MANAGED, elements, gd3dDevice, &mPlaceholderMesh));
+	SafeRelease(box);
+
+	if (numWorkers < 0)
+	{
+		int hw = (int)std::thread::hardware_concurrency();
+		numWorkers = hw > 1 ? hw - 1 : 1;
+	}
+
+	for (int i = 0; i < numWorkers; ++i)
+		mWorkers.push_back(std::thread(&AssetLoader::workerMain, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeCV.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+
+	for (size_t i = 0; i < mPending.size(); ++i)
+		delete mPending[i];
+	for (size_t i = 0; i < mFinished.size(); ++i)
+		delete mFinished[i];
+
+	for (size_t i = 0; i < mMeshes.size(); ++i)
+	{
+		if (mMeshes[i]->mesh != mPlaceholderMesh)
+		{
+			for (size_t j = 0; j < mMeshes[i]->lods.size(); ++j)
+				SafeRelease(mMeshes[i]->lods[j]);
+		}
+		delete mMeshes[i];
+	}
+
+	for (auto it = mTextures.begin(); it != mTextures.end(); ++it)
+	{
+		if (it->second->texture != mPlaceholderTex)
+			SafeRelease(it->second->texture);
+		delete it->second;
+	}
+
+	SafeRelease(mPlaceholderMesh);
+	SafeRelease(mPlaceholderTex);
+}
+
+MeshAsset* AssetLoader::loadMesh(const std::wstring& filename, int numLods)
+{
+	MeshAsset* asset = new MeshAsset;
+	asset->mesh   = mPlaceholderMesh;
+	asset->lods.push_back(mPlaceholderMesh);
+	asset->lodErrors.push_back(0.0f);
+	asset->materials.push_back(Material());
+	asset->textures.push_back(0);
+	asset->ready  = false;
+	asset->failed = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mMeshes.push_back(asset);
+	}
+
+	queueJob(new MeshJob(filename, asset, numLods));
+	return asset;
+}
+
+TextureAsset* AssetLoader::loadTexture(const std::wstring& filename)
+{
+	return requestTexture(filename);
+}
+
+TextureAsset* AssetLoader::requestTexture(const std::wstring& filename)
+{
+	TextureAsset* asset = 0;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		TextureAsset*& slot = mTextures[filename];
+		if (slot != 0)
+			return slot;
+
+		asset = new TextureAsset;
+		asset->texture = mPlaceholderTex;
+		asset->ready   = false;
+		asset->failed  = false;
+		slot = asset;
+	}
+
+	queueJob(new TextureJob(filename, asset));
+	return asset;
+}
+
+void AssetLoader::queueJob(Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending.push_back(job);
+		++mNumRequested;
+	}
+	mWakeCV.notify_one();
+}
+
+void AssetLoader::workerMain()
+{
+	for (;;)
+	{
+		Job* job = 0;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCV.wait(lock, [this] { return mQuit || !mPending.empty(); });
+			if (mQuit)
+				return;
+
+			job = mPending.front();
+			mPending.pop_front();
+		}
+
+		job->load(*this);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mFinished.push_back(job);
+		}
+		mFinishedCV.notify_all();
+	}
+}
+
+void AssetLoader::update(float maxSeconds)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (;;)
+	{
+		// Without workers, the loads run here, one per job created.
+		Job* job = 0;
+		bool loaded = true;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mFinished.empty())
+			{
+				job = mFinished.front();
+				mFinished.pop_front();
+			}
+			else if (mWorkers.empty() && !mPending.empty())
+			{
+				job = mPending.front();
+				mPending.pop_front();
+				loaded = false;
+			}
+		}
+		if (job == 0)
+			break;
+
+		if (!loaded)
+			job->load(*this);
+		job->create(*this);
+
+		if (job->failed)
+		{
+			std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+			std::wstring msg = L"AssetLoader: could not load " + job->filename + L": " +
+				converter.from_bytes(job->error) + L"\n";
+			OutputDebugStringW(msg.c_str());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			++mNumCompleted;
+			if (job->failed)
+				++mNumFailed;
+		}
+		delete job;
+
+		if (std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() >= maxSeconds)
+			break;
+	}
+}
+
+void AssetLoader::finish()
+{
+	while (!isDone())
+	{
+		if (!mWorkers.empty())
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mFinishedCV.wait(lock, [this] { return !mFinished.empty(); });
+		}
+		update(MY_INFINITY);
+	}
+}
+
+int AssetLoader::getNumRequested()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumRequested;
+}
+
+int AssetLoader::getNumCompleted()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumCompleted;
+}
+
+int AssetLoader::getNumFailed()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumFailed;
+}
+
+float AssetLoader::getProgress()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumRequested == 0 ? 1.0f : (float)mNumCompleted / mNumRequested;
+}
+
+bool AssetLoader::isDone()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumCompleted == mNumRequested;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+
+//===============================================================
+// Background loading of .x meshes and their textures.
+//
+// Requests return at once with a handle that already holds a usable
+// placeholder: a white texture, or a unit box mesh with one white
+// material.  Worker threads do everything that does not need the
+// device -- reading the files, parsing the .x file (ParseXFile, not
+// D3DX), building levels of detail, sorting faces by subset, ordering
+// them with OptimizeMesh, and taking DDS files apart into mip levels --
+// and queue the results.  Meshes go through the .x file's mesh cache
+// (MeshCache.h) as LoadXFileCached does, so once the cache is written a
+// load skips the parse and everything after it.  The render thread calls
+// update() once a frame, which turns finished jobs into managed-pool
+// resources and swaps them into the handles, so a demo can draw its
+// first frame before any asset has loaded.
+//
+// Handles are owned by the loader and live until it is destroyed,
+// along with every resource they point to.  Only the render thread may
+// read them, and only update() changes them.
+
+struct TextureAsset
+{
+	IDirect3DTexture9* texture;  // Placeholder until ready.
+	bool ready;   // Loaded, or failed and left on the placeholder.
+	bool failed;
+};
+
+struct MeshAsset
+{
+	ID3DXMesh* mesh;                      // Placeholder box until ready.
+	std::vector<ID3DXMesh*> lods;         // Finest first; lods[0] is mesh.
+	std::vector<float> lodErrors;         // One per lod, for SelectLod.
+	std::vector<Material> materials;      // One per subset.
+	std::vector<TextureAsset*> textures;  // One per material; null for none.
+	AABB box;                             // Empty until ready.
+	bool ready;
+	bool failed;
+};
+
+class AssetLoader
+{
+public:
+	// numWorkers < 0 means "one worker per hardware thread, minus the
+	// render thread".  With zero workers the jobs run inside update().
+	explicit AssetLoader(int numWorkers = -1);
+	~AssetLoader();
+
+	// Queue a load.  Texture paths are used as given; a mesh's textures
+	// are looked up relative to the .x file and queued as soon as the
+	// file is parsed.  Asking for the same texture twice returns the
+	// same handle, and textures go through gTextureCache when there is
+	// one, so they are shared with LoadTextureCached callers too.
+	//
+	// numLods > 1 also builds up to that many levels of detail
+	// (BuildLodChain) on the worker, each its own mesh with the same
+	// materials; the mesh may end up with fewer.
+	MeshAsset*    loadMesh(const std::wstring& filename, int numLods = 1);
+	TextureAsset* loadTexture(const std::wstring& filename);
+
+	// Creates device resources for finished jobs until maxSeconds have
+	// passed (always at least one job).  Render thread only.
+	void update(float maxSeconds = 0.004f);
+
+	// Progress over every asset requested so far, counting the textures
+	// meshes turned out to need.  An asset is done once update() has
+	// published it, whether it loaded or failed.
+	int   getNumRequested()const;
+	int   getNumCompleted()const;
+	int   getNumFailed()const;
+	float getProgress()const;
+	bool  isDone()const;
+
+	// Blocks, pumping update(), until every request is done.
+	void finish();
+
+	IDirect3DTexture9* getPlaceholderTexture()const { return mPlaceholderTex; }
+
+private:
+	AssetLoader(const AssetLoader& rhs);
+	AssetLoader& operator=(const AssetLoader& rhs);
+
+	struct Job;
+	struct MeshJob;
+	struct TextureJob;
+
+	// Callable from workers too, for the textures a mesh turns out to use.
+	TextureAsset* requestTexture(const std::wstring& filename);
+	void queueJob(Job* job);
+	void workerMain();
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	// Guards everything below it.  Jobs go from mPending to a worker to
+	// mFinished, and update() takes them from there.
+	mutable std::mutex      mMutex;
+	std::condition_variable mWakeCV;
+	std::condition_variable mFinishedCV;
+	std::deque<Job*>        mPending;
+	std::deque<Job*>        mFinished;
+	bool mQuit;
+
+	std::vector<MeshAsset*> mMeshes;
+	std::map<std::wstring, TextureAsset*> mTextures;
+	int mNumRequested;
+	int mNumCompleted;
+	int mNumFailed;
+
+	IDirect3DTexture9* mPlaceholderTex;
+	ID3DXMesh*         mPlaceholderMesh;
+};
@@ -0,0 +1,363 @@
+#include "FFT.h"
+#include "ThreadPool.h"
+#include <math.h>
+#include <assert.h>
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FFT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// The kernel is written once over a "lane vector" type: a plain float
+	// for one sequence, or __m128 for four interleaved ones.  Element k
+	// of lane l lives at index k*WIDTH + l.
+	struct ScalarOps
+	{
+		typedef float V;
+		enum { WIDTH = 1 };
+
+		static V load(const float* p)    { return *p; }
+		static void store(float* p, V v) { *p = v; }
+		static V set1(float f)           { return f; }
+		static V add(V a, V b)           { return a + b; }
+		static V sub(V a, V b)           { return a - b; }
+		static V mul(V a, V b)           { return a * b; }
+	};
+
+#if defined(FFT_SSE2)
+	struct SSEOps
+	{
+		typedef __m128 V;
+		enum { WIDTH = 4 };
+
+		static V load(const float* p)    { return _mm_load_ps(p); }
+		static void store(float* p, V v) { _mm_store_ps(p, v); }
+		static V set1(float f)           { return _mm_set1_ps(f); }
+		static V add(V a, V b)           { return _mm_add_ps(a, b); }
+		static V sub(V a, V b)           { return _mm_sub_ps(a, b); }
+		static V mul(V a, V b)           { return _mm_mul_ps(a, b); }
+	};
+#endif
+
+	// Runs every stage, ping-ponging between x and y.  Returns true if
+	// the result ended up in y.
+	template <class Ops>
+	bool Stockham(const FFTPlan::Stage* stages, int numStages,
+		const float* twRe, const float* twIm, bool inverse,
+		float* xr, float* xi, float* yr, float* yi)
+	{
+		typedef typename Ops::V V;
+		const int W = Ops::WIDTH;
+
+		// Forward multiplies by -i where the inverse multiplies by +i, and
+		// uses the conjugate twiddles.
+		float sign = inverse ? 1.0f : -1.0f;
+		V posSign = Ops::set1(sign);
+		V negSign = Ops::set1(-sign);
+
+		for (int st = 0; st < numStages; ++st)
+		{
+			const FFTPlan::Stage& stage = stages[st];
+			int s = stage.stride;
+
+			if (stage.radix == 2)
+			{
+				// Last stage, length 2: no twiddles.
+				for (int q = 0; q < s; ++q)
+				{
+					int a = q*W, b = (q + s)*W;
+					V ar = Ops::load(xr + a), ai = Ops::load(xi + a);
+					V br = Ops::load(xr + b), bi = Ops::load(xi + b);
+
+					Ops::store(yr + a, Ops::add(ar, br));
+					Ops::store(yi + a, Ops::add(ai, bi));
+					Ops::store(yr + b, Ops::sub(ar, br));
+					Ops::store(yi + b, Ops::sub(ai, bi));
+				}
+			}
+			else
+			{
+				int n0 = stage.length / 4;
+				const float* wr = twRe + stage.twiddles;
+				const float* wi = twIm + stage.twiddles;
+
+				for (int p = 0; p < n0; ++p)
+				{
+					V w1r = Ops::set1(wr[3*p]),   w1i = Ops::set1(-sign*wi[3*p]);
+					V w2r = Ops::set1(wr[3*p+1]), w2i = Ops::set1(-sign*wi[3*p+1]);
+					V w3r = Ops::set1(wr[3*p+2]), w3i = Ops::set1(-sign*wi[3*p+2]);
+
+					for (int q = 0; q < s; ++q)
+					{
+						int ia = (q + s*p)*W;
+						int ib = ia + s*n0*W;
+						int ic = ib + s*n0*W;
+						int id = ic + s*n0*W;
+
+						V ar = Ops::load(xr + ia), ai = Ops::load(xi + ia);
+						V br = Ops::load(xr + ib), bi = Ops::load(xi + ib);
+						V cr = Ops::load(xr + ic), ci = Ops::load(xi + ic);
+						V dr = Ops::load(xr + id), di = Ops::load(xi + id);
+
+						V apcR = Ops::add(ar, cr), apcI = Ops::add(ai, ci);
+						V amcR = Ops::sub(ar, cr), amcI = Ops::sub(ai, ci);
+						V bpdR = Ops::add(br, dr), bpdI = Ops::add(bi, di);
+
+						// j*(b - d) with j = sign*i.
+						V jR = Ops::mul(negSign, Ops::sub(bi, di));
+						V jI = Ops::mul(posSign, Ops::sub(br, dr));
+
+						V t1r = Ops::add(amcR, jR), t1i = Ops::add(amcI, jI);
+						V t2r = Ops::sub(apcR, bpdR), t2i = Ops::sub(apcI, bpdI);
+						V t3r = Ops::sub(amcR, jR), t3i = Ops::sub(amcI, jI);
+
+						int out = (q + s*4*p)*W;
+						int sW  = s*W;
+
+						Ops::store(yr + out, Ops::add(apcR, bpdR));
+						Ops::store(yi + out, Ops::add(apcI, bpdI));
+
+						Ops::store(yr + out + sW,   Ops::sub(Ops::mul(t1r, w1r), Ops::mul(t1i, w1i)));
+						Ops::store(yi + out + sW,   Ops::add(Ops::mul(t1r, w1i), Ops::mul(t1i, w1r)));
+						Ops::store(yr + out + 2*sW, Ops::sub(Ops::mul(t2r, w2r), Ops::mul(t2i, w2i)));
+						Ops::store(yi + out + 2*sW, Ops::add(Ops::mul(t2r, w2i), Ops::mul(t2i, w2r)));
+						Ops::store(yr + out + 3*sW, Ops::sub(Ops::mul(t3r, w3r), Ops::mul(t3i, w3i)));
+						Ops::store(yi + out + 3*sW, Ops::add(Ops::mul(t3r, w3i), Ops::mul(t3i, w3r)));
+					}
+				}
+			}
+
+			float* t;
+			t = xr; xr = yr; yr = t;
+			t = xi; xi = yi; yi = t;
+		}
+
+		return (numStages & 1) != 0;
+	}
+
+	// Scratch floats needed for one group of up to four sequences.
+	int ScratchSize(int n)
+	{
+		return 4*4*n + 4;
+	}
+
+	// 16-byte aligned start of a scratch vector.
+	float* AlignScratch(std::vector<float>& scratch)
+	{
+		size_t addr = (size_t)&scratch[0];
+		return (float*)((addr + 15) & ~(size_t)15);
+	}
+}
+
+FFTPlan::FFTPlan(int n)
+	: mSize(n)
+{
+	assert(n >= 4 && (n & (n - 1)) == 0);
+
+	const double TWO_PI = 6.283185307179586;
+
+	int length = n;
+	int stride = 1;
+	while (length >= 4)
+	{
+		Stage stage = { 4, length, stride, (int)mTwiddleRe.size() };
+		mStages.push_back(stage);
+
+		for (int p = 0; p < length/4; ++p)
+		{
+			for (int m = 1; m <= 3; ++m)
+			{
+				double theta = TWO_PI * p * m / length;
+				mTwiddleRe.push_back((float)cos(theta));
+				mTwiddleIm.push_back((float)-sin(theta));
+			}
+		}
+
+		length /= 4;
+		stride *= 4;
+	}
+
+	if (length == 2)
+	{
+		Stage stage = { 2, 2, stride, 0 };
+		mStages.push_back(stage);
+	}
+}
+
+void FFTPlan::transform(float* re, float* im, bool inverse)const
+{
+	std::vector<float> scratch(2*mSize);
+	float* yr = &scratch[0];
+	float* yi = yr + mSize;
+
+	const float* twRe = mTwiddleRe.empty() ? 0 : &mTwiddleRe[0];
+	const float* twIm = mTwiddleIm.empty() ? 0 : &mTwiddleIm[0];
+
+	if (Stockham<ScalarOps>(&mStages[0], (int)mStages.size(), twRe, twIm, inverse, re, im, yr, yi))
+	{
+		memcpy(re, yr, mSize*sizeof(float));
+		memcpy(im, yi, mSize*sizeof(float));
+	}
+}
+
+void FFTPlan::transformRows(float* re, float* im, int firstRow, int numRows, bool inverse, float* scratch)const
+{
+	int n = mSize;
+	const float* twRe = &mTwiddleRe[0];
+	const float* twIm = &mTwiddleIm[0];
+
+	int r = firstRow;
+
+#if defined(FFT_SSE2)
+	float* xr = scratch;
+	float* xi = xr + 4*n;
+	float* yr = xi + 4*n;
+	float* yi = yr + 4*n;
+
+	for (; r + 4 <= firstRow + numRows; r += 4)
+	{
+		float* rowRe = re + (size_t)r*n;
+		float* rowIm = im + (size_t)r*n;
+
+		// Four rows to lane-interleaved: each 4x4 block is transposed.
+		for (int k = 0; k < n; k += 4)
+		{
+			__m128 a0 = _mm_loadu_ps(rowRe + k),       a1 = _mm_loadu_ps(rowRe + n + k);
+			__m128 a2 = _mm_loadu_ps(rowRe + 2*n + k), a3 = _mm_loadu_ps(rowRe + 3*n + k);
+			_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+			_mm_store_ps(xr + 4*k, a0);      _mm_store_ps(xr + 4*k + 4, a1);
+			_mm_store_ps(xr + 4*k + 8, a2);  _mm_store_ps(xr + 4*k + 12, a3);
+
+			__m128 b0 = _mm_loadu_ps(rowIm + k),       b1 = _mm_loadu_ps(rowIm + n + k);
+			__m128 b2 = _mm_loadu_ps(rowIm + 2*n + k), b3 = _mm_loadu_ps(rowIm + 3*n + k);
+			_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+			_mm_store_ps(xi + 4*k, b0);      _mm_store_ps(xi + 4*k + 4, b1);
+			_mm_store_ps(xi + 4*k + 8, b2);  _mm_store_ps(xi + 4*k + 12, b3);
+		}
+
+		bool inY = Stockham<SSEOps>(&mStages[0], (int)mStages.size(), twRe, twIm, inverse, xr, xi, yr, yi);
+		const float* outRe = inY ? yr : xr;
+		const float* outIm = inY ? yi : xi;
+
+		for (int k = 0; k < n; k += 4)
+		{
+			__m128 a0 = _mm_load_ps(outRe + 4*k),     a1 = _mm_load_ps(outRe + 4*k + 4);
+			__m128 a2 = _mm_load_ps(outRe + 4*k + 8), a3 = _mm_load_ps(outRe + 4*k + 12);
+			_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+			_mm_storeu_ps(rowRe + k, a0);       _mm_storeu_ps(rowRe + n + k, a1);
+			_mm_storeu_ps(rowRe + 2*n + k, a2); _mm_storeu_ps(rowRe + 3*n + k, a3);
+
+			__m128 b0 = _mm_load_ps(outIm + 4*k),     b1 = _mm_load_ps(outIm + 4*k + 4);
+			__m128 b2 = _mm_load_ps(outIm + 4*k + 8), b3 = _mm_load_ps(outIm + 4*k + 12);
+			_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+			_mm_storeu_ps(rowIm + k, b0);       _mm_storeu_ps(rowIm + n + k, b1);
+			_mm_storeu_ps(rowIm + 2*n + k, b2); _mm_storeu_ps(rowIm + 3*n + k, b3);
+		}
+	}
+#endif
+
+	for (; r < firstRow + numRows; ++r)
+	{
+		float* rowRe = re + (size_t)r*n;
+		float* rowIm = im + (size_t)r*n;
+
+		if (Stockham<ScalarOps>(&mStages[0], (int)mStages.size(), twRe, twIm, inverse,
+			rowRe, rowIm, scratch, scratch + n))
+		{
+			memcpy(rowRe, scratch, n*sizeof(float));
+			memcpy(rowIm, scratch + n, n*sizeof(float));
+		}
+	}
+}
+
+void FFTPlan::transformCols(float* re, float* im, int firstCol, int numCols, bool inverse, float* scratch)const
+{
+	int n = mSize;
+	const float* twRe = &mTwiddleRe[0];
+	const float* twIm = &mTwiddleIm[0];
+
+	float* xr = scratch;
+	float* xi = xr + 4*n;
+	float* yr = xi + 4*n;
+	float* yi = yr + 4*n;
+
+	int c = firstCol;
+
+#if defined(FFT_SSE2)
+	// Four adjacent columns are already lane-interleaved in memory.
+	for (; c + 4 <= firstCol + numCols; c += 4)
+	{
+		for (int k = 0; k < n; ++k)
+		{
+			_mm_store_ps(xr + 4*k, _mm_loadu_ps(re + (size_t)k*n + c));
+			_mm_store_ps(xi + 4*k, _mm_loadu_ps(im + (size_t)k*n + c));
+		}
+
+		bool inY = Stockham<SSEOps>(&mStages[0], (int)mStages.size(), twRe, twIm, inverse, xr, xi, yr, yi);
+		const float* outRe = inY ? yr : xr;
+		const float* outIm = inY ? yi : xi;
+
+		for (int k = 0; k < n; ++k)
+		{
+			_mm_storeu_ps(re + (size_t)k*n + c, _mm_load_ps(outRe + 4*k));
+			_mm_storeu_ps(im + (size_t)k*n + c, _mm_load_ps(outIm + 4*k));
+		}
+	}
+#endif
+
+	for (; c < firstCol + numCols; ++c)
+	{
+		for (int k = 0; k < n; ++k)
+		{
+			xr[k] = re[(size_t)k*n + c];
+			xi[k] = im[(size_t)k*n + c];
+		}
+
+		bool inY = Stockham<ScalarOps>(&mStages[0], (int)mStages.size(), twRe, twIm, inverse, xr, xi, yr, yi);
+		const float* outRe = inY ? yr : xr;
+		const float* outIm = inY ? yi : xi;
+
+		for (int k = 0; k < n; ++k)
+		{
+			re[(size_t)k*n + c] = outRe[k];
+			im[(size_t)k*n + c] = outIm[k];
+		}
+	}
+}
+
+void FFTPlan::transform2D(float* re, float* im, bool inverse, ThreadPool* pool)const
+{
+	int n = mSize;
+
+	// Work is handed out in groups of four rows or columns.
+	int numGroups = (n + 3) / 4;
+	int grain = ITEMS_PER_CHUNK / (4*n);
+	if (grain < 1) grain = 1;
+
+	auto rows = [&](int begin, int end) {
+		std::vector<float> scratch(ScratchSize(n));
+		int first = 4*begin;
+		int last  = 4*end < n ? 4*end : n;
+		transformRows(re, im, first, last - first, inverse, AlignScratch(scratch));
+	};
+	auto cols = [&](int begin, int end) {
+		std::vector<float> scratch(ScratchSize(n));
+		int first = 4*begin;
+		int last  = 4*end < n ? 4*end : n;
+		transformCols(re, im, first, last - first, inverse, AlignScratch(scratch));
+	};
+
+	if (pool)
+	{
+		pool->parallelFor(numGroups, grain, rows);
+		pool->parallelFor(numGroups, grain, cols);
+	}
+	else
+	{
+		rows(0, numGroups);
+		cols(0, numGroups);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+class ThreadPool;
+
+//===============================================================
+// Complex FFT for power-of-two sizes.
+//
+// A Stockham auto-sort FFT (no bit-reversal pass) built from radix-4
+// stages plus one radix-2 stage when log2(n) is odd.  Data is split
+// into separate real and imaginary arrays.  The SSE2 kernel transforms
+// four sequences at once, one per lane: four columns of a 2D array are
+// already interleaved that way in memory, and four rows are brought
+// into that layout with 4x4 transposes.
+//
+// Neither direction is normalized: forward computes
+// X[k] = sum x[j]*exp(-2*pi*i*j*k/n) and inverse the same with +i, so
+// inverse(forward(x)) = n*x (n*n*x in 2D).
+
+class FFTPlan
+{
+public:
+	// n must be a power of two, at least 4.
+	explicit FFTPlan(int n);
+
+	int getSize()const { return mSize; }
+
+	// In-place transform of one sequence of n elements.
+	void transform(float* re, float* im, bool inverse)const;
+
+	// In-place transform of an n x n row-major array: every row, then
+	// every column.  With a pool, groups of four rows (then columns) are
+	// spread across its threads.
+	void transform2D(float* re, float* im, bool inverse, ThreadPool* pool = 0)const;
+
+	struct Stage
+	{
+		int radix;       // 4 or 2
+		int length;      // Length of the sub-transforms this stage splits.
+		int stride;      // Number of interleaved sub-transforms.
+		int twiddles;    // Offset of this stage's twiddles.
+	};
+
+private:
+	void transformRows(float* re, float* im, int firstRow, int numRows, bool inverse, float* scratch)const;
+	void transformCols(float* re, float* im, int firstCol, int numCols, bool inverse, float* scratch)const;
+
+private:
+	int mSize;
+	std::vector<Stage> mStages;
+
+	// exp(-2*pi*i*p*m/length) for m = 1, 2, 3, per radix-4 stage and p.
+	std::vector<float> mTwiddleRe;
+	std::vector<float> mTwiddleIm;
+};
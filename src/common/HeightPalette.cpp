@@ -0,0 +1,60 @@
+#include "HeightPalette.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEIGHTPALETTE_SSE2
+#include <emmintrin.h>
+#endif
+
+HeightPalette::HeightPalette(const HeightBand* bands, int numBands, float range, int size)
+	: mTable(size), mRange(range), mScale(size / range), mLast(size - 1)
+{
+	// Each entry takes the color of the band its center falls in.
+	int b = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		float h = (i + 0.5f) * range / size;
+		while (b < numBands - 1 && h > bands[b].maxHeight)
+			++b;
+		mTable[i] = bands[b].color;
+	}
+}
+
+void HeightPalette::lookup(const float* heights, int count, D3DCOLOR* colors)const
+{
+	const D3DCOLOR* table = &mTable[0];
+	int i = 0;
+
+#if defined(HEIGHTPALETTE_SSE2)
+	// |y| by clearing the sign bit, and the clamp done on the float
+	// before conversion.
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 scale   = _mm_set1_ps(mScale);
+	__m128 last    = _mm_set1_ps((float)mLast);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 y = _mm_and_ps(_mm_loadu_ps(heights + i), absMask);
+		__m128i index = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(y, scale), last));
+
+		int idx[4];
+		_mm_storeu_si128((__m128i*)idx, index);
+		colors[i]     = table[idx[0]];
+		colors[i + 1] = table[idx[1]];
+		colors[i + 2] = table[idx[2]];
+		colors[i + 3] = table[idx[3]];
+	}
+#endif
+
+	for (; i < count; ++i)
+		colors[i] = lookup(heights[i]);
+}
+
+void HeightPalette::createTexture(IDirect3DTexture9** tex)const
+{
+	HR(D3DXCreateTexture(gd3dDevice, getSize(), 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, tex));
+
+	D3DLOCKED_RECT lockedRect;
+	HR((*tex)->LockRect(0, &lockedRect, 0, 0));
+	memcpy(lockedRect.pBits, &mTable[0], mTable.size() * sizeof(D3DCOLOR));
+	HR((*tex)->UnlockRect(0));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+//===============================================================
+// Banded height-to-color palette baked into a lookup table.
+//
+// A band table ("|y| up to 0.2 is black, up to 0.4 blue, ...") is
+// sampled once into a table of size entries covering |y| in
+// [0, range); heights at or past range use the last entry.  A lookup
+// is then a scale, a clamp and a load whatever the number of bands, so
+// tables of up to 256 bands cost the same per vertex as five.  The
+// price is that |y| is quantized to range/size.
+//
+// The same table feeds the GPU as a size x 1 texture (see color.fx)
+// and CPU code such as WaveField through lookup().
+
+struct HeightBand
+{
+	float    maxHeight;  // Inclusive upper bound on |y|.
+	D3DCOLOR color;
+};
+
+class HeightPalette
+{
+public:
+	// bands must be sorted by maxHeight; heights above the last bound
+	// take the last band's color.
+	HeightPalette(const HeightBand* bands, int numBands, float range, int size = 256);
+
+	int   getSize()const  { return (int)mTable.size(); }
+	float getRange()const { return mRange; }
+
+	// Point sampling the texture at u = |y|*getTexScale() gives the same
+	// entry as lookup(y).
+	float getTexScale()const { return 1.0f / mRange; }
+
+	const D3DCOLOR* getTable()const { return &mTable[0]; }
+
+	D3DCOLOR lookup(float y)const
+	{
+		// Clamped before the conversion so huge heights cannot overflow.
+		float f = fabsf(y) * mScale;
+		return mTable[(int)(f < mLast ? f : (float)mLast)];
+	}
+
+	// Colors for count heights, four at a time with SSE2.
+	void lookup(const float* heights, int count, D3DCOLOR* colors)const;
+
+	// A managed size x 1 A8R8G8B8 texture holding the table, meant for
+	// point sampling with clamp addressing.
+	void createTexture(IDirect3DTexture9** tex)const;
+
+private:
+	std::vector<D3DCOLOR> mTable;
+	float mRange;
+	float mScale;  // size/range
+	int   mLast;   // size-1
+};
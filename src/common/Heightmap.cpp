@@ -0,0 +1,300 @@
+#include "Heightmap.h"
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+	// Skips whitespace and '#' comments in a PGM header.
+	void SkipPGMWhitespace(const char*& p, const char* end)
+	{
+		while (p < end)
+		{
+			if (*p == '#')
+			{
+				while (p < end && *p != '\n')
+					++p;
+			}
+			else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+				++p;
+			else
+				break;
+		}
+	}
+
+	bool ReadPGMInt(const char*& p, const char* end, int& value)
+	{
+		SkipPGMWhitespace(p, end);
+		if (p == end || *p < '0' || *p > '9')
+			return false;
+
+		value = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			value = value*10 + (*p - '0');
+			++p;
+		}
+		return true;
+	}
+}
+
+Heightmap::Heightmap()
+: mFile(INVALID_HANDLE_VALUE), mMapping(0), mDataOffset(0), mFileSize(0),
+  mNumRows(0), mNumCols(0), mBytesPerSample(2), mBigEndian(false), mMaxValue(65535),
+  mHeightScale(1.0f), mHeightOffset(0.0f)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	mAllocGranularity = info.dwAllocationGranularity;
+}
+
+Heightmap::~Heightmap()
+{
+	close();
+}
+
+void Heightmap::close()
+{
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mMapping  = 0;
+	mFile     = INVALID_HANDLE_VALUE;
+	mFileSize = 0;
+	mNumRows  = 0;
+	mNumCols  = 0;
+}
+
+bool Heightmap::openFile(const std::wstring& filename)
+{
+	close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	mFileSize = (ULONGLONG)size.QuadPart;
+
+	// Creating the mapping reads nothing; pages come in only when a
+	// view of them is touched.
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if (mMapping == 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool Heightmap::setLayout(ULONGLONG dataOffset, int numRows, int numCols,
+	int bytesPerSample, bool bigEndian, int maxValue)
+{
+	// A zero size asks for a square map filling the rest of the file.
+	if (numRows == 0 || numCols == 0)
+	{
+		ULONGLONG samples = (mFileSize - dataOffset) / bytesPerSample;
+		int side = (int)sqrt((double)samples);
+		while ((ULONGLONG)(side+1)*(side+1) <= samples) ++side;
+		while ((ULONGLONG)side*side > samples) --side;
+
+		numRows = numCols = side;
+	}
+
+	ULONGLONG dataSize = (ULONGLONG)numRows * numCols * bytesPerSample;
+	if (numRows < 2 || numCols < 2 || dataOffset + dataSize > mFileSize)
+	{
+		close();
+		return false;
+	}
+
+	mDataOffset     = dataOffset;
+	mNumRows        = numRows;
+	mNumCols        = numCols;
+	mBytesPerSample = bytesPerSample;
+	mBigEndian      = bigEndian;
+	mMaxValue       = maxValue;
+	return true;
+}
+
+bool Heightmap::openRAW(const std::wstring& filename, int numRows, int numCols)
+{
+	if (!openFile(filename))
+		return false;
+
+	return setLayout(0, numRows, numCols, 2, false, 65535);
+}
+
+bool Heightmap::openPGM(const std::wstring& filename)
+{
+	if (!openFile(filename))
+		return false;
+
+	size_t headerBytes = mFileSize < 4096 ? (size_t)mFileSize : 4096;
+	const char* header = (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, headerBytes);
+	if (header == 0)
+	{
+		close();
+		return false;
+	}
+
+	const char* p   = header;
+	const char* end = header + headerBytes;
+
+	int width = 0, height = 0, maxValue = 0;
+	bool ok = headerBytes > 2 && p[0] == 'P' && p[1] == '5';
+	p += 2;
+
+	ok = ok && ReadPGMInt(p, end, width) && ReadPGMInt(p, end, height) && ReadPGMInt(p, end, maxValue);
+
+	// Exactly one whitespace character separates the header from the data.
+	ok = ok && p < end && maxValue > 0 && maxValue < 65536;
+	ULONGLONG dataOffset = (ULONGLONG)(p - header) + 1;
+
+	UnmapViewOfFile(header);
+
+	if (!ok || width == 0 || height == 0)
+	{
+		close();
+		return false;
+	}
+
+	int bytesPerSample = maxValue < 256 ? 1 : 2;
+	return setLayout(dataOffset, height, width, bytesPerSample, true, maxValue);
+}
+
+bool Heightmap::open(const std::wstring& filename)
+{
+	size_t dot = filename.find_last_of(L'.');
+	if (dot != std::wstring::npos)
+	{
+		std::wstring ext = filename.substr(dot);
+		if (_wcsicmp(ext.c_str(), L".pgm") == 0)
+			return openPGM(filename);
+	}
+	return openRAW(filename);
+}
+
+const BYTE* Heightmap::mapRows(int firstRow, int numRows, void** view)const
+{
+	ULONGLONG rowBytes = (ULONGLONG)mNumCols * mBytesPerSample;
+	ULONGLONG offset   = mDataOffset + firstRow * rowBytes;
+
+	// View offsets must be multiples of the allocation granularity.
+	ULONGLONG aligned = offset - offset % mAllocGranularity;
+	size_t    size    = (size_t)(offset + numRows * rowBytes - aligned);
+
+	*view = MapViewOfFile(mMapping, FILE_MAP_READ, (DWORD)(aligned >> 32), (DWORD)aligned, size);
+	if (*view == 0)
+		return 0;
+
+	return (const BYTE*)*view + (offset - aligned);
+}
+
+bool Heightmap::readHeights(int firstRow, int firstCol, int numRows, int numCols, float* out)const
+{
+	void* view = 0;
+	const BYTE* rows = mapRows(firstRow, numRows, &view);
+	if (rows == 0)
+	{
+		for (int k = 0; k < numRows*numCols; ++k)
+			out[k] = mHeightOffset;
+		return false;
+	}
+
+	float scale = mHeightScale / mMaxValue;
+	size_t rowBytes = (size_t)mNumCols * mBytesPerSample;
+
+	for (int i = 0; i < numRows; ++i)
+	{
+		const BYTE* src = rows + i*rowBytes + (size_t)firstCol*mBytesPerSample;
+		float* dst = out + i*numCols;
+
+		if (mBytesPerSample == 1)
+		{
+			for (int j = 0; j < numCols; ++j)
+				dst[j] = src[j] * scale + mHeightOffset;
+		}
+		else if (mBigEndian)
+		{
+			for (int j = 0; j < numCols; ++j)
+				dst[j] = (WORD)(src[2*j] << 8 | src[2*j+1]) * scale + mHeightOffset;
+		}
+		else
+		{
+			for (int j = 0; j < numCols; ++j)
+			{
+				WORD s;
+				memcpy(&s, src + 2*j, sizeof(WORD));
+				dst[j] = s * scale + mHeightOffset;
+			}
+		}
+	}
+
+	UnmapViewOfFile(view);
+	return true;
+}
+
+bool Heightmap::buildTile(int firstRow, int firstCol, int numRows, int numCols,
+	float dx, float dz, const D3DXVECTOR3& center,
+	D3DXVECTOR3* positions, D3DXVECTOR3* normals)const
+{
+	// Read the tile plus a one-sample border, clamped to the map.
+	int r0 = firstRow > 0 ? firstRow-1 : firstRow;
+	int c0 = firstCol > 0 ? firstCol-1 : firstCol;
+	int r1 = firstRow+numRows < mNumRows ? firstRow+numRows : mNumRows-1;
+	int c1 = firstCol+numCols < mNumCols ? firstCol+numCols : mNumCols-1;
+
+	int pitch = c1 - c0 + 1;
+	std::vector<float> h((r1 - r0 + 1) * pitch);
+	bool read = readHeights(r0, c0, r1 - r0 + 1, pitch, &h[0]);
+
+	float width   = (float)(mNumCols-1) * dx;
+	float depth   = (float)(mNumRows-1) * dz;
+	float xOffset = -width * 0.5f;
+	float zOffset =  depth * 0.5f;
+
+	// Height at global sample (r, c), which must lie in the read window.
+	#define H(r, c) h[((r) - r0)*pitch + ((c) - c0)]
+
+	for (int i = 0; i < numRows; ++i)
+	{
+		int r = firstRow + i;
+
+		for (int j = 0; j < numCols; ++j)
+		{
+			int c = firstCol + j;
+			int k = i*numCols + j;
+
+			if (positions)
+			{
+				positions[k].x = ((float)c*dx + xOffset) + center.x;
+				positions[k].y = H(r, c) + center.y;
+				positions[k].z = (-(float)r*dz + zOffset) + center.z;
+			}
+
+			if (normals)
+			{
+				// Central differences, one-sided at the map border.
+				int rU = r > r0 ? r-1 : r, rD = r < r1 ? r+1 : r;
+				int cL = c > c0 ? c-1 : c, cR = c < c1 ? c+1 : c;
+
+				float dhdx = (H(r, cR) - H(r, cL)) / ((cR - cL) * dx);
+				float dhdz = (H(rU, c) - H(rD, c)) / ((rD - rU) * dz);
+
+				D3DXVECTOR3 n(-dhdx, 1.0f, -dhdz);
+				D3DXVec3Normalize(&normals[k], &n);
+			}
+		}
+	}
+
+	#undef H
+	return read;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+//===============================================================
+// Memory-mapped heightmap.
+//
+// Reads 16-bit heightmaps straight out of a file mapping, so opening
+// an 8k x 8k (or much larger) map costs the same as opening a tiny one
+// and only the rows of the tiles actually requested are ever paged in.
+// Each request maps just the band of rows it needs and unmaps it again,
+// so 32-bit builds can also read maps bigger than their address space.
+//
+// Supported formats:
+//   RAW - headerless, row-major, little-endian 16-bit samples (the .r16
+//         and .raw output of most terrain tools).
+//   PGM - binary "P5" greymap, 8 or 16 bits per sample (16-bit samples
+//         are big-endian, as the format requires).
+//
+// Samples are normalized by the file's maximum value and mapped to
+// height = sample/maxValue * heightScale + heightOffset.  Row 0 is the
+// first row in the file and lands at +z, matching GenTriGrid.
+//
+// All read methods are const and map their own views, so tiles can be
+// built from several threads at once.
+
+class Heightmap
+{
+public:
+	Heightmap();
+	~Heightmap();
+
+	// numRows/numCols of zero means the map is square and its size is
+	// taken from the file size.
+	bool openRAW(const std::wstring& filename, int numRows = 0, int numCols = 0);
+	bool openPGM(const std::wstring& filename);
+
+	// Picks the format from the extension (.pgm, otherwise RAW).
+	bool open(const std::wstring& filename);
+
+	void close();
+
+	bool isOpen()const     { return mMapping != 0; }
+	int  getNumRows()const { return mNumRows; }
+	int  getNumCols()const { return mNumCols; }
+
+	void  setHeightScale(float scale, float offset = 0.0f) { mHeightScale = scale; mHeightOffset = offset; }
+	float getHeightScale()const  { return mHeightScale;  }
+	float getHeightOffset()const { return mHeightOffset; }
+
+	// Copies heights of rows [firstRow, firstRow+numRows) and columns
+	// [firstCol, firstCol+numCols) into out, row-major.  The window must
+	// lie inside the map.  Returns false, with every height set to the
+	// height offset, if the rows could not be mapped; callers on worker
+	// threads report that themselves.
+	bool readHeights(int firstRow, int firstCol, int numRows, int numCols, float* out)const;
+
+	// Builds the vertices of a tile of the full-map grid with cell size
+	// dx x dz centered at center, exactly where GenTriGrid would put them
+	// for the whole map, plus smooth normals from central differences
+	// (which read one sample past the tile where the map allows).
+	// positions and normals each hold numRows*numCols elements; either
+	// may be null.  Returns false, leaving a flat tile, where readHeights
+	// would.
+	bool buildTile(int firstRow, int firstCol, int numRows, int numCols,
+		float dx, float dz, const D3DXVECTOR3& center,
+		D3DXVECTOR3* positions, D3DXVECTOR3* normals)const;
+
+private:
+	Heightmap(const Heightmap& rhs);
+	Heightmap& operator=(const Heightmap& rhs);
+
+	bool openFile(const std::wstring& filename);
+	bool setLayout(ULONGLONG dataOffset, int numRows, int numCols,
+		int bytesPerSample, bool bigEndian, int maxValue);
+
+	// Maps rows [firstRow, firstRow+numRows); returns a pointer to the
+	// first byte of firstRow and the view to unmap in *view.
+	const BYTE* mapRows(int firstRow, int numRows, void** view)const;
+
+private:
+	HANDLE    mFile;
+	HANDLE    mMapping;
+	ULONGLONG mDataOffset;
+	ULONGLONG mFileSize;
+	DWORD     mAllocGranularity;
+
+	int  mNumRows;
+	int  mNumCols;
+	int  mBytesPerSample;
+	bool mBigEndian;
+	int  mMaxValue;
+
+	float mHeightScale;
+	float mHeightOffset;
+};
@@ -0,0 +1,144 @@
+#include "MappedFile.h"
+#include <string.h>
+
+#ifndef _WIN32
+#include <codecvt>
+#include <locale>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+: mFile(INVALID_HANDLE_VALUE), mMapping(0), mData(0), mSize(0)
+{
+}
+
+bool MappedFile::open(const std::wstring& filename)
+{
+	close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0 ||
+		(ULONGLONG)size.QuadPart > (ULONGLONG)(size_t)-1)
+	{
+		close();
+		return false;
+	}
+	mSize = (size_t)size.QuadPart;
+
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if (mMapping == 0)
+	{
+		close();
+		return false;
+	}
+
+	mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == 0)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mData    = 0;
+	mMapping = 0;
+	mFile    = INVALID_HANDLE_VALUE;
+	mSize    = 0;
+}
+
+#else
+
+MappedFile::MappedFile()
+: mFile(-1), mData(0), mSize(0)
+{
+}
+
+bool MappedFile::open(const std::wstring& filename)
+{
+	close();
+
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+	mFile = ::open(converter.to_bytes(filename).c_str(), O_RDONLY);
+	if (mFile < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(mFile, &info) != 0 || info.st_size == 0 ||
+		(unsigned long long)info.st_size > (unsigned long long)(size_t)-1)
+	{
+		close();
+		return false;
+	}
+	mSize = (size_t)info.st_size;
+
+	void* data = mmap(0, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	mData = (const unsigned char*)data;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		munmap((void*)mData, mSize);
+	if (mFile >= 0)
+		::close(mFile);
+
+	mData = 0;
+	mFile = -1;
+	mSize = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+unsigned long long HashBytes(const void* data, size_t size)
+{
+	// Multiply-xorshift over 64-bit words; every input bit reaches every
+	// output bit within two steps.
+	const unsigned long long K = 0x9E3779B97F4A7C15ull;
+
+	unsigned long long h = (unsigned long long)size * K;
+	const unsigned char* p = (const unsigned char*)data;
+	for (; size >= 8; p += 8, size -= 8)
+	{
+		unsigned long long w;
+		memcpy(&w, p, 8);
+		h = (h ^ w) * K;
+		h ^= h >> 29;
+	}
+
+	unsigned long long tail = 0;
+	memcpy(&tail, p, size);
+	h = (h ^ tail) * K;
+	h ^= h >> 32;
+	return h;
+}
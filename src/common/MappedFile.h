@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+#ifdef _WIN32
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+//===============================================================
+// A whole file mapped read-only into memory.
+//
+// Opening maps the file but reads nothing; pages come in as the data
+// is touched, so reading a file this way costs no copy into a buffer
+// of our own.  Empty files fail to open.
+//
+// This header does not depend on Direct3D, and off Windows maps files
+// with POSIX mmap, so offline tools built on it also run in the Linux
+// asset pipeline.
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::wstring& filename);
+	void close();
+
+	bool                 isOpen()const  { return mData != 0; }
+	const unsigned char* getData()const { return mData; }
+	size_t               getSize()const { return mSize; }
+
+private:
+	MappedFile(const MappedFile& rhs);
+	MappedFile& operator=(const MappedFile& rhs);
+
+private:
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int    mFile;
+#endif
+	const unsigned char* mData;
+	size_t               mSize;
+};
+
+// 64-bit hash of size bytes, for telling file contents apart (not for
+// security).  Reads eight bytes a step.
+unsigned long long HashBytes(const void* data, size_t size);
@@ -0,0 +1,535 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "XFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplify.h"
+#include "Normals.h"
+#include "Vertex.h"
+#include <string.h>
+
+namespace
+{
+	// A cache file is a MeshCacheHeader followed by these blocks, each at
+	// the 16-byte aligned offset the header or its level records:
+	//
+	//   levels           numLevels MeshCacheLevelRecords, finest first
+	//   per level:
+	//     vertices         numVertices VertexPNTs
+	//     indices          numFaces*3 WORDs, or DWORDs for 32-bit meshes
+	//     attributes       numFaces DWORDs, the subset of each face
+	//     attribute table  numAttributes D3DXATTRIBUTERANGEs
+	//   materials        numMaterials MeshCacheMaterials
+	//   names            the texture names, each null terminated
+	const char MESH_CACHE_MAGIC[4] = { 'X', 'M', 'C', 'H' };
+
+	struct MeshCacheHeader
+	{
+		char             magic[4];
+		DWORD            version;
+		unsigned __int64 sourceHash;
+		unsigned __int64 sourceSize;
+		unsigned __int64 contentHash;  // Of everything after the header.
+
+		DWORD fileSize;
+		DWORD vertexStride;
+		DWORD numLods;       // Levels asked for when it was built.
+		DWORD numLevels;     // Levels built; fewer if the chain ended early.
+		DWORD numMaterials;
+
+		DWORD levelOffset;
+		DWORD materialOffset;
+		DWORD nameOffset;
+		DWORD nameBytes;
+	};
+
+	struct MeshCacheLevelRecord
+	{
+		float lodError;
+		DWORD options;       // D3DXMESH_32BIT or 0.
+		DWORD numVertices;
+		DWORD numFaces;
+		DWORD numAttributes;
+
+		DWORD vertexOffset;
+		DWORD indexOffset;
+		DWORD attributeOffset;
+		DWORD tableOffset;
+	};
+
+	struct MeshCacheMaterial
+	{
+		Material material;
+		DWORD    nameOffset;  // Into the names block.
+	};
+
+	// Appends size bytes at the next 16-byte boundary; returns their offset.
+	DWORD AppendBlock(std::vector<BYTE>& file, const void* data, size_t size)
+	{
+		size_t offset = (file.size() + 15) & ~(size_t)15;
+		file.resize(offset + size);
+		if (size != 0)
+			memcpy(&file[offset], data, size);
+		return (DWORD)offset;
+	}
+
+	template<typename T>
+	DWORD AppendBlock(std::vector<BYTE>& file, const std::vector<T>& v)
+	{
+		return AppendBlock(file, v.empty() ? 0 : &v[0], v.size() * sizeof(T));
+	}
+
+	bool BlockInFile(DWORD offset, unsigned __int64 size, size_t fileSize)
+	{
+		return offset >= sizeof(MeshCacheHeader) && offset <= fileSize && size <= fileSize - offset;
+	}
+
+	template<typename T>
+	void ReadBlock(const BYTE* data, DWORD offset, DWORD count, std::vector<T>& v)
+	{
+		const T* first = (const T*)(data + offset);
+		v.assign(first, first + count);
+	}
+
+	Material ToMaterial(const XFileMaterial& m)
+	{
+		// As in LoadXFile, the file has no ambient color, so use the
+		// diffuse one.
+		D3DXCOLOR diffuse(m.diffuse[0], m.diffuse[1], m.diffuse[2], m.diffuse[3]);
+		D3DXCOLOR spec(m.spec[0], m.spec[1], m.spec[2], 1.0f);
+		return Material(diffuse, diffuse, spec, m.specPower);
+	}
+
+	// Fills level from faces that index vertices, which it takes a copy of.
+	void BuildLevel(const XFileVertex* vertices, DWORD numVertices, const DWORD* faceIndices,
+		const DWORD* faceAttributes, DWORD numFaces, DWORD numMaterials, MeshCacheLevel& level)
+	{
+		// Sort the faces by subset (a counting sort, so each subset keeps
+		// its order) ...
+		std::vector<DWORD> faceStart(numMaterials + 1, 0);
+		for (DWORD i = 0; i < numFaces; ++i)
+			++faceStart[faceAttributes[i] + 1];
+		for (DWORD i = 0; i < numMaterials; ++i)
+			faceStart[i + 1] += faceStart[i];
+
+		level.indices.resize(numFaces * 3);
+		level.attributes.resize(numFaces);
+		std::vector<DWORD> next(faceStart.begin(), faceStart.end() - 1);
+		for (DWORD i = 0; i < numFaces; ++i)
+		{
+			DWORD a = faceAttributes[i];
+			DWORD f = next[a]++;
+			level.indices[f*3 + 0] = faceIndices[i*3 + 0];
+			level.indices[f*3 + 1] = faceIndices[i*3 + 1];
+			level.indices[f*3 + 2] = faceIndices[i*3 + 2];
+			level.attributes[f] = a;
+		}
+
+		// ... and order the faces of each subset and then the vertices.
+		// OptimizeMesh moves the vertices no face uses to the end, so they
+		// can be dropped; coarser levels leave many behind.
+		for (DWORD a = 0; a < numMaterials; ++a)
+		{
+			if (faceStart[a + 1] == faceStart[a])
+				continue;
+
+			D3DXATTRIBUTERANGE range;
+			range.AttribId    = a;
+			range.FaceStart   = faceStart[a];
+			range.FaceCount   = faceStart[a + 1] - faceStart[a];
+			range.VertexStart = 0;
+			range.VertexCount = 0;
+			level.table.push_back(range);
+		}
+
+		// XFileVertex is laid out as VertexPNT.
+		level.vertices.assign((const VertexPNT*)vertices, (const VertexPNT*)vertices + numVertices);
+		DWORD numUsed = OptimizeMesh(&level.indices[0], &level.table[0], (DWORD)level.table.size(),
+			&level.vertices[0], numVertices, sizeof(VertexPNT));
+		level.vertices.resize(numUsed);
+
+		level.use32Bit = level.vertices.size() > 0xffff;
+		if (!level.use32Bit)
+		{
+			level.indices16.assign(level.indices.begin(), level.indices.end());
+			std::vector<DWORD>().swap(level.indices);
+		}
+	}
+}
+
+bool SaveMeshCache(
+	const std::wstring& filename,
+	unsigned __int64 sourceHash,
+	unsigned __int64 sourceSize,
+	int numLods,
+	const std::vector<MeshCacheLevel>& levels,
+	const std::vector<Material>& materials,
+	const std::vector<std::string>& textureNames)
+{
+	if (numLods < 1)
+		numLods = 1;
+	if (levels.empty() || levels.size() > (size_t)numLods || textureNames.size() != materials.size())
+		return false;
+
+	MeshCacheHeader header;
+	ZeroMemory(&header, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version       = MESH_CACHE_VERSION;
+	header.sourceHash    = sourceHash;
+	header.sourceSize    = sourceSize;
+	header.vertexStride  = sizeof(VertexPNT);
+	header.numLods       = (DWORD)numLods;
+	header.numLevels     = (DWORD)levels.size();
+	header.numMaterials  = (DWORD)materials.size();
+
+	// The level records are filled in as their blocks are appended and
+	// copied over their placeholder at the end.
+	std::vector<BYTE> file(sizeof(header));
+	std::vector<MeshCacheLevelRecord> records(levels.size());
+	header.levelOffset = AppendBlock(file, records);
+
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		const MeshCacheLevel& level = levels[i];
+		MeshCacheLevelRecord& r = records[i];
+		r.lodError      = level.lodError;
+		r.options       = level.use32Bit ? D3DXMESH_32BIT : 0;
+		r.numVertices   = (DWORD)level.vertices.size();
+		r.numFaces      = (DWORD)level.attributes.size();
+		r.numAttributes = (DWORD)level.table.size();
+		if ((level.use32Bit ? level.indices.size() : level.indices16.size()) != r.numFaces * 3)
+			return false;
+
+		r.vertexOffset    = AppendBlock(file, level.vertices);
+		r.indexOffset     = level.use32Bit ? AppendBlock(file, level.indices) : AppendBlock(file, level.indices16);
+		r.attributeOffset = AppendBlock(file, level.attributes);
+		r.tableOffset     = AppendBlock(file, level.table);
+	}
+	memcpy(&file[header.levelOffset], &records[0], records.size() * sizeof(MeshCacheLevelRecord));
+
+	std::vector<MeshCacheMaterial> materialRecords(materials.size());
+	std::string names;
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		materialRecords[i].material   = materials[i];
+		materialRecords[i].nameOffset = (DWORD)names.size();
+		names.append(textureNames[i].c_str(), textureNames[i].size() + 1);
+	}
+	header.materialOffset = AppendBlock(file, materialRecords);
+	header.nameOffset = AppendBlock(file, names.data(), names.size());
+	header.nameBytes  = (DWORD)names.size();
+
+	header.fileSize    = (DWORD)file.size();
+	header.contentHash = HashBytes(&file[sizeof(header)], file.size() - sizeof(header));
+	memcpy(&file[0], &header, sizeof(header));
+
+	// Written beside the cache and renamed over it, so a reader never
+	// maps a half-written file.
+	std::wstring temp = filename + L".tmp";
+	HANDLE f = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	bool ok = WriteFile(f, &file[0], (DWORD)file.size(), &written, 0) && written == file.size();
+	CloseHandle(f);
+
+	if (ok)
+		ok = MoveFileExW(temp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	if (!ok)
+		DeleteFileW(temp.c_str());
+	return ok;
+}
+
+bool LoadMeshCache(
+	const std::wstring& filename,
+	unsigned __int64 sourceHash,
+	unsigned __int64 sourceSize,
+	int numLods,
+	std::vector<MeshCacheLevel>& levels,
+	std::vector<Material>& materials,
+	std::vector<std::string>& textureNames)
+{
+	if (numLods < 1)
+		numLods = 1;
+
+	MappedFile file;
+	if (!file.open(filename) || file.getSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	const BYTE* data = file.getData();
+	size_t size = file.getSize();
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != MESH_CACHE_VERSION ||
+		header.sourceHash != sourceHash ||
+		header.sourceSize != sourceSize ||
+		header.fileSize != size ||
+		header.vertexStride != sizeof(VertexPNT) ||
+		header.numLevels == 0 || header.numLevels > header.numLods ||
+		((DWORD)numLods > header.numLods && header.numLevels == header.numLods))
+		return false;
+
+	// Every block must lie inside the file before anything is hashed or
+	// read, and the names must end in a terminator.
+	if (!BlockInFile(header.levelOffset, (unsigned __int64)header.numLevels * sizeof(MeshCacheLevelRecord), size) ||
+		!BlockInFile(header.materialOffset, (unsigned __int64)header.numMaterials * sizeof(MeshCacheMaterial), size) ||
+		!BlockInFile(header.nameOffset, header.nameBytes, size) ||
+		(header.nameBytes != 0 && data[header.nameOffset + header.nameBytes - 1] != 0))
+		return false;
+
+	const MeshCacheLevelRecord* records = (const MeshCacheLevelRecord*)(data + header.levelOffset);
+	for (DWORD i = 0; i < header.numLevels; ++i)
+	{
+		const MeshCacheLevelRecord& r = records[i];
+		unsigned __int64 numFaces = r.numFaces;
+		DWORD indexSize = r.options ? sizeof(DWORD) : sizeof(WORD);
+		if ((r.options & ~D3DXMESH_32BIT) != 0 ||
+			!BlockInFile(r.vertexOffset, (unsigned __int64)r.numVertices * sizeof(VertexPNT), size) ||
+			!BlockInFile(r.indexOffset, numFaces * 3 * indexSize, size) ||
+			!BlockInFile(r.attributeOffset, numFaces * sizeof(DWORD), size) ||
+			!BlockInFile(r.tableOffset, (unsigned __int64)r.numAttributes * sizeof(D3DXATTRIBUTERANGE), size))
+			return false;
+	}
+
+	if (HashBytes(data + sizeof(header), size - sizeof(header)) != header.contentHash)
+		return false;
+
+	const MeshCacheMaterial* materialRecords = (const MeshCacheMaterial*)(data + header.materialOffset);
+	for (DWORD i = 0; i < header.numMaterials; ++i)
+	{
+		if (materialRecords[i].nameOffset >= header.nameBytes)
+			return false;
+	}
+
+	// The file checks out; copy the levels asked for out of the mapping.
+	DWORD numLevels = header.numLevels < (DWORD)numLods ? header.numLevels : (DWORD)numLods;
+	levels.resize(numLevels);
+	for (DWORD i = 0; i < numLevels; ++i)
+	{
+		const MeshCacheLevelRecord& r = records[i];
+		MeshCacheLevel& level = levels[i];
+		level.lodError = r.lodError;
+		level.use32Bit = r.options != 0;
+
+		ReadBlock(data, r.vertexOffset, r.numVertices, level.vertices);
+		if (level.use32Bit)
+		{
+			ReadBlock(data, r.indexOffset, r.numFaces * 3, level.indices);
+			level.indices16.clear();
+		}
+		else
+		{
+			ReadBlock(data, r.indexOffset, r.numFaces * 3, level.indices16);
+			level.indices.clear();
+		}
+		ReadBlock(data, r.attributeOffset, r.numFaces, level.attributes);
+		ReadBlock(data, r.tableOffset, r.numAttributes, level.table);
+	}
+
+	const char* names = (const char*)(data + header.nameOffset);
+	for (DWORD i = 0; i < header.numMaterials; ++i)
+	{
+		materials.push_back(materialRecords[i].material);
+		textureNames.push_back(names + materialRecords[i].nameOffset);
+	}
+	return true;
+}
+
+bool CreateMeshFromLevel(const MeshCacheLevel& level, ID3DXMesh** meshOut)
+{
+	D3DVERTEXELEMENT9 elements[MAX_FVF_DECL_SIZE];
+	UINT numElements = 0;
+	VertexPNT::Decl->GetDeclaration(elements, &numElements);
+
+	ID3DXMesh* mesh = 0;
+	DWORD numFaces = (DWORD)level.attributes.size();
+	DWORD numVertices = (DWORD)level.vertices.size();
+	if (FAILED(D3DXCreateMesh(numFaces, numVertices, D3DXMESH_MANAGED | (level.use32Bit ? D3DXMESH_32BIT : 0),
+		elements, gd3dDevice, &mesh)))
+		return false;
+
+	void* v = 0;
+	HR(mesh->LockVertexBuffer(0, &v));
+	memcpy(v, &level.vertices[0], numVertices * sizeof(VertexPNT));
+	HR(mesh->UnlockVertexBuffer());
+
+	void* k = 0;
+	HR(mesh->LockIndexBuffer(0, &k));
+	if (level.use32Bit)
+		memcpy(k, &level.indices[0], numFaces * 3 * sizeof(DWORD));
+	else
+		memcpy(k, &level.indices16[0], numFaces * 3 * sizeof(WORD));
+	HR(mesh->UnlockIndexBuffer());
+
+	DWORD* attributes = 0;
+	HR(mesh->LockAttributeBuffer(0, &attributes));
+	memcpy(attributes, &level.attributes[0], numFaces * sizeof(DWORD));
+	HR(mesh->UnlockAttributeBuffer());
+
+	if (!level.table.empty())
+		HR(mesh->SetAttributeTable(&level.table[0], (DWORD)level.table.size()));
+
+	*meshOut = mesh;
+	return true;
+}
+
+bool ReadMeshLevel(ID3DXMesh* mesh, MeshCacheLevel& level)
+{
+	if (mesh->GetNumBytesPerVertex() != sizeof(VertexPNT))
+		return false;
+
+	DWORD numVertices = mesh->GetNumVertices();
+	DWORD numFaces    = mesh->GetNumFaces();
+	level.lodError = 0.0f;
+	level.use32Bit = (mesh->GetOptions() & D3DXMESH_32BIT) != 0;
+
+	DWORD numAttributes = 0;
+	HR(mesh->GetAttributeTable(0, &numAttributes));
+	level.table.resize(numAttributes);
+	if (numAttributes != 0)
+		HR(mesh->GetAttributeTable(&level.table[0], &numAttributes));
+
+	void* v = 0;
+	HR(mesh->LockVertexBuffer(D3DLOCK_READONLY, &v));
+	level.vertices.assign((const VertexPNT*)v, (const VertexPNT*)v + numVertices);
+	HR(mesh->UnlockVertexBuffer());
+
+	void* k = 0;
+	HR(mesh->LockIndexBuffer(D3DLOCK_READONLY, &k));
+	if (level.use32Bit)
+	{
+		level.indices.assign((const DWORD*)k, (const DWORD*)k + numFaces * 3);
+		level.indices16.clear();
+	}
+	else
+	{
+		level.indices16.assign((const WORD*)k, (const WORD*)k + numFaces * 3);
+		level.indices.clear();
+	}
+	HR(mesh->UnlockIndexBuffer());
+
+	DWORD* attributes = 0;
+	HR(mesh->LockAttributeBuffer(D3DLOCK_READONLY, &attributes));
+	level.attributes.assign(attributes, attributes + numFaces);
+	HR(mesh->UnlockAttributeBuffer());
+	return true;
+}
+
+bool BuildMeshLevels(
+	const void* data,
+	size_t size,
+	int numLods,
+	std::vector<MeshCacheLevel>& levels,
+	std::vector<Material>& materials,
+	std::vector<std::string>& textureNames,
+	std::string* error)
+{
+	XFileMesh mesh;
+	if (!ParseXFile(data, size, &mesh, error))
+		return false;
+
+	DWORD numFaces     = (DWORD)mesh.attributes.size();
+	DWORD numMaterials = (DWORD)mesh.materials.size();
+	if (numFaces == 0)
+	{
+		if (error)
+			*error = "mesh has no faces";
+		return false;
+	}
+
+	// Normals the file lacks are made as LoadXFile makes them, before
+	// the LOD chain's attribute quadrics read them.  AssetLoader's workers
+	// already run jobs side by side, so this runs serially.
+	if (!mesh.hasNormals)
+		ComputeXFileNormals(mesh);
+
+	// Each level indexes the file's vertices, so every level is built
+	// from the same vertex array.
+	const XFileVertex* vertices = &mesh.vertices[0];
+	DWORD numVertices = (DWORD)mesh.vertices.size();
+	if (numLods > 1)
+	{
+		LodSource source;
+		source.vertices    = (const VertexPNT*)vertices;
+		source.numVertices = numVertices;
+		source.indices     = (const DWORD*)&mesh.indices[0];     // unsigned int, 32 bits like DWORD.
+		source.attributes  = (const DWORD*)&mesh.attributes[0];
+		source.numFaces    = numFaces;
+
+		std::vector<LodLevel> chain;
+		BuildLodChain(source, chain, numLods);
+
+		levels.clear();
+		levels.resize(chain.size());
+		for (size_t i = 0; i < chain.size(); ++i)
+		{
+			BuildLevel(vertices, numVertices, &chain[i].indices[0], &chain[i].attributes[0],
+				(DWORD)chain[i].attributes.size(), numMaterials, levels[i]);
+			levels[i].lodError = chain[i].error;
+		}
+	}
+	else
+	{
+		levels.clear();
+		levels.resize(1);
+		BuildLevel(vertices, numVertices, (const DWORD*)&mesh.indices[0], (const DWORD*)&mesh.attributes[0],
+			numFaces, numMaterials, levels[0]);
+		levels[0].lodError = 0.0f;
+	}
+
+	for (DWORD i = 0; i < numMaterials; ++i)
+	{
+		materials.push_back(ToMaterial(mesh.materials[i]));
+		textureNames.push_back(mesh.materials[i].textureFilename);
+	}
+	return true;
+}
+
+std::wstring GetMeshCacheFilename(const std::wstring& filename)
+{
+	return filename + L".mcache";
+}
+
+void LoadXFileCached(
+	const std::wstring& filename,
+	ID3DXMesh** meshOut,
+	std::vector<Material>& materials,
+	std::vector<IDirect3DTexture9*>& textures)
+{
+	// The cache is keyed on the .x file's contents, not its timestamp,
+	// so copying or checking out the assets never serves a stale mesh.
+	MappedFile source;
+	if (!source.open(filename))
+	{
+		// Let LoadXFile report the missing file.
+		LoadXFile(filename, meshOut, materials, textures);
+		return;
+	}
+	unsigned __int64 sourceHash = HashBytes(source.getData(), source.getSize());
+	unsigned __int64 sourceSize = source.getSize();
+	source.close();
+
+	// Materials are only appended once the mesh exists.
+	std::wstring cacheFilename = GetMeshCacheFilename(filename);
+	std::vector<MeshCacheLevel> levels;
+	std::vector<Material> cachedMaterials;
+	std::vector<std::string> textureNames;
+	if (LoadMeshCache(cacheFilename, sourceHash, sourceSize, 1, levels, cachedMaterials, textureNames) &&
+		CreateMeshFromLevel(levels[0], meshOut))
+	{
+		materials.insert(materials.end(), cachedMaterials.begin(), cachedMaterials.end());
+		LoadXFileTextures(filename, textureNames, textures);
+		return;
+	}
+	textureNames.clear();
+
+	size_t firstMaterial = materials.size();
+	LoadXFile(filename, meshOut, materials, textures, &textureNames);
+
+	levels.resize(1);
+	std::vector<Material> newMaterials(materials.begin() + firstMaterial, materials.end());
+	if (ReadMeshLevel(*meshOut, levels[0]))
+		SaveMeshCache(cacheFilename, sourceHash, sourceSize, 1, levels, newMaterials, textureNames);
+}
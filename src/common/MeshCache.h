@@ -0,0 +1,98 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Vertex.h"
+
+//===============================================================
+// Binary cache of LoadXFile results.
+//
+// LoadXFile parses the .x file, converts it to VertexPNT, may compute
+// normals and then optimizes the mesh (OptimizeMesh), every launch, and
+// AssetLoader also builds a chain of levels of detail.  A mesh cache
+// holds what all that produces -- for each level the optimized vertices,
+// indices, per-face attributes and attribute table, then the materials
+// and texture names -- in one file laid out so that loading is a single
+// file mapping and a memcpy into each array.
+//
+// A cache file records the format version and the 64-bit hash and size
+// of the .x file it was built from, plus a hash of its own contents.
+// Loading checks all of them, so a cache left over from an edited .x
+// file, an older build or a torn write is rebuilt instead of used.
+//
+// Saving and loading touch no device, so AssetLoader's workers use the
+// cache too; CreateMeshFromLevel makes the mesh on the render thread.
+
+const DWORD MESH_CACHE_VERSION = 1;
+
+// One mesh, or one level of detail, as LoadXFile would leave it: faces
+// sorted by subset, each subset and then the vertices ordered by
+// OptimizeMesh, and an attribute table.
+struct MeshCacheLevel
+{
+	std::vector<VertexPNT>          vertices;
+	std::vector<DWORD>              indices;
+	std::vector<WORD>               indices16;   // Used instead when !use32Bit.
+	std::vector<DWORD>              attributes;  // Subset of each face.
+	std::vector<D3DXATTRIBUTERANGE> table;
+	float lodError;   // As LodLevel::error; 0 for the finest level.
+	bool  use32Bit;
+};
+
+// Writes levels (finest first, as BuildLodChain made them when asked for
+// numLods), their materials and their texture names to filename, tagged
+// with the hash and size of the source file.
+bool SaveMeshCache(
+	const std::wstring& filename,
+	unsigned __int64 sourceHash,
+	unsigned __int64 sourceSize,
+	int numLods,
+	const std::vector<MeshCacheLevel>& levels,
+	const std::vector<Material>& materials,
+	const std::vector<std::string>& textureNames);
+
+// Reads up to numLods levels from filename if it is a valid cache of the
+// current version built from a source with this hash and size, and was
+// built for at least numLods levels or ended its chain early; returns
+// false, with nothing changed, otherwise.  A chain's first levels do not
+// depend on its length, so any cache serves numLods = 1.  levels is
+// replaced; materials and textureNames are appended to.
+bool LoadMeshCache(
+	const std::wstring& filename,
+	unsigned __int64 sourceHash,
+	unsigned __int64 sourceSize,
+	int numLods,
+	std::vector<MeshCacheLevel>& levels,
+	std::vector<Material>& materials,
+	std::vector<std::string>& textureNames);
+
+// Creates a managed VertexPNT mesh holding level.
+bool CreateMeshFromLevel(const MeshCacheLevel& level, ID3DXMesh** meshOut);
+
+// Reads mesh, as LoadXFile returns it, into level (with lodError 0).
+bool ReadMeshLevel(ID3DXMesh* mesh, MeshCacheLevel& level);
+
+// What a cache holds, built from an .x file's contents: ParseXFile,
+// normals as LoadXFile makes them, up to numLods levels (BuildLodChain),
+// then each level sorted by subset and ordered by OptimizeMesh.  This is
+// the work a cache hit skips.  levels is replaced; materials and
+// textureNames are appended to.  Touches no device.
+bool BuildMeshLevels(
+	const void* data,
+	size_t size,
+	int numLods,
+	std::vector<MeshCacheLevel>& levels,
+	std::vector<Material>& materials,
+	std::vector<std::string>& textureNames,
+	std::string* error = 0);
+
+// The cache file used for an .x file: filename + L".mcache".
+std::wstring GetMeshCacheFilename(const std::wstring& filename);
+
+// Same results as LoadXFile, through the .x file's mesh cache: loads the
+// cache if it matches the file, otherwise calls LoadXFile and writes a
+// new cache (silently skipped if the directory is read-only).
+void LoadXFileCached(
+	const std::wstring& filename,
+	ID3DXMesh** meshOut,
+	std::vector<Material>& materials,
+	std::vector<IDirect3DTexture9*>& textures);
@@ -0,0 +1,432 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	//===============================================================
+	// Overdraw measurement.
+
+	const int OVERDRAW_GRID = 256;
+
+	// Looking down axis (negated when sign < 0) with right and up chosen
+	// so that right x up = the view direction, as in a left-handed view
+	// space.
+	struct OverdrawView
+	{
+		int   axis;
+		float sign;
+		int   right;
+		int   up;
+	};
+
+	const OverdrawView OVERDRAW_VIEWS[6] =
+	{
+		{ 2,  1.0f, 0, 1 },
+		{ 2, -1.0f, 1, 0 },
+		{ 0,  1.0f, 1, 2 },
+		{ 0, -1.0f, 2, 1 },
+		{ 1,  1.0f, 2, 0 },
+		{ 1, -1.0f, 0, 2 },
+	};
+
+	struct ScreenVertex
+	{
+		float x, y, z;
+	};
+
+	float Edge(const ScreenVertex& a, const ScreenVertex& b, float x, float y)
+	{
+		return (b.x - a.x)*(y - a.y) - (b.y - a.y)*(x - a.x);
+	}
+
+	// Depth tests the front-facing triangle abc at every pixel centre it
+	// covers, counting the pixels that pass.
+	DWORD Rasterize(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c, float* depth)
+	{
+		// With y up, front faces wind clockwise: negative area.
+		float area = Edge(a, b, c.x, c.y);
+		if (area >= 0.0f)
+			return 0;
+
+		float minX = std::min(a.x, std::min(b.x, c.x));
+		float maxX = std::max(a.x, std::max(b.x, c.x));
+		float minY = std::min(a.y, std::min(b.y, c.y));
+		float maxY = std::max(a.y, std::max(b.y, c.y));
+
+		int x0 = std::max((int)ceilf(minX - 0.5f), 0);
+		int x1 = std::min((int)floorf(maxX - 0.5f), OVERDRAW_GRID - 1);
+		int y0 = std::max((int)ceilf(minY - 0.5f), 0);
+		int y1 = std::min((int)floorf(maxY - 0.5f), OVERDRAW_GRID - 1);
+
+		float invArea = 1.0f / area;
+		DWORD shaded = 0;
+		for (int y = y0; y <= y1; ++y)
+		{
+			float py = y + 0.5f;
+			for (int x = x0; x <= x1; ++x)
+			{
+				float px = x + 0.5f;
+				float wa = Edge(b, c, px, py) * invArea;
+				float wb = Edge(c, a, px, py) * invArea;
+				float wc = Edge(a, b, px, py) * invArea;
+				if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+					continue;
+
+				float z = wa*a.z + wb*b.z + wc*c.z;
+				float& d = depth[y*OVERDRAW_GRID + x];
+				if (z < d)
+				{
+					d = z;
+					++shaded;
+				}
+			}
+		}
+		return shaded;
+	}
+
+	template <typename Index>
+	OverdrawStats MeasureOD(const Index* indices, DWORD numIndices,
+		const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride)
+	{
+		OverdrawStats stats = {0};
+		DWORD numTris = numIndices / 3;
+		if (numTris == 0 || numVertices == 0)
+			return stats;
+
+		// One scale for every axis, so the views agree on pixel size.
+		D3DXVECTOR3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		D3DXVECTOR3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (DWORD i = 0; i < numTris*3; ++i)
+		{
+			const D3DXVECTOR3& p = StridedVec3(positions, stride, indices[i]);
+			D3DXVec3Minimize(&lo, &lo, &p);
+			D3DXVec3Maximize(&hi, &hi, &p);
+		}
+		float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+		float scale = extent > 0.0f ? OVERDRAW_GRID / extent : 0.0f;
+
+		std::vector<float> depth(OVERDRAW_GRID*OVERDRAW_GRID);
+		for (int v = 0; v < 6; ++v)
+		{
+			const OverdrawView& view = OVERDRAW_VIEWS[v];
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for (DWORD t = 0; t < numTris; ++t)
+			{
+				ScreenVertex s[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					const float* p = StridedVec3(positions, stride, indices[3*t + c]);
+					s[c].x = (p[view.right] - lo[view.right]) * scale;
+					s[c].y = (p[view.up] - lo[view.up]) * scale;
+					s[c].z = p[view.axis] * view.sign;
+				}
+				stats.pixelsShaded += Rasterize(s[0], s[1], s[2], &depth[0]);
+			}
+
+			for (size_t i = 0; i < depth.size(); ++i)
+			{
+				if (depth[i] != FLT_MAX)
+					++stats.pixelsCovered;
+			}
+		}
+
+		stats.overdraw = stats.pixelsCovered != 0 ? (float)stats.pixelsShaded / stats.pixelsCovered : 0.0f;
+		return stats;
+	}
+
+	//===============================================================
+	// Overdraw reordering.
+
+	// The FIFO cache MeasureVertexCache simulates.  A vertex loaded at
+	// miss number m is in the cache until miss m + cacheSize.
+	class FifoCache
+	{
+	public:
+		FifoCache(DWORD numVertices, int cacheSize)
+			: mLoadedAt(numVertices, 0), mMisses(cacheSize), mCacheSize(cacheSize)
+		{
+		}
+
+		// Returns how many of the triangle's vertices missed.
+		template <typename Index>
+		DWORD draw(const Index* tri)
+		{
+			DWORD before = mMisses;
+			for (int c = 0; c < 3; ++c)
+			{
+				DWORD& loaded = mLoadedAt[tri[c]];
+				if (mMisses - loaded >= mCacheSize)
+					loaded = mMisses++;
+			}
+			return mMisses - before;
+		}
+
+		// Empties the cache.
+		void flush()
+		{
+			mMisses += mCacheSize;
+		}
+
+	private:
+		std::vector<DWORD> mLoadedAt;
+		DWORD mMisses;
+		DWORD mCacheSize;
+	};
+
+	template <typename Index>
+	void Overdraw(Index* indices, DWORD numIndices, const D3DXVECTOR3* positions,
+		DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+	{
+		DWORD numTris = numIndices / 3;
+		if (numTris < 2)
+			return;
+		if (cacheSize < 3)
+			cacheSize = 3;
+
+		// Patches: a triangle none of whose vertices are in the cache
+		// starts a new one.
+		std::vector<DWORD> patches;
+		FifoCache cache(numVertices, cacheSize);
+		for (DWORD t = 0; t < numTris; ++t)
+		{
+			if (cache.draw(indices + 3*t) == 3 || t == 0)
+				patches.push_back(t);
+		}
+		patches.push_back(numTris);
+
+		// Clusters: each patch is cut as soon as the triangles since the
+		// last cut, drawn from an empty cache, are within threshold of the
+		// whole patch's ACMR.  A tail that never gets there joins the
+		// cluster before it.
+		std::vector<DWORD> clusters;
+		for (size_t p = 0; p + 1 < patches.size(); ++p)
+		{
+			DWORD start = patches[p];
+			DWORD end   = patches[p + 1];
+
+			DWORD patchMisses = 0;
+			cache.flush();
+			for (DWORD t = start; t < end; ++t)
+				patchMisses += cache.draw(indices + 3*t);
+			float target = threshold * patchMisses / (end - start);
+
+			clusters.push_back(start);
+			cache.flush();
+			DWORD misses = 0, count = 0;
+			for (DWORD t = start; t < end; ++t)
+			{
+				misses += cache.draw(indices + 3*t);
+				++count;
+				if (misses <= target * count && t + 1 < end)
+				{
+					clusters.push_back(t + 1);
+					cache.flush();
+					misses = 0;
+					count  = 0;
+				}
+			}
+
+			if (count != 0 && clusters.back() != start && misses > target * count)
+				clusters.pop_back();
+		}
+		clusters.push_back(numTris);
+
+		DWORD numClusters = (DWORD)clusters.size() - 1;
+		if (numClusters < 2)
+			return;
+
+		// Sort key: how far a cluster faces out from the centre.  Normals
+		// follow D3D's clockwise winding, as D3DXComputeNormals does.
+		D3DXVECTOR3 centre(0.0f, 0.0f, 0.0f);
+		for (DWORD i = 0; i < numTris*3; ++i)
+			centre += StridedVec3(positions, stride, indices[i]);
+		centre /= (float)(numTris*3);
+
+		std::vector<float> key(numClusters);
+		for (DWORD c = 0; c < numClusters; ++c)
+		{
+			D3DXVECTOR3 clusterCentre(0.0f, 0.0f, 0.0f);
+			D3DXVECTOR3 normal(0.0f, 0.0f, 0.0f);
+			float area = 0.0f;
+			for (DWORD t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const D3DXVECTOR3& a = StridedVec3(positions, stride, indices[3*t]);
+				const D3DXVECTOR3& b = StridedVec3(positions, stride, indices[3*t + 1]);
+				const D3DXVECTOR3& d = StridedVec3(positions, stride, indices[3*t + 2]);
+
+				D3DXVECTOR3 u = b - a, v = d - a, n;
+				D3DXVec3Cross(&n, &u, &v);
+				float triArea = D3DXVec3Length(&n);
+
+				clusterCentre += (a + b + d) * (triArea / 3.0f);
+				normal += n;
+				area += triArea;
+			}
+
+			float length = D3DXVec3Length(&normal);
+			if (area > 0.0f && length > 0.0f)
+			{
+				clusterCentre /= area;
+				D3DXVECTOR3 out = clusterCentre - centre;
+				key[c] = D3DXVec3Dot(&out, &normal) / length;
+			}
+			else
+				key[c] = 0.0f;
+		}
+
+		std::vector<DWORD> order(numClusters);
+		for (DWORD c = 0; c < numClusters; ++c)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](DWORD a, DWORD b) { return key[a] > key[b]; });
+
+		std::vector<Index> out;
+		out.reserve(numTris*3);
+		for (DWORD i = 0; i < numClusters; ++i)
+		{
+			DWORD c = order[i];
+			out.insert(out.end(), indices + 3*clusters[c], indices + 3*clusters[c + 1]);
+		}
+		memcpy(indices, &out[0], numTris*3*sizeof(Index));
+	}
+
+	//===============================================================
+	// Vertex fetch reordering.
+
+	template <typename Index>
+	DWORD Fetch(Index* indices, DWORD numIndices, void* vertices, DWORD numVertices, DWORD stride)
+	{
+		const DWORD UNUSED = 0xffffffff;
+		std::vector<DWORD> remap(numVertices, UNUSED);
+
+		DWORD next = 0;
+		for (DWORD i = 0; i < numIndices; ++i)
+		{
+			DWORD& r = remap[indices[i]];
+			if (r == UNUSED)
+				r = next++;
+			indices[i] = (Index)r;
+		}
+
+		DWORD numUsed = next;
+		for (DWORD v = 0; v < numVertices; ++v)
+		{
+			if (remap[v] == UNUSED)
+				remap[v] = next++;
+		}
+
+		std::vector<BYTE> copy((size_t)numVertices * stride);
+		const BYTE* src = (const BYTE*)vertices;
+		for (DWORD v = 0; v < numVertices; ++v)
+			memcpy(&copy[(size_t)remap[v] * stride], src + (size_t)v * stride, stride);
+		if (!copy.empty())
+			memcpy(vertices, &copy[0], copy.size());
+
+		return numUsed;
+	}
+
+	template <typename Index>
+	DWORD Optimize(Index* indices, D3DXATTRIBUTERANGE* table, DWORD numRanges,
+		void* vertices, DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+	{
+		const D3DXVECTOR3* positions = (const D3DXVECTOR3*)vertices;
+
+		DWORD numFaces = 0;
+		for (DWORD r = 0; r < numRanges; ++r)
+		{
+			Index* subset = indices + table[r].FaceStart*3;
+			DWORD count = table[r].FaceCount*3;
+			OptimizeVertexCacheForsyth(subset, count, numVertices, cacheSize);
+			Overdraw(subset, count, positions, numVertices, stride, cacheSize, threshold);
+
+			numFaces = std::max(numFaces, table[r].FaceStart + table[r].FaceCount);
+		}
+
+		DWORD numUsed = Fetch(indices, numFaces*3, vertices, numVertices, stride);
+
+		for (DWORD r = 0; r < numRanges; ++r)
+		{
+			DWORD lo = 0xffffffff, hi = 0;
+			for (DWORD i = table[r].FaceStart*3; i < (table[r].FaceStart + table[r].FaceCount)*3; ++i)
+			{
+				lo = std::min(lo, (DWORD)indices[i]);
+				hi = std::max(hi, (DWORD)indices[i]);
+			}
+			table[r].VertexStart = table[r].FaceCount != 0 ? lo : 0;
+			table[r].VertexCount = table[r].FaceCount != 0 ? hi - lo + 1 : 0;
+		}
+		return numUsed;
+	}
+}
+
+OverdrawStats MeasureOverdraw(const DWORD* indices, DWORD numIndices,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride)
+{
+	return MeasureOD(indices, numIndices, positions, numVertices, stride);
+}
+
+OverdrawStats MeasureOverdraw(const WORD* indices, DWORD numIndices,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride)
+{
+	return MeasureOD(indices, numIndices, positions, numVertices, stride);
+}
+
+void OptimizeOverdraw(DWORD* indices, DWORD numIndices, const D3DXVECTOR3* positions,
+	DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+{
+	Overdraw(indices, numIndices, positions, numVertices, stride, cacheSize, threshold);
+}
+
+void OptimizeOverdraw(WORD* indices, DWORD numIndices, const D3DXVECTOR3* positions,
+	DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+{
+	Overdraw(indices, numIndices, positions, numVertices, stride, cacheSize, threshold);
+}
+
+DWORD OptimizeVertexFetch(DWORD* indices, DWORD numIndices, void* vertices, DWORD numVertices, DWORD stride)
+{
+	return Fetch(indices, numIndices, vertices, numVertices, stride);
+}
+
+DWORD OptimizeVertexFetch(WORD* indices, DWORD numIndices, void* vertices, DWORD numVertices, DWORD stride)
+{
+	return Fetch(indices, numIndices, vertices, numVertices, stride);
+}
+
+DWORD OptimizeMesh(DWORD* indices, D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	void* vertices, DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+{
+	return Optimize(indices, table, numRanges, vertices, numVertices, stride, cacheSize, threshold);
+}
+
+DWORD OptimizeMesh(WORD* indices, D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	void* vertices, DWORD numVertices, DWORD stride, int cacheSize, float threshold)
+{
+	return Optimize(indices, table, numRanges, vertices, numVertices, stride, cacheSize, threshold);
+}
+
+void OptimizeMesh(ID3DXMesh* mesh, int cacheSize, float threshold)
+{
+	DWORD numRanges = 0;
+	HR(mesh->GetAttributeTable(0, &numRanges));
+	if (numRanges == 0)
+		return;
+
+	std::vector<D3DXATTRIBUTERANGE> table(numRanges);
+	HR(mesh->GetAttributeTable(&table[0], &numRanges));
+
+	void* v = 0;
+	void* k = 0;
+	HR(mesh->LockVertexBuffer(0, &v));
+	HR(mesh->LockIndexBuffer(0, &k));
+	if (mesh->GetOptions() & D3DXMESH_32BIT)
+		Optimize((DWORD*)k, &table[0], numRanges, v, mesh->GetNumVertices(), mesh->GetNumBytesPerVertex(), cacheSize, threshold);
+	else
+		Optimize((WORD*)k, &table[0], numRanges, v, mesh->GetNumVertices(), mesh->GetNumBytesPerVertex(), cacheSize, threshold);
+	HR(mesh->UnlockIndexBuffer());
+	HR(mesh->UnlockVertexBuffer());
+
+	HR(mesh->SetAttributeTable(&table[0], numRanges));
+}
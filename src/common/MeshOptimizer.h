@@ -0,0 +1,72 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "VertexCache.h"
+
+//===============================================================
+// Triangle and vertex order for drawing, without D3DX.
+//
+// OptimizeMesh replaces ID3DXMesh::Optimize's D3DXMESHOPT_VERTEXCACHE
+// with three passes that each keep what the one before won:
+//
+//   1. Vertex cache: Forsyth's reorder (VertexCache.h) for a cache of
+//      cacheSize entries.
+//   2. Overdraw: Sander, Nehab and Barczak, "Fast Triangle Reordering
+//      for Vertex Locality and Reduced Overdraw", 2007.  The cache
+//      order is cut into clusters wherever a cluster has got within
+//      threshold times the ACMR of the patch it comes from, and the
+//      clusters facing away from the mesh's centre are drawn first, so
+//      they hide more of what comes later.  A larger threshold makes
+//      smaller clusters, which sort better but miss the cache more.
+//   3. Vertex fetch: vertices are laid out in the order the triangles
+//      first use them, so fetches walk the vertex buffer forwards.
+//
+// Every pass works one subset at a time and never moves a face from one
+// attribute range to another, so a mesh sorted by attribute stays so.
+
+// Overdraw as an early-Z GPU would see it: the triangles, culled like
+// D3D's default clockwise front faces, are rasterized in index order
+// with a depth test into a 256x256 buffer looking down each of the six
+// axis directions.  overdraw is pixels shaded over pixels covered; 1 is
+// the best possible.
+struct OverdrawStats
+{
+	DWORD pixelsCovered;
+	DWORD pixelsShaded;
+	float overdraw;
+};
+
+// positions is the first vertex's position and stride the bytes from
+// one vertex to the next, as for D3DXComputeBoundingBox.
+OverdrawStats MeasureOverdraw(const DWORD* indices, DWORD numIndices,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride);
+OverdrawStats MeasureOverdraw(const WORD* indices, DWORD numIndices,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride);
+
+// Pass 2 on its own: reorders the triangles of a triangle list that is
+// already in vertex cache order.
+void OptimizeOverdraw(DWORD* indices, DWORD numIndices, const D3DXVECTOR3* positions,
+	DWORD numVertices, DWORD stride, int cacheSize = 16, float threshold = 1.05f);
+void OptimizeOverdraw(WORD* indices, DWORD numIndices, const D3DXVECTOR3* positions,
+	DWORD numVertices, DWORD stride, int cacheSize = 16, float threshold = 1.05f);
+
+// Pass 3 on its own: moves the vertices (stride bytes each) into
+// first-use order and rewrites the indices to match.  Vertices no index
+// refers to keep their order after the rest; returns how many are
+// referenced.
+DWORD OptimizeVertexFetch(DWORD* indices, DWORD numIndices, void* vertices, DWORD numVertices, DWORD stride);
+DWORD OptimizeVertexFetch(WORD* indices, DWORD numIndices, void* vertices, DWORD numVertices, DWORD stride);
+
+// All three passes over a triangle list whose faces are sorted by
+// subset as table says.  Each range keeps its faces; VertexStart and
+// VertexCount are recomputed for the new vertex order.  Vertices start
+// with their position.  Returns OptimizeVertexFetch's count.
+DWORD OptimizeMesh(DWORD* indices, D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	void* vertices, DWORD numVertices, DWORD stride, int cacheSize = 16, float threshold = 1.05f);
+DWORD OptimizeMesh(WORD* indices, D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	void* vertices, DWORD numVertices, DWORD stride, int cacheSize = 16, float threshold = 1.05f);
+
+// The same, in place, for a mesh with an attribute table
+// (D3DXMESHOPT_ATTRSORT).  Unreferenced vertices are kept, at the end of
+// the vertex buffer, so compact the mesh first to be rid of them.
+void OptimizeMesh(ID3DXMesh* mesh, int cacheSize = 16, float threshold = 1.05f);
@@ -0,0 +1,684 @@
+#include "MeshSimplify.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	// Attribute errors count like position errors in the mesh scaled to
+	// a unit cube: a normal turned about 30 degrees costs about what
+	// moving the surface 1% of the mesh's size does, and so do texture
+	// coordinates 5% of the texture off.
+	const float NORMAL_WEIGHT   = 0.02f;
+	const float TEXCOORD_WEIGHT = 0.2f;
+
+	// Planes through open edges, square to their faces, hold mesh and
+	// subset edges in place.  Seams have faces on both sides to hold
+	// them as well, so they get less.
+	const float BORDER_WEIGHT = 10.0f;
+	const float SEAM_WEIGHT   = 1.0f;
+
+	const DWORD NONE = 0xffffffff;
+
+	// What a vertex (all the vertices at its position) may collapse onto.
+	enum VertexKind
+	{
+		KIND_MANIFOLD,  // Inside one subset, one vertex: any neighbour.
+		KIND_BORDER,    // On one open edge loop, one vertex: the next or previous vertex on it.
+		KIND_SEAM,      // Two vertices, each on one open edge loop: the same, both at once.
+		KIND_LOCKED     // Anything else: stays.
+	};
+
+	struct Quadric
+	{
+		float a00, a11, a22, a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float w;  // Total weight, to turn the error into a mean squared distance.
+	};
+
+	void AddPlane(Quadric& q, const D3DXVECTOR3& n, float d, float w)
+	{
+		q.a00 += w*n.x*n.x;
+		q.a11 += w*n.y*n.y;
+		q.a22 += w*n.z*n.z;
+		q.a10 += w*n.y*n.x;
+		q.a20 += w*n.z*n.x;
+		q.a21 += w*n.z*n.y;
+		q.b0  += w*n.x*d;
+		q.b1  += w*n.y*d;
+		q.b2  += w*n.z*d;
+		q.c   += w*d*d;
+		q.w   += w;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& r)
+	{
+		q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+		q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+		q.b0  += r.b0;  q.b1  += r.b1;  q.b2  += r.b2;
+		q.c   += r.c;
+		q.w   += r.w;
+	}
+
+	// Weighted sum of squared distances from p to the quadric's planes.
+	float QuadricError(const Quadric& q, const D3DXVECTOR3& p)
+	{
+		float e = q.a00*p.x*p.x + q.a11*p.y*p.y + q.a22*p.z*p.z +
+			2.0f*(q.a10*p.x*p.y + q.a20*p.x*p.z + q.a21*p.y*p.z) +
+			2.0f*(q.b0*p.x + q.b1*p.y + q.b2*p.z) + q.c;
+		return e > 0.0f ? e : 0.0f;
+	}
+
+	// Normal and texture coordinates, weighted.  The quadric sums the
+	// squared distance from an attribute vector to every one merged in.
+	const int NUM_ATTRIBUTES = 5;
+
+	struct AttributeQuadric
+	{
+		float w;
+		float b[NUM_ATTRIBUTES];
+		float c;
+	};
+
+	void AddAttributes(AttributeQuadric& q, const float* a, float w)
+	{
+		q.w += w;
+		for (int i = 0; i < NUM_ATTRIBUTES; ++i)
+		{
+			q.b[i] += w*a[i];
+			q.c    += w*a[i]*a[i];
+		}
+	}
+
+	void AddAttributeQuadric(AttributeQuadric& q, const AttributeQuadric& r)
+	{
+		q.w += r.w;
+		for (int i = 0; i < NUM_ATTRIBUTES; ++i)
+			q.b[i] += r.b[i];
+		q.c += r.c;
+	}
+
+	float AttributeError(const AttributeQuadric& q, const float* a)
+	{
+		float e = q.c;
+		for (int i = 0; i < NUM_ATTRIBUTES; ++i)
+			e += a[i]*(q.w*a[i] - 2.0f*q.b[i]);
+		return e > 0.0f ? e : 0.0f;
+	}
+
+	// v's link along an open edge loop (links[v]) after a pass of
+	// collapses.  If the linked vertex collapsed onto v, v links to the
+	// vertex beyond it instead; NONE once the loop has no other vertex.
+	DWORD Relink(const std::vector<DWORD>& links, const std::vector<DWORD>& collapseRemap, DWORD v)
+	{
+		DWORD next = links[v];
+		if (next != NONE && collapseRemap[next] == v)
+			next = links[next];
+		if (next == NONE)
+			return NONE;
+
+		next = collapseRemap[next];
+		return next != v ? next : NONE;
+	}
+
+	struct HalfEdge
+	{
+		DWORD from;
+		DWORD to;
+		DWORD attribute;
+
+		bool operator<(const HalfEdge& rhs)const
+		{
+			if (from != rhs.from) return from < rhs.from;
+			if (to != rhs.to)     return to < rhs.to;
+			return attribute < rhs.attribute;
+		}
+	};
+
+	struct Collapse
+	{
+		DWORD v0;  // Moves onto v1.
+		DWORD v1;
+		float error;
+	};
+
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const LodSource& source);
+
+		// Collapses edges until at most targetFaces faces are left, or
+		// returns false once nothing more can collapse.
+		bool simplify(DWORD targetFaces);
+
+		DWORD getNumFaces()const { return (DWORD)mAttributes.size(); }
+		void getLevel(LodLevel& level)const;
+
+	private:
+		void classify();
+		void buildQuadrics();
+
+		bool canCollapse(DWORD v0, DWORD v1)const;
+		float collapseError(DWORD v0, DWORD v1)const;
+		bool flipsFaces(DWORD v0, DWORD v1)const;
+
+	private:
+		std::vector<DWORD> mIndices;     // Current faces, into welded vertices.
+		std::vector<DWORD> mAttributes;
+
+		std::vector<D3DXVECTOR3> mPositions;  // Scaled to a unit cube.
+		std::vector<float>       mAttrs;      // NUM_ATTRIBUTES per vertex.
+		float mScale;
+
+		std::vector<DWORD> mRemap;     // First vertex at the same position.
+		std::vector<DWORD> mWedge;     // Next vertex at the same position, round a ring.
+		std::vector<BYTE>  mKind;
+		std::vector<DWORD> mLoop;      // Open edges out of and into border and seam vertices.
+		std::vector<DWORD> mLoopBack;
+
+		std::vector<Quadric>          mQuadrics;  // Per position (mRemap).
+		std::vector<AttributeQuadric> mAttrQuadrics;
+		float mError;  // Largest mean squared distance a collapse has made.
+
+		// Faces round each position, rebuilt every pass for flipsFaces.
+		std::vector<DWORD> mFaceStart;
+		std::vector<DWORD> mFaces;
+	};
+
+	Simplifier::Simplifier(const LodSource& source)
+		: mScale(1.0f), mError(0.0f)
+	{
+		DWORD numVertices = source.numVertices;
+		const VertexPNT* vertices = source.vertices;
+
+		// Weld vertices that are identical in every attribute, which
+		// unindexed files (Dwarf.x) are full of.
+		std::vector<DWORD> order(numVertices);
+		for (DWORD v = 0; v < numVertices; ++v)
+			order[v] = v;
+		std::stable_sort(order.begin(), order.end(), [&](DWORD a, DWORD b) {
+			return memcmp(&vertices[a], &vertices[b], sizeof(VertexPNT)) < 0;
+		});
+
+		std::vector<DWORD> weld(numVertices);
+		for (DWORD i = 0; i < numVertices; ++i)
+		{
+			bool same = i > 0 && memcmp(&vertices[order[i]], &vertices[order[i-1]], sizeof(VertexPNT)) == 0;
+			weld[order[i]] = same ? weld[order[i-1]] : order[i];
+		}
+
+		mIndices.resize(source.numFaces*3);
+		std::vector<bool> used(numVertices, false);
+		for (DWORD i = 0; i < source.numFaces*3; ++i)
+		{
+			mIndices[i] = weld[source.indices[i]];
+			used[mIndices[i]] = true;
+		}
+		mAttributes.assign(source.attributes, source.attributes + source.numFaces);
+
+		// Rings of the used vertices at each position.
+		order.clear();
+		for (DWORD v = 0; v < numVertices; ++v)
+		{
+			if (used[v])
+				order.push_back(v);
+		}
+		std::stable_sort(order.begin(), order.end(), [&](DWORD a, DWORD b) {
+			return memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(D3DXVECTOR3)) < 0;
+		});
+
+		mRemap.resize(numVertices);
+		mWedge.resize(numVertices);
+		for (DWORD v = 0; v < numVertices; ++v)
+			mRemap[v] = mWedge[v] = v;
+
+		for (size_t i = 0; i < order.size(); )
+		{
+			size_t end = i + 1;
+			while (end < order.size() && memcmp(&vertices[order[end]].pos, &vertices[order[i]].pos, sizeof(D3DXVECTOR3)) == 0)
+				++end;
+			for (size_t j = i; j < end; ++j)
+			{
+				mRemap[order[j]] = order[i];
+				mWedge[order[j]] = order[j + 1 < end ? j + 1 : i];
+			}
+			i = end;
+		}
+
+		// Work in a unit cube so the weights above mean the same for every mesh.
+		D3DXVECTOR3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			D3DXVec3Minimize(&lo, &lo, &vertices[order[i]].pos);
+			D3DXVec3Maximize(&hi, &hi, &vertices[order[i]].pos);
+		}
+		float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+		mScale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+		mPositions.resize(numVertices);
+		mAttrs.resize(numVertices*NUM_ATTRIBUTES);
+		for (DWORD v = 0; v < numVertices; ++v)
+		{
+			mPositions[v] = (vertices[v].pos - lo) * mScale;
+
+			float* a = &mAttrs[v*NUM_ATTRIBUTES];
+			a[0] = vertices[v].normal.x * NORMAL_WEIGHT;
+			a[1] = vertices[v].normal.y * NORMAL_WEIGHT;
+			a[2] = vertices[v].normal.z * NORMAL_WEIGHT;
+			a[3] = vertices[v].tex0.x * TEXCOORD_WEIGHT;
+			a[4] = vertices[v].tex0.y * TEXCOORD_WEIGHT;
+		}
+
+		// Faces with two corners at one position cover nothing.
+		DWORD numFaces = 0;
+		for (DWORD f = 0; f < source.numFaces; ++f)
+		{
+			DWORD r0 = mRemap[mIndices[3*f]], r1 = mRemap[mIndices[3*f+1]], r2 = mRemap[mIndices[3*f+2]];
+			if (r0 == r1 || r1 == r2 || r2 == r0)
+				continue;
+			for (int c = 0; c < 3; ++c)
+				mIndices[3*numFaces + c] = mIndices[3*f + c];
+			mAttributes[numFaces++] = mAttributes[f];
+		}
+		mIndices.resize(numFaces*3);
+		mAttributes.resize(numFaces);
+
+		classify();
+		buildQuadrics();
+	}
+
+	void Simplifier::classify()
+	{
+		DWORD numVertices = (DWORD)mRemap.size();
+		DWORD numFaces = getNumFaces();
+
+		// An edge is open unless a face of the same subset runs along it
+		// the other way through the same two vertices, so seams and the
+		// edges between subsets are open as well as the mesh's own.
+		std::vector<HalfEdge> edges(numFaces*3);
+		for (DWORD f = 0; f < numFaces; ++f)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				HalfEdge& e = edges[3*f + c];
+				e.from      = mIndices[3*f + c];
+				e.to        = mIndices[3*f + (c + 1) % 3];
+				e.attribute = mAttributes[f];
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		std::vector<DWORD> openOut(numVertices, 0), openIn(numVertices, 0);
+		mLoop.assign(numVertices, NONE);
+		mLoopBack.assign(numVertices, NONE);
+		for (size_t i = 0; i < edges.size(); ++i)
+		{
+			HalfEdge opposite = { edges[i].to, edges[i].from, edges[i].attribute };
+			if (std::binary_search(edges.begin(), edges.end(), opposite))
+				continue;
+
+			++openOut[edges[i].from];
+			++openIn[edges[i].to];
+			mLoop[edges[i].from]   = edges[i].to;
+			mLoopBack[edges[i].to] = edges[i].from;
+		}
+
+		mKind.assign(numVertices, KIND_LOCKED);
+		for (DWORD v = 0; v < numVertices; ++v)
+		{
+			if (mRemap[v] != v)
+				continue;
+
+			DWORD w = mWedge[v];
+			BYTE kind = KIND_LOCKED;
+			if (w == v)
+			{
+				if (openOut[v] == 0 && openIn[v] == 0)
+					kind = KIND_MANIFOLD;
+				else if (openOut[v] == 1 && openIn[v] == 1)
+					kind = KIND_BORDER;
+			}
+			else if (mWedge[w] == v)
+			{
+				// Two vertices, whose open edges run back to back.
+				if (openOut[v] == 1 && openIn[v] == 1 && openOut[w] == 1 && openIn[w] == 1 &&
+					mRemap[mLoop[v]] == mRemap[mLoopBack[w]] && mRemap[mLoopBack[v]] == mRemap[mLoop[w]])
+					kind = KIND_SEAM;
+			}
+
+			DWORD u = v;
+			do
+			{
+				mKind[u] = kind;
+				u = mWedge[u];
+			} while (u != v);
+		}
+	}
+
+	void Simplifier::buildQuadrics()
+	{
+		DWORD numVertices = (DWORD)mRemap.size();
+		DWORD numFaces = getNumFaces();
+
+		Quadric zero;
+		ZeroMemory(&zero, sizeof(zero));
+		mQuadrics.assign(numVertices, zero);
+
+		AttributeQuadric attrZero;
+		ZeroMemory(&attrZero, sizeof(attrZero));
+		mAttrQuadrics.assign(numVertices, attrZero);
+
+		for (DWORD f = 0; f < numFaces; ++f)
+		{
+			const DWORD* tri = &mIndices[3*f];
+			const D3DXVECTOR3& p0 = mPositions[tri[0]];
+			const D3DXVECTOR3& p1 = mPositions[tri[1]];
+			const D3DXVECTOR3& p2 = mPositions[tri[2]];
+
+			D3DXVECTOR3 u = p1 - p0, v = p2 - p0, n;
+			D3DXVec3Cross(&n, &u, &v);
+			float length = D3DXVec3Length(&n);
+			if (length == 0.0f)
+				continue;
+			n /= length;
+			float area = 0.5f * length;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				AddPlane(mQuadrics[mRemap[tri[c]]], n, -D3DXVec3Dot(&n, &p0), area);
+				AddAttributes(mAttrQuadrics[tri[c]], &mAttrs[tri[c]*NUM_ATTRIBUTES], area / 3.0f);
+			}
+
+			// Open edges, found again through the loops classify() built.
+			for (int c = 0; c < 3; ++c)
+			{
+				DWORD a = tri[c], b = tri[(c + 1) % 3];
+				if (mLoop[a] != b)
+					continue;
+
+				D3DXVECTOR3 edge = mPositions[b] - mPositions[a], pn;
+				D3DXVec3Cross(&pn, &edge, &n);
+				float pl = D3DXVec3Length(&pn);
+				if (pl == 0.0f)
+					continue;
+				pn /= pl;
+
+				float weight = (mKind[a] == KIND_SEAM && mKind[b] == KIND_SEAM ? SEAM_WEIGHT : BORDER_WEIGHT) *
+					D3DXVec3Dot(&edge, &edge);
+				float d = -D3DXVec3Dot(&pn, &mPositions[a]);
+				AddPlane(mQuadrics[mRemap[a]], pn, d, weight);
+				AddPlane(mQuadrics[mRemap[b]], pn, d, weight);
+			}
+		}
+	}
+
+	bool Simplifier::canCollapse(DWORD v0, DWORD v1)const
+	{
+		switch (mKind[v0])
+		{
+		case KIND_MANIFOLD:
+			return true;
+		case KIND_BORDER:
+			return mKind[v1] == KIND_BORDER && (mLoop[v0] == v1 || mLoopBack[v0] == v1);
+		case KIND_SEAM:
+			{
+				if (mKind[v1] != KIND_SEAM || (mLoop[v0] != v1 && mLoopBack[v0] != v1))
+					return false;
+				DWORD s0 = mWedge[v0], s1 = mWedge[v1];
+				return mLoop[s0] == s1 || mLoopBack[s0] == s1;
+			}
+		default:
+			return false;
+		}
+	}
+
+	float Simplifier::collapseError(DWORD v0, DWORD v1)const
+	{
+		float e = QuadricError(mQuadrics[mRemap[v0]], mPositions[v1]) +
+			AttributeError(mAttrQuadrics[v0], &mAttrs[v1*NUM_ATTRIBUTES]);
+		if (mKind[v0] == KIND_SEAM)
+			e += AttributeError(mAttrQuadrics[mWedge[v0]], &mAttrs[mWedge[v1]*NUM_ATTRIBUTES]);
+		return e;
+	}
+
+	bool Simplifier::flipsFaces(DWORD v0, DWORD v1)const
+	{
+		DWORD r0 = mRemap[v0], r1 = mRemap[v1];
+		const D3DXVECTOR3& target = mPositions[v1];
+
+		for (DWORD i = mFaceStart[r0]; i < mFaceStart[r0 + 1]; ++i)
+		{
+			const DWORD* tri = &mIndices[3*mFaces[i]];
+			DWORD q0 = mRemap[tri[0]], q1 = mRemap[tri[1]], q2 = mRemap[tri[2]];
+			if (q0 == r1 || q1 == r1 || q2 == r1)
+				continue;  // Collapses away.
+
+			D3DXVECTOR3 p[3], moved[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				p[c] = mPositions[tri[c]];
+				moved[c] = mRemap[tri[c]] == r0 ? target : p[c];
+			}
+
+			D3DXVECTOR3 u = p[1] - p[0], v = p[2] - p[0], before, after;
+			D3DXVec3Cross(&before, &u, &v);
+			u = moved[1] - moved[0];
+			v = moved[2] - moved[0];
+			D3DXVec3Cross(&after, &u, &v);
+			if (D3DXVec3Dot(&before, &after) <= 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	bool Simplifier::simplify(DWORD targetFaces)
+	{
+		DWORD numVertices = (DWORD)mRemap.size();
+		std::vector<Collapse> collapses;
+		std::vector<DWORD> collapseRemap(numVertices);
+		std::vector<bool> touched(numVertices);
+		std::vector<DWORD> loop, loopBack;
+
+		while (getNumFaces() > targetFaces)
+		{
+			DWORD numFaces = getNumFaces();
+
+			mFaceStart.assign(numVertices + 1, 0);
+			for (DWORD i = 0; i < numFaces*3; ++i)
+				++mFaceStart[mRemap[mIndices[i]] + 1];
+			for (DWORD v = 0; v < numVertices; ++v)
+				mFaceStart[v + 1] += mFaceStart[v];
+			mFaces.resize(numFaces*3);
+			std::vector<DWORD> fill(mFaceStart.begin(), mFaceStart.end() - 1);
+			for (DWORD i = 0; i < numFaces*3; ++i)
+				mFaces[fill[mRemap[mIndices[i]]]++] = i / 3;
+
+			// The cheaper allowed direction of every edge.  Edges inside the
+			// mesh come up once from each side, which does no harm.
+			collapses.clear();
+			for (DWORD i = 0; i < numFaces*3; ++i)
+			{
+				DWORD a = mIndices[i];
+				DWORD b = mIndices[i % 3 == 2 ? i - 2 : i + 1];
+
+				Collapse c = { NONE, NONE, FLT_MAX };
+				if (canCollapse(a, b))
+				{
+					c.v0 = a;
+					c.v1 = b;
+					c.error = collapseError(a, b);
+				}
+				if (canCollapse(b, a))
+				{
+					float e = collapseError(b, a);
+					if (e < c.error)
+					{
+						c.v0 = b;
+						c.v1 = a;
+						c.error = e;
+					}
+				}
+				if (c.v0 != NONE)
+					collapses.push_back(c);
+			}
+
+			// Most collapses lose out to a cheaper one next to them, so take
+			// somewhat more than the cheapest half of what is needed.  Only
+			// the candidates under that limit need sorting.
+			auto cheaper = [](const Collapse& a, const Collapse& b) { return a.error < b.error; };
+			DWORD faceGoal = numFaces - targetFaces;
+			size_t edgeGoal = faceGoal / 2;
+			float errorLimit = FLT_MAX;
+			if (edgeGoal < collapses.size())
+			{
+				std::nth_element(collapses.begin(), collapses.begin() + edgeGoal, collapses.end(), cheaper);
+				errorLimit = 1.5f * collapses[edgeGoal].error;
+			}
+			size_t numSorted = std::partition(collapses.begin(), collapses.end(),
+				[errorLimit](const Collapse& c) { return c.error <= errorLimit; }) - collapses.begin();
+			std::sort(collapses.begin(), collapses.begin() + numSorted, cheaper);
+
+			for (DWORD v = 0; v < numVertices; ++v)
+				collapseRemap[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			DWORD removed = 0;
+			for (size_t i = 0; i < collapses.size() && removed < faceGoal; ++i)
+			{
+				// The limit only ends a pass that has done something, so a
+				// run of cheap collapses that would all flip faces cannot
+				// stall it; the rest are sorted in that case.
+				if (i == numSorted)
+				{
+					if (removed > 0)
+						break;
+					std::sort(collapses.begin() + numSorted, collapses.end(), cheaper);
+				}
+
+				const Collapse& c = collapses[i];
+				DWORD r0 = mRemap[c.v0], r1 = mRemap[c.v1];
+				if (touched[r0] || touched[r1] || flipsFaces(c.v0, c.v1))
+					continue;
+
+				float error = QuadricError(mQuadrics[r0], mPositions[c.v1]);
+				if (mQuadrics[r0].w > 0.0f)
+					mError = std::max(mError, error / mQuadrics[r0].w);
+
+				collapseRemap[c.v0] = c.v1;
+				AddQuadric(mQuadrics[r1], mQuadrics[r0]);
+				AddAttributeQuadric(mAttrQuadrics[c.v1], mAttrQuadrics[c.v0]);
+				if (mKind[c.v0] == KIND_SEAM)
+				{
+					DWORD s0 = mWedge[c.v0], s1 = mWedge[c.v1];
+					collapseRemap[s0] = s1;
+					AddAttributeQuadric(mAttrQuadrics[s1], mAttrQuadrics[s0]);
+				}
+
+				touched[r0] = touched[r1] = true;
+				removed += mKind[c.v0] == KIND_BORDER ? 1 : 2;
+			}
+
+			if (removed == 0)
+				return false;
+
+			DWORD kept = 0;
+			for (DWORD f = 0; f < numFaces; ++f)
+			{
+				DWORD i0 = collapseRemap[mIndices[3*f]];
+				DWORD i1 = collapseRemap[mIndices[3*f+1]];
+				DWORD i2 = collapseRemap[mIndices[3*f+2]];
+				if (mRemap[i0] == mRemap[i1] || mRemap[i1] == mRemap[i2] || mRemap[i2] == mRemap[i0])
+					continue;
+
+				mIndices[3*kept]   = i0;
+				mIndices[3*kept+1] = i1;
+				mIndices[3*kept+2] = i2;
+				mAttributes[kept++] = mAttributes[f];
+			}
+			mIndices.resize(kept*3);
+			mAttributes.resize(kept);
+
+			// Open edges now end where their vertices went.  A vertex whose
+			// loop neighbour collapsed onto it takes over that neighbour's
+			// link on the far side, so the loop stays closed.
+			loop     = mLoop;
+			loopBack = mLoopBack;
+			for (DWORD v = 0; v < numVertices; ++v)
+			{
+				mLoop[v]     = Relink(loop, collapseRemap, v);
+				mLoopBack[v] = Relink(loopBack, collapseRemap, v);
+			}
+		}
+		return true;
+	}
+
+	void Simplifier::getLevel(LodLevel& level)const
+	{
+		level.indices    = mIndices;
+		level.attributes = mAttributes;
+		level.error      = sqrtf(mError) / mScale;
+	}
+}
+
+void BuildLodChain(const LodSource& source, std::vector<LodLevel>& levels, int numLevels, float ratio)
+{
+	levels.resize(1);
+	levels[0].indices.assign(source.indices, source.indices + source.numFaces*3);
+	levels[0].attributes.assign(source.attributes, source.attributes + source.numFaces);
+	levels[0].error = 0.0f;
+	if (numLevels < 2 || source.numFaces == 0)
+		return;
+
+	Simplifier simplifier(source);
+	for (int i = 1; i < numLevels; ++i)
+	{
+		DWORD previous = (DWORD)levels.back().attributes.size();
+		DWORD target = (DWORD)(previous * ratio);
+		bool reached = simplifier.simplify(target);
+
+		// A level that got less than halfway to its target is not worth
+		// the memory.
+		DWORD numFaces = simplifier.getNumFaces();
+		if (numFaces == 0 || numFaces > (previous + target) / 2)
+			break;
+
+		levels.push_back(LodLevel());
+		simplifier.getLevel(levels.back());
+		if (!reached)
+			break;
+	}
+}
+
+void BuildLodChains(const LodSource* sources, std::vector<LodLevel>* chains, int count,
+	ThreadPool* pool, int numLevels, float ratio)
+{
+	auto build = [&](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			BuildLodChain(sources[i], chains[i], numLevels, ratio);
+	};
+
+	if (pool)
+		pool->parallelFor(count, 1, build);
+	else
+		build(0, count);
+}
+
+int SelectLod(const float* errors, int numLevels, float distance, float projScaleY,
+	float viewportHeight, float maxPixelError)
+{
+	if (distance <= 0.0f)
+		return 0;
+
+	// Pixels one mesh unit covers at this distance.
+	float pixelsPerUnit = projScaleY * viewportHeight / (2.0f * distance);
+
+	int lod = 0;
+	for (int i = 1; i < numLevels; ++i)
+	{
+		if (errors[i] * pixelsPerUnit <= maxPixelError)
+			lod = i;
+	}
+	return lod;
+}
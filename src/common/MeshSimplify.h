@@ -0,0 +1,58 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Vertex.h"
+
+class ThreadPool;
+
+//===============================================================
+// Level of detail chains by quadric mesh simplification.
+//
+// Edges collapse one end onto the other (Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics", 1997), cheapest
+// first, in passes of collapses that share no vertex.  The cost of a
+// collapse is the position quadric of the vertex that moves, plus
+// attribute quadrics over its normal and texture coordinates, so
+// creases and texture detail go last.  Since a vertex only ever moves
+// onto another, every level indexes the original vertices and keeps
+// their attributes exactly.
+//
+// Edges of the mesh, of a subset, and seams where vertices at one
+// position differ in normal or texture coordinates are kept in place:
+// vertices on them only slide along them, both sides of a seam move
+// together, and faces of different subsets never merge.  Collapses that
+// would flip a face are skipped.
+
+struct LodSource
+{
+	const VertexPNT* vertices;
+	DWORD numVertices;
+	const DWORD* indices;     // Three per face.
+	const DWORD* attributes;  // Subset of each face.
+	DWORD numFaces;
+};
+
+struct LodLevel
+{
+	std::vector<DWORD> indices;     // Into LodSource::vertices; three per face.
+	std::vector<DWORD> attributes;  // Subset of each face.
+	float error;   // Estimated distance the surface has moved, in mesh units.
+};
+
+// Fills levels with up to numLevels levels: levels[0] is the source as
+// given, with error 0, and each later level has about ratio times the
+// faces of the one before.  The chain ends early if the mesh cannot be
+// simplified that far without breaking the rules above.
+void BuildLodChain(const LodSource& source, std::vector<LodLevel>& levels,
+	int numLevels = 4, float ratio = 0.5f);
+
+// BuildLodChain over several meshes, one mesh per task.
+void BuildLodChains(const LodSource* sources, std::vector<LodLevel>* chains, int count,
+	ThreadPool* pool = 0, int numLevels = 4, float ratio = 0.5f);
+
+// Picks the coarsest level whose error stays within maxPixelError
+// pixels at the mesh's projected size: distance from the eye, the
+// projection's y scale (_22 of the projection matrix: cot(fovY/2)) and
+// the viewport height.  errors holds each level's error, finest first.
+int SelectLod(const float* errors, int numLevels, float distance, float projScaleY,
+	float viewportHeight, float maxPixelError = 1.0f);
@@ -0,0 +1,486 @@
+#include "Meshlets.h"
+#include "VertexCache.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	// Below this the cone is too wide to ever show the whole meshlet
+	// turned away, so culling doesn't try.
+	const float MIN_CONE_DOT = 0.1f;
+
+	// How much turning from the meshlet's normal counts against a face,
+	// against its distance.  Narrow cones cull far more often.
+	const float CONE_WEIGHT = 16.0f;
+
+	// A meshlet that runs out of neighbours while under a quarter full
+	// looks this far ahead for more.
+	const DWORD FALLBACK_FACES = 256;
+
+	void ComputeBounds(const DWORD* indices, DWORD numTriangles, const D3DXVECTOR3* positions, DWORD stride,
+		const D3DXVECTOR3* faceNormals, const DWORD* faces, Meshlet& meshlet)
+	{
+		AABB box;
+		for (DWORD i = 0; i < numTriangles*3; ++i)
+		{
+			const D3DXVECTOR3& p = StridedVec3(positions, stride, indices[i]);
+			D3DXVec3Minimize(&box.minPt, &box.minPt, &p);
+			D3DXVec3Maximize(&box.maxPt, &box.maxPt, &p);
+		}
+
+		meshlet.sphere.pos = box.center();
+		float radius2 = 0.0f;
+		for (DWORD i = 0; i < numTriangles*3; ++i)
+		{
+			D3DXVECTOR3 d = StridedVec3(positions, stride, indices[i]) - meshlet.sphere.pos;
+			radius2 = std::max(radius2, D3DXVec3Dot(&d, &d));
+		}
+		meshlet.sphere.radius = sqrtf(radius2);
+
+		// Degenerate faces have no normal and are never seen, so they
+		// don't widen the cone.
+		D3DXVECTOR3 axis(0.0f, 0.0f, 0.0f);
+		for (DWORD i = 0; i < numTriangles; ++i)
+			axis += faceNormals[faces[i]];
+
+		float length = D3DXVec3Length(&axis);
+		meshlet.coneAxis = length > 1e-6f ? axis / length : D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+
+		float minDot = length > 1e-6f ? 1.0f : -1.0f;
+		for (DWORD i = 0; i < numTriangles; ++i)
+		{
+			const D3DXVECTOR3& n = faceNormals[faces[i]];
+			if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+				minDot = std::min(minDot, D3DXVec3Dot(&n, &meshlet.coneAxis));
+		}
+		meshlet.coneCutoff = minDot > MIN_CONE_DOT ? sqrtf(1.0f - minDot*minDot) : 1.0f;
+	}
+
+	// Every face is turned away if the eye lies inside the cone opposite
+	// the normals', widened by the sphere so it holds from any point of
+	// the meshlet (the test meshoptimizer uses).
+	bool FacesAway(const Meshlet& meshlet, const D3DXVECTOR3& eyePos)
+	{
+		D3DXVECTOR3 d = meshlet.sphere.pos - eyePos;
+		return D3DXVec3Dot(&d, &meshlet.coneAxis) >= meshlet.coneCutoff * D3DXVec3Length(&d) + meshlet.sphere.radius;
+	}
+
+	void CopyIndices(const DWORD* src, DWORD count, DWORD* dst)
+	{
+		memcpy(dst, src, count*sizeof(DWORD));
+	}
+
+	void CopyIndices(const DWORD* src, DWORD count, WORD* dst)
+	{
+		for (DWORD i = 0; i < count; ++i)
+			dst[i] = (WORD)src[i];
+	}
+
+	template <typename Index>
+	DWORD Cull(const Meshlet* meshlets, DWORD numMeshlets, const DWORD* meshletIndices,
+		const D3DXATTRIBUTERANGE* table, DWORD numRanges, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos,
+		Index* out, D3DXATTRIBUTERANGE* ranges, MeshletCullStats* stats)
+	{
+		MeshletCullStats s = { numMeshlets, 0, 0, 0, 0 };
+
+		// Meshlets come in table order, so each range takes the run of
+		// meshlets with its subset.
+		DWORD m = 0;
+		DWORD written = 0;
+		for (DWORD r = 0; r < numRanges; ++r)
+		{
+			ranges[r] = table[r];
+			ranges[r].FaceStart = written / 3;
+
+			for (; m < numMeshlets && meshlets[m].subset == table[r].AttribId; ++m)
+			{
+				const Meshlet& meshlet = meshlets[m];
+				s.numTriangles += meshlet.numTriangles;
+
+				if (!SphereInFrustum(meshlet.sphere, planes))
+				{
+					++s.numFrustumCulled;
+					continue;
+				}
+				if (FacesAway(meshlet, eyePos))
+				{
+					++s.numBackfaceCulled;
+					continue;
+				}
+
+				CopyIndices(meshletIndices + meshlet.firstIndex, meshlet.numTriangles*3, out + written);
+				written += meshlet.numTriangles*3;
+			}
+
+			ranges[r].FaceCount = written / 3 - ranges[r].FaceStart;
+		}
+
+		s.numTrianglesDrawn = written / 3;
+		if (stats)
+			*stats = s;
+		return written;
+	}
+}
+
+void BuildMeshlets(const DWORD* indices, const D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride,
+	std::vector<Meshlet>& meshlets, std::vector<DWORD>& meshletIndices,
+	DWORD maxVertices, DWORD maxTriangles)
+{
+	meshlets.clear();
+	meshletIndices.clear();
+
+	DWORD numFaces = 0;
+	for (DWORD r = 0; r < numRanges; ++r)
+		numFaces = std::max(numFaces, table[r].FaceStart + table[r].FaceCount);
+	if (numFaces == 0)
+		return;
+
+	// Meshlets grow across shared positions rather than shared vertices,
+	// since hard edges and texture seams split vertices and would
+	// otherwise cut the mesh into single faces.
+	std::vector<DWORD> order(numVertices);
+	for (DWORD v = 0; v < numVertices; ++v)
+		order[v] = v;
+	std::sort(order.begin(), order.end(), [&](DWORD a, DWORD b) {
+		return memcmp(&StridedVec3(positions, stride, a), &StridedVec3(positions, stride, b), sizeof(D3DXVECTOR3)) < 0;
+	});
+
+	std::vector<DWORD> weld(numVertices);
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		bool same = i > 0 && memcmp(&StridedVec3(positions, stride, order[i]), &StridedVec3(positions, stride, order[i-1]), sizeof(D3DXVECTOR3)) == 0;
+		weld[order[i]] = same ? weld[order[i-1]] : order[i];
+	}
+
+	// Faces round each welded position.
+	std::vector<DWORD> faceStart(numVertices + 1, 0);
+	for (DWORD i = 0; i < numFaces*3; ++i)
+		++faceStart[weld[indices[i]] + 1];
+	for (DWORD v = 0; v < numVertices; ++v)
+		faceStart[v + 1] += faceStart[v];
+
+	std::vector<DWORD> adjacent(numFaces*3);
+	std::vector<DWORD> fill(faceStart.begin(), faceStart.end() - 1);
+	for (DWORD i = 0; i < numFaces*3; ++i)
+		adjacent[fill[weld[indices[i]]]++] = i / 3;
+
+	std::vector<D3DXVECTOR3> centroids(numFaces);
+	std::vector<D3DXVECTOR3> normals(numFaces);
+	for (DWORD f = 0; f < numFaces; ++f)
+	{
+		const D3DXVECTOR3& p0 = StridedVec3(positions, stride, indices[f*3 + 0]);
+		const D3DXVECTOR3& p1 = StridedVec3(positions, stride, indices[f*3 + 1]);
+		const D3DXVECTOR3& p2 = StridedVec3(positions, stride, indices[f*3 + 2]);
+		centroids[f] = (p0 + p1 + p2) / 3.0f;
+
+		// Clockwise front faces: (p1-p0) x (p2-p0) points out.
+		D3DXVECTOR3 e1 = p1 - p0;
+		D3DXVECTOR3 e2 = p2 - p0;
+		D3DXVECTOR3 n;
+		D3DXVec3Cross(&n, &e1, &e2);
+		float length = D3DXVec3Length(&n);
+		normals[f] = length > 0.0f ? n / length : D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	}
+
+	// Stamps of the meshlet that last used a vertex or listed a face as a
+	// candidate, so neither needs clearing between meshlets.
+	std::vector<DWORD> vertexStamp(numVertices, 0xffffffff);
+	std::vector<DWORD> candidateStamp(numFaces, 0xffffffff);
+	std::vector<bool>  used(numFaces, false);
+
+	std::vector<DWORD> faces;
+	std::vector<DWORD> candidates;
+	std::vector<DWORD> local;
+	std::vector<DWORD> localToVertex;
+
+	for (DWORD r = 0; r < numRanges; ++r)
+	{
+		DWORD begin = table[r].FaceStart;
+		DWORD end   = begin + table[r].FaceCount;
+
+		// Seeds are taken in the faces' own order, which after
+		// OptimizeMesh is vertex cache order and so walks the surface.
+		for (DWORD seed = begin; seed < end; ++seed)
+		{
+			if (used[seed])
+				continue;
+
+			DWORD id = (DWORD)meshlets.size();
+			DWORD numMeshletVertices = 0;
+			D3DXVECTOR3 centroidSum(0.0f, 0.0f, 0.0f);
+			D3DXVECTOR3 normalSum(0.0f, 0.0f, 0.0f);
+			faces.clear();
+			candidates.clear();
+
+			DWORD next = seed;
+			while (next != 0xffffffff)
+			{
+				DWORD f = next;
+				used[f] = true;
+				faces.push_back(f);
+				centroidSum += centroids[f];
+				normalSum   += normals[f];
+
+				for (int k = 0; k < 3; ++k)
+				{
+					DWORD v = indices[f*3 + k];
+					if (vertexStamp[v] != id)
+					{
+						vertexStamp[v] = id;
+						++numMeshletVertices;
+					}
+
+					DWORD w = weld[v];
+					for (DWORD a = faceStart[w]; a < faceStart[w + 1]; ++a)
+					{
+						DWORD g = adjacent[a];
+						if (g >= begin && g < end && !used[g] && candidateStamp[g] != id)
+						{
+							candidateStamp[g] = id;
+							candidates.push_back(g);
+						}
+					}
+				}
+
+				if (faces.size() >= maxTriangles)
+					break;
+
+				// Fewest new vertices first; among those, nearest the
+				// meshlet and closest to facing its way.
+				D3DXVECTOR3 center = centroidSum / (float)faces.size();
+				D3DXVECTOR3 axis = normalSum;
+				float axisLength = D3DXVec3Length(&axis);
+				if (axisLength > 0.0f)
+					axis /= axisLength;
+
+				next = 0xffffffff;
+				int bestNew = 4;
+				float bestScore = FLT_MAX;
+				for (size_t c = 0; c < candidates.size(); )
+				{
+					DWORD g = candidates[c];
+					if (used[g])
+					{
+						candidates[c] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					++c;
+
+					int newVertices = 0;
+					for (int k = 0; k < 3; ++k)
+						newVertices += vertexStamp[indices[g*3 + k]] != id;
+					if (numMeshletVertices + newVertices > maxVertices || newVertices > bestNew)
+						continue;
+
+					D3DXVECTOR3 d = centroids[g] - center;
+					float score = D3DXVec3Dot(&d, &d) * (1.0f + CONE_WEIGHT * (1.0f - D3DXVec3Dot(&normals[g], &axis)));
+					if (newVertices < bestNew || score < bestScore)
+					{
+						bestNew = newVertices;
+						bestScore = score;
+						next = g;
+					}
+				}
+
+				// Out of neighbours with room to spare: rather than leave a
+				// meshlet of scraps, take the nearest of the next unused
+				// faces in cache order, which are close by on the surface.
+				if (next == 0xffffffff && candidates.empty() && faces.size() < maxTriangles / 4)
+				{
+					DWORD scanned = 0;
+					for (DWORD g = seed + 1; g < end && scanned < FALLBACK_FACES; ++g)
+					{
+						if (used[g])
+							continue;
+						++scanned;
+
+						int newVertices = 0;
+						for (int k = 0; k < 3; ++k)
+							newVertices += vertexStamp[indices[g*3 + k]] != id;
+						if (numMeshletVertices + newVertices > maxVertices)
+							continue;
+
+						D3DXVECTOR3 d = centroids[g] - center;
+						float score = D3DXVec3Dot(&d, &d);
+						if (score < bestScore)
+						{
+							bestScore = score;
+							next = g;
+						}
+					}
+				}
+			}
+
+			// The faces' indices, renumbered from 0 so the cache reorder
+			// works on this meshlet's vertices alone.
+			DWORD firstIndex = (DWORD)meshletIndices.size();
+			DWORD numTriangles = (DWORD)faces.size();
+			local.resize(numTriangles*3);
+			localToVertex.clear();
+			for (DWORD i = 0; i < numTriangles*3; ++i)
+			{
+				DWORD v = indices[faces[i/3]*3 + i%3];
+				DWORD j = 0;
+				while (j < localToVertex.size() && localToVertex[j] != v)
+					++j;
+				if (j == localToVertex.size())
+					localToVertex.push_back(v);
+				local[i] = j;
+			}
+			OptimizeVertexCacheForsyth(&local[0], numTriangles*3, (DWORD)localToVertex.size());
+			for (DWORD i = 0; i < numTriangles*3; ++i)
+				meshletIndices.push_back(localToVertex[local[i]]);
+
+			Meshlet meshlet;
+			meshlet.subset       = table[r].AttribId;
+			meshlet.firstIndex   = firstIndex;
+			meshlet.numTriangles = numTriangles;
+			meshlet.numVertices  = numMeshletVertices;
+			ComputeBounds(&meshletIndices[firstIndex], numTriangles, positions, stride, &normals[0], &faces[0], meshlet);
+			meshlets.push_back(meshlet);
+		}
+	}
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos)
+{
+	return SphereInFrustum(meshlet.sphere, planes) && !FacesAway(meshlet, eyePos);
+}
+
+DWORD CullMeshlets(const Meshlet* meshlets, DWORD numMeshlets, const DWORD* meshletIndices,
+	const D3DXATTRIBUTERANGE* table, DWORD numRanges, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos,
+	DWORD* out, D3DXATTRIBUTERANGE* ranges, MeshletCullStats* stats)
+{
+	return Cull(meshlets, numMeshlets, meshletIndices, table, numRanges, planes, eyePos, out, ranges, stats);
+}
+
+DWORD CullMeshlets(const Meshlet* meshlets, DWORD numMeshlets, const DWORD* meshletIndices,
+	const D3DXATTRIBUTERANGE* table, DWORD numRanges, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos,
+	WORD* out, D3DXATTRIBUTERANGE* ranges, MeshletCullStats* stats)
+{
+	return Cull(meshlets, numMeshlets, meshletIndices, table, numRanges, planes, eyePos, out, ranges, stats);
+}
+
+//===============================================================
+// MeshletMesh
+
+MeshletMesh::MeshletMesh(ID3DXMesh* mesh, DWORD maxVertices, DWORD maxTriangles)
+	: mMesh(mesh), mVB(0), mIB(0), mDecl(0)
+{
+	mMesh->AddRef();
+	memset(&mStats, 0, sizeof(mStats));
+
+	mStride   = mMesh->GetNumBytesPerVertex();
+	mUse32Bit = (mMesh->GetOptions() & D3DXMESH_32BIT) != 0;
+
+	D3DVERTEXELEMENT9 elements[MAX_FVF_DECL_SIZE];
+	HR(mMesh->GetDeclaration(elements));
+	HR(gd3dDevice->CreateVertexDeclaration(elements, &mDecl));
+	HR(mMesh->GetVertexBuffer(&mVB));
+
+	DWORD positionOffset = 0;
+	for (int i = 0; elements[i].Stream != 0xFF; ++i)
+	{
+		if (elements[i].Usage == D3DDECLUSAGE_POSITION && elements[i].UsageIndex == 0)
+			positionOffset = elements[i].Offset;
+	}
+
+	DWORD numRanges = 0;
+	HR(mMesh->GetAttributeTable(0, &numRanges));
+	mTable.resize(numRanges);
+	mRanges.resize(numRanges);
+	if (numRanges > 0)
+		HR(mMesh->GetAttributeTable(&mTable[0], &numRanges));
+
+	DWORD numIndices = mMesh->GetNumFaces()*3;
+	std::vector<DWORD> indices(numIndices);
+	void* v = 0;
+	void* k = 0;
+	HR(mMesh->LockVertexBuffer(D3DLOCK_READONLY, &v));
+	HR(mMesh->LockIndexBuffer(D3DLOCK_READONLY, &k));
+	if (mUse32Bit)
+		memcpy(&indices[0], k, numIndices*sizeof(DWORD));
+	else
+		std::copy((const WORD*)k, (const WORD*)k + numIndices, indices.begin());
+
+	if (numRanges > 0)
+	{
+		BuildMeshlets(&indices[0], &mTable[0], numRanges, (const D3DXVECTOR3*)((BYTE*)v + positionOffset),
+			mMesh->GetNumVertices(), mStride, mMeshlets, mMeshletIndices, maxVertices, maxTriangles);
+	}
+	HR(mMesh->UnlockIndexBuffer());
+	HR(mMesh->UnlockVertexBuffer());
+
+	onResetDevice();
+}
+
+MeshletMesh::~MeshletMesh()
+{
+	SafeRelease(mIB);
+	SafeRelease(mVB);
+	SafeRelease(mDecl);
+	SafeRelease(mMesh);
+}
+
+void MeshletMesh::onLostDevice()
+{
+	SafeRelease(mIB);
+}
+
+void MeshletMesh::onResetDevice()
+{
+	if (mIB || mMeshletIndices.empty())
+		return;
+
+	DWORD size = (DWORD)mMeshletIndices.size() * (mUse32Bit ? sizeof(DWORD) : sizeof(WORD));
+	HR(gd3dDevice->CreateIndexBuffer(size, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+		mUse32Bit ? D3DFMT_INDEX32 : D3DFMT_INDEX16, D3DPOOL_DEFAULT, &mIB, 0));
+
+	// Nothing is culled until the first update().
+	for (size_t r = 0; r < mTable.size(); ++r)
+		mRanges[r].FaceCount = 0;
+}
+
+void MeshletMesh::update(const D3DXMATRIX& world, const D3DXMATRIX& viewProj, const D3DXVECTOR3& eyePosW)
+{
+	if (mIB == 0)
+		return;
+
+	// Cull in the mesh's own space so the meshlets need no transforming.
+	D3DXPLANE planes[6];
+	ExtractFrustumPlanes(world * viewProj, planes);
+
+	D3DXMATRIX worldInv;
+	D3DXMatrixInverse(&worldInv, 0, &world);
+	D3DXVECTOR3 eyePos;
+	D3DXVec3TransformCoord(&eyePos, &eyePosW, &worldInv);
+
+	void* k = 0;
+	HR(mIB->Lock(0, 0, &k, D3DLOCK_DISCARD));
+	if (mUse32Bit)
+		CullMeshlets(&mMeshlets[0], (DWORD)mMeshlets.size(), &mMeshletIndices[0], &mTable[0], (DWORD)mTable.size(),
+			planes, eyePos, (DWORD*)k, &mRanges[0], &mStats);
+	else
+		CullMeshlets(&mMeshlets[0], (DWORD)mMeshlets.size(), &mMeshletIndices[0], &mTable[0], (DWORD)mTable.size(),
+			planes, eyePos, (WORD*)k, &mRanges[0], &mStats);
+	HR(mIB->Unlock());
+}
+
+void MeshletMesh::drawSubset(DWORD subset)
+{
+	for (size_t r = 0; r < mRanges.size(); ++r)
+	{
+		const D3DXATTRIBUTERANGE& range = mRanges[r];
+		if (range.AttribId != subset || range.FaceCount == 0 || mIB == 0)
+			continue;
+
+		HR(gd3dDevice->SetVertexDeclaration(mDecl));
+		HR(gd3dDevice->SetStreamSource(0, mVB, 0, mStride));
+		HR(gd3dDevice->SetIndices(mIB));
+		HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, range.VertexStart, range.VertexCount,
+			range.FaceStart*3, range.FaceCount));
+	}
+}
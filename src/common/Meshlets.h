@@ -0,0 +1,112 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+//===============================================================
+// Meshlets: small clusters of a mesh's triangles that can be culled on
+// their own.
+//
+// Each subset is cut into meshlets of at most maxVertices distinct
+// vertices and maxTriangles triangles.  A meshlet grows from a seed
+// face across shared edges, preferring faces that add the fewest new
+// vertices and then those nearest it and facing its way, so meshlets
+// come out compact and flat enough for their normal cones to be useful.
+// Each meshlet keeps a bounding sphere and a cone holding every face
+// normal, and its triangles in vertex cache order.
+//
+// Culling drops meshlets outside the frustum, and meshlets whose cone
+// shows every face turned away from the eye, and copies the indices of
+// the rest into one compacted index list, still grouped by subset.
+// Face normals are taken as D3D's clockwise front faces see them.
+
+struct Meshlet
+{
+	DWORD subset;
+	DWORD firstIndex;     // Into the meshlet index list.
+	DWORD numTriangles;
+	DWORD numVertices;    // Distinct vertices.
+	BoundingSphere sphere;
+	D3DXVECTOR3 coneAxis;
+	float coneCutoff;     // Sine of the cone's half angle; 1 if it can't be culled.
+};
+
+struct MeshletCullStats
+{
+	DWORD numMeshlets;
+	DWORD numFrustumCulled;
+	DWORD numBackfaceCulled;
+	DWORD numTriangles;
+	DWORD numTrianglesDrawn;
+};
+
+// Builds meshlets for a triangle list sorted by subset as table says.
+// positions is the first vertex's position and stride the bytes from one
+// vertex to the next.  meshletIndices gets every face once, meshlet
+// after meshlet in table order.
+void BuildMeshlets(const DWORD* indices, const D3DXATTRIBUTERANGE* table, DWORD numRanges,
+	const D3DXVECTOR3* positions, DWORD numVertices, DWORD stride,
+	std::vector<Meshlet>& meshlets, std::vector<DWORD>& meshletIndices,
+	DWORD maxVertices = 64, DWORD maxTriangles = 124);
+
+// True if the meshlet may be seen: planes (ExtractFrustumPlanes) and
+// eyePos are in the meshlets' own space.
+bool IsMeshletVisible(const Meshlet& meshlet, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos);
+
+// Writes the indices of every visible meshlet to out, which must have
+// room for them all, and sets ranges[i].FaceStart and FaceCount to
+// where subset table[i].AttribId's faces ended up (the rest of
+// ranges[i] is copied from table[i]).  Returns the number of indices
+// written.
+DWORD CullMeshlets(const Meshlet* meshlets, DWORD numMeshlets, const DWORD* meshletIndices,
+	const D3DXATTRIBUTERANGE* table, DWORD numRanges, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos,
+	DWORD* out, D3DXATTRIBUTERANGE* ranges, MeshletCullStats* stats = 0);
+DWORD CullMeshlets(const Meshlet* meshlets, DWORD numMeshlets, const DWORD* meshletIndices,
+	const D3DXATTRIBUTERANGE* table, DWORD numRanges, const D3DXPLANE planes[6], const D3DXVECTOR3& eyePos,
+	WORD* out, D3DXATTRIBUTERANGE* ranges, MeshletCullStats* stats = 0);
+
+//===============================================================
+// An ID3DXMesh drawn through meshlets.  update() culls once a frame
+// into a dynamic index buffer, and drawSubset() draws what survived
+// with the mesh's own vertex buffer, in place of ID3DXMesh::DrawSubset.
+
+class MeshletMesh
+{
+public:
+	// mesh needs an attribute table (D3DXMESHOPT_ATTRSORT) and stays
+	// referenced until destruction.
+	explicit MeshletMesh(ID3DXMesh* mesh, DWORD maxVertices = 64, DWORD maxTriangles = 124);
+	~MeshletMesh();
+
+	// The index buffer lives in the default pool.
+	void onLostDevice();
+	void onResetDevice();
+
+	// world must be rigid or uniformly scaled, so the normal cones stay
+	// cones in world space.
+	void update(const D3DXMATRIX& world, const D3DXMATRIX& viewProj, const D3DXVECTOR3& eyePosW);
+
+	// Call inside an effect pass after CommitChanges; sets the vertex
+	// declaration, stream source and indices itself.
+	void drawSubset(DWORD subset);
+
+	DWORD getNumMeshlets()const                 { return (DWORD)mMeshlets.size(); }
+	const MeshletCullStats& getCullStats()const { return mStats; }
+
+private:
+	MeshletMesh(const MeshletMesh& rhs);
+	MeshletMesh& operator=(const MeshletMesh& rhs);
+
+private:
+	ID3DXMesh* mMesh;
+	IDirect3DVertexBuffer9* mVB;
+	IDirect3DIndexBuffer9*  mIB;  // Dynamic; the culled indices.
+	IDirect3DVertexDeclaration9* mDecl;
+	DWORD mStride;
+	bool  mUse32Bit;
+
+	std::vector<Meshlet> mMeshlets;
+	std::vector<DWORD> mMeshletIndices;
+	std::vector<D3DXATTRIBUTERANGE> mTable;
+	std::vector<D3DXATTRIBUTERANGE> mRanges;  // This frame's, per mTable entry.
+	MeshletCullStats mStats;
+};
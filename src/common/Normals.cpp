@@ -0,0 +1,552 @@
+#include "Normals.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+#include "XFile.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	const DWORD NO_VERTEX = 0xffffffff;
+
+	// A face's unit normal and its area (doubled), loaded as one SimdF4.
+	struct FaceRecord
+	{
+		float n[3];
+		float area;
+	};
+
+	void ParallelFor(ThreadPool* pool, int count, int grain, const std::function<void(int, int)>& job)
+	{
+		if (pool)
+			pool->parallelFor(count, grain, job);
+		else
+			job(0, count);
+	}
+
+	//===============================================================
+	// Where faces come from: a gather fills p with the corner positions
+	// of faces [first, first+count), one face per lane, as x0 y0 z0 x1 ...
+	// z2.  Short groups repeat their last face in the spare lanes.
+
+	template <typename Index>
+	struct ListGather
+	{
+		const Index* indices;
+		const D3DXVECTOR3* positions;
+		DWORD stride;
+
+		void operator()(DWORD first, int count, float p[9][4])const
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				const Index* face = indices + (first + (i < count ? i : count - 1))*3;
+				for (int k = 0; k < 3; ++k)
+				{
+					const D3DXVECTOR3& v = StridedVec3(positions, stride, face[k]);
+					p[3*k][i] = v.x;
+					p[3*k + 1][i] = v.y;
+					p[3*k + 2][i] = v.z;
+				}
+			}
+		}
+	};
+
+	// GenTriGrid's two triangles per cell, cell after cell in row order.
+	// Groups start on even faces, so a group is two whole cells.
+	template <typename Positions>
+	struct GridGather
+	{
+		Positions positions;
+		int numCellCols;
+
+		void operator()(DWORD first, int count, float p[9][4])const
+		{
+			static const int corners[2][3][2] = {
+				{ { 0, 0 }, { 0, 1 }, { 1, 0 } },
+				{ { 1, 0 }, { 0, 1 }, { 1, 1 } }
+			};
+
+			int row = (int)(first / 2 / numCellCols);
+			int col = (int)(first / 2 - row * numCellCols);
+			for (int i = 0; i < 4; ++i)
+			{
+				int f = i < count ? i : count - 1;
+				int r = row, c = col + f/2;
+				if (c == numCellCols)
+				{
+					++r;
+					c = 0;
+				}
+				for (int k = 0; k < 3; ++k)
+					positions(r + corners[f & 1][k][0], c + corners[f & 1][k][1], &p[3*k][i], &p[3*k + 1][i], &p[3*k + 2][i]);
+			}
+		}
+	};
+
+	struct StridedGridPositions
+	{
+		const D3DXVECTOR3* positions;
+		DWORD stride;
+		int numVertCols;
+
+		void operator()(int r, int c, float* x, float* y, float* z)const
+		{
+			const D3DXVECTOR3& v = StridedVec3(positions, stride, r*numVertCols + c);
+			*x = v.x;
+			*y = v.y;
+			*z = v.z;
+		}
+	};
+
+	struct HeightGridPositions
+	{
+		const float* heights;
+		int numVertCols;
+		float dx;
+		float dz;
+
+		void operator()(int r, int c, float* x, float* y, float* z)const
+		{
+			*x =  (float)c * dx;
+			*y =  heights[r*numVertCols + c];
+			*z = -(float)r * dz;
+		}
+	};
+
+	//===============================================================
+	// Pass 1: face normals, areas and corner angles.
+
+	// acos(x) for x in [-1, 1], to within 7e-5 radians (Abramowitz and
+	// Stegun 4.4.45); plenty for weights.
+	SimdF4 SimdAcos(SimdF4 x)
+	{
+		SimdF4 zero = SimdSet1(0.0f);
+		SimdF4 a = SimdMax(x, SimdSub(zero, x));
+
+		SimdF4 p = SimdSet1(-0.0187293f);
+		p = SimdMulAdd(p, a, SimdSet1( 0.0742610f));
+		p = SimdMulAdd(p, a, SimdSet1(-0.2121144f));
+		p = SimdMulAdd(p, a, SimdSet1( 1.5707288f));
+		SimdF4 r = SimdMul(p, SimdSqrt(SimdMax(SimdSub(SimdSet1(1.0f), a), zero)));
+
+		return SimdSelect(SimdCmpLt(x, zero), SimdSub(SimdSet1(D3DX_PI), r), r);
+	}
+
+	SimdF4 SimdDot(SimdF4 ax, SimdF4 ay, SimdF4 az, SimdF4 bx, SimdF4 by, SimdF4 bz)
+	{
+		return SimdMulAdd(ax, bx, SimdMulAdd(ay, by, SimdMul(az, bz)));
+	}
+
+	// Faces [first, first+count), count <= 4, one per lane.
+	template <typename Gather>
+	void ComputeFaceGroup(const Gather& gather, DWORD first, int count, FaceRecord* records, float* angles)
+	{
+		float p[9][4];
+		gather(first, count, p);
+
+		SimdF4 x0 = SimdLoad(p[0]), y0 = SimdLoad(p[1]), z0 = SimdLoad(p[2]);
+		SimdF4 x1 = SimdLoad(p[3]), y1 = SimdLoad(p[4]), z1 = SimdLoad(p[5]);
+		SimdF4 x2 = SimdLoad(p[6]), y2 = SimdLoad(p[7]), z2 = SimdLoad(p[8]);
+
+		SimdF4 e1x = SimdSub(x1, x0), e1y = SimdSub(y1, y0), e1z = SimdSub(z1, z0);
+		SimdF4 e2x = SimdSub(x2, x0), e2y = SimdSub(y2, y0), e2z = SimdSub(z2, z0);
+
+		// (p1 - p0) x (p2 - p0) faces out of a clockwise front face.
+		SimdF4 nx = SimdSub(SimdMul(e1y, e2z), SimdMul(e1z, e2y));
+		SimdF4 ny = SimdSub(SimdMul(e1z, e2x), SimdMul(e1x, e2z));
+		SimdF4 nz = SimdSub(SimdMul(e1x, e2y), SimdMul(e1y, e2x));
+
+		SimdF4 tiny = SimdSet1(1.0e-30f);
+		SimdF4 area = SimdSqrt(SimdDot(nx, ny, nz, nx, ny, nz));
+		SimdF4 invArea = SimdDiv(SimdSet1(1.0f), SimdMax(area, tiny));
+		nx = SimdMul(nx, invArea);
+		ny = SimdMul(ny, invArea);
+		nz = SimdMul(nz, invArea);
+
+		SimdTranspose4(nx, ny, nz, area);
+		SimdF4 r[4] = { nx, ny, nz, area };
+		for (int i = 0; i < count; ++i)
+			SimdStore(records[first + i].n, r[i]);
+
+		if (angles == 0)
+			return;
+
+		// The angle at each corner, between the two edges leaving it.
+		SimdF4 e3x = SimdSub(x2, x1), e3y = SimdSub(y2, y1), e3z = SimdSub(z2, z1);
+		SimdF4 l1 = SimdSqrt(SimdMax(SimdDot(e1x, e1y, e1z, e1x, e1y, e1z), tiny));
+		SimdF4 l2 = SimdSqrt(SimdMax(SimdDot(e2x, e2y, e2z, e2x, e2y, e2z), tiny));
+		SimdF4 l3 = SimdSqrt(SimdMax(SimdDot(e3x, e3y, e3z, e3x, e3y, e3z), tiny));
+
+		SimdF4 zero = SimdSet1(0.0f);
+		SimdF4 a0 = SimdAcos(SimdDiv(SimdDot(e1x, e1y, e1z, e2x, e2y, e2z), SimdMul(l1, l2)));
+		SimdF4 a1 = SimdAcos(SimdDiv(SimdSub(zero, SimdDot(e1x, e1y, e1z, e3x, e3y, e3z)), SimdMul(l1, l3)));
+		SimdF4 a2 = SimdAcos(SimdDiv(SimdDot(e2x, e2y, e2z, e3x, e3y, e3z), SimdMul(l2, l3)));
+
+		float a[3][4];
+		SimdStore(a[0], a0);
+		SimdStore(a[1], a1);
+		SimdStore(a[2], a2);
+		for (int i = 0; i < count; ++i)
+		{
+			angles[(first + i)*3 + 0] = a[0][i];
+			angles[(first + i)*3 + 1] = a[1][i];
+			angles[(first + i)*3 + 2] = a[2][i];
+		}
+	}
+
+	template <typename Gather>
+	void ComputeFaces(const Gather& gather, DWORD numFaces,
+		std::vector<FaceRecord>& records, std::vector<float>& angles, NormalWeighting weighting, ThreadPool* pool)
+	{
+		records.resize(numFaces);
+		if (weighting == NORMALS_ANGLE_WEIGHTED)
+			angles.resize(numFaces*3);
+
+		FaceRecord* r = records.empty() ? 0 : &records[0];
+		float* a = angles.empty() ? 0 : &angles[0];
+
+		int numGroups = (int)((numFaces + 3) / 4);
+		ParallelFor(pool, numGroups, ITEMS_PER_CHUNK / 4, [&](int begin, int end)
+		{
+			for (int g = begin; g < end; ++g)
+			{
+				DWORD first = (DWORD)g * 4;
+				ComputeFaceGroup(gather, first, (int)std::min(numFaces - first, (DWORD)4), r, a);
+			}
+		});
+	}
+
+	//===============================================================
+	// Pass 2: per-vertex sums.
+
+	SimdF4 AddCorner(SimdF4 sum, const FaceRecord* records, const float* angles, DWORD corner)
+	{
+		const FaceRecord& r = records[corner / 3];
+		float w = angles ? angles[corner] : r.area;
+		return SimdMulAdd(SimdLoad(r.n), SimdSet1(w), sum);
+	}
+
+	D3DXVECTOR3 NormalizeSum(SimdF4 sum)
+	{
+		float s[4];
+		SimdStore(s, sum);
+
+		D3DXVECTOR3 n(s[0], s[1], s[2]);
+		float length = sqrtf(n.x*n.x + n.y*n.y + n.z*n.z);
+		return length > 0.0f ? n / length : D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	}
+
+	template <typename Index>
+	void BuildAdjacency(const Index* indices, DWORD numIndices, DWORD numVertices,
+		VertexFaceAdjacency& adjacency, const D3DXVECTOR3* positions, DWORD positionStride)
+	{
+		adjacency.list.resize(numVertices);
+		for (DWORD v = 0; v < numVertices; ++v)
+			adjacency.list[v] = v;
+
+		// Vertices at one position all use the list of the first of them.
+		if (positions)
+		{
+			std::vector<DWORD> order(adjacency.list);
+			std::sort(order.begin(), order.end(), [&](DWORD a, DWORD b) {
+				return memcmp(&StridedVec3(positions, positionStride, a), &StridedVec3(positions, positionStride, b), sizeof(D3DXVECTOR3)) < 0;
+			});
+			for (DWORD i = 1; i < numVertices; ++i)
+			{
+				if (memcmp(&StridedVec3(positions, positionStride, order[i]), &StridedVec3(positions, positionStride, order[i-1]), sizeof(D3DXVECTOR3)) == 0)
+					adjacency.list[order[i]] = adjacency.list[order[i-1]];
+			}
+		}
+
+		// Counting sort of the corners by list, which keeps each list in
+		// index order.
+		adjacency.cornerStart.assign(numVertices + 1, 0);
+		for (DWORD i = 0; i < numIndices; ++i)
+			++adjacency.cornerStart[adjacency.list[indices[i]] + 1];
+		for (DWORD v = 0; v < numVertices; ++v)
+			adjacency.cornerStart[v + 1] += adjacency.cornerStart[v];
+
+		adjacency.corners.resize(numIndices);
+		std::vector<DWORD> next(adjacency.cornerStart.begin(), adjacency.cornerStart.end() - 1);
+		for (DWORD i = 0; i < numIndices; ++i)
+			adjacency.corners[next[adjacency.list[indices[i]]]++] = i;
+	}
+
+	template <typename Index>
+	void ComputeListNormals(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+		const Index* indices, DWORD numIndices, const VertexFaceAdjacency& adjacency,
+		D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+	{
+		std::vector<FaceRecord> records;
+		std::vector<float> angles;
+		ListGather<Index> gather = { indices, positions, positionStride };
+		ComputeFaces(gather, numIndices / 3, records, angles, weighting, pool);
+
+		const FaceRecord* r = records.empty() ? 0 : &records[0];
+		const float* a = angles.empty() ? 0 : &angles[0];
+		const DWORD* start = &adjacency.cornerStart[0];
+		const DWORD* corners = adjacency.corners.empty() ? 0 : &adjacency.corners[0];
+
+		ParallelFor(pool, (int)numVertices, ITEMS_PER_CHUNK, [&](int begin, int end)
+		{
+			for (int v = begin; v < end; ++v)
+			{
+				DWORD list = adjacency.list[v];
+				SimdF4 sum = SimdSet1(0.0f);
+				for (DWORD c = start[list]; c < start[list + 1]; ++c)
+					sum = AddCorner(sum, r, a, corners[c]);
+				StridedVec3(normals, normalStride, v) = NormalizeSum(sum);
+			}
+		});
+	}
+
+	template <typename Positions>
+	void ComputeGrid(const Positions& positions, int numVertRows, int numVertCols,
+		D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+	{
+		if (numVertRows < 2 || numVertCols < 2)
+			return;
+
+		std::vector<FaceRecord> records;
+		std::vector<float> angles;
+		DWORD numCellCols = numVertCols - 1;
+		GridGather<Positions> gather = { positions, (int)numCellCols };
+		ComputeFaces(gather, 2 * (numVertRows - 1) * numCellCols, records, angles, weighting, pool);
+
+		const FaceRecord* r = &records[0];
+		const float* a = angles.empty() ? 0 : &angles[0];
+
+		// Vertex (i, j) is corner 0 of the first triangle of cell (i, j),
+		// corner 1 of both triangles of cell (i, j-1), corners 2 and 0 of
+		// those of cell (i-1, j) and corner 2 of the second triangle of
+		// cell (i-1, j-1).
+		int grain = std::max(1, ITEMS_PER_CHUNK / numVertCols);
+		ParallelFor(pool, numVertRows, grain, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				for (int j = 0; j < numVertCols; ++j)
+				{
+					SimdF4 sum = SimdSet1(0.0f);
+					if (i < numVertRows - 1)
+					{
+						DWORD cell = i*numCellCols + j;
+						if (j < numVertCols - 1)
+							sum = AddCorner(sum, r, a, 6*cell + 0);
+						if (j > 0)
+						{
+							sum = AddCorner(sum, r, a, 6*(cell - 1) + 1);
+							sum = AddCorner(sum, r, a, 6*(cell - 1) + 4);
+						}
+					}
+					if (i > 0)
+					{
+						DWORD cell = (i - 1)*numCellCols + j;
+						if (j < numVertCols - 1)
+						{
+							sum = AddCorner(sum, r, a, 6*cell + 2);
+							sum = AddCorner(sum, r, a, 6*cell + 3);
+						}
+						if (j > 0)
+							sum = AddCorner(sum, r, a, 6*(cell - 1) + 5);
+					}
+					StridedVec3(normals, normalStride, i*numVertCols + j) = NormalizeSum(sum);
+				}
+			}
+		});
+	}
+}
+
+void BuildVertexFaceAdjacency(const DWORD* indices, DWORD numIndices, DWORD numVertices,
+	VertexFaceAdjacency& adjacency, const D3DXVECTOR3* positions, DWORD positionStride)
+{
+	BuildAdjacency(indices, numIndices, numVertices, adjacency, positions, positionStride);
+}
+
+void BuildVertexFaceAdjacency(const WORD* indices, DWORD numIndices, DWORD numVertices,
+	VertexFaceAdjacency& adjacency, const D3DXVECTOR3* positions, DWORD positionStride)
+{
+	BuildAdjacency(indices, numIndices, numVertices, adjacency, positions, positionStride);
+}
+
+void ComputeVertexNormals(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	const DWORD* indices, DWORD numIndices, const VertexFaceAdjacency& adjacency,
+	D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+{
+	ComputeListNormals(positions, positionStride, numVertices, indices, numIndices, adjacency,
+		normals, normalStride, weighting, pool);
+}
+
+void ComputeVertexNormals(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	const WORD* indices, DWORD numIndices, const VertexFaceAdjacency& adjacency,
+	D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+{
+	ComputeListNormals(positions, positionStride, numVertices, indices, numIndices, adjacency,
+		normals, normalStride, weighting, pool);
+}
+
+void ComputeVertexNormals(ID3DXMesh* mesh, NormalWeighting weighting, ThreadPool* pool)
+{
+	D3DVERTEXELEMENT9 elems[MAX_FVF_DECL_SIZE];
+	HR(mesh->GetDeclaration(elems));
+
+	DWORD positionOffset = 0xffffffff, normalOffset = 0xffffffff;
+	for (int i = 0; i < MAX_FVF_DECL_SIZE && elems[i].Stream != 0xff; ++i)
+	{
+		if (elems[i].Type != D3DDECLTYPE_FLOAT3 || elems[i].UsageIndex != 0)
+			continue;
+		if (elems[i].Usage == D3DDECLUSAGE_POSITION)
+			positionOffset = elems[i].Offset;
+		else if (elems[i].Usage == D3DDECLUSAGE_NORMAL)
+			normalOffset = elems[i].Offset;
+	}
+	if (positionOffset == 0xffffffff || normalOffset == 0xffffffff)
+		return;
+
+	DWORD numVertices = mesh->GetNumVertices();
+	DWORD numIndices = mesh->GetNumFaces() * 3;
+	DWORD stride = mesh->GetNumBytesPerVertex();
+
+	BYTE* v = 0;
+	void* k = 0;
+	HR(mesh->LockVertexBuffer(0, (void**)&v));
+	HR(mesh->LockIndexBuffer(D3DLOCK_READONLY, &k));
+
+	const D3DXVECTOR3* positions = (const D3DXVECTOR3*)(v + positionOffset);
+	D3DXVECTOR3* normals = (D3DXVECTOR3*)(v + normalOffset);
+	VertexFaceAdjacency adjacency;
+	if (mesh->GetOptions() & D3DXMESH_32BIT)
+	{
+		BuildAdjacency((const DWORD*)k, numIndices, numVertices, adjacency, positions, stride);
+		ComputeListNormals(positions, stride, numVertices, (const DWORD*)k, numIndices, adjacency,
+			normals, stride, weighting, pool);
+	}
+	else
+	{
+		BuildAdjacency((const WORD*)k, numIndices, numVertices, adjacency, positions, stride);
+		ComputeListNormals(positions, stride, numVertices, (const WORD*)k, numIndices, adjacency,
+			normals, stride, weighting, pool);
+	}
+
+	HR(mesh->UnlockIndexBuffer());
+	HR(mesh->UnlockVertexBuffer());
+}
+
+void ComputeXFileNormals(XFileMesh& mesh, ThreadPool* pool)
+{
+	if (mesh.indices.empty())
+		return;
+
+	// unsigned int indices are 32 bits, like DWORD.
+	const D3DXVECTOR3* positions = (const D3DXVECTOR3*)mesh.vertices[0].pos;
+	const DWORD* indices = (const DWORD*)&mesh.indices[0];
+	DWORD numVertices = (DWORD)mesh.vertices.size();
+	DWORD numIndices = (DWORD)mesh.indices.size();
+
+	VertexFaceAdjacency adjacency;
+	BuildAdjacency(indices, numIndices, numVertices, adjacency, positions, sizeof(XFileVertex));
+	ComputeListNormals(positions, sizeof(XFileVertex), numVertices, indices, numIndices, adjacency,
+		(D3DXVECTOR3*)mesh.vertices[0].normal, sizeof(XFileVertex), NORMALS_ANGLE_WEIGHTED, pool);
+}
+
+DWORD ComputeVertexNormalsSplit(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	DWORD* indices, DWORD numIndices, float smoothingAngle,
+	std::vector<DWORD>& remap, std::vector<D3DXVECTOR3>& normals,
+	NormalWeighting weighting, ThreadPool* pool)
+{
+	VertexFaceAdjacency adjacency;
+	BuildAdjacency(indices, numIndices, numVertices, adjacency, positions, positionStride);
+
+	std::vector<FaceRecord> records;
+	std::vector<float> angles;
+	ListGather<DWORD> gather = { indices, positions, positionStride };
+	ComputeFaces(gather, numIndices / 3, records, angles, weighting, pool);
+
+	const FaceRecord* r = records.empty() ? 0 : &records[0];
+	const float* a = angles.empty() ? 0 : &angles[0];
+	const DWORD* start = &adjacency.cornerStart[0];
+	const DWORD* corners = adjacency.corners.empty() ? 0 : &adjacency.corners[0];
+
+	// Each corner's normal from the faces round its position that are
+	// near enough its own face.  Degenerate faces have no direction of
+	// their own and take all of them.
+	float cosLimit = cosf(smoothingAngle);
+	std::vector<D3DXVECTOR3> cornerNormals(numIndices);
+	ParallelFor(pool, (int)numVertices, ITEMS_PER_CHUNK, [&](int begin, int end)
+	{
+		for (int list = begin; list < end; ++list)
+		{
+			for (DWORD c = start[list]; c < start[list + 1]; ++c)
+			{
+				const float* n = r[corners[c] / 3].n;
+				bool degenerate = n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f;
+
+				SimdF4 sum = SimdSet1(0.0f);
+				for (DWORD d = start[list]; d < start[list + 1]; ++d)
+				{
+					const float* m = r[corners[d] / 3].n;
+					if (degenerate || n[0]*m[0] + n[1]*m[1] + n[2]*m[2] >= cosLimit)
+						sum = AddCorner(sum, r, a, corners[d]);
+				}
+				cornerNormals[corners[c]] = NormalizeSum(sum);
+			}
+		}
+	});
+
+	// A vertex keeps the first normal its corners ask for; corners that
+	// want another get a copy of the vertex, shared by those that agree.
+	remap.resize(numVertices);
+	for (DWORD v = 0; v < numVertices; ++v)
+		remap[v] = v;
+	normals.assign(numVertices, D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+
+	std::vector<DWORD> nextCopy(numVertices, NO_VERTEX);
+	std::vector<bool> used(numVertices, false);
+	for (DWORD c = 0; c < numIndices; ++c)
+	{
+		DWORD v = indices[c];
+		const D3DXVECTOR3& n = cornerNormals[c];
+		if (!used[v])
+		{
+			used[v] = true;
+			normals[v] = n;
+			continue;
+		}
+
+		DWORD u = v, last = v;
+		for (; u != NO_VERTEX; last = u, u = nextCopy[u])
+		{
+			const D3DXVECTOR3& m = normals[u];
+			if ((n.x == m.x && n.y == m.y && n.z == m.z) || n.x*m.x + n.y*m.y + n.z*m.z >= 0.99999f)
+				break;
+		}
+
+		if (u == NO_VERTEX)
+		{
+			u = (DWORD)remap.size();
+			remap.push_back(v);
+			normals.push_back(n);
+			nextCopy.push_back(NO_VERTEX);
+			nextCopy[last] = u;
+		}
+		indices[c] = u;
+	}
+
+	return (DWORD)remap.size();
+}
+
+void ComputeGridNormals(const D3DXVECTOR3* positions, DWORD positionStride, int numVertRows, int numVertCols,
+	D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+{
+	StridedGridPositions source = { positions, positionStride, numVertCols };
+	ComputeGrid(source, numVertRows, numVertCols, normals, normalStride, weighting, pool);
+}
+
+void ComputeHeightGridNormals(const float* heights, int numVertRows, int numVertCols, float dx, float dz,
+	D3DXVECTOR3* normals, DWORD normalStride, NormalWeighting weighting, ThreadPool* pool)
+{
+	HeightGridPositions source = { heights, numVertCols, dx, dz };
+	ComputeGrid(source, numVertRows, numVertCols, normals, normalStride, weighting, pool);
+}
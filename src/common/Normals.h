@@ -0,0 +1,104 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class ThreadPool;
+struct XFileMesh;
+
+//===============================================================
+// Vertex normal generation, in place of D3DXComputeNormals.
+//
+// A vertex normal is the normalized sum of the normals of the faces
+// round it, each weighted either by the face's area or by its angle at
+// the vertex.  Angle weighting (Thurmer and Wuthrich, 1998) doesn't
+// depend on how a surface happens to be triangulated, so it is the
+// default.  Faces follow D3D's clockwise winding, as
+// D3DXComputeNormals does.
+//
+// The work is done in two passes, each split across a ThreadPool's
+// threads if one is given:
+//
+//   1. Face normals, areas and corner angles, four faces at a time with
+//      SIMD (SimdMath.h).
+//   2. Each vertex sums its own faces, found through a vertex-to-face
+//      adjacency list in CSR form (one run of corners per vertex).
+//      Every vertex is written by one thread only, so the pass needs
+//      neither atomics nor per-thread copies of the normals, and the
+//      result doesn't depend on how the work was split.
+//
+// Positions and normals may be interleaved in a vertex array: strides
+// are in bytes, as in D3DX's *Array functions.  Vertices no face uses,
+// and vertices whose faces are all degenerate, get a zero normal.
+
+enum NormalWeighting
+{
+	NORMALS_ANGLE_WEIGHTED,
+	NORMALS_AREA_WEIGHTED
+};
+
+// Which face corners (index list positions, 3*face + k) each vertex has:
+// vertex v's are corners[cornerStart[list[v]]] up to
+// corners[cornerStart[list[v] + 1]].  Built once per index list, it can
+// be reused as long as only the positions change, e.g. for a mesh
+// deformed every frame.
+struct VertexFaceAdjacency
+{
+	std::vector<DWORD> list;         // The list each vertex uses.
+	std::vector<DWORD> cornerStart;  // One past the last list's end.
+	std::vector<DWORD> corners;
+};
+
+// If positions is given, vertices at the same position share one list,
+// so normals are smooth across texture seams and other splits.
+// Otherwise each vertex has its own list.
+void BuildVertexFaceAdjacency(const DWORD* indices, DWORD numIndices, DWORD numVertices,
+	VertexFaceAdjacency& adjacency, const D3DXVECTOR3* positions = 0, DWORD positionStride = 0);
+void BuildVertexFaceAdjacency(const WORD* indices, DWORD numIndices, DWORD numVertices,
+	VertexFaceAdjacency& adjacency, const D3DXVECTOR3* positions = 0, DWORD positionStride = 0);
+
+// Smooth normals for every vertex of an indexed triangle list.
+void ComputeVertexNormals(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	const DWORD* indices, DWORD numIndices, const VertexFaceAdjacency& adjacency,
+	D3DXVECTOR3* normals, DWORD normalStride,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
+void ComputeVertexNormals(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	const WORD* indices, DWORD numIndices, const VertexFaceAdjacency& adjacency,
+	D3DXVECTOR3* normals, DWORD normalStride,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
+
+// The same in place for a mesh whose vertices have a FLOAT3 normal,
+// smooth across vertices at the same position, as D3DXComputeNormals(mesh, 0).
+void ComputeVertexNormals(ID3DXMesh* mesh,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
+
+// Angle-weighted normals, welded by position, for a parsed .x file
+// that had none (XFileMesh::hasNormals false): what LoadXFile gives the
+// same file.
+void ComputeXFileNormals(XFileMesh& mesh, ThreadPool* pool = 0);
+
+// Normals with creases: a face only shares its corners' normals with
+// the faces round them that are within smoothingAngle (radians) of it,
+// so edges sharper than that stay hard.  Vertices whose corners end up
+// with different normals are split.  Adjacency is by position.
+//
+// indices is rewritten to use the split vertices, which are appended
+// after the numVertices originals: vertex i copies the rest of its data
+// from vertex remap[i], and normals[i] is its normal.  Returns the new
+// number of vertices.
+DWORD ComputeVertexNormalsSplit(const D3DXVECTOR3* positions, DWORD positionStride, DWORD numVertices,
+	DWORD* indices, DWORD numIndices, float smoothingAngle,
+	std::vector<DWORD>& remap, std::vector<D3DXVECTOR3>& normals,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
+
+// Normals of a numVertRows x numVertCols grid laid out and triangulated
+// as GenTriGrid does, without an index list or adjacency: each vertex
+// has up to six faces, found from its row and column.
+void ComputeGridNormals(const D3DXVECTOR3* positions, DWORD positionStride, int numVertRows, int numVertCols,
+	D3DXVECTOR3* normals, DWORD normalStride,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
+
+// The same for a height grid: vertex (r, c) is at (c*dx, heights[r*numVertCols + c], -r*dz),
+// plus any offset, which doesn't change the normals.
+void ComputeHeightGridNormals(const float* heights, int numVertRows, int numVertCols, float dx, float dz,
+	D3DXVECTOR3* normals, DWORD normalStride,
+	NormalWeighting weighting = NORMALS_ANGLE_WEIGHTED, ThreadPool* pool = 0);
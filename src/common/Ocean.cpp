@@ -0,0 +1,311 @@
+#include "Ocean.h"
+#include "ThreadPool.h"
+#include "WaveField.h"
+#include <math.h>
+
+namespace
+{
+	const float GRAVITY = 9.81f;
+	const float PI      = 3.14159265f;
+
+	// Small deterministic generator so a seed always gives the same sea,
+	// whatever the CRT's rand() does.
+	class Random
+	{
+	public:
+		Random(UINT seed) : mState(seed ? seed : 0x9e3779b9) {}
+
+		// Uniform in (0, 1].
+		float uniform()
+		{
+			mState ^= mState << 13;
+			mState ^= mState >> 17;
+			mState ^= mState << 5;
+			return ((mState >> 8) + 1) * (1.0f / 16777216.0f);
+		}
+
+		// Standard normal, Box-Muller.
+		float gaussian()
+		{
+			float u1 = uniform();
+			float u2 = uniform();
+			return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * u2);
+		}
+
+	private:
+		UINT mState;
+	};
+
+	// Spectral density of wave vector (kx, kz) in m^4.
+	float Phillips(float kx, float kz, const OceanParams& params)
+	{
+		float k2 = kx*kx + kz*kz;
+		if (k2 == 0.0f)
+			return 0.0f;
+
+		D3DXVECTOR2 wind;
+		D3DXVec2Normalize(&wind, &params.windDir);
+
+		// Largest wave the wind makes, and a cut-off for tiny ones.
+		float L = params.windSpeed * params.windSpeed / GRAVITY;
+		float l = L * 0.001f;
+
+		float cosTheta = (kx*wind.x + kz*wind.y) / sqrtf(k2);
+		return params.amplitude * expf(-1.0f / (k2*L*L)) / (k2*k2)
+			* cosTheta*cosTheta * expf(-k2*l*l);
+	}
+
+	float Jonswap(float kx, float kz, const OceanParams& params)
+	{
+		float k2 = kx*kx + kz*kz;
+		if (k2 == 0.0f)
+			return 0.0f;
+
+		float k = sqrtf(k2);
+		float omega = sqrtf(GRAVITY * k);
+
+		float V = params.windSpeed;
+		float F = params.fetch;
+		float alpha  = 0.076f * powf(V*V / (F*GRAVITY), 0.22f);
+		float omegaP = 22.0f * powf(GRAVITY*GRAVITY / (V*F), 1.0f/3.0f);
+		float sigma  = omega <= omegaP ? 0.07f : 0.09f;
+		float r = expf(-(omega - omegaP)*(omega - omegaP) / (2.0f*sigma*sigma*omegaP*omegaP));
+
+		float sOmega = alpha * GRAVITY*GRAVITY / powf(omega, 5.0f)
+			* expf(-1.25f * powf(omegaP / omega, 4.0f)) * powf(params.peakEnhancement, r);
+
+		// S(w) -> S(k) with dw/dk = g/(2w), then spread over directions
+		// by cos^2, which integrates to pi around the circle.
+		D3DXVECTOR2 wind;
+		D3DXVec2Normalize(&wind, &params.windDir);
+		float cosTheta = (kx*wind.x + kz*wind.y) / k;
+
+		float sK = sOmega * GRAVITY / (2.0f * omega);
+		return params.amplitude * sK / k * cosTheta*cosTheta / PI;
+	}
+}
+
+OceanParams::OceanParams()
+	: spectrum(OCEAN_PHILLIPS), windSpeed(10.0f), windDir(1.0f, 0.0f),
+	amplitude(0.0081f), fetch(100000.0f), peakEnhancement(3.3f),
+	choppiness(1.0f), repeatTime(200.0f), seed(1)
+{
+}
+
+Ocean::Ocean(int size, float patchSize, const OceanParams& params, ThreadPool* pool)
+	: mSize(size), mPatchSize(patchSize), mParams(params), mPool(pool), mPlan(size)
+{
+	int n = size*size;
+	mARe.resize(n, 0.0f); mAIm.resize(n, 0.0f);
+	mBRe.resize(n, 0.0f); mBIm.resize(n, 0.0f);
+	mCRe.resize(n, 0.0f); mCIm.resize(n, 0.0f);
+
+	buildSpectrum();
+}
+
+void Ocean::setParams(const OceanParams& params)
+{
+	mParams = params;
+	buildSpectrum();
+}
+
+void Ocean::buildSpectrum()
+{
+	int n = mSize*mSize;
+	mH0Re.assign(n, 0.0f);
+	mH0Im.assign(n, 0.0f);
+	mH0ConjRe.assign(n, 0.0f);
+	mH0ConjIm.assign(n, 0.0f);
+	mOmega.assign(n, 0.0f);
+
+	Random random(mParams.seed);
+
+	float dk = 2.0f * PI / mPatchSize;
+	float omega0 = 2.0f * PI / mParams.repeatTime;
+
+	for (int r = 0; r < mSize; ++r)
+	{
+		for (int c = 0; c < mSize; ++c)
+		{
+			int i = r*mSize + c;
+
+			// Always draw, so a seed gives the same waves whatever the
+			// spectrum.
+			float xr = random.gaussian();
+			float xi = random.gaussian();
+
+			// The Nyquist row and column have no distinct -k partner; leave
+			// them empty so the maps come out real.
+			int fr = frequency(r), fc = frequency(c);
+			if (fr == -mSize/2 || fc == -mSize/2)
+				continue;
+
+			// Row index runs towards -z.
+			float kx =  dk * fc;
+			float kz = -dk * fr;
+
+			float s = mParams.spectrum == OCEAN_JONSWAP ? Jonswap(kx, kz, mParams) : Phillips(kx, kz, mParams);
+			float scale = sqrtf(0.5f * s) * dk;
+
+			mH0Re[i] = xr * scale;
+			mH0Im[i] = xi * scale;
+
+			float omega = sqrtf(GRAVITY * sqrtf(kx*kx + kz*kz));
+			mOmega[i] = floorf(omega / omega0);
+		}
+	}
+
+	for (int r = 0; r < mSize; ++r)
+	{
+		for (int c = 0; c < mSize; ++c)
+		{
+			int m = ((mSize - r) % mSize)*mSize + (mSize - c) % mSize;
+			mH0ConjRe[r*mSize + c] =  mH0Re[m];
+			mH0ConjIm[r*mSize + c] = -mH0Im[m];
+		}
+	}
+}
+
+void Ocean::update(float t)
+{
+	// w*t = omega*2*pi*t/repeatTime; only the fraction of a loop matters.
+	double loops = (double)t / mParams.repeatTime;
+	float loopFraction = (float)(loops - floor(loops));
+
+	if (mPool)
+	{
+		int grain = ITEMS_PER_CHUNK / mSize;
+		mPool->parallelFor(mSize, grain > 0 ? grain : 1, [&](int rowBegin, int rowEnd) {
+			evolveRows(rowBegin, rowEnd, loopFraction);
+		});
+	}
+	else
+		evolveRows(0, mSize, loopFraction);
+
+	mPlan.transform2D(&mARe[0], &mAIm[0], true, mPool);
+	if (mParams.choppiness != 0.0f)
+		mPlan.transform2D(&mBRe[0], &mBIm[0], true, mPool);
+	mPlan.transform2D(&mCRe[0], &mCIm[0], true, mPool);
+}
+
+void Ocean::evolveRows(int rowBegin, int rowEnd, float loopFraction)
+{
+	float dk = 2.0f * PI / mPatchSize;
+	float lambda = mParams.choppiness;
+
+	std::vector<float> phase(mSize), sinPhase(mSize), cosPhase(mSize);
+
+	for (int r = rowBegin; r < rowEnd; ++r)
+	{
+		float kz = -dk * frequency(r);
+		const float* omega = &mOmega[r*mSize];
+
+		// Phases in [-pi, pi); cycles is never negative, so truncation
+		// rounds down.
+		for (int c = 0; c < mSize; ++c)
+		{
+			float cycles = omega[c] * loopFraction;
+			phase[c] = 2.0f * PI * (cycles - (float)(int)(cycles + 0.5f));
+		}
+		WaveSinCos(&phase[0], mSize, &sinPhase[0], &cosPhase[0]);
+
+		for (int c = 0; c < mSize; ++c)
+		{
+			int i = r*mSize + c;
+			float kx = dk * frequency(c);
+			float s  = sinPhase[c];
+			float co = cosPhase[c];
+
+			// h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt)
+			float hr = (mH0Re[i] + mH0ConjRe[i])*co - (mH0Im[i] - mH0ConjIm[i])*s;
+			float hi = (mH0Im[i] + mH0ConjIm[i])*co + (mH0Re[i] - mH0ConjRe[i])*s;
+
+			// Height + i*slopeX: h + i*(i*kx*h) = (1 - kx)*h.
+			mARe[i] = (1.0f - kx) * hr;
+			mAIm[i] = (1.0f - kx) * hi;
+
+			// Displacement -i*k/|k|*h, x + i*z: h*(kz - i*kx)/|k|.
+			float k = sqrtf(kx*kx + kz*kz);
+			float f = k > 0.0f ? lambda / k : 0.0f;
+			mBRe[i] = f * (kz*hr + kx*hi);
+			mBIm[i] = f * (kz*hi - kx*hr);
+
+			// SlopeZ: i*kz*h.
+			mCRe[i] = -kz * hi;
+			mCIm[i] =  kz * hr;
+		}
+	}
+}
+
+void Ocean::writeGrid(int numVertRows, int numVertCols, const D3DXVECTOR3& center,
+	D3DXVECTOR3* positions, D3DXVECTOR3* normals)const
+{
+	float dx = mPatchSize / mSize;
+	float xOffset = -(float)(numVertCols-1) * dx * 0.5f;
+	float zOffset =  (float)(numVertRows-1) * dx * 0.5f;
+	bool choppy = mParams.choppiness != 0.0f;
+
+	for (int i = 0; i < numVertRows; ++i)
+	{
+		const int r = i % mSize;
+		for (int j = 0; j < numVertCols; ++j)
+		{
+			int t = r*mSize + j % mSize;
+			int k = i*numVertCols + j;
+
+			if (positions)
+			{
+				positions[k].x = ((float)j*dx + xOffset) + center.x;
+				positions[k].y = mARe[t] + center.y;
+				positions[k].z = (-(float)i*dx + zOffset) + center.z;
+				if (choppy)
+				{
+					positions[k].x += mBRe[t];
+					positions[k].z += mBIm[t];
+				}
+			}
+
+			if (normals)
+			{
+				D3DXVECTOR3 n(-mAIm[t], 1.0f, -mCRe[t]);
+				D3DXVec3Normalize(&normals[k], &n);
+			}
+		}
+	}
+}
+
+void Ocean::writeDisplacementMap(void* bits, int pitch)const
+{
+	bool choppy = mParams.choppiness != 0.0f;
+	for (int r = 0; r < mSize; ++r)
+	{
+		float* row = (float*)((BYTE*)bits + r*pitch);
+		for (int c = 0; c < mSize; ++c)
+		{
+			int t = r*mSize + c;
+			row[4*c]     = choppy ? mBRe[t] : 0.0f;
+			row[4*c + 1] = mARe[t];
+			row[4*c + 2] = choppy ? mBIm[t] : 0.0f;
+			row[4*c + 3] = 0.0f;
+		}
+	}
+}
+
+void Ocean::writeNormalMap(void* bits, int pitch)const
+{
+	for (int r = 0; r < mSize; ++r)
+	{
+		D3DCOLOR* row = (D3DCOLOR*)((BYTE*)bits + r*pitch);
+		for (int c = 0; c < mSize; ++c)
+		{
+			int t = r*mSize + c;
+			D3DXVECTOR3 n(-mAIm[t], 1.0f, -mCRe[t]);
+			D3DXVec3Normalize(&n, &n);
+
+			row[c] = D3DCOLOR_ARGB(255,
+				(int)(n.x*127.5f + 127.5f),
+				(int)(n.y*127.5f + 127.5f),
+				(int)(n.z*127.5f + 127.5f));
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "FFT.h"
+
+class ThreadPool;
+
+//===============================================================
+// Spectral ocean surface (Tessendorf, "Simulating Ocean Water").
+//
+// A random field of wave amplitudes h0(k) is drawn once from a wind
+// driven spectrum, either Phillips or JONSWAP.  Every update() advances
+// each wave by its deep water dispersion w(k) = sqrt(g*|k|) and runs
+// inverse FFTs to get, over one square patch:
+//
+//   height        y
+//   displacement  x and z offsets scaled by the choppiness (sharpens
+//                 crests and flattens troughs)
+//   slopes        dy/dx and dy/dz, for the normals
+//
+// Each real map pair shares one complex FFT, so an update is three
+// size x size inverse FFTs.  The maps are periodic, so patches tile
+// seamlessly.  Frequencies are rounded to multiples of
+// 2*pi/repeatTime, so the animation also loops in time and the phases
+// stay exact however long it runs.
+
+enum OceanSpectrum
+{
+	OCEAN_PHILLIPS,
+	OCEAN_JONSWAP
+};
+
+struct OceanParams
+{
+	OceanParams();
+
+	OceanSpectrum spectrum;
+	float windSpeed;        // m/s, at 10 m above the surface.
+	D3DXVECTOR2 windDir;    // (x, z), need not be normalized.
+
+	// Scale on the spectrum: Phillips' constant A, or a multiplier on
+	// JONSWAP (1 being the measured spectrum).
+	float amplitude;
+
+	float fetch;            // JONSWAP: distance the wind has blown over, m.
+	float peakEnhancement;  // JONSWAP gamma; 3.3 is the usual value.
+
+	float choppiness;       // Horizontal displacement scale; 0 turns it off.
+	float repeatTime;       // Seconds before the animation loops.
+	UINT  seed;
+};
+
+class Ocean
+{
+public:
+	// size is the FFT size (a power of two), patchSize the width of one
+	// tile in meters.
+	Ocean(int size, float patchSize, const OceanParams& params, ThreadPool* pool = 0);
+
+	// Redraws the wave amplitudes.
+	void setParams(const OceanParams& params);
+	const OceanParams& getParams()const { return mParams; }
+
+	void update(float t);
+
+	int   getSize()const      { return mSize; }
+	float getPatchSize()const { return mPatchSize; }
+
+	// size x size maps from the last update(), row-major with row 0 at
+	// the patch's +z edge like GenTriGrid.
+	const float* getHeights()const { return &mARe[0]; }
+	const float* getSlopeX()const  { return &mAIm[0]; }
+	const float* getDispX()const   { return &mBRe[0]; }
+	const float* getDispZ()const   { return &mBIm[0]; }
+	const float* getSlopeZ()const  { return &mCRe[0]; }
+
+	// Writes a GenTriGrid-style grid of any size whose cells are one
+	// texel (patchSize/size) wide, repeating the patch as often as
+	// needed: positions are the flat grid plus the displacement, normals
+	// come from the slopes.  Either pointer may be null.
+	void writeGrid(int numVertRows, int numVertCols, const D3DXVECTOR3& center,
+		D3DXVECTOR3* positions, D3DXVECTOR3* normals)const;
+
+	// Texture rows for a D3DFMT_A32B32G32R32F displacement map (x, y, z
+	// displacement, 0) and a D3DFMT_A8R8G8B8 normal map (n*0.5 + 0.5 in
+	// r, g, b), pitch in bytes.
+	void writeDisplacementMap(void* bits, int pitch)const;
+	void writeNormalMap(void* bits, int pitch)const;
+
+private:
+	void buildSpectrum();
+	void evolveRows(int rowBegin, int rowEnd, float loopFraction);
+
+	// Signed frequency index of FFT bin i.
+	int frequency(int i)const { return i < mSize/2 ? i : i - mSize; }
+
+private:
+	int   mSize;
+	float mPatchSize;
+	OceanParams mParams;
+	ThreadPool* mPool;
+	FFTPlan     mPlan;
+
+	// Per wave vector: h0(k), conj(h0(-k)), and w(k) in multiples of
+	// 2*pi/repeatTime.
+	std::vector<float> mH0Re;
+	std::vector<float> mH0Im;
+	std::vector<float> mH0ConjRe;
+	std::vector<float> mH0ConjIm;
+	std::vector<float> mOmega;
+
+	// FFT buffers; after update() they hold (height, slopeX),
+	// (dispX, dispZ) and (slopeZ, unused).
+	std::vector<float> mARe, mAIm;
+	std::vector<float> mBRe, mBIm;
+	std::vector<float> mCRe, mCIm;
+};
@@ -0,0 +1,841 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+//===============================================================
+// Header-only vector math for CPU-side code.
+//
+// Vec3, Vec4, Mat4, Quat and Plane have exactly the layout of
+// D3DXVECTOR3, D3DXVECTOR4, D3DXMATRIX, D3DXQUATERNION and D3DXPLANE,
+// and the functions follow the D3DX conventions (row vectors, v*M,
+// left-handed helpers, D3DX quaternion multiply order), so code can
+// switch between the two a call at a time; AsD3DX()/FromD3DX() cast
+// between them when d3dx9math.h has been included first.
+//
+// Unlike the d3dx9 DLL everything here is inline and needs no DirectX,
+// so it also builds for Linux tools.  Matrix rows are processed four
+// floats at a time with SSE2 or NEON, or plain scalar code otherwise
+// (define SIMDMATH_SCALAR to force that).  The *Array and *SoA
+// functions transform many elements per call; the SoA forms work on
+// separate x, y and z arrays and do four points per instruction.
+
+#if !defined(SIMDMATH_SCALAR)
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMDMATH_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM) || defined(_M_ARM64)
+#define SIMDMATH_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+//===============================================================
+// Four-float register abstraction.
+
+#if defined(SIMDMATH_SSE)
+
+typedef __m128 SimdF4;
+
+inline SimdF4 SimdLoad(const float* p)           { return _mm_loadu_ps(p); }
+inline void   SimdStore(float* p, SimdF4 v)      { _mm_storeu_ps(p, v); }
+inline SimdF4 SimdSet1(float f)                  { return _mm_set1_ps(f); }
+inline SimdF4 SimdAdd(SimdF4 a, SimdF4 b)        { return _mm_add_ps(a, b); }
+inline SimdF4 SimdSub(SimdF4 a, SimdF4 b)        { return _mm_sub_ps(a, b); }
+inline SimdF4 SimdMul(SimdF4 a, SimdF4 b)        { return _mm_mul_ps(a, b); }
+inline SimdF4 SimdDiv(SimdF4 a, SimdF4 b)        { return _mm_div_ps(a, b); }
+inline SimdF4 SimdMulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline SimdF4 SimdSqrt(SimdF4 a)                 { return _mm_sqrt_ps(a); }
+inline SimdF4 SimdMax(SimdF4 a, SimdF4 b)        { return _mm_max_ps(a, b); }
+
+// Comparisons give a mask with every bit of a lane set where true;
+// SimdSelect takes a where the mask is set and b elsewhere.
+inline SimdF4 SimdCmpEq(SimdF4 a, SimdF4 b)      { return _mm_cmpeq_ps(a, b); }
+inline SimdF4 SimdCmpLt(SimdF4 a, SimdF4 b)      { return _mm_cmplt_ps(a, b); }
+inline SimdF4 SimdSelect(SimdF4 mask, SimdF4 a, SimdF4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+// Treats a, b, c, d as the rows of a 4x4 matrix and transposes it, so
+// four structures loaded one per register come out one field per
+// register.
+inline void SimdTranspose4(SimdF4& a, SimdF4& b, SimdF4& c, SimdF4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+#elif defined(SIMDMATH_NEON)
+
+typedef float32x4_t SimdF4;
+
+inline SimdF4 SimdLoad(const float* p)           { return vld1q_f32(p); }
+inline void   SimdStore(float* p, SimdF4 v)      { vst1q_f32(p, v); }
+inline SimdF4 SimdSet1(float f)                  { return vdupq_n_f32(f); }
+inline SimdF4 SimdAdd(SimdF4 a, SimdF4 b)        { return vaddq_f32(a, b); }
+inline SimdF4 SimdSub(SimdF4 a, SimdF4 b)        { return vsubq_f32(a, b); }
+inline SimdF4 SimdMul(SimdF4 a, SimdF4 b)        { return vmulq_f32(a, b); }
+inline SimdF4 SimdMulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { return vmlaq_f32(c, a, b); }
+inline SimdF4 SimdDiv(SimdF4 a, SimdF4 b)
+{
+	// Reciprocal estimate plus two Newton steps; ARMv7 has no divide.
+	float32x4_t r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	return vmulq_f32(a, r);
+}
+inline SimdF4 SimdSqrt(SimdF4 a)
+{
+	// Reciprocal square root estimate plus two Newton steps, with a
+	// zero input kept at zero rather than 0 * inf.
+	float32x4_t r = vrsqrteq_f32(a);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+	r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+	uint32x4_t zero = vceqq_f32(a, vdupq_n_f32(0.0f));
+	return vbslq_f32(zero, a, vmulq_f32(a, r));
+}
+inline SimdF4 SimdMax(SimdF4 a, SimdF4 b)        { return vmaxq_f32(a, b); }
+inline SimdF4 SimdCmpEq(SimdF4 a, SimdF4 b)      { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+inline SimdF4 SimdCmpLt(SimdF4 a, SimdF4 b)      { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline SimdF4 SimdSelect(SimdF4 mask, SimdF4 a, SimdF4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+inline void SimdTranspose4(SimdF4& a, SimdF4& b, SimdF4& c, SimdF4& d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b);
+	float32x4x2_t cd = vtrnq_f32(c, d);
+	a = vcombine_f32(vget_low_f32(ab.val[0]),  vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]),  vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#else
+
+struct SimdF4 { float v[4]; };
+
+inline SimdF4 SimdLoad(const float* p)      { SimdF4 r; r.v[0] = p[0]; r.v[1] = p[1]; r.v[2] = p[2]; r.v[3] = p[3]; return r; }
+inline void   SimdStore(float* p, SimdF4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+inline SimdF4 SimdSet1(float f)             { SimdF4 r; r.v[0] = r.v[1] = r.v[2] = r.v[3] = f; return r; }
+inline SimdF4 SimdAdd(SimdF4 a, SimdF4 b)   { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline SimdF4 SimdSub(SimdF4 a, SimdF4 b)   { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+inline SimdF4 SimdMul(SimdF4 a, SimdF4 b)   { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+inline SimdF4 SimdDiv(SimdF4 a, SimdF4 b)   { for (int i = 0; i < 4; ++i) a.v[i] /= b.v[i]; return a; }
+inline SimdF4 SimdMulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i]*b.v[i] + c.v[i]; return a; }
+inline SimdF4 SimdSqrt(SimdF4 a)            { for (int i = 0; i < 4; ++i) a.v[i] = sqrtf(a.v[i]); return a; }
+inline SimdF4 SimdMax(SimdF4 a, SimdF4 b)   { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+
+inline float SimdMaskLane(bool set)
+{
+	unsigned bits = set ? 0xffffffffu : 0u;
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+inline SimdF4 SimdCmpEq(SimdF4 a, SimdF4 b) { for (int i = 0; i < 4; ++i) a.v[i] = SimdMaskLane(a.v[i] == b.v[i]); return a; }
+inline SimdF4 SimdCmpLt(SimdF4 a, SimdF4 b) { for (int i = 0; i < 4; ++i) a.v[i] = SimdMaskLane(a.v[i] < b.v[i]); return a; }
+inline SimdF4 SimdSelect(SimdF4 mask, SimdF4 a, SimdF4 b)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		unsigned m, x, y;
+		memcpy(&m, &mask.v[i], sizeof(m));
+		memcpy(&x, &a.v[i], sizeof(x));
+		memcpy(&y, &b.v[i], sizeof(y));
+		x = (x & m) | (y & ~m);
+		memcpy(&a.v[i], &x, sizeof(x));
+	}
+	return a;
+}
+inline void SimdTranspose4(SimdF4& a, SimdF4& b, SimdF4& c, SimdF4& d)
+{
+	SimdF4 r[4] = { a, b, c, d };
+	for (int i = 0; i < 4; ++i)
+	{
+		a.v[i] = r[i].v[0];
+		b.v[i] = r[i].v[1];
+		c.v[i] = r[i].v[2];
+		d.v[i] = r[i].v[3];
+	}
+}
+
+#endif
+
+//===============================================================
+// Types.
+
+struct Vec3
+{
+	Vec3() {}
+	Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+	Vec3& operator+=(const Vec3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vec3& operator-=(const Vec3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vec3& operator*=(float s)       { x *= s; y *= s; z *= s; return *this; }
+
+	Vec3 operator-()const                { return Vec3(-x, -y, -z); }
+	Vec3 operator+(const Vec3& v)const   { return Vec3(x + v.x, y + v.y, z + v.z); }
+	Vec3 operator-(const Vec3& v)const   { return Vec3(x - v.x, y - v.y, z - v.z); }
+	Vec3 operator*(float s)const         { return Vec3(x*s, y*s, z*s); }
+	bool operator==(const Vec3& v)const  { return x == v.x && y == v.y && z == v.z; }
+	bool operator!=(const Vec3& v)const  { return !(*this == v); }
+
+	float x, y, z;
+};
+
+struct Vec4
+{
+	Vec4() {}
+	Vec4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+	Vec4(const Vec3& v, float w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+
+	Vec4 operator+(const Vec4& v)const   { return Vec4(x + v.x, y + v.y, z + v.z, w + v.w); }
+	Vec4 operator-(const Vec4& v)const   { return Vec4(x - v.x, y - v.y, z - v.z, w - v.w); }
+	Vec4 operator*(float s)const         { return Vec4(x*s, y*s, z*s, w*s); }
+	bool operator==(const Vec4& v)const  { return x == v.x && y == v.y && z == v.z && w == v.w; }
+	bool operator!=(const Vec4& v)const  { return !(*this == v); }
+
+	float x, y, z, w;
+};
+
+// Row-major, row vectors: a point transforms as v*M and the translation
+// is in the fourth row.
+struct Mat4
+{
+	Mat4() {}
+	Mat4(float m11, float m12, float m13, float m14,
+	     float m21, float m22, float m23, float m24,
+	     float m31, float m32, float m33, float m34,
+	     float m41, float m42, float m43, float m44)
+		: _11(m11), _12(m12), _13(m13), _14(m14),
+		  _21(m21), _22(m22), _23(m23), _24(m24),
+		  _31(m31), _32(m32), _33(m33), _34(m34),
+		  _41(m41), _42(m42), _43(m43), _44(m44) {}
+
+	float& operator()(int row, int col)       { return m[row][col]; }
+	float  operator()(int row, int col)const  { return m[row][col]; }
+
+	Mat4 operator*(const Mat4& b)const;
+	Mat4& operator*=(const Mat4& b)     { return *this = *this * b; }
+	bool operator==(const Mat4& b)const { return memcmp(m, b.m, sizeof(m)) == 0; }
+	bool operator!=(const Mat4& b)const { return !(*this == b); }
+
+	union
+	{
+		struct
+		{
+			float _11, _12, _13, _14;
+			float _21, _22, _23, _24;
+			float _31, _32, _33, _34;
+			float _41, _42, _43, _44;
+		};
+		float m[4][4];
+	};
+};
+
+struct Quat
+{
+	Quat() {}
+	Quat(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+
+	bool operator==(const Quat& q)const { return x == q.x && y == q.y && z == q.z && w == q.w; }
+	bool operator!=(const Quat& q)const { return !(*this == q); }
+
+	float x, y, z, w;
+};
+
+// Points p with a*p.x + b*p.y + c*p.z + d = 0.
+struct Plane
+{
+	Plane() {}
+	Plane(float a_, float b_, float c_, float d_) : a(a_), b(b_), c(c_), d(d_) {}
+
+	float a, b, c, d;
+};
+
+//===============================================================
+// Vec3 / Vec4.
+
+inline float Vec3Dot(const Vec3* a, const Vec3* b)
+{
+	return a->x*b->x + a->y*b->y + a->z*b->z;
+}
+
+inline Vec3* Vec3Cross(Vec3* out, const Vec3* a, const Vec3* b)
+{
+	Vec3 r(a->y*b->z - a->z*b->y,
+	       a->z*b->x - a->x*b->z,
+	       a->x*b->y - a->y*b->x);
+	*out = r;
+	return out;
+}
+
+inline float Vec3Length(const Vec3* v)
+{
+	return sqrtf(Vec3Dot(v, v));
+}
+
+inline float Vec3LengthSq(const Vec3* v)
+{
+	return Vec3Dot(v, v);
+}
+
+// A zero vector stays zero, as in D3DX.
+inline Vec3* Vec3Normalize(Vec3* out, const Vec3* v)
+{
+	float len = Vec3Length(v);
+	if (len > 0.0f)
+		*out = *v * (1.0f / len);
+	else
+		*out = Vec3(0.0f, 0.0f, 0.0f);
+	return out;
+}
+
+inline Vec3* Vec3Lerp(Vec3* out, const Vec3* a, const Vec3* b, float t)
+{
+	*out = *a + (*b - *a) * t;
+	return out;
+}
+
+inline float Vec4Dot(const Vec4* a, const Vec4* b)
+{
+	return a->x*b->x + a->y*b->y + a->z*b->z + a->w*b->w;
+}
+
+// r = x*row0 + y*row1 + z*row2 + w*row3.
+inline SimdF4 SimdTransformRow(float x, float y, float z, float w, const Mat4* m)
+{
+	SimdF4 r = SimdMul(SimdSet1(x), SimdLoad(m->m[0]));
+	r = SimdMulAdd(SimdSet1(y), SimdLoad(m->m[1]), r);
+	r = SimdMulAdd(SimdSet1(z), SimdLoad(m->m[2]), r);
+	return SimdMulAdd(SimdSet1(w), SimdLoad(m->m[3]), r);
+}
+
+// (x, y, z, 1)*M.
+inline Vec4* Vec3Transform(Vec4* out, const Vec3* v, const Mat4* m)
+{
+	SimdStore(&out->x, SimdTransformRow(v->x, v->y, v->z, 1.0f, m));
+	return out;
+}
+
+// (x, y, z, 1)*M projected back to w = 1.
+inline Vec3* Vec3TransformCoord(Vec3* out, const Vec3* v, const Mat4* m)
+{
+	Vec4 r;
+	Vec3Transform(&r, v, m);
+	float invW = 1.0f / r.w;
+	*out = Vec3(r.x*invW, r.y*invW, r.z*invW);
+	return out;
+}
+
+// (x, y, z, 0)*M: directions ignore the translation.
+inline Vec3* Vec3TransformNormal(Vec3* out, const Vec3* v, const Mat4* m)
+{
+	float r[4];
+	SimdStore(r, SimdTransformRow(v->x, v->y, v->z, 0.0f, m));
+	*out = Vec3(r[0], r[1], r[2]);
+	return out;
+}
+
+inline Vec4* Vec4Transform(Vec4* out, const Vec4* v, const Mat4* m)
+{
+	SimdStore(&out->x, SimdTransformRow(v->x, v->y, v->z, v->w, m));
+	return out;
+}
+
+//===============================================================
+// Mat4.
+
+inline Mat4* Mat4Identity(Mat4* out)
+{
+	*out = Mat4(1.0f, 0.0f, 0.0f, 0.0f,
+	            0.0f, 1.0f, 0.0f, 0.0f,
+	            0.0f, 0.0f, 1.0f, 0.0f,
+	            0.0f, 0.0f, 0.0f, 1.0f);
+	return out;
+}
+
+inline bool Mat4IsIdentity(const Mat4* m)
+{
+	Mat4 i;
+	return *m == *Mat4Identity(&i);
+}
+
+// out = a*b (a applied first).  out may alias a or b.
+inline Mat4* Mat4Multiply(Mat4* out, const Mat4* a, const Mat4* b)
+{
+	SimdF4 r0 = SimdTransformRow(a->_11, a->_12, a->_13, a->_14, b);
+	SimdF4 r1 = SimdTransformRow(a->_21, a->_22, a->_23, a->_24, b);
+	SimdF4 r2 = SimdTransformRow(a->_31, a->_32, a->_33, a->_34, b);
+	SimdF4 r3 = SimdTransformRow(a->_41, a->_42, a->_43, a->_44, b);
+	SimdStore(out->m[0], r0);
+	SimdStore(out->m[1], r1);
+	SimdStore(out->m[2], r2);
+	SimdStore(out->m[3], r3);
+	return out;
+}
+
+inline Mat4 Mat4::operator*(const Mat4& b)const
+{
+	Mat4 r;
+	Mat4Multiply(&r, this, &b);
+	return r;
+}
+
+inline Mat4* Mat4Transpose(Mat4* out, const Mat4* m)
+{
+	Mat4 t(m->_11, m->_21, m->_31, m->_41,
+	       m->_12, m->_22, m->_32, m->_42,
+	       m->_13, m->_23, m->_33, m->_43,
+	       m->_14, m->_24, m->_34, m->_44);
+	*out = t;
+	return out;
+}
+
+inline float Mat4Determinant(const Mat4* m)
+{
+	float s0 = m->_11*m->_22 - m->_21*m->_12;
+	float s1 = m->_11*m->_23 - m->_21*m->_13;
+	float s2 = m->_11*m->_24 - m->_21*m->_14;
+	float s3 = m->_12*m->_23 - m->_22*m->_13;
+	float s4 = m->_12*m->_24 - m->_22*m->_14;
+	float s5 = m->_13*m->_24 - m->_23*m->_14;
+
+	float c5 = m->_33*m->_44 - m->_43*m->_34;
+	float c4 = m->_32*m->_44 - m->_42*m->_34;
+	float c3 = m->_32*m->_43 - m->_42*m->_33;
+	float c2 = m->_31*m->_44 - m->_41*m->_34;
+	float c1 = m->_31*m->_43 - m->_41*m->_33;
+	float c0 = m->_31*m->_42 - m->_41*m->_32;
+
+	return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
+// General inverse from 2x2 sub-determinants.  Returns 0 and leaves out
+// untouched if m is singular, like D3DXMatrixInverse.
+inline Mat4* Mat4Inverse(Mat4* out, float* determinant, const Mat4* m)
+{
+	float s0 = m->_11*m->_22 - m->_21*m->_12;
+	float s1 = m->_11*m->_23 - m->_21*m->_13;
+	float s2 = m->_11*m->_24 - m->_21*m->_14;
+	float s3 = m->_12*m->_23 - m->_22*m->_13;
+	float s4 = m->_12*m->_24 - m->_22*m->_14;
+	float s5 = m->_13*m->_24 - m->_23*m->_14;
+
+	float c5 = m->_33*m->_44 - m->_43*m->_34;
+	float c4 = m->_32*m->_44 - m->_42*m->_34;
+	float c3 = m->_32*m->_43 - m->_42*m->_33;
+	float c2 = m->_31*m->_44 - m->_41*m->_34;
+	float c1 = m->_31*m->_43 - m->_41*m->_33;
+	float c0 = m->_31*m->_42 - m->_41*m->_32;
+
+	float det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+	if (determinant)
+		*determinant = det;
+	if (det == 0.0f)
+		return 0;
+
+	float inv = 1.0f / det;
+
+	Mat4 r(( m->_22*c5 - m->_23*c4 + m->_24*c3) * inv,
+	       (-m->_12*c5 + m->_13*c4 - m->_14*c3) * inv,
+	       ( m->_42*s5 - m->_43*s4 + m->_44*s3) * inv,
+	       (-m->_32*s5 + m->_33*s4 - m->_34*s3) * inv,
+
+	       (-m->_21*c5 + m->_23*c2 - m->_24*c1) * inv,
+	       ( m->_11*c5 - m->_13*c2 + m->_14*c1) * inv,
+	       (-m->_41*s5 + m->_43*s2 - m->_44*s1) * inv,
+	       ( m->_31*s5 - m->_33*s2 + m->_34*s1) * inv,
+
+	       ( m->_21*c4 - m->_22*c2 + m->_24*c0) * inv,
+	       (-m->_11*c4 + m->_12*c2 - m->_14*c0) * inv,
+	       ( m->_41*s4 - m->_42*s2 + m->_44*s0) * inv,
+	       (-m->_31*s4 + m->_32*s2 - m->_34*s0) * inv,
+
+	       (-m->_21*c3 + m->_22*c1 - m->_23*c0) * inv,
+	       ( m->_11*c3 - m->_12*c1 + m->_13*c0) * inv,
+	       (-m->_41*s3 + m->_42*s1 - m->_43*s0) * inv,
+	       ( m->_31*s3 - m->_32*s1 + m->_33*s0) * inv);
+	*out = r;
+	return out;
+}
+
+inline Mat4* Mat4Translation(Mat4* out, float x, float y, float z)
+{
+	Mat4Identity(out);
+	out->_41 = x;
+	out->_42 = y;
+	out->_43 = z;
+	return out;
+}
+
+inline Mat4* Mat4Scaling(Mat4* out, float sx, float sy, float sz)
+{
+	Mat4Identity(out);
+	out->_11 = sx;
+	out->_22 = sy;
+	out->_33 = sz;
+	return out;
+}
+
+inline Mat4* Mat4RotationX(Mat4* out, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4Identity(out);
+	out->_22 =  c; out->_23 = s;
+	out->_32 = -s; out->_33 = c;
+	return out;
+}
+
+inline Mat4* Mat4RotationY(Mat4* out, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4Identity(out);
+	out->_11 = c; out->_13 = -s;
+	out->_31 = s; out->_33 =  c;
+	return out;
+}
+
+inline Mat4* Mat4RotationZ(Mat4* out, float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4Identity(out);
+	out->_11 =  c; out->_12 = s;
+	out->_21 = -s; out->_22 = c;
+	return out;
+}
+
+inline Mat4* Mat4RotationQuaternion(Mat4* out, const Quat* q)
+{
+	float xx = q->x*q->x, yy = q->y*q->y, zz = q->z*q->z;
+	float xy = q->x*q->y, xz = q->x*q->z, yz = q->y*q->z;
+	float wx = q->w*q->x, wy = q->w*q->y, wz = q->w*q->z;
+
+	*out = Mat4(1.0f - 2.0f*(yy + zz), 2.0f*(xy + wz),        2.0f*(xz - wy),        0.0f,
+	            2.0f*(xy - wz),        1.0f - 2.0f*(xx + zz), 2.0f*(yz + wx),        0.0f,
+	            2.0f*(xz + wy),        2.0f*(yz - wx),        1.0f - 2.0f*(xx + yy), 0.0f,
+	            0.0f,                  0.0f,                  0.0f,                  1.0f);
+	return out;
+}
+
+inline Quat* QuatRotationAxis(Quat* out, const Vec3* axis, float angle);
+
+inline Mat4* Mat4RotationAxis(Mat4* out, const Vec3* axis, float angle)
+{
+	Quat q;
+	return Mat4RotationQuaternion(out, QuatRotationAxis(&q, axis, angle));
+}
+
+inline Mat4* Mat4LookAtLH(Mat4* out, const Vec3* eye, const Vec3* target, const Vec3* up)
+{
+	Vec3 z = *target - *eye, x, y;
+	Vec3Normalize(&z, &z);
+	Vec3Normalize(&x, Vec3Cross(&x, up, &z));
+	Vec3Cross(&y, &z, &x);
+
+	*out = Mat4(x.x, y.x, z.x, 0.0f,
+	            x.y, y.y, z.y, 0.0f,
+	            x.z, y.z, z.z, 0.0f,
+	            -Vec3Dot(&x, eye), -Vec3Dot(&y, eye), -Vec3Dot(&z, eye), 1.0f);
+	return out;
+}
+
+inline Mat4* Mat4PerspectiveFovLH(Mat4* out, float fovY, float aspect, float zn, float zf)
+{
+	float yScale = 1.0f / tanf(fovY * 0.5f);
+	float xScale = yScale / aspect;
+
+	*out = Mat4(xScale, 0.0f,   0.0f,                  0.0f,
+	            0.0f,   yScale, 0.0f,                  0.0f,
+	            0.0f,   0.0f,   zf/(zf - zn),          1.0f,
+	            0.0f,   0.0f,   -zn*zf/(zf - zn),      0.0f);
+	return out;
+}
+
+//===============================================================
+// Quat.  Multiply follows D3DX: QuatMultiply(out, a, b) rotates by a
+// and then by b.
+
+inline Quat* QuatIdentity(Quat* out)
+{
+	*out = Quat(0.0f, 0.0f, 0.0f, 1.0f);
+	return out;
+}
+
+inline float QuatDot(const Quat* a, const Quat* b)
+{
+	return a->x*b->x + a->y*b->y + a->z*b->z + a->w*b->w;
+}
+
+inline Quat* QuatMultiply(Quat* out, const Quat* a, const Quat* b)
+{
+	Quat r(b->w*a->x + b->x*a->w + b->y*a->z - b->z*a->y,
+	       b->w*a->y - b->x*a->z + b->y*a->w + b->z*a->x,
+	       b->w*a->z + b->x*a->y - b->y*a->x + b->z*a->w,
+	       b->w*a->w - b->x*a->x - b->y*a->y - b->z*a->z);
+	*out = r;
+	return out;
+}
+
+inline Quat* QuatNormalize(Quat* out, const Quat* q)
+{
+	float len = sqrtf(QuatDot(q, q));
+	float s = len > 0.0f ? 1.0f / len : 0.0f;
+	*out = Quat(q->x*s, q->y*s, q->z*s, q->w*s);
+	return out;
+}
+
+inline Quat* QuatConjugate(Quat* out, const Quat* q)
+{
+	*out = Quat(-q->x, -q->y, -q->z, q->w);
+	return out;
+}
+
+inline Quat* QuatRotationAxis(Quat* out, const Vec3* axis, float angle)
+{
+	Vec3 n;
+	Vec3Normalize(&n, axis);
+	float s = sinf(angle * 0.5f);
+	*out = Quat(n.x*s, n.y*s, n.z*s, cosf(angle * 0.5f));
+	return out;
+}
+
+// Rotation part of m, which must be orthonormal.
+inline Quat* QuatRotationMatrix(Quat* out, const Mat4* m)
+{
+	float trace = m->_11 + m->_22 + m->_33;
+	if (trace > 0.0f)
+	{
+		float s = sqrtf(trace + 1.0f) * 2.0f;
+		*out = Quat((m->_23 - m->_32) / s, (m->_31 - m->_13) / s, (m->_12 - m->_21) / s, 0.25f * s);
+	}
+	else if (m->_11 > m->_22 && m->_11 > m->_33)
+	{
+		float s = sqrtf(1.0f + m->_11 - m->_22 - m->_33) * 2.0f;
+		*out = Quat(0.25f * s, (m->_12 + m->_21) / s, (m->_31 + m->_13) / s, (m->_23 - m->_32) / s);
+	}
+	else if (m->_22 > m->_33)
+	{
+		float s = sqrtf(1.0f + m->_22 - m->_11 - m->_33) * 2.0f;
+		*out = Quat((m->_12 + m->_21) / s, 0.25f * s, (m->_23 + m->_32) / s, (m->_31 - m->_13) / s);
+	}
+	else
+	{
+		float s = sqrtf(1.0f + m->_33 - m->_11 - m->_22) * 2.0f;
+		*out = Quat((m->_31 + m->_13) / s, (m->_23 + m->_32) / s, 0.25f * s, (m->_12 - m->_21) / s);
+	}
+	return out;
+}
+
+// Shortest-path spherical interpolation; falls back to a normalized
+// lerp when the rotations are almost equal.
+inline Quat* QuatSlerp(Quat* out, const Quat* a, const Quat* b, float t)
+{
+	float cosTheta = QuatDot(a, b);
+	float sign = 1.0f;
+	if (cosTheta < 0.0f)
+	{
+		cosTheta = -cosTheta;
+		sign = -1.0f;
+	}
+
+	float wa, wb;
+	if (cosTheta < 0.9995f)
+	{
+		float theta = acosf(cosTheta);
+		float invSin = 1.0f / sinf(theta);
+		wa = sinf((1.0f - t) * theta) * invSin;
+		wb = sinf(t * theta) * invSin * sign;
+	}
+	else
+	{
+		wa = 1.0f - t;
+		wb = t * sign;
+	}
+
+	Quat r(wa*a->x + wb*b->x, wa*a->y + wb*b->y, wa*a->z + wb*b->z, wa*a->w + wb*b->w);
+	if (cosTheta >= 0.9995f)
+		QuatNormalize(&r, &r);
+	*out = r;
+	return out;
+}
+
+//===============================================================
+// Plane.
+
+inline float PlaneDotCoord(const Plane* p, const Vec3* v)
+{
+	return p->a*v->x + p->b*v->y + p->c*v->z + p->d;
+}
+
+inline float PlaneDotNormal(const Plane* p, const Vec3* v)
+{
+	return p->a*v->x + p->b*v->y + p->c*v->z;
+}
+
+// Scales the plane so its normal has unit length.
+inline Plane* PlaneNormalize(Plane* out, const Plane* p)
+{
+	float len = sqrtf(p->a*p->a + p->b*p->b + p->c*p->c);
+	float s = len > 0.0f ? 1.0f / len : 0.0f;
+	*out = Plane(p->a*s, p->b*s, p->c*s, p->d*s);
+	return out;
+}
+
+inline Plane* PlaneFromPointNormal(Plane* out, const Vec3* point, const Vec3* normal)
+{
+	*out = Plane(normal->x, normal->y, normal->z, -Vec3Dot(point, normal));
+	return out;
+}
+
+// Plane through three points, normal by the left-handed winding rule
+// D3DX uses: (p1 - p0) x (p2 - p0), normalized.
+inline Plane* PlaneFromPoints(Plane* out, const Vec3* p0, const Vec3* p1, const Vec3* p2)
+{
+	Vec3 e1 = *p1 - *p0, e2 = *p2 - *p0, n;
+	Vec3Normalize(&n, Vec3Cross(&n, &e1, &e2));
+	return PlaneFromPointNormal(out, p0, &n);
+}
+
+// Transforms a plane by m, which must be the inverse transpose of the
+// matrix the points are transformed by (as D3DXPlaneTransform).
+inline Plane* PlaneTransform(Plane* out, const Plane* p, const Mat4* m)
+{
+	SimdStore(&out->a, SimdTransformRow(p->a, p->b, p->c, p->d, m));
+	return out;
+}
+
+//===============================================================
+// Batch operations.  Strides are in bytes, as in D3DX's *Array
+// functions, so positions can be read from and written to interleaved
+// vertex data.
+
+inline Vec3* Vec3TransformCoordArray(Vec3* out, unsigned outStride,
+	const Vec3* in, unsigned inStride, const Mat4* m, unsigned n)
+{
+	SimdF4 r0 = SimdLoad(m->m[0]), r1 = SimdLoad(m->m[1]);
+	SimdF4 r2 = SimdLoad(m->m[2]), r3 = SimdLoad(m->m[3]);
+
+	const char* src = (const char*)in;
+	char* dst = (char*)out;
+	for (unsigned i = 0; i < n; ++i, src += inStride, dst += outStride)
+	{
+		const Vec3* v = (const Vec3*)src;
+		SimdF4 r = SimdMulAdd(SimdSet1(v->x), r0, r3);
+		r = SimdMulAdd(SimdSet1(v->y), r1, r);
+		r = SimdMulAdd(SimdSet1(v->z), r2, r);
+
+		float t[4];
+		SimdStore(t, r);
+		float invW = 1.0f / t[3];
+		*(Vec3*)dst = Vec3(t[0]*invW, t[1]*invW, t[2]*invW);
+	}
+	return out;
+}
+
+inline Vec3* Vec3TransformNormalArray(Vec3* out, unsigned outStride,
+	const Vec3* in, unsigned inStride, const Mat4* m, unsigned n)
+{
+	SimdF4 r0 = SimdLoad(m->m[0]), r1 = SimdLoad(m->m[1]), r2 = SimdLoad(m->m[2]);
+
+	const char* src = (const char*)in;
+	char* dst = (char*)out;
+	for (unsigned i = 0; i < n; ++i, src += inStride, dst += outStride)
+	{
+		const Vec3* v = (const Vec3*)src;
+		SimdF4 r = SimdMul(SimdSet1(v->x), r0);
+		r = SimdMulAdd(SimdSet1(v->y), r1, r);
+		r = SimdMulAdd(SimdSet1(v->z), r2, r);
+
+		float t[4];
+		SimdStore(t, r);
+		*(Vec3*)dst = Vec3(t[0], t[1], t[2]);
+	}
+	return out;
+}
+
+// out[i] = a[i]*b.  out may alias a.
+inline Mat4* Mat4MultiplyArray(Mat4* out, const Mat4* a, const Mat4* b, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		Mat4Multiply(&out[i], &a[i], b);
+	return out;
+}
+
+// Points as separate x, y, z arrays, transformed with the w divide
+// four at a time.  Input and output arrays may be the same.
+inline void Vec3TransformCoordSoA(float* outX, float* outY, float* outZ,
+	const float* x, const float* y, const float* z, const Mat4* m, unsigned n)
+{
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		SimdF4 vx = SimdLoad(x + i), vy = SimdLoad(y + i), vz = SimdLoad(z + i);
+
+		SimdF4 rx = SimdMulAdd(vx, SimdSet1(m->_11), SimdMulAdd(vy, SimdSet1(m->_21), SimdMulAdd(vz, SimdSet1(m->_31), SimdSet1(m->_41))));
+		SimdF4 ry = SimdMulAdd(vx, SimdSet1(m->_12), SimdMulAdd(vy, SimdSet1(m->_22), SimdMulAdd(vz, SimdSet1(m->_32), SimdSet1(m->_42))));
+		SimdF4 rz = SimdMulAdd(vx, SimdSet1(m->_13), SimdMulAdd(vy, SimdSet1(m->_23), SimdMulAdd(vz, SimdSet1(m->_33), SimdSet1(m->_43))));
+		SimdF4 rw = SimdMulAdd(vx, SimdSet1(m->_14), SimdMulAdd(vy, SimdSet1(m->_24), SimdMulAdd(vz, SimdSet1(m->_34), SimdSet1(m->_44))));
+
+		SimdF4 invW = SimdDiv(SimdSet1(1.0f), rw);
+		SimdStore(outX + i, SimdMul(rx, invW));
+		SimdStore(outY + i, SimdMul(ry, invW));
+		SimdStore(outZ + i, SimdMul(rz, invW));
+	}
+
+	for (; i < n; ++i)
+	{
+		Vec3 v(x[i], y[i], z[i]);
+		Vec3TransformCoord(&v, &v, m);
+		outX[i] = v.x;
+		outY[i] = v.y;
+		outZ[i] = v.z;
+	}
+}
+
+// Signed distances of n points (SoA) to a plane.
+inline void PlaneDotCoordSoA(float* out, const Plane* p,
+	const float* x, const float* y, const float* z, unsigned n)
+{
+	unsigned i = 0;
+	SimdF4 a = SimdSet1(p->a), b = SimdSet1(p->b), c = SimdSet1(p->c), d = SimdSet1(p->d);
+	for (; i + 4 <= n; i += 4)
+	{
+		SimdF4 r = SimdMulAdd(SimdLoad(x + i), a, d);
+		r = SimdMulAdd(SimdLoad(y + i), b, r);
+		r = SimdMulAdd(SimdLoad(z + i), c, r);
+		SimdStore(out + i, r);
+	}
+
+	for (; i < n; ++i)
+		out[i] = p->a*x[i] + p->b*y[i] + p->c*z[i] + p->d;
+}
+
+//===============================================================
+// D3DX interop, available when d3dx9math.h is included first.
+
+#if defined(D3DX_PI)
+
+static_assert(sizeof(Vec3)  == sizeof(D3DXVECTOR3),    "Vec3 must match D3DXVECTOR3");
+static_assert(sizeof(Vec4)  == sizeof(D3DXVECTOR4),    "Vec4 must match D3DXVECTOR4");
+static_assert(sizeof(Mat4)  == sizeof(D3DXMATRIX),     "Mat4 must match D3DXMATRIX");
+static_assert(sizeof(Quat)  == sizeof(D3DXQUATERNION), "Quat must match D3DXQUATERNION");
+static_assert(sizeof(Plane) == sizeof(D3DXPLANE),      "Plane must match D3DXPLANE");
+
+inline const D3DXVECTOR3&    AsD3DX(const Vec3& v)  { return reinterpret_cast<const D3DXVECTOR3&>(v); }
+inline const D3DXVECTOR4&    AsD3DX(const Vec4& v)  { return reinterpret_cast<const D3DXVECTOR4&>(v); }
+inline const D3DXMATRIX&     AsD3DX(const Mat4& m)  { return reinterpret_cast<const D3DXMATRIX&>(m); }
+inline const D3DXQUATERNION& AsD3DX(const Quat& q)  { return reinterpret_cast<const D3DXQUATERNION&>(q); }
+inline const D3DXPLANE&      AsD3DX(const Plane& p) { return reinterpret_cast<const D3DXPLANE&>(p); }
+
+inline D3DXVECTOR3&    AsD3DX(Vec3& v)  { return reinterpret_cast<D3DXVECTOR3&>(v); }
+inline D3DXVECTOR4&    AsD3DX(Vec4& v)  { return reinterpret_cast<D3DXVECTOR4&>(v); }
+inline D3DXMATRIX&     AsD3DX(Mat4& m)  { return reinterpret_cast<D3DXMATRIX&>(m); }
+inline D3DXQUATERNION& AsD3DX(Quat& q)  { return reinterpret_cast<D3DXQUATERNION&>(q); }
+inline D3DXPLANE&      AsD3DX(Plane& p) { return reinterpret_cast<D3DXPLANE&>(p); }
+
+inline const Vec3&  FromD3DX(const D3DXVECTOR3& v)    { return reinterpret_cast<const Vec3&>(v); }
+inline const Vec4&  FromD3DX(const D3DXVECTOR4& v)    { return reinterpret_cast<const Vec4&>(v); }
+inline const Mat4&  FromD3DX(const D3DXMATRIX& m)     { return reinterpret_cast<const Mat4&>(m); }
+inline const Quat&  FromD3DX(const D3DXQUATERNION& q) { return reinterpret_cast<const Quat&>(q); }
+inline const Plane& FromD3DX(const D3DXPLANE& p)      { return reinterpret_cast<const Plane&>(p); }
+
+inline Vec3&  FromD3DX(D3DXVECTOR3& v)    { return reinterpret_cast<Vec3&>(v); }
+inline Vec4&  FromD3DX(D3DXVECTOR4& v)    { return reinterpret_cast<Vec4&>(v); }
+inline Mat4&  FromD3DX(D3DXMATRIX& m)     { return reinterpret_cast<Mat4&>(m); }
+inline Quat&  FromD3DX(D3DXQUATERNION& q) { return reinterpret_cast<Quat&>(q); }
+inline Plane& FromD3DX(D3DXPLANE& p)      { return reinterpret_cast<Plane&>(p); }
+
+#endif
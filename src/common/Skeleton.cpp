@@ -0,0 +1,352 @@
+#include "Skeleton.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+	// Working set a run of instances in UpdateSkeletons aims for: half
+	// of a 256 KB L2, leaving room for whatever the caller touches.
+	const int INSTANCE_RUN_BYTES = 128 * 1024;
+
+	// Bytes a bone occupies: three matrices, nine channels, the parent,
+	// the world class and scale, and two dirty flags.
+	const int BYTES_PER_BONE = 3*sizeof(D3DXMATRIX) + 9*sizeof(float) + sizeof(int) + 1 + sizeof(float) + 2;
+}
+
+bool SortBonesTopologically(const int* parents, int numBones, int* order)
+{
+	// Children lists in CSR form, then a breadth-first walk from the
+	// roots.  A bone on a cycle is never reached from a root.
+	std::vector<int> childStart(numBones + 1, 0);
+	for (int i = 0; i < numBones; ++i)
+	{
+		int p = parents[i];
+		if (p < -1 || p >= numBones)
+			return false;
+		if (p >= 0)
+			++childStart[p + 1];
+	}
+	for (int i = 0; i < numBones; ++i)
+		childStart[i + 1] += childStart[i];
+
+	std::vector<int> children(childStart[numBones]);
+	std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+	for (int i = 0; i < numBones; ++i)
+	{
+		if (parents[i] >= 0)
+			children[fill[parents[i]]++] = i;
+	}
+
+	int count = 0;
+	for (int i = 0; i < numBones; ++i)
+	{
+		if (parents[i] < 0)
+			order[count++] = i;
+	}
+	for (int head = 0; head < count; ++head)
+	{
+		int b = order[head];
+		for (int c = childStart[b]; c < childStart[b + 1]; ++c)
+			order[count++] = children[c];
+	}
+
+	return count == numBones;
+}
+
+void SkeletonPose::resize(int n)
+{
+	numBones = n;
+
+	int padded = (n + 3) & ~3;
+	posX.resize(padded);
+	posY.resize(padded);
+	posZ.resize(padded);
+	rotX.resize(padded);
+	rotY.resize(padded);
+	rotZ.resize(padded);
+	rotW.resize(padded, 1.0f);
+}
+
+Skeleton::Skeleton()
+	: mRootClass(AFFINE_RIGID), mRootScale(1.0f),
+	  mFirstDirty(0), mRootDirty(true), mNumLocalUpdates(0), mNumWorldUpdates(0)
+{
+	D3DXMatrixIdentity(&mRootXForm);
+}
+
+Skeleton::Skeleton(const int* parents, int numBones)
+	: mRootClass(AFFINE_RIGID), mRootScale(1.0f),
+	  mFirstDirty(0), mRootDirty(true), mNumLocalUpdates(0), mNumWorldUpdates(0)
+{
+	D3DXMatrixIdentity(&mRootXForm);
+
+	for (int i = 0; i < numBones; ++i)
+		addBone(parents[i], D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+}
+
+int Skeleton::addBone(int parent, const D3DXVECTOR3& pos, const D3DXQUATERNION& rot, float scale)
+{
+	int bone = numBones();
+	assert(parent >= -1 && parent < bone);
+
+	mParents.push_back(parent);
+
+	mPosX.push_back(pos.x);
+	mPosY.push_back(pos.y);
+	mPosZ.push_back(pos.z);
+	mRotX.push_back(rot.x);
+	mRotY.push_back(rot.y);
+	mRotZ.push_back(rot.z);
+	mRotW.push_back(rot.w);
+	mScale.push_back(scale);
+
+	D3DXMATRIX I;
+	D3DXMatrixIdentity(&I);
+	mToParent.push_back(I);
+	mToWorld.push_back(I);
+	mToWorldInvTrans.push_back(I);
+	mWorldClass.push_back(AFFINE_RIGID);
+	mWorldScale.push_back(1.0f);
+
+	mLocalDirty.push_back(0);
+	mWorldDirty.push_back(0);
+	markDirty(bone);
+
+	return bone;
+}
+
+void Skeleton::setLocal(int bone, const D3DXVECTOR3& pos, const D3DXQUATERNION& rot, float scale)
+{
+	setPosition(bone, pos);
+	setRotation(bone, rot);
+	setScale(bone, scale);
+}
+
+void Skeleton::setPosition(int bone, const D3DXVECTOR3& pos)
+{
+	mPosX[bone] = pos.x;
+	mPosY[bone] = pos.y;
+	mPosZ[bone] = pos.z;
+	markDirty(bone);
+}
+
+void Skeleton::setRotation(int bone, const D3DXQUATERNION& rot)
+{
+	mRotX[bone] = rot.x;
+	mRotY[bone] = rot.y;
+	mRotZ[bone] = rot.z;
+	mRotW[bone] = rot.w;
+	markDirty(bone);
+}
+
+void Skeleton::setScale(int bone, float scale)
+{
+	mScale[bone] = scale;
+	markDirty(bone);
+}
+
+void Skeleton::setPose(const SkeletonPose& pose)
+{
+	assert(pose.numBones == numBones());
+
+	for (int i = 0; i < numBones(); ++i)
+	{
+		if (mPosX[i] == pose.posX[i] && mPosY[i] == pose.posY[i] && mPosZ[i] == pose.posZ[i] &&
+			mRotX[i] == pose.rotX[i] && mRotY[i] == pose.rotY[i] &&
+			mRotZ[i] == pose.rotZ[i] && mRotW[i] == pose.rotW[i])
+			continue;
+
+		mPosX[i] = pose.posX[i];
+		mPosY[i] = pose.posY[i];
+		mPosZ[i] = pose.posZ[i];
+		mRotX[i] = pose.rotX[i];
+		mRotY[i] = pose.rotY[i];
+		mRotZ[i] = pose.rotZ[i];
+		mRotW[i] = pose.rotW[i];
+		markDirty(i);
+	}
+}
+
+void Skeleton::setRootTransform(const D3DXMATRIX& M)
+{
+	mRootXForm = M;
+	mRootClass = ClassifyAffine(M, &mRootScale);
+	mRootDirty = true;
+}
+
+void Skeleton::markDirty(int bone)
+{
+	mLocalDirty[bone] = 1;
+	if (bone < mFirstDirty)
+		mFirstDirty = bone;
+}
+
+D3DXVECTOR3 Skeleton::getPosition(int bone)const
+{
+	return D3DXVECTOR3(mPosX[bone], mPosY[bone], mPosZ[bone]);
+}
+
+D3DXQUATERNION Skeleton::getRotation(int bone)const
+{
+	return D3DXQUATERNION(mRotX[bone], mRotY[bone], mRotZ[bone], mRotW[bone]);
+}
+
+void Skeleton::update()
+{
+	int n = numBones();
+	int start = mRootDirty ? 0 : mFirstDirty;
+
+	mNumLocalUpdates = 0;
+	mNumWorldUpdates = 0;
+
+	// To-parent matrices, in blocks of four so the SIMD path is used;
+	// the clean bones of a block are rebuilt unchanged.
+	for (int b = mFirstDirty & ~3; b < n; b += 4)
+	{
+		int end = std::min(b + 4, n);
+		int dirty = 0;
+		for (int i = b; i < end; ++i)
+			dirty += mLocalDirty[i];
+
+		if (dirty)
+		{
+			buildToParent(b, end);
+			mNumLocalUpdates += dirty;
+		}
+	}
+
+	// A bone's world matrix is stale if its own local transform changed
+	// or its parent's world matrix did.  Parents come first, so their
+	// world transforms are always ready.
+	const Mat4& root = FromD3DX(mRootXForm);
+	for (int i = start; i < n; ++i)
+	{
+		int p = mParents[i];
+		mWorldDirty[i] = mLocalDirty[i] | (p < 0 ? mRootDirty : mWorldDirty[p]);
+		if (!mWorldDirty[i])
+			continue;
+
+		const Mat4& parentToWorld = p < 0 ? root : FromD3DX(mToWorld[p]);
+		Mat4Multiply(&FromD3DX(mToWorld[i]), &FromD3DX(mToParent[i]), &parentToWorld);
+
+		// The local part is rigid, or uniformly scaled by |s| (a negative
+		// s adds a reflection), or singular when s is zero.
+		float s = fabsf(mScale[i]);
+		int localClass = s == 1.0f ? AFFINE_RIGID : (s > 0.0f ? AFFINE_UNIFORM_SCALE : AFFINE_GENERAL);
+		int parentClass = p < 0 ? mRootClass : mWorldClass[p];
+
+		mWorldClass[i] = (unsigned char)std::max(localClass, parentClass);
+		mWorldScale[i] = s * (p < 0 ? mRootScale : mWorldScale[p]);
+
+		NormalMatrix(&mToWorldInvTrans[i], mToWorld[i], (AffineClass)mWorldClass[i], mWorldScale[i]);
+
+		++mNumWorldUpdates;
+	}
+
+	for (int i = start; i < n; ++i)
+	{
+		mLocalDirty[i] = 0;
+		mWorldDirty[i] = 0;
+	}
+	mFirstDirty = n;
+	mRootDirty  = false;
+}
+
+void Skeleton::updateAll()
+{
+	for (int i = 0; i < numBones(); ++i)
+		mLocalDirty[i] = 1;
+	mFirstDirty = 0;
+	mRootDirty  = true;
+
+	update();
+}
+
+void Skeleton::buildToParent(int begin, int end)
+{
+	// Same matrix as D3DXMatrixScaling * D3DXMatrixRotationQuaternion *
+	// D3DXMatrixTranslation, with the rotation rows scaled by s.
+	int i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		SimdF4 x = SimdLoad(&mRotX[i]), y = SimdLoad(&mRotY[i]);
+		SimdF4 z = SimdLoad(&mRotZ[i]), w = SimdLoad(&mRotW[i]);
+		SimdF4 s  = SimdLoad(&mScale[i]);
+		SimdF4 s2 = SimdAdd(s, s);
+
+		SimdF4 xx = SimdMul(x, x), yy = SimdMul(y, y), zz = SimdMul(z, z);
+		SimdF4 xy = SimdMul(x, y), xz = SimdMul(x, z), yz = SimdMul(y, z);
+		SimdF4 wx = SimdMul(w, x), wy = SimdMul(w, y), wz = SimdMul(w, z);
+
+		// The nine rotation entries, four lanes each.
+		float r[9][4];
+		SimdStore(r[0], SimdSub(s, SimdMul(s2, SimdAdd(yy, zz))));
+		SimdStore(r[1], SimdMul(s2, SimdAdd(xy, wz)));
+		SimdStore(r[2], SimdMul(s2, SimdSub(xz, wy)));
+		SimdStore(r[3], SimdMul(s2, SimdSub(xy, wz)));
+		SimdStore(r[4], SimdSub(s, SimdMul(s2, SimdAdd(xx, zz))));
+		SimdStore(r[5], SimdMul(s2, SimdAdd(yz, wx)));
+		SimdStore(r[6], SimdMul(s2, SimdAdd(xz, wy)));
+		SimdStore(r[7], SimdMul(s2, SimdSub(yz, wx)));
+		SimdStore(r[8], SimdSub(s, SimdMul(s2, SimdAdd(xx, yy))));
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			int b = i + lane;
+			D3DXMATRIX& M = mToParent[b];
+			M._11 = r[0][lane]; M._12 = r[1][lane]; M._13 = r[2][lane]; M._14 = 0.0f;
+			M._21 = r[3][lane]; M._22 = r[4][lane]; M._23 = r[5][lane]; M._24 = 0.0f;
+			M._31 = r[6][lane]; M._32 = r[7][lane]; M._33 = r[8][lane]; M._34 = 0.0f;
+			M._41 = mPosX[b];   M._42 = mPosY[b];   M._43 = mPosZ[b];   M._44 = 1.0f;
+		}
+	}
+
+	for (; i < end; ++i)
+	{
+		Quat q(mRotX[i], mRotY[i], mRotZ[i], mRotW[i]);
+		Mat4& M = FromD3DX(mToParent[i]);
+		Mat4RotationQuaternion(&M, &q);
+
+		float s = mScale[i];
+		for (int r = 0; r < 3; ++r)
+		{
+			M.m[r][0] *= s;
+			M.m[r][1] *= s;
+			M.m[r][2] *= s;
+		}
+		M._41 = mPosX[i];
+		M._42 = mPosY[i];
+		M._43 = mPosZ[i];
+	}
+}
+
+void UpdateSkeletons(Skeleton* skeletons, int count, ThreadPool* pool)
+{
+	if (count <= 0)
+		return;
+
+	if (!pool)
+	{
+		for (int i = 0; i < count; ++i)
+			skeletons[i].update();
+		return;
+	}
+
+	long long totalBones = 0;
+	for (int i = 0; i < count; ++i)
+		totalBones += skeletons[i].numBones();
+	long long bytesPerInstance = std::max(1LL, totalBones * BYTES_PER_BONE / count);
+
+	// Runs that fit the cache, but at least four per thread so stealing
+	// has something to balance.
+	int grain = (int)std::max(1LL, INSTANCE_RUN_BYTES / bytesPerInstance);
+	int maxGrain = (count + 4*pool->numThreads() - 1) / (4*pool->numThreads());
+	grain = std::max(1, std::min(grain, maxGrain));
+
+	pool->parallelFor(count, grain, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			skeletons[i].update();
+	});
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Transform.h"
+
+class ThreadPool;
+
+//===============================================================
+// Bone hierarchy with linear-time world transform evaluation.
+//
+// Bones are stored in topological order: every bone's parent has a
+// smaller index than the bone itself, and roots have parent -1.  Any
+// tree (or forest) can be put in that order with SortBonesTopologically.
+// Because of the ordering, update() computes every world transform in
+// one forward pass,
+//
+//     toWorld[i] = toParent[i] * toWorld[parent[i]],
+//
+// so each bone costs one matrix multiply whatever the depth of the
+// tree, instead of one per ancestor.
+//
+// The local (to-parent) transform of a bone is scale, then rotation,
+// then translation, with a uniform scale.  The three parts are kept as
+// structure-of-arrays so animation code can write whole channels at
+// once, and the to-parent matrices are built four bones at a time.
+// Roots are placed in the world by the root transform, which is
+// appended after their own to-parent transform.
+//
+// Updates are incremental.  Every setter marks its bone dirty, and
+// update() rebuilds the to-parent matrix of each dirty bone and the
+// to-world matrix of each bone in a dirty subtree, leaving the rest
+// alone; a pose where one joint moved costs only that joint's
+// descendants.  The inverse transposes of the world matrices, which
+// lighting needs for normals, are cached next to them and refreshed
+// with them.  Local transforms are rigid or uniformly scaled, so every
+// world matrix is too unless the root transform is general, and the
+// inverse transpose is then a rescale rather than an inverse (see
+// Transform.h).
+
+// Writes into order a permutation of [0, numBones) that lists every
+// parent before its children (a stable breadth-first order: roots, then
+// their children, ...).  parents[i] is the parent of bone i or -1.
+// Returns false if the parents contain a cycle or an out-of-range index.
+bool SortBonesTopologically(const int* parents, int numBones, int* order);
+
+// Local positions and rotations of every bone of a skeleton, one array
+// per channel, as animation sampling produces them.  The arrays are
+// padded to a multiple of four bones so samplers can store whole SIMD
+// groups; the padding is ignored.
+struct SkeletonPose
+{
+	SkeletonPose() : numBones(0) {}
+
+	void resize(int n);
+
+	int numBones;
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW;
+};
+
+class Skeleton
+{
+public:
+	Skeleton();
+
+	// parents[i] < i for every bone (or -1 for a root).  Every bone starts
+	// with the identity local transform.
+	Skeleton(const int* parents, int numBones);
+
+	// Appends a bone under parent (-1 for a new root) and returns its
+	// index.
+	int addBone(int parent, const D3DXVECTOR3& pos,
+		const D3DXQUATERNION& rot = D3DXQUATERNION(0.0f, 0.0f, 0.0f, 1.0f), float scale = 1.0f);
+
+	int numBones()const         { return (int)mParents.size(); }
+	int getParent(int bone)const { return mParents[bone]; }
+	const int* getParents()const { return numBones() ? &mParents[0] : 0; }
+
+	// Local transform, relative to the parent (or the root transform).
+	void setLocal(int bone, const D3DXVECTOR3& pos, const D3DXQUATERNION& rot, float scale = 1.0f);
+	void setPosition(int bone, const D3DXVECTOR3& pos);
+	void setRotation(int bone, const D3DXQUATERNION& rot);
+	void setScale(int bone, float scale);
+
+	// Positions and rotations of every bone at once; pose.numBones must
+	// equal numBones().  Only bones whose channels actually change are
+	// marked dirty, so a clip holding most joints still is cheap.
+	void setPose(const SkeletonPose& pose);
+
+	D3DXVECTOR3    getPosition(int bone)const;
+	D3DXQUATERNION getRotation(int bone)const;
+	float          getScale(int bone)const { return mScale[bone]; }
+
+	void setRootTransform(const D3DXMATRIX& M);
+	const D3DXMATRIX& getRootTransform()const  { return mRootXForm; }
+
+	// Brings every matrix up to date with the local transforms set since
+	// the last update.
+	void update();
+
+	// Rebuilds every matrix whether dirty or not.
+	void updateAll();
+
+	// Results of the last update().
+	const D3DXMATRIX& getToParent(int bone)const        { return mToParent[bone]; }
+	const D3DXMATRIX& getToWorld(int bone)const         { return mToWorld[bone]; }
+	const D3DXMATRIX& getToWorldInvTrans(int bone)const { return mToWorldInvTrans[bone]; }
+	const D3DXMATRIX* getToWorldArray()const            { return numBones() ? &mToWorld[0] : 0; }
+
+	// Bones the last update() found with a dirty local transform, and
+	// bones whose to-world matrix (and inverse transpose) it rebuilt.
+	int getNumLocalUpdates()const { return mNumLocalUpdates; }
+	int getNumWorldUpdates()const { return mNumWorldUpdates; }
+
+private:
+	void markDirty(int bone);
+	void buildToParent(int begin, int end);
+
+private:
+	std::vector<int> mParents;
+
+	// Local transforms, one array per channel.
+	std::vector<float> mPosX, mPosY, mPosZ;
+	std::vector<float> mRotX, mRotY, mRotZ, mRotW;
+	std::vector<float> mScale;
+
+	D3DXMATRIX  mRootXForm;
+	AffineClass mRootClass;
+	float       mRootScale;
+
+	std::vector<D3DXMATRIX> mToParent;
+	std::vector<D3DXMATRIX> mToWorld;
+	std::vector<D3DXMATRIX> mToWorldInvTrans;
+
+	// Affine class and uniform scale of each to-world matrix.
+	std::vector<unsigned char> mWorldClass;
+	std::vector<float>         mWorldScale;
+
+	// Bones whose local transform changed, and scratch marks for the
+	// world pass.  Nothing before mFirstDirty is dirty, and since
+	// parents come first nothing before it can be in a dirty subtree.
+	std::vector<unsigned char> mLocalDirty;
+	std::vector<unsigned char> mWorldDirty;
+	int  mFirstDirty;
+	bool mRootDirty;
+
+	int mNumLocalUpdates;
+	int mNumWorldUpdates;
+};
+
+// Updates count independent skeletons, such as many instances of one
+// rig, splitting them across pool's threads.  Each thread takes runs of
+// whole instances sized so a run's matrices and channels stay in a
+// typical L2 cache, and instances never share data, so the results are
+// the same as updating them one after another.
+void UpdateSkeletons(Skeleton* skeletons, int count, ThreadPool* pool = 0);
@@ -0,0 +1,177 @@
+#include "SkinnedMesh.h"
+#include "Skeleton.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <assert.h>
+
+void BuildSkinPalette(const Skeleton& skeleton, const D3DXMATRIX* offsets, D3DXMATRIX* palette)
+{
+	for (int i = 0; i < skeleton.numBones(); ++i)
+		Mat4Multiply(&FromD3DX(palette[i]), &FromD3DX(offsets[i]), &FromD3DX(skeleton.getToWorld(i)));
+}
+
+SkinnedMesh::SkinnedMesh(ThreadPool* pool)
+	: mPool(pool), mNumVertices(0), mNumBones(0)
+{
+}
+
+void SkinnedMesh::setVertices(int numVertices, const void* verts, UINT stride,
+	const WORD* boneIndices, const float* weights, int influencesPerVertex)
+{
+	mNumVertices = numVertices;
+	mNumBones = 0;
+
+	int padded = (numVertices + 3) & ~3;
+	mBindPosX.assign(padded, 0.0f);
+	mBindPosY.assign(padded, 0.0f);
+	mBindPosZ.assign(padded, 0.0f);
+	mBindNormalX.assign(padded, 0.0f);
+	mBindNormalY.assign(padded, 0.0f);
+	mBindNormalZ.assign(padded, 0.0f);
+	for (int k = 0; k < SKIN_MAX_INFLUENCES; ++k)
+	{
+		mBones[k].assign(padded, 0);
+		mWeights[k].assign(padded, 0.0f);
+	}
+	mGroupInfluences.assign(padded / 4, 0);
+
+	mPosX.resize(padded);
+	mPosY.resize(padded);
+	mPosZ.resize(padded);
+	mNormalX.resize(padded);
+	mNormalY.resize(padded);
+	mNormalZ.resize(padded);
+
+	const BYTE* src = (const BYTE*)verts;
+	std::vector<std::pair<float, WORD> > influences(std::max(influencesPerVertex, 1));
+	for (int v = 0; v < numVertices; ++v, src += stride)
+	{
+		const D3DXVECTOR3* pos = (const D3DXVECTOR3*)src;
+		mBindPosX[v] = pos[0].x;
+		mBindPosY[v] = pos[0].y;
+		mBindPosZ[v] = pos[0].z;
+		mBindNormalX[v] = pos[1].x;
+		mBindNormalY[v] = pos[1].y;
+		mBindNormalZ[v] = pos[1].z;
+
+		// The largest weights first.
+		int count = 0;
+		for (int k = 0; k < influencesPerVertex; ++k)
+		{
+			float w = weights[v*influencesPerVertex + k];
+			if (w > 0.0f)
+				influences[count++] = std::make_pair(w, boneIndices[v*influencesPerVertex + k]);
+		}
+		std::sort(influences.begin(), influences.begin() + count,
+			[](const std::pair<float, WORD>& a, const std::pair<float, WORD>& b) { return a.first > b.first; });
+		count = std::min(count, SKIN_MAX_INFLUENCES);
+
+		// A vertex no bone moves follows bone 0.
+		if (count == 0)
+			influences[count++] = std::make_pair(1.0f, (WORD)0);
+
+		float sum = 0.0f;
+		for (int k = 0; k < count; ++k)
+			sum += influences[k].first;
+
+		for (int k = 0; k < count; ++k)
+		{
+			mWeights[k][v] = influences[k].first / sum;
+			mBones[k][v]   = influences[k].second;
+			mNumBones = std::max(mNumBones, influences[k].second + 1);
+		}
+
+		unsigned char& groupCount = mGroupInfluences[v / 4];
+		groupCount = (unsigned char)std::max((int)groupCount, count);
+	}
+}
+
+void SkinnedMesh::skin(const D3DXMATRIX* palette)
+{
+	int padded = (mNumVertices + 3) & ~3;
+	if (mPool)
+	{
+		mPool->parallelFor(padded / 4, ITEMS_PER_CHUNK / 4, [&](int groupBegin, int groupEnd) {
+			skinVertices(4*groupBegin, 4*groupEnd, palette);
+		});
+	}
+	else
+		skinVertices(0, padded, palette);
+}
+
+void SkinnedMesh::skinVertices(int begin, int end, const D3DXMATRIX* palette)
+{
+	const Mat4* bones = &FromD3DX(palette[0]);
+	SimdF4 zero = SimdSet1(0.0f);
+
+	for (int v = begin; v < end; v += 4)
+	{
+		// Blend the top three columns of each lane's palette matrices;
+		// m[3*r + c] holds entry (r, c) for the four vertices.
+		SimdF4 m[12];
+		for (int i = 0; i < 12; ++i)
+			m[i] = zero;
+
+		int count = mGroupInfluences[v / 4];
+		for (int k = 0; k < count; ++k)
+		{
+			const WORD* b = &mBones[k][v];
+			const Mat4& m0 = bones[b[0]];
+			const Mat4& m1 = bones[b[1]];
+			const Mat4& m2 = bones[b[2]];
+			const Mat4& m3 = bones[b[3]];
+			SimdF4 w = SimdLoad(&mWeights[k][v]);
+
+			for (int r = 0; r < 4; ++r)
+			{
+				SimdF4 c0 = SimdLoad(m0.m[r]);
+				SimdF4 c1 = SimdLoad(m1.m[r]);
+				SimdF4 c2 = SimdLoad(m2.m[r]);
+				SimdF4 c3 = SimdLoad(m3.m[r]);
+				SimdTranspose4(c0, c1, c2, c3);
+
+				m[3*r + 0] = SimdMulAdd(c0, w, m[3*r + 0]);
+				m[3*r + 1] = SimdMulAdd(c1, w, m[3*r + 1]);
+				m[3*r + 2] = SimdMulAdd(c2, w, m[3*r + 2]);
+			}
+		}
+
+		// p*M as a point, n*M as a direction.
+		SimdF4 x = SimdLoad(&mBindPosX[v]);
+		SimdF4 y = SimdLoad(&mBindPosY[v]);
+		SimdF4 z = SimdLoad(&mBindPosZ[v]);
+		SimdStore(&mPosX[v], SimdMulAdd(x, m[0], SimdMulAdd(y, m[3], SimdMulAdd(z, m[6], m[9]))));
+		SimdStore(&mPosY[v], SimdMulAdd(x, m[1], SimdMulAdd(y, m[4], SimdMulAdd(z, m[7], m[10]))));
+		SimdStore(&mPosZ[v], SimdMulAdd(x, m[2], SimdMulAdd(y, m[5], SimdMulAdd(z, m[8], m[11]))));
+
+		SimdF4 nx = SimdLoad(&mBindNormalX[v]);
+		SimdF4 ny = SimdLoad(&mBindNormalY[v]);
+		SimdF4 nz = SimdLoad(&mBindNormalZ[v]);
+		SimdF4 n[3];
+		for (int c = 0; c < 3; ++c)
+			n[c] = SimdMulAdd(nx, m[c], SimdMulAdd(ny, m[3 + c], SimdMul(nz, m[6 + c])));
+
+		// The padding lanes have zero normals; keep them finite.
+		SimdF4 len2 = SimdMulAdd(n[0], n[0], SimdMulAdd(n[1], n[1], SimdMul(n[2], n[2])));
+		SimdF4 invLen = SimdDiv(SimdSet1(1.0f), SimdSqrt(SimdMax(len2, SimdSet1(1.0e-30f))));
+		SimdStore(&mNormalX[v], SimdMul(n[0], invLen));
+		SimdStore(&mNormalY[v], SimdMul(n[1], invLen));
+		SimdStore(&mNormalZ[v], SimdMul(n[2], invLen));
+	}
+}
+
+void SkinnedMesh::writeVertices(void* verts, UINT stride)const
+{
+	BYTE* dst = (BYTE*)verts;
+	for (int v = 0; v < mNumVertices; ++v, dst += stride)
+	{
+		D3DXVECTOR3* pos = (D3DXVECTOR3*)dst;
+		pos[0].x = mPosX[v];
+		pos[0].y = mPosY[v];
+		pos[0].z = mPosZ[v];
+		pos[1].x = mNormalX[v];
+		pos[1].y = mNormalY[v];
+		pos[1].z = mNormalZ[v];
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class ThreadPool;
+class Skeleton;
+
+//===============================================================
+// Linear blend skinning on the CPU.
+//
+// Each vertex is bound to up to SKIN_MAX_INFLUENCES bones with weights
+// summing to one, and is skinned by the weighted sum of its bones'
+// palette matrices,
+//
+//     M = sum_k w[k] * palette[bone[k]],   p' = p*M,   n' = normalize(n*M),
+//
+// where palette[i] takes bind-pose (mesh) space to world space through
+// bone i: the bone's offset matrix (the inverse of its bind-pose world
+// transform) times its current world transform.  The normal uses the
+// 3x3 part of M itself, which is exact for the rigid and uniformly
+// scaled bones a Skeleton produces once the result is renormalized.
+//
+// This is the path for machines without a GPU, and for gameplay code
+// that needs skinned positions.  Vertices are kept as structure-of-
+// arrays and skinned four at a time with SIMD: the four palette rows
+// each influence needs are loaded one vertex per register and
+// transposed, so the blend and transform run one component per
+// register.  A group of four only loops over as many influences as its
+// busiest vertex has.  With a ThreadPool the vertices are split into
+// blocks across threads.
+
+const int SKIN_MAX_INFLUENCES = 4;
+
+// palette[i] = offsets[i] * skeleton.getToWorld(i) for every bone.
+void BuildSkinPalette(const Skeleton& skeleton, const D3DXMATRIX* offsets, D3DXMATRIX* palette);
+
+class SkinnedMesh
+{
+public:
+	explicit SkinnedMesh(ThreadPool* pool = 0);
+
+	// Bind-pose vertices from any vertex format that starts with a
+	// position followed by a normal (VertexPN, VertexPNT; stride in
+	// bytes), and influencesPerVertex bone indices and weights per
+	// vertex.  A vertex keeps its SKIN_MAX_INFLUENCES largest weights,
+	// rescaled to sum to one.
+	void setVertices(int numVertices, const void* verts, UINT stride,
+		const WORD* boneIndices, const float* weights, int influencesPerVertex);
+
+	int getNumVertices()const { return mNumVertices; }
+
+	// Palette entries skin() reads: one past the largest bone index.
+	int getNumBones()const    { return mNumBones; }
+
+	// Skins every vertex with palette, which holds getNumBones()
+	// matrices.
+	void skin(const D3DXMATRIX* palette);
+
+	// Results of the last skin(), one array per component.
+	const float* getPositionX()const { return &mPosX[0]; }
+	const float* getPositionY()const { return &mPosY[0]; }
+	const float* getPositionZ()const { return &mPosZ[0]; }
+	const float* getNormalX()const   { return &mNormalX[0]; }
+	const float* getNormalY()const   { return &mNormalY[0]; }
+	const float* getNormalZ()const   { return &mNormalZ[0]; }
+
+	// Writes the skinned positions and normals into a vertex format laid
+	// out as for setVertices; anything after the normal is left alone.
+	void writeVertices(void* verts, UINT stride)const;
+
+private:
+	// Vertices [begin, end), both multiples of four.
+	void skinVertices(int begin, int end, const D3DXMATRIX* palette);
+
+private:
+	ThreadPool* mPool;
+	int mNumVertices;
+	int mNumBones;
+
+	// Bind pose, padded to a multiple of four vertices.
+	std::vector<float> mBindPosX, mBindPosY, mBindPosZ;
+	std::vector<float> mBindNormalX, mBindNormalY, mBindNormalZ;
+
+	// Influence k of vertex v is mBones[k][v] with weight mWeights[k][v];
+	// unused slots have weight zero.
+	std::vector<WORD>  mBones[SKIN_MAX_INFLUENCES];
+	std::vector<float> mWeights[SKIN_MAX_INFLUENCES];
+
+	// Influences used by each group of four vertices.
+	std::vector<unsigned char> mGroupInfluences;
+
+	std::vector<float> mPosX, mPosY, mPosZ;
+	std::vector<float> mNormalX, mNormalY, mNormalZ;
+};
@@ -0,0 +1,379 @@
+#include "Terrain.h"
+#include "Vertex.h"
+#include "Normals.h"
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	// Emits a triangle given in (row, col) patch coordinates, flipping it
+	// if needed so it winds the same way as GenTriGrid's triangles.
+	void EmitTri(std::vector<WORD>& out, int stride,
+		int r0, int c0, int r1, int c1, int r2, int c2)
+	{
+		int cross = (c1 - c0)*(r2 - r0) - (r1 - r0)*(c2 - c0);
+		if (cross == 0)
+			return;
+
+		if (cross < 0)
+		{
+			int tr = r1, tc = c1;
+			r1 = r2; c1 = c2;
+			r2 = tr; c2 = tc;
+		}
+
+		out.push_back((WORD)(r0*stride + c0));
+		out.push_back((WORD)(r1*stride + c1));
+		out.push_back((WORD)(r2*stride + c2));
+	}
+
+	// Height the LOD with the given cell step would show at (r, c), using
+	// the same diagonal split as GenTriGrid.
+	float InterpolatedHeight(const float* h, int pitch, int r, int c, int step)
+	{
+		int r0 = (r / step) * step;
+		int c0 = (c / step) * step;
+
+		float v = (float)(r - r0) / step;
+		float u = (float)(c - c0) / step;
+
+		// Only step past the cell when (r, c) is actually inside it, so
+		// samples on the patch's last row/column stay in range.
+		int r1 = r > r0 ? r0 + step : r0;
+		int c1 = c > c0 ? c0 + step : c0;
+
+		float h00 = h[r0*pitch + c0];
+		float h01 = h[r0*pitch + c1];
+		float h10 = h[r1*pitch + c0];
+
+		if (u + v <= 1.0f)
+			return h00 + u*(h01 - h00) + v*(h10 - h00);
+
+		float h11 = h[r1*pitch + c1];
+		return h11 + (1.0f - u)*(h10 - h11) + (1.0f - v)*(h01 - h11);
+	}
+}
+
+Terrain::Terrain(int numVertRows, int numVertCols, float dx, float dz, const float* heights,
+	const D3DXVECTOR3& center, int patchCells, float texScale, ThreadPool* pool)
+	: mVB(0), mIB(0), mMaxPixelError(2.0f), mNumTrisSubmitted(0)
+{
+	// Patch vertices are addressed with 16-bit indices, so the largest
+	// power-of-two patch is 128 cells.
+	mPatchCells = 1;
+	while (mPatchCells*2 <= patchCells && mPatchCells < 128)
+		mPatchCells *= 2;
+
+	mPatchRows = (numVertRows - 1) / mPatchCells;
+	mPatchCols = (numVertCols - 1) / mPatchCells;
+
+	mNumLODs = 1;
+	while ((1 << (mNumLODs - 1)) < mPatchCells)
+		++mNumLODs;
+
+	mVertsPerPatch  = (DWORD)(mPatchCells + 1) * (mPatchCells + 1);
+	mNumVertices    = mVertsPerPatch * mPatchRows * mPatchCols;
+	mNumFullResTris = (DWORD)mPatchRows * mPatchCols * mPatchCells * mPatchCells * 2;
+
+	mPatches.resize(mPatchRows * mPatchCols);
+
+	buildVertices(numVertRows, numVertCols, dx, dz, heights, center, texScale, pool);
+	buildIndices();
+	computeLODErrors(heights, numVertCols);
+}
+
+Terrain::~Terrain()
+{
+	SafeRelease(mVB);
+	SafeRelease(mIB);
+}
+
+void Terrain::buildVertices(int numVertRows, int numVertCols, float dx, float dz,
+	const float* heights, const D3DXVECTOR3& center, float texScale, ThreadPool* pool)
+{
+	if (mNumVertices == 0)
+		return;
+
+	std::vector<D3DXVECTOR3> normals(numVertRows * numVertCols);
+	ComputeHeightGridNormals(heights, numVertRows, numVertCols, dx, dz,
+		&normals[0], sizeof(D3DXVECTOR3), NORMALS_ANGLE_WEIGHTED, pool);
+
+	HR(gd3dDevice->CreateVertexBuffer(mNumVertices * sizeof(VertexPNT),
+		D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &mVB, 0));
+
+	VertexPNT* v = 0;
+	HR(mVB->Lock(0, 0, (void**)&v, 0));
+
+	float width = (float)(numVertCols-1) * dx;
+	float depth = (float)(numVertRows-1) * dz;
+	float xOffset = -width * 0.5f + center.x;
+	float zOffset =  depth * 0.5f + center.z;
+
+	DWORD k = 0;
+	for (int pr = 0; pr < mPatchRows; ++pr)
+	{
+		for (int pc = 0; pc < mPatchCols; ++pc)
+		{
+			Patch& patch = patchAt(pr, pc);
+			patch.baseVertex = k;
+
+			for (int i = 0; i <= mPatchCells; ++i)
+			{
+				for (int j = 0; j <= mPatchCells; ++j)
+				{
+					int r = pr*mPatchCells + i;
+					int c = pc*mPatchCells + j;
+
+					v[k].pos    = D3DXVECTOR3(c*dx + xOffset, heights[r*numVertCols + c] + center.y, -r*dz + zOffset);
+					v[k].normal = normals[r*numVertCols + c];
+					v[k].tex0   = D3DXVECTOR2((float)c, (float)r) * texScale;
+
+					D3DXVec3Minimize(&patch.bounds.minPt, &patch.bounds.minPt, &v[k].pos);
+					D3DXVec3Maximize(&patch.bounds.maxPt, &patch.bounds.maxPt, &v[k].pos);
+					++k;
+				}
+			}
+		}
+	}
+
+	HR(mVB->Unlock());
+}
+
+void Terrain::genPatchIndices(int step, int stitchMask, std::vector<WORD>& out)
+{
+	int P = mPatchCells;
+	int stride = P + 1;
+	int n = P / step;
+
+	// Coarsest LOD: the whole patch is one cell, and no neighbour can be
+	// coarser than it.
+	if (n == 1)
+	{
+		EmitTri(out, stride, 0, 0, 0, P, P, 0);
+		EmitTri(out, stride, P, 0, 0, P, P, P);
+		return;
+	}
+
+	// Interior cells, same pattern as GenTriGrid.
+	for (int i = 1; i < n-1; ++i)
+	{
+		for (int j = 1; j < n-1; ++j)
+		{
+			int r = i*step, c = j*step;
+			EmitTri(out, stride, r, c, r, c+step, r+step, c);
+			EmitTri(out, stride, r+step, c, r, c+step, r+step, c+step);
+		}
+	}
+
+	// The border ring is four trapezoids, each zipping the outer edge
+	// (every step, or every 2*step when stitched to a coarser neighbour)
+	// to the inner line one step in.  Adjacent trapezoids share the
+	// corner-to-inner-corner diagonal, so the ring has no gaps.
+	for (int edge = 0; edge < 4; ++edge)
+	{
+		int bit = 1 << edge;
+		int outerStep = (stitchMask & bit) ? 2*step : step;
+
+		std::vector<int> outerT, innerT;
+		for (int t = 0; t <= P; t += outerStep)  outerT.push_back(t);
+		for (int t = step; t <= P-step; t += step) innerT.push_back(t);
+
+		// Maps a position t along the edge to (row, col) on the outer
+		// edge line (depth 0) or the inner line (depth step).
+		auto rc = [&](int t, int d, int& r, int& c)
+		{
+			switch (bit)
+			{
+			case STITCH_TOP:    r = d;     c = t;     break;
+			case STITCH_BOTTOM: r = P - d; c = t;     break;
+			case STITCH_LEFT:   r = t;     c = d;     break;
+			default:            r = t;     c = P - d; break;
+			}
+		};
+
+		size_t i = 0, j = 0;
+		while (i + 1 < outerT.size() || j + 1 < innerT.size())
+		{
+			bool advanceOuter;
+			if (i + 1 >= outerT.size())      advanceOuter = false;
+			else if (j + 1 >= innerT.size()) advanceOuter = true;
+			else                             advanceOuter = outerT[i+1] <= innerT[j+1];
+
+			int r0, c0, r1, c1, r2, c2;
+			rc(outerT[i], 0, r0, c0);
+			rc(innerT[j], step, r1, c1);
+			if (advanceOuter)
+			{
+				rc(outerT[i+1], 0, r2, c2);
+				++i;
+			}
+			else
+			{
+				rc(innerT[j+1], step, r2, c2);
+				++j;
+			}
+			EmitTri(out, stride, r0, c0, r1, c1, r2, c2);
+		}
+	}
+}
+
+void Terrain::buildIndices()
+{
+	std::vector<WORD> indices;
+	mIndexRanges.resize(mNumLODs * NUM_STITCH_MASKS);
+
+	for (int lod = 0; lod < mNumLODs; ++lod)
+	{
+		for (int mask = 0; mask < NUM_STITCH_MASKS; ++mask)
+		{
+			IndexRange& range = mIndexRanges[lod*NUM_STITCH_MASKS + mask];
+			range.startIndex = (DWORD)indices.size();
+			genPatchIndices(1 << lod, mask, indices);
+			range.numTriangles = ((DWORD)indices.size() - range.startIndex) / 3;
+		}
+	}
+
+	HR(gd3dDevice->CreateIndexBuffer((UINT)indices.size()*sizeof(WORD), D3DUSAGE_WRITEONLY,
+		D3DFMT_INDEX16, D3DPOOL_MANAGED, &mIB, 0));
+
+	WORD* k = 0;
+	HR(mIB->Lock(0, 0, (void**)&k, 0));
+	memcpy(k, &indices[0], indices.size()*sizeof(WORD));
+	HR(mIB->Unlock());
+}
+
+void Terrain::computeLODErrors(const float* heights, int numVertCols)
+{
+	for (int pr = 0; pr < mPatchRows; ++pr)
+	{
+		for (int pc = 0; pc < mPatchCols; ++pc)
+		{
+			Patch& patch = patchAt(pr, pc);
+			patch.lodError.assign(mNumLODs, 0.0f);
+			patch.lod = 0;
+			patch.visible = true;
+
+			const float* h = heights + (pr*mPatchCells)*numVertCols + pc*mPatchCells;
+
+			for (int lod = 1; lod < mNumLODs; ++lod)
+			{
+				int step = 1 << lod;
+				float err = patch.lodError[lod-1];
+				for (int i = 0; i <= mPatchCells; ++i)
+				{
+					for (int j = 0; j <= mPatchCells; ++j)
+					{
+						float e = fabsf(h[i*numVertCols + j] - InterpolatedHeight(h, numVertCols, i, j, step));
+						if (e > err)
+							err = e;
+					}
+				}
+				patch.lodError[lod] = err;
+			}
+		}
+	}
+}
+
+void Terrain::update(const D3DXVECTOR3& eyePosW, const D3DXMATRIX& viewProj,
+	float fovY, float viewportHeight)
+{
+	D3DXPLANE frustum[6];
+	ExtractFrustumPlanes(viewProj, frustum);
+
+	// A world-space error e at distance d covers e*K/d pixels.
+	float K = viewportHeight / (2.0f * tanf(0.5f * fovY));
+
+	for (size_t p = 0; p < mPatches.size(); ++p)
+	{
+		Patch& patch = mPatches[p];
+		patch.visible = AABBInFrustum(patch.bounds, frustum);
+
+		// Distance from the eye to the nearest point of the patch box.
+		D3DXVECTOR3 q = eyePosW;
+		D3DXVec3Maximize(&q, &q, &patch.bounds.minPt);
+		D3DXVec3Minimize(&q, &q, &patch.bounds.maxPt);
+		D3DXVECTOR3 toEye = eyePosW - q;
+		float d = D3DXVec3Length(&toEye);
+		if (d < MY_EPSILON)
+			d = MY_EPSILON;
+
+		int lod = 0;
+		while (lod + 1 < mNumLODs && patch.lodError[lod+1] * K / d <= mMaxPixelError)
+			++lod;
+		patch.lod = lod;
+	}
+
+	// Stitching only handles neighbours one LOD apart, so refine any patch
+	// that is coarser than that until the whole terrain is consistent.
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int pr = 0; pr < mPatchRows; ++pr)
+		{
+			for (int pc = 0; pc < mPatchCols; ++pc)
+			{
+				int& lod = patchAt(pr, pc).lod;
+				int minNeighbor = lod;
+				if (pr > 0)            minNeighbor = std::min(minNeighbor, patchAt(pr-1, pc).lod);
+				if (pr < mPatchRows-1) minNeighbor = std::min(minNeighbor, patchAt(pr+1, pc).lod);
+				if (pc > 0)            minNeighbor = std::min(minNeighbor, patchAt(pr, pc-1).lod);
+				if (pc < mPatchCols-1) minNeighbor = std::min(minNeighbor, patchAt(pr, pc+1).lod);
+
+				if (lod > minNeighbor + 1)
+				{
+					lod = minNeighbor + 1;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	mNumTrisSubmitted = 0;
+	for (int pr = 0; pr < mPatchRows; ++pr)
+	{
+		for (int pc = 0; pc < mPatchCols; ++pc)
+		{
+			const Patch& patch = patchAt(pr, pc);
+			if (patch.visible)
+				mNumTrisSubmitted += mIndexRanges[patch.lod*NUM_STITCH_MASKS + stitchMask(pr, pc)].numTriangles;
+		}
+	}
+}
+
+int Terrain::stitchMask(int pr, int pc)
+{
+	int lod = patchAt(pr, pc).lod;
+
+	int mask = 0;
+	if (pr > 0            && patchAt(pr-1, pc).lod > lod) mask |= STITCH_TOP;
+	if (pr < mPatchRows-1 && patchAt(pr+1, pc).lod > lod) mask |= STITCH_BOTTOM;
+	if (pc > 0            && patchAt(pr, pc-1).lod > lod) mask |= STITCH_LEFT;
+	if (pc < mPatchCols-1 && patchAt(pr, pc+1).lod > lod) mask |= STITCH_RIGHT;
+
+	return mask;
+}
+
+void Terrain::draw()
+{
+	if (mNumVertices == 0)
+		return;
+
+	HR(gd3dDevice->SetVertexDeclaration(VertexPNT::Decl));
+	HR(gd3dDevice->SetStreamSource(0, mVB, 0, sizeof(VertexPNT)));
+	HR(gd3dDevice->SetIndices(mIB));
+
+	for (int pr = 0; pr < mPatchRows; ++pr)
+	{
+		for (int pc = 0; pc < mPatchCols; ++pc)
+		{
+			Patch& patch = patchAt(pr, pc);
+			if (!patch.visible)
+				continue;
+
+			const IndexRange& range = mIndexRanges[patch.lod*NUM_STITCH_MASKS + stitchMask(pr, pc)];
+			HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, patch.baseVertex, 0,
+				mVertsPerPatch, range.startIndex, range.numTriangles));
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class ThreadPool;
+
+//===============================================================
+// Geomipmapped terrain.
+//
+// The heightfield is cut into square patches of patchCells x patchCells
+// cells (a power of two, at most 128).  Each patch keeps its own block
+// of VertexPNT vertices at full resolution, and every patch shares one
+// set of index lists: for each LOD (cell step 1, 2, 4, ... patchCells)
+// there are 16 variants, one per combination of edges that must be
+// stitched to a neighbour one LOD coarser.  LODs are picked per patch so
+// that the patch's geometric error projects to at most maxPixelError
+// pixels, neighbours are kept within one LOD of each other so the
+// stitched variants close every crack, and patches outside the view
+// frustum are skipped.
+//
+// heights holds numVertRows*numVertCols samples in GenTriGrid order
+// (row 0 at +z, column 0 at -x).  numVertRows-1 and numVertCols-1
+// should be multiples of patchCells; leftover cells are dropped.
+// Vertex normals are angle weighted (see Normals.h), computed on pool's
+// threads if one is given.
+
+class Terrain
+{
+public:
+	Terrain(int numVertRows, int numVertCols, float dx, float dz, const float* heights,
+		const D3DXVECTOR3& center, int patchCells = 32, float texScale = 0.2f, ThreadPool* pool = 0);
+	~Terrain();
+
+	// Picks each patch's LOD and visibility for this frame.  fovY is the
+	// vertical field of view in radians and viewportHeight is in pixels.
+	void update(const D3DXVECTOR3& eyePosW, const D3DXMATRIX& viewProj,
+		float fovY, float viewportHeight);
+
+	// Draws every visible patch.  Call inside an effect pass; sets the
+	// vertex declaration, stream source and indices itself.
+	void draw();
+
+	void  setMaxPixelError(float pixels) { mMaxPixelError = pixels; }
+	float getMaxPixelError()const        { return mMaxPixelError;   }
+
+	int   getNumPatches()const { return (int)mPatches.size(); }
+	int   getNumLODs()const    { return mNumLODs; }
+
+	DWORD getNumVertices()const            { return mNumVertices; }
+	DWORD getNumTrianglesSubmitted()const  { return mNumTrisSubmitted; }
+	DWORD getNumFullResTriangles()const    { return mNumFullResTris; }
+
+private:
+	Terrain(const Terrain& rhs);
+	Terrain& operator=(const Terrain& rhs);
+
+	enum
+	{
+		STITCH_TOP    = 1,   // Row 0 edge (+z side).
+		STITCH_BOTTOM = 2,   // Last row edge (-z side).
+		STITCH_LEFT   = 4,   // Column 0 edge (-x side).
+		STITCH_RIGHT  = 8,   // Last column edge (+x side).
+		NUM_STITCH_MASKS = 16
+	};
+
+	struct Patch
+	{
+		DWORD baseVertex;
+		AABB  bounds;
+		std::vector<float> lodError;  // Max height error at each LOD, monotonic.
+		int   lod;
+		bool  visible;
+	};
+
+	struct IndexRange
+	{
+		DWORD startIndex;
+		DWORD numTriangles;
+	};
+
+	void buildVertices(int numVertRows, int numVertCols, float dx, float dz,
+		const float* heights, const D3DXVECTOR3& center, float texScale, ThreadPool* pool);
+	void buildIndices();
+	void computeLODErrors(const float* heights, int numVertCols);
+
+	void genPatchIndices(int step, int stitchMask, std::vector<WORD>& out);
+
+	// Edges of patch (pr, pc) whose neighbour is one LOD coarser.
+	int stitchMask(int pr, int pc);
+
+	Patch& patchAt(int row, int col) { return mPatches[row*mPatchCols + col]; }
+
+private:
+	int mPatchCells;
+	int mPatchRows;
+	int mPatchCols;
+	int mNumLODs;
+	DWORD mVertsPerPatch;
+
+	std::vector<Patch>      mPatches;
+	std::vector<IndexRange> mIndexRanges;  // [lod*NUM_STITCH_MASKS + stitchMask]
+
+	IDirect3DVertexBuffer9* mVB;
+	IDirect3DIndexBuffer9*  mIB;
+
+	float mMaxPixelError;
+
+	DWORD mNumVertices;
+	DWORD mNumTrisSubmitted;
+	DWORD mNumFullResTris;
+};
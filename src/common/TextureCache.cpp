@@ -0,0 +1,251 @@
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include <cwctype>
+#include <set>
+
+TextureCache* gTextureCache = 0;
+
+namespace
+{
+	// Lower case, forward slashes, and "." and ".." segments resolved
+	// lexically; ".." segments with nothing left to cancel are kept.
+	std::wstring NormalizePath(const std::wstring& filename)
+	{
+		std::wstring prefix;
+		size_t i = 0;
+		while (i < filename.size() && (filename[i] == L'/' || filename[i] == L'\\'))
+		{
+			prefix += L'/';
+			++i;
+		}
+
+		std::vector<std::wstring> segments;
+		while (i <= filename.size())
+		{
+			size_t end = filename.find_first_of(L"/\\", i);
+			if (end == std::wstring::npos)
+				end = filename.size();
+
+			std::wstring segment = filename.substr(i, end - i);
+			for (size_t c = 0; c < segment.size(); ++c)
+				segment[c] = (wchar_t)std::towlower(segment[c]);
+
+			if (segment == L"..")
+			{
+				if (!segments.empty() && segments.back() != L"..")
+					segments.pop_back();
+				else
+					segments.push_back(segment);
+			}
+			else if (!segment.empty() && segment != L".")
+				segments.push_back(segment);
+
+			i = end + 1;
+		}
+
+		std::wstring path = prefix;
+		for (size_t s = 0; s < segments.size(); ++s)
+		{
+			if (s != 0)
+				path += L'/';
+			path += segments[s];
+		}
+		return path;
+	}
+
+	unsigned __int64 SurfaceBytes(D3DFORMAT format, UINT width, UINT height)
+	{
+		unsigned __int64 blocks = (unsigned __int64)((width + 3) / 4) * ((height + 3) / 4);
+		unsigned __int64 pixels = (unsigned __int64)width * height;
+
+		switch (format)
+		{
+		case D3DFMT_DXT1:
+			return blocks * 8;
+		case D3DFMT_DXT2:
+		case D3DFMT_DXT3:
+		case D3DFMT_DXT4:
+		case D3DFMT_DXT5:
+			return blocks * 16;
+		case D3DFMT_L8:
+		case D3DFMT_A8:
+		case D3DFMT_P8:
+			return pixels;
+		case D3DFMT_R5G6B5:
+		case D3DFMT_X1R5G5B5:
+		case D3DFMT_A1R5G5B5:
+		case D3DFMT_A4R4G4B4:
+		case D3DFMT_A8L8:
+		case D3DFMT_L16:
+		case D3DFMT_R16F:
+			return pixels * 2;
+		case D3DFMT_R8G8B8:
+			return pixels * 3;
+		case D3DFMT_A16B16G16R16:
+		case D3DFMT_A16B16G16R16F:
+		case D3DFMT_G32R32F:
+			return pixels * 8;
+		case D3DFMT_A32B32G32R32F:
+			return pixels * 16;
+		default:
+			return pixels * 4;
+		}
+	}
+
+	unsigned __int64 TextureBytes(IDirect3DTexture9* tex)
+	{
+		unsigned __int64 bytes = 0;
+		for (DWORD i = 0; i < tex->GetLevelCount(); ++i)
+		{
+			D3DSURFACE_DESC desc;
+			HR(tex->GetLevelDesc(i, &desc));
+			bytes += SurfaceBytes(desc.Format, desc.Width, desc.Height);
+		}
+		return bytes;
+	}
+}
+
+TextureCache::TextureCache()
+{
+	ZeroMemory(&mStats, sizeof(mStats));
+}
+
+TextureCache::~TextureCache()
+{
+	for (auto it = mByContent.begin(); it != mByContent.end(); ++it)
+	{
+		SafeRelease(it->second->texture);
+		delete it->second;
+	}
+}
+
+HRESULT TextureCache::acquire(const std::wstring& filename, IDirect3DTexture9** tex)
+{
+	auto it = mByPath.find(NormalizePath(filename));
+	if (it != mByPath.end())
+	{
+		++mStats.pathHits;
+		*tex = hit(it->second);
+		return D3D_OK;
+	}
+
+	// Let D3DX fail on files we cannot open, the way it always has.
+	MappedFile file;
+	if (!file.open(filename))
+		return D3DXCreateTextureFromFile(gd3dDevice, filename.c_str(), tex);
+
+	unsigned __int64 hash = HashBytes(file.getData(), file.getSize());
+	*tex = find(filename, hash, file.getSize());
+	if (*tex)
+		return D3D_OK;
+
+	HRESULT hr = D3DXCreateTextureFromFileInMemory(gd3dDevice, file.getData(), (UINT)file.getSize(), tex);
+	if (SUCCEEDED(hr))
+		add(filename, hash, file.getSize(), *tex);
+	return hr;
+}
+
+IDirect3DTexture9* TextureCache::find(const std::wstring& filename, unsigned __int64 hash, unsigned __int64 size)
+{
+	std::wstring path = NormalizePath(filename);
+	auto p = mByPath.find(path);
+	if (p != mByPath.end())
+	{
+		++mStats.pathHits;
+		return hit(p->second);
+	}
+
+	auto c = mByContent.find(ContentKey(hash, size));
+	if (c != mByContent.end())
+	{
+		// Remember the new name, so asking for it again reads nothing.
+		mByPath[path] = c->second;
+		++mStats.contentHits;
+		return hit(c->second);
+	}
+	return 0;
+}
+
+void TextureCache::add(const std::wstring& filename, unsigned __int64 hash, unsigned __int64 size, IDirect3DTexture9* tex)
+{
+	Entry* entry   = new Entry;
+	entry->texture = tex;
+	entry->hash    = hash;
+	entry->size    = size;
+	entry->bytes   = TextureBytes(tex);
+	tex->AddRef();
+
+	// A texture already cached under this path or these contents (the
+	// caller raced another load of the same file) is replaced for new
+	// requests; whoever holds it keeps it.
+	Entry*& byContent = mByContent[ContentKey(hash, size)];
+	if (byContent != 0)
+	{
+		Entry* old = byContent;
+		for (auto it = mByPath.begin(); it != mByPath.end(); ++it)
+		{
+			if (it->second == old)
+				it->second = entry;
+		}
+		--mStats.numTextures;
+		mStats.bytesCached -= old->bytes;
+		SafeRelease(old->texture);
+		delete old;
+	}
+	byContent = entry;
+	mByPath[NormalizePath(filename)] = entry;
+
+	++mStats.misses;
+	++mStats.numTextures;
+	mStats.bytesCached += entry->bytes;
+}
+
+void TextureCache::purgeUnused()
+{
+	// AddRef returns the new count: 2 means only the cache and this call
+	// hold the texture.
+	std::set<Entry*> unused;
+	for (auto it = mByContent.begin(); it != mByContent.end(); )
+	{
+		Entry* entry = it->second;
+		ULONG refs = entry->texture->AddRef();
+		entry->texture->Release();
+		if (refs == 2)
+		{
+			unused.insert(entry);
+			it = mByContent.erase(it);
+		}
+		else
+			++it;
+	}
+
+	for (auto it = mByPath.begin(); it != mByPath.end(); )
+	{
+		if (unused.count(it->second) != 0)
+			it = mByPath.erase(it);
+		else
+			++it;
+	}
+
+	for (auto it = unused.begin(); it != unused.end(); ++it)
+	{
+		--mStats.numTextures;
+		mStats.bytesCached -= (*it)->bytes;
+		SafeRelease((*it)->texture);
+		delete *it;
+	}
+}
+
+IDirect3DTexture9* TextureCache::hit(Entry* entry)
+{
+	mStats.bytesSaved += entry->bytes;
+	entry->texture->AddRef();
+	return entry->texture;
+}
+
+HRESULT LoadTextureCached(const std::wstring& filename, IDirect3DTexture9** tex)
+{
+	if (gTextureCache)
+		return gTextureCache->acquire(filename, tex);
+	return D3DXCreateTextureFromFile(gd3dDevice, filename.c_str(), tex);
+}
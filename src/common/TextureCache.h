@@ -0,0 +1,85 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <map>
+
+//===============================================================
+// Shared textures.
+//
+// Materials and meshes often name the same image: several subsets of
+// one .x file, or copies of whitetex.dds and brick2.dds sitting beside
+// every demo that uses them.  The cache loads each image once and hands
+// out references to the one texture.
+//
+// A request is looked up by its normalized path first (case, slash
+// direction and "." / ".." segments do not matter), which costs no file
+// access.  On a miss the file is read and looked up by the 64-bit hash
+// and size of its contents, so a copy under another name shares the
+// texture too; only when that misses as well is the image decoded and a
+// texture created, exactly as D3DXCreateTextureFromFile would.
+//
+// Textures come back with a reference added, so callers release them
+// with SafeRelease as before.  The cache keeps a reference of its own
+// to everything it has loaded until purgeUnused() or its destructor.
+// Render thread only.
+
+struct TextureCacheStats
+{
+	DWORD pathHits;      // Same path as a cached texture: nothing read.
+	DWORD contentHits;   // New path, same contents: read and hashed, not decoded.
+	DWORD misses;        // Decoded and created.
+	DWORD numTextures;   // Textures held now.
+	unsigned __int64 bytesCached;  // Texture memory of those.
+	unsigned __int64 bytesSaved;   // Texture memory the hits would have duplicated.
+};
+
+class TextureCache
+{
+public:
+	TextureCache();
+	~TextureCache();
+
+	// Returns a new reference to the texture for filename, loading it if
+	// no cached texture has the same path or contents.
+	HRESULT acquire(const std::wstring& filename, IDirect3DTexture9** tex);
+
+	// For callers that read the file themselves (AssetLoader reads on its
+	// workers): returns a new reference to a cached texture with this
+	// path or these contents, or null; add() caches a texture created
+	// from them after a miss.
+	IDirect3DTexture9* find(const std::wstring& filename, unsigned __int64 hash, unsigned __int64 size);
+	void add(const std::wstring& filename, unsigned __int64 hash, unsigned __int64 size, IDirect3DTexture9* tex);
+
+	// Drops the textures nobody else holds a reference to any more.
+	void purgeUnused();
+
+	const TextureCacheStats& getStats()const { return mStats; }
+
+private:
+	TextureCache(const TextureCache& rhs);
+	TextureCache& operator=(const TextureCache& rhs);
+
+	struct Entry
+	{
+		IDirect3DTexture9* texture;
+		unsigned __int64   hash;
+		unsigned __int64   size;
+		unsigned __int64   bytes;
+	};
+	typedef std::pair<unsigned __int64, unsigned __int64> ContentKey;
+
+	IDirect3DTexture9* hit(Entry* entry);
+
+private:
+	std::map<std::wstring, Entry*> mByPath;     // Several paths may share an entry.
+	std::map<ContentKey, Entry*>   mByContent;
+	TextureCacheStats mStats;
+};
+
+// The application's cache: created by D3DApp with the device and
+// destroyed just before it.  Null in tools that make their own device.
+extern TextureCache* gTextureCache;
+
+// Loads filename through gTextureCache, or straight through D3DX when
+// there is no cache.
+HRESULT LoadTextureCached(const std::wstring& filename, IDirect3DTexture9** tex);
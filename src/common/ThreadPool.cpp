@@ -0,0 +1,161 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int numWorkers)
+	: mFunc(0), mCount(0), mGrain(1), mBusyWorkers(0),
+	mGeneration(0), mQuit(false)
+{
+	if (numWorkers < 0)
+	{
+		int hw = (int)std::thread::hardware_concurrency();
+		numWorkers = hw > 1 ? hw - 1 : 0;
+	}
+
+	mRanges.reset(new ChunkRange[numWorkers + 1]);
+	for (int i = 0; i <= numWorkers; ++i)
+		mRanges[i].range.store(0);
+
+	for (int i = 0; i < numWorkers; ++i)
+		mWorkers.push_back(std::thread(&ThreadPool::workerMain, this, i + 1));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeCV.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+}
+
+int ThreadPool::numThreads()const
+{
+	return (int)mWorkers.size() + 1;
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& func)
+{
+	if (count <= 0)
+		return;
+
+	if (grain < 1)
+		grain = 1;
+
+	// Not worth waking anyone up for a single chunk.
+	if (mWorkers.empty() || count <= grain)
+	{
+		func(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFunc  = &func;
+		mCount = count;
+		mGrain = grain;
+
+		// An even share of consecutive chunks for every thread.
+		unsigned long long numChunks = (count + grain - 1) / grain;
+		unsigned long long numThreads = mWorkers.size() + 1;
+		for (unsigned long long t = 0; t < numThreads; ++t)
+		{
+			unsigned long long begin = numChunks * t / numThreads;
+			unsigned long long end   = numChunks * (t + 1) / numThreads;
+			mRanges[t].range.store(end << 32 | begin);
+		}
+
+		mBusyWorkers = (int)mWorkers.size();
+		++mGeneration;
+	}
+	mWakeCV.notify_all();
+
+	runChunks(0);
+
+	// Wait for every worker to check out of this job before func goes
+	// out of scope.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDoneCV.wait(lock, [this] { return mBusyWorkers == 0; });
+	mFunc = 0;
+}
+
+void ThreadPool::runChunks(int thread)
+{
+	std::atomic<unsigned long long>& own = mRanges[thread].range;
+	do
+	{
+		for (;;)
+		{
+			// Take the front chunk of our own run.
+			unsigned long long r = own.load();
+			unsigned next = (unsigned)r, end = (unsigned)(r >> 32);
+			if (next >= end)
+				break;
+			if (!own.compare_exchange_weak(r, (unsigned long long)end << 32 | (next + 1)))
+				continue;
+
+			int begin = (int)next * mGrain;
+			int last  = begin + mGrain < mCount ? begin + mGrain : mCount;
+			(*mFunc)(begin, last);
+		}
+	} while (stealChunks(thread));
+}
+
+bool ThreadPool::stealChunks(int thread)
+{
+	int numThreads = (int)mWorkers.size() + 1;
+	for (;;)
+	{
+		// The victim with the most chunks left.
+		int victim = -1;
+		unsigned most = 0;
+		unsigned long long victimRange = 0;
+		for (int t = 0; t < numThreads; ++t)
+		{
+			unsigned long long r = mRanges[t].range.load();
+			unsigned next = (unsigned)r, end = (unsigned)(r >> 32);
+			if (t != thread && end > next && end - next > most)
+			{
+				victim = t;
+				most = end - next;
+				victimRange = r;
+			}
+		}
+		if (victim < 0)
+			return false;
+
+		// Take the back half (rounded up, so a last chunk can be stolen)
+		// and make it our own run.  On a lost race, look again.
+		unsigned next = (unsigned)victimRange, end = (unsigned)(victimRange >> 32);
+		unsigned split = end - (most + 1) / 2;
+		if (mRanges[victim].range.compare_exchange_strong(victimRange, (unsigned long long)split << 32 | next))
+		{
+			mRanges[thread].range.store((unsigned long long)end << 32 | split);
+			return true;
+		}
+	}
+}
+
+void ThreadPool::workerMain(int thread)
+{
+	unsigned seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCV.wait(lock, [&] { return mQuit || mGeneration != seenGeneration; });
+			if (mQuit)
+				return;
+			seenGeneration = mGeneration;
+		}
+
+		runChunks(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mBusyWorkers;
+		}
+		mDoneCV.notify_one();
+	}
+}
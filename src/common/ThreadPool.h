@@ -0,0 +1,77 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//===============================================================
+// A small fixed-size pool of worker threads used to split CPU-side
+// geometry work (grid generation, etc.) across cores.  The calling
+// thread always takes part in the work, so a pool created with zero
+// workers simply runs everything serially on the caller.
+//
+// Scheduling is work stealing: the chunks of a parallelFor are dealt
+// out as one contiguous run per thread, so each thread walks its own
+// stretch of memory, and a thread that finishes its run steals the back
+// half of the largest run still left.
+
+// Roughly how many items (vertices, cells, samples) callers put in one
+// parallelFor chunk, so that handing chunks out stays negligible next
+// to the work in them.
+const int ITEMS_PER_CHUNK = 16384;
+
+class ThreadPool
+{
+public:
+	// numWorkers < 0 means "one worker per hardware thread, minus the caller".
+	explicit ThreadPool(int numWorkers = -1);
+	~ThreadPool();
+
+	// Total number of threads that take part in a parallelFor
+	// (workers + the calling thread).
+	int numThreads()const;
+
+	// Calls func(begin, end) over [0, count) in chunks of at most grain
+	// items and blocks until every chunk has finished.  Not reentrant:
+	// func must not call parallelFor on the same pool.
+	void parallelFor(int count, int grain, const std::function<void(int, int)>& func);
+
+private:
+	ThreadPool(const ThreadPool& rhs);
+	ThreadPool& operator=(const ThreadPool& rhs);
+
+	void workerMain(int thread);
+	void runChunks(int thread);
+	bool stealChunks(int thread);
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	std::mutex              mMutex;
+	std::condition_variable mWakeCV;
+	std::condition_variable mDoneCV;
+
+	// Chunks [next, end) still owned by one thread, packed as
+	// end << 32 | next so the owner taking from the front and a thief
+	// taking from the back agree through a single compare-and-swap.
+	// Padded to a cache line each.
+	struct ChunkRange
+	{
+		std::atomic<unsigned long long> range;
+		char pad[64 - sizeof(std::atomic<unsigned long long>)];
+	};
+
+	// Current job.  mGeneration is bumped for every parallelFor so the
+	// workers can tell a new job from a spurious wake-up.
+	const std::function<void(int, int)>* mFunc;
+	int  mCount;
+	int  mGrain;
+	std::unique_ptr<ChunkRange[]> mRanges;  // One per thread; 0 is the caller.
+	int  mBusyWorkers;
+	unsigned mGeneration;
+	bool mQuit;
+};
@@ -0,0 +1,113 @@
+#include "Transform.h"
+#include "SimdMath.h"
+
+AffineClass ClassifyAffine(const D3DXMATRIX& M, float* scale, float tolerance)
+{
+	if (scale)
+		*scale = 1.0f;
+
+	// Must be affine: last column (0, 0, 0, 1).
+	if (fabsf(M._14) > tolerance || fabsf(M._24) > tolerance ||
+		fabsf(M._34) > tolerance || fabsf(M._44 - 1.0f) > tolerance)
+		return AFFINE_GENERAL;
+
+	const Vec3& r0 = *(const Vec3*)&M._11;
+	const Vec3& r1 = *(const Vec3*)&M._21;
+	const Vec3& r2 = *(const Vec3*)&M._31;
+
+	// Rows of equal length and mutually perpendicular.
+	float l0 = Vec3Dot(&r0, &r0);
+	float l1 = Vec3Dot(&r1, &r1);
+	float l2 = Vec3Dot(&r2, &r2);
+	float s2 = (l0 + l1 + l2) / 3.0f;
+	if (s2 <= 0.0f)
+		return AFFINE_GENERAL;
+
+	float tol = tolerance * s2;
+	if (fabsf(l0 - s2) > tol || fabsf(l1 - s2) > tol || fabsf(l2 - s2) > tol ||
+		fabsf(Vec3Dot(&r0, &r1)) > tol || fabsf(Vec3Dot(&r0, &r2)) > tol ||
+		fabsf(Vec3Dot(&r1, &r2)) > tol)
+		return AFFINE_GENERAL;
+
+	float s = sqrtf(s2);
+	if (fabsf(s - 1.0f) <= tolerance)
+		return AFFINE_RIGID;
+
+	if (scale)
+		*scale = s;
+	return AFFINE_UNIFORM_SCALE;
+}
+
+void NormalMatrix(D3DXMATRIX* out, const D3DXMATRIX& M, AffineClass affineClass, float scale)
+{
+	Mat4& N = FromD3DX(*out);
+	const Mat4& A = FromD3DX(M);
+
+	if (affineClass != AFFINE_GENERAL)
+	{
+		// M = [sQ 0; t 1] has inverse [Q^T/s 0; -t*Q^T/s 1], so the inverse
+		// transpose is [sQ/s^2 -(sQ*t)/s^2; 0 1].
+		float invS2 = affineClass == AFFINE_RIGID ? 1.0f : 1.0f / (scale * scale);
+		const Vec3& t = *(const Vec3*)&A._41;
+
+		float c0 = -Vec3Dot((const Vec3*)&A._11, &t) * invS2;
+		float c1 = -Vec3Dot((const Vec3*)&A._21, &t) * invS2;
+		float c2 = -Vec3Dot((const Vec3*)&A._31, &t) * invS2;
+
+		SimdF4 k = SimdSet1(invS2);
+		SimdStore(N.m[0], SimdMul(SimdLoad(A.m[0]), k));
+		SimdStore(N.m[1], SimdMul(SimdLoad(A.m[1]), k));
+		SimdStore(N.m[2], SimdMul(SimdLoad(A.m[2]), k));
+		N._14 = c0;
+		N._24 = c1;
+		N._34 = c2;
+		N._41 = 0.0f; N._42 = 0.0f; N._43 = 0.0f; N._44 = 1.0f;
+		return;
+	}
+
+	Mat4 inv;
+	if (Mat4Inverse(&inv, 0, &A))
+	{
+		Mat4Transpose(&N, &inv);
+		return;
+	}
+
+	// Singular: the cofactor matrix of the 3x3 part, which is det times
+	// the inverse transpose when that exists.
+	N = Mat4(A._22*A._33 - A._23*A._32, A._23*A._31 - A._21*A._33, A._21*A._32 - A._22*A._31, 0.0f,
+	         A._13*A._32 - A._12*A._33, A._11*A._33 - A._13*A._31, A._12*A._31 - A._11*A._32, 0.0f,
+	         A._12*A._23 - A._13*A._22, A._13*A._21 - A._11*A._23, A._11*A._22 - A._12*A._21, 0.0f,
+	         0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Transform::Transform()
+	: mClass(AFFINE_RIGID), mScale(1.0f)
+{
+	D3DXMatrixIdentity(&mMatrix);
+}
+
+Transform::Transform(const D3DXMATRIX& M)
+	: mMatrix(M)
+{
+	mClass = ClassifyAffine(M, &mScale);
+}
+
+Transform::Transform(const D3DXMATRIX& M, AffineClass affineClass, float scale)
+	: mMatrix(M), mClass(affineClass), mScale(affineClass == AFFINE_RIGID ? 1.0f : scale)
+{
+}
+
+Transform Transform::operator*(const Transform& rhs)const
+{
+	Transform r;
+	Mat4Multiply(&FromD3DX(r.mMatrix), &FromD3DX(mMatrix), &FromD3DX(rhs.mMatrix));
+	r.mClass = mClass > rhs.mClass ? mClass : rhs.mClass;
+	r.mScale = mScale * rhs.mScale;
+	return r;
+}
+
+void ComputeNormalMatrices(const Transform* transforms, int count, D3DXMATRIX* normalMatrices)
+{
+	for (int i = 0; i < count; ++i)
+		transforms[i].getNormalMatrix(&normalMatrices[i]);
+}
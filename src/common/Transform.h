@@ -0,0 +1,66 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+//===============================================================
+// World transforms that remember what kind of matrix they hold.
+//
+// Lighting needs the inverse transpose of the world matrix for
+// normals.  Most world matrices are rotations (or reflections) and
+// translations, perhaps with a uniform scale, and for those the
+// inverse transpose is just the matrix itself, divided by scale^2 in
+// the scaled case; only a general matrix needs a real inverse.  A
+// Transform carries its affine class along with the matrix, so the
+// normal matrix costs a handful of multiplies instead of a 4x4 inverse.
+//
+// The class is either stated by the code that builds the matrix (a
+// translation is rigid by construction) or found by ClassifyAffine.
+// Composition keeps track of it: rigid * rigid is rigid, anything with
+// a uniform scale is uniform-scale, and anything else is general.
+
+enum AffineClass
+{
+	AFFINE_RIGID,          // Orthonormal 3x3 part (rotation or reflection) plus translation.
+	AFFINE_UNIFORM_SCALE,  // Rigid with every axis scaled by the same factor.
+	AFFINE_GENERAL         // Anything else, including projections.
+};
+
+// Class of M, and in scale the uniform scale factor (1 for rigid
+// matrices).  Entries may be off by tolerance relative to the scale.
+AffineClass ClassifyAffine(const D3DXMATRIX& M, float* scale = 0, float tolerance = 1.0e-4f);
+
+// Inverse transpose of M, given its class (scale is only used for
+// AFFINE_UNIFORM_SCALE).  A singular general matrix gets the transposed
+// cofactor matrix of its 3x3 part instead, which still maps normals to
+// the right directions wherever they are defined.
+void NormalMatrix(D3DXMATRIX* out, const D3DXMATRIX& M, AffineClass affineClass, float scale = 1.0f);
+
+class Transform
+{
+public:
+	// Identity.
+	Transform();
+
+	// Classifies M with ClassifyAffine.
+	explicit Transform(const D3DXMATRIX& M);
+
+	// M is known to be of the given class (and scale).
+	Transform(const D3DXMATRIX& M, AffineClass affineClass, float scale = 1.0f);
+
+	const D3DXMATRIX& getMatrix()const { return mMatrix; }
+	AffineClass getClass()const        { return mClass; }
+	float getScale()const              { return mScale; }
+
+	// *this applied first, then rhs.
+	Transform operator*(const Transform& rhs)const;
+
+	void getNormalMatrix(D3DXMATRIX* out)const { NormalMatrix(out, mMatrix, mClass, mScale); }
+
+private:
+	D3DXMATRIX  mMatrix;
+	AffineClass mClass;
+	float       mScale;
+};
+
+// Normal matrices of count transforms, as getNormalMatrix for each.
+void ComputeNormalMatrices(const Transform* transforms, int count, D3DXMATRIX* normalMatrices);
@@ -0,0 +1,505 @@
+#include "TriGrid.h"
+#include "ThreadPool.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#define TRIGRID_AVX2
+#endif
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRIGRID_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(TRIGRID_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	int RowGrain(int itemsPerRow)
+	{
+		int grain = ITEMS_PER_CHUNK / (itemsPerRow > 0 ? itemsPerRow : 1);
+		return grain > 0 ? grain : 1;
+	}
+
+	// The original generator transformed every vertex by a translation
+	// matrix with D3DXVec3TransformCoord, i.e. x' = ((x*1 + y*0) + z*0) + tx
+	// and so on.  The zero terms only matter for the sign of zero, so
+	// adding 0.0f before the translation reproduces it bit-for-bit.
+
+	// Writes global vertex rows [rowBegin, rowEnd) of a block numCols wide
+	// whose x values are rowX[0..numCols).  out receives row rowBegin.
+	void WriteVertRows(int rowBegin, int rowEnd, int numCols, float dz, float zOffset,
+		const D3DXVECTOR3& center, const float* rowX, D3DXVECTOR3* out)
+	{
+		float y = 0.0f + center.y;
+
+		for (int i = rowBegin; i < rowEnd; ++i)
+		{
+			float z = (-(float)i * dz + zOffset + 0.0f) + center.z;
+			D3DXVECTOR3* v = out + (size_t)(i - rowBegin) * numCols;
+			int j = 0;
+
+#if defined(TRIGRID_SSE2)
+			// Four vertices are twelve consecutive floats:
+			//   [x0 y z x1] [y z x2 y] [z x3 y z]
+			__m128 yz = _mm_setr_ps(y, z, y, z);
+			float* dst = (float*)v;
+			for (; j + 4 <= numCols; j += 4)
+			{
+				__m128 x  = _mm_loadu_ps(rowX + j);
+				__m128 p  = _mm_shuffle_ps(x, yz, _MM_SHUFFLE(1, 0, 1, 0)); // x0 x1 y z
+				__m128 s  = _mm_shuffle_ps(x, yz, _MM_SHUFFLE(0, 0, 3, 2)); // x2 x3 y y
+				__m128 t  = _mm_shuffle_ps(yz, x, _MM_SHUFFLE(3, 3, 1, 1)); // z z x3 x3
+				__m128 v0 = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 3, 2, 0));  // x0 y z x1
+				__m128 v1 = _mm_shuffle_ps(yz, s, _MM_SHUFFLE(2, 0, 1, 0)); // y z x2 y
+				__m128 v2 = _mm_shuffle_ps(t, yz, _MM_SHUFFLE(1, 0, 2, 0)); // z x3 y z
+
+				_mm_storeu_ps(dst + 3*j,     v0);
+				_mm_storeu_ps(dst + 3*j + 4, v1);
+				_mm_storeu_ps(dst + 3*j + 8, v2);
+			}
+#endif
+			for (; j < numCols; ++j)
+			{
+				v[j].x = rowX[j];
+				v[j].y = y;
+				v[j].z = z;
+			}
+		}
+	}
+
+	// x only depends on the column, so every generator computes one row of
+	// it up front.  Returns the z offset of row 0.
+	float GridOffsets(int numVertRows, int numVertCols, float dx, float dz,
+		const D3DXVECTOR3& center, std::vector<float>& rowX)
+	{
+		float width = (float)(numVertCols-1) * dx;
+		float depth = (float)(numVertRows-1) * dz;
+
+		float xOffset = -width * 0.5f;
+		float zOffset =  depth * 0.5f;
+
+		rowX.resize(numVertCols);
+		for (int j = 0; j < numVertCols; ++j)
+			rowX[j] = ((float)j * dx + xOffset + 0.0f) + center.x;
+
+		return zOffset;
+	}
+
+	// Index pattern of one cell, relative to its upper-left vertex.
+	void CellPattern(int numVertCols, DWORD pattern[6])
+	{
+		pattern[0] = 0;
+		pattern[1] = 1;
+		pattern[2] = numVertCols;
+		pattern[3] = numVertCols;
+		pattern[4] = 1;
+		pattern[5] = numVertCols + 1;
+	}
+
+	void WriteIndexRows(int rowBegin, int rowEnd, int numVertCols, DWORD* indices)
+	{
+		int numCellCols = numVertCols - 1;
+
+		DWORD pattern[6];
+		CellPattern(numVertCols, pattern);
+
+#if defined(TRIGRID_SSE2)
+		// Four consecutive cells are 24 indices; index n is
+		// base + n/6 + pattern[n%6].  Precompute the 24 offsets once.
+		DWORD offsets[24];
+		for (int n = 0; n < 24; ++n)
+			offsets[n] = n / 6 + pattern[n % 6];
+
+#if defined(TRIGRID_AVX2)
+		__m256i o0 = _mm256_loadu_si256((const __m256i*)(offsets + 0));
+		__m256i o1 = _mm256_loadu_si256((const __m256i*)(offsets + 8));
+		__m256i o2 = _mm256_loadu_si256((const __m256i*)(offsets + 16));
+#else
+		__m128i o[6];
+		for (int n = 0; n < 6; ++n)
+			o[n] = _mm_loadu_si128((const __m128i*)(offsets + 4*n));
+#endif
+#endif
+
+		for (int i = rowBegin; i < rowEnd; ++i)
+		{
+			DWORD* k = indices + (size_t)i * numCellCols * 6;
+			DWORD base = (DWORD)i * numVertCols;
+			int j = 0;
+
+#if defined(TRIGRID_AVX2)
+			for (; j + 4 <= numCellCols; j += 4)
+			{
+				__m256i b = _mm256_set1_epi32((int)(base + j));
+				_mm256_storeu_si256((__m256i*)(k + 6*j),      _mm256_add_epi32(b, o0));
+				_mm256_storeu_si256((__m256i*)(k + 6*j + 8),  _mm256_add_epi32(b, o1));
+				_mm256_storeu_si256((__m256i*)(k + 6*j + 16), _mm256_add_epi32(b, o2));
+			}
+#elif defined(TRIGRID_SSE2)
+			for (; j + 4 <= numCellCols; j += 4)
+			{
+				__m128i b = _mm_set1_epi32((int)(base + j));
+				__m128i* out = (__m128i*)(k + 6*j);
+				for (int n = 0; n < 6; ++n)
+					_mm_storeu_si128(out + n, _mm_add_epi32(b, o[n]));
+			}
+#endif
+			for (; j < numCellCols; ++j)
+			{
+				DWORD a = base + j;
+				for (int n = 0; n < 6; ++n)
+					k[6*j + n] = a + pattern[n];
+			}
+		}
+	}
+	// 16-bit chunks are at most 65536 vertices, so the plain loop is
+	// already bound by the stores.
+	void WriteIndexRows(int rowBegin, int rowEnd, int numVertCols, WORD* indices)
+	{
+		int numCellCols = numVertCols - 1;
+
+		DWORD pattern[6];
+		CellPattern(numVertCols, pattern);
+
+		for (int i = rowBegin; i < rowEnd; ++i)
+		{
+			WORD* k = indices + (size_t)i * numCellCols * 6;
+			DWORD base = (DWORD)i * numVertCols;
+
+			for (int j = 0; j < numCellCols; ++j)
+			{
+				DWORD a = base + j;
+				for (int n = 0; n < 6; ++n)
+					k[6*j + n] = (WORD)(a + pattern[n]);
+			}
+		}
+	}
+
+	// Cache-aware orders emit whole cells with GenTriGrid's triangle
+	// pattern; only the order in which cells are visited changes.
+	template <typename Index>
+	Index* EmitCell(Index* k, int r, int c, int numVertCols)
+	{
+		DWORD a = (DWORD)r * numVertCols + c;
+		k[0] = (Index)a;
+		k[1] = (Index)(a + 1);
+		k[2] = (Index)(a + numVertCols);
+		k[3] = (Index)(a + numVertCols);
+		k[4] = (Index)(a + 1);
+		k[5] = (Index)(a + numVertCols + 1);
+		return k + 6;
+	}
+
+	// Emits cells [r0, r1) x [c0, c1) row by row, bottom row first if
+	// upwards is set.
+	template <typename Index>
+	Index* EmitBlock(Index* k, int r0, int r1, int c0, int c1, int numVertCols, bool upwards)
+	{
+		for (int n = 0; n < r1 - r0; ++n)
+		{
+			int r = upwards ? r1 - 1 - n : r0 + n;
+			for (int c = c0; c < c1; ++c)
+				k = EmitCell(k, r, c, numVertCols);
+		}
+		return k;
+	}
+
+	// Maps distance d along a Hilbert curve filling an n x n square (n a
+	// power of two) to (x, y).
+	void HilbertToXY(int n, int d, int& x, int& y)
+	{
+		x = y = 0;
+		for (int s = 1; s < n; s *= 2)
+		{
+			int rx = 1 & (d / 2);
+			int ry = 1 & (d ^ rx);
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = s - 1 - x;
+					y = s - 1 - y;
+				}
+				std::swap(x, y);
+			}
+			x += s * rx;
+			y += s * ry;
+			d /= 4;
+		}
+	}
+
+	template <typename Index>
+	void WriteOrderedIndices(int numVertRows, int numVertCols, TriGridOrder order,
+		int cacheSize, Index* indices)
+	{
+		int numCellRows = numVertRows - 1;
+		int numCellCols = numVertCols - 1;
+		Index* k = indices;
+
+		if (order == TRIGRID_COLUMN_STRIPS)
+		{
+			// A cell loads its top and bottom vertices interleaved, so a
+			// row of a strip w cells wide can push up to 2w+2 entries
+			// through the FIFO before the next row reuses its bottom
+			// vertices; w = cacheSize/2-2 keeps them resident.  Alternate
+			// strips run upwards to pick up the shared column at the turn.
+			int w = std::max(cacheSize/2 - 2, 1);
+			for (int c0 = 0, strip = 0; c0 < numCellCols; c0 += w, ++strip)
+			{
+				int c1 = std::min(c0 + w, numCellCols);
+				k = EmitBlock(k, 0, numCellRows, c0, c1, numVertCols, (strip & 1) != 0);
+			}
+		}
+		else if (order == TRIGRID_HILBERT)
+		{
+			// Blocks b cells square keep two vertex rows (2b+2 vertices) in
+			// the cache, and visiting them along a Hilbert curve makes
+			// consecutive blocks neighbours in both directions.
+			int b = std::max(cacheSize/2 - 1, 1);
+			int blockRows = (numCellRows + b - 1) / b;
+			int blockCols = (numCellCols + b - 1) / b;
+
+			int n = 1;
+			while (n < blockRows || n < blockCols)
+				n *= 2;
+
+			for (int d = 0; d < n*n; ++d)
+			{
+				int x, y;
+				HilbertToXY(n, d, x, y);
+				if (x >= blockCols || y >= blockRows)
+					continue;
+
+				k = EmitBlock(k, y*b, std::min((y+1)*b, numCellRows),
+					x*b, std::min((x+1)*b, numCellCols), numVertCols, false);
+			}
+		}
+		else
+		{
+			k = EmitBlock(k, 0, numCellRows, 0, numCellCols, numVertCols, false);
+		}
+	}
+
+	void WriteIndices(int numVertRows, int numVertCols, TriGridOrder order, WORD* indices)
+	{
+		if (order == TRIGRID_ROW_MAJOR)
+			WriteIndexRows(0, numVertRows-1, numVertCols, indices);
+		else
+			WriteOrderedIndices(numVertRows, numVertCols, order, TRIGRID_CACHE_SIZE, indices);
+	}
+
+	void ComputeBounds(const D3DXVECTOR3* v, DWORD n, AABB& box)
+	{
+		box = AABB();
+		for (DWORD i = 0; i < n; ++i)
+		{
+			D3DXVec3Minimize(&box.minPt, &box.minPt, &v[i]);
+			D3DXVec3Maximize(&box.maxPt, &box.maxPt, &v[i]);
+		}
+	}
+}
+
+void GenTriGridVerts(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, D3DXVECTOR3* verts, ThreadPool* pool)
+{
+	if (verts == 0 || numVertRows <= 0 || numVertCols <= 0)
+		return;
+
+	std::vector<float> rowX;
+	float zOffset = GridOffsets(numVertRows, numVertCols, dx, dz, center, rowX);
+
+	auto job = [&](int begin, int end)
+	{
+		WriteVertRows(begin, end, numVertCols, dz, zOffset, center, &rowX[0],
+			verts + (size_t)begin * numVertCols);
+	};
+
+	if (pool)
+		pool->parallelFor(numVertRows, RowGrain(numVertCols), job);
+	else
+		job(0, numVertRows);
+}
+
+void GenTriGridIndices(int numVertRows, int numVertCols, DWORD* indices, ThreadPool* pool)
+{
+	int numCellRows = numVertRows-1;
+	int numCellCols = numVertCols-1;
+
+	if (indices == 0 || numCellRows <= 0 || numCellCols <= 0)
+		return;
+
+	auto job = [&](int begin, int end)
+	{
+		WriteIndexRows(begin, end, numVertCols, indices);
+	};
+
+	if (pool)
+		pool->parallelFor(numCellRows, RowGrain(numCellCols), job);
+	else
+		job(0, numCellRows);
+}
+
+void GenTriGridIndices(int numVertRows, int numVertCols, TriGridOrder order,
+	DWORD* indices, int cacheSize, ThreadPool* pool)
+{
+	if (order == TRIGRID_ROW_MAJOR)
+	{
+		GenTriGridIndices(numVertRows, numVertCols, indices, pool);
+		return;
+	}
+
+	if (indices == 0 || numVertRows < 2 || numVertCols < 2)
+		return;
+
+	WriteOrderedIndices(numVertRows, numVertCols, order, cacheSize, indices);
+}
+
+void GenTriGrid(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, D3DXVECTOR3* verts, DWORD* indices, ThreadPool* pool)
+{
+	GenTriGridVerts(numVertRows, numVertCols, dx, dz, center, verts, pool);
+	GenTriGridIndices(numVertRows, numVertCols, indices, pool);
+}
+
+bool Supports32BitIndices(DWORD numVertices)
+{
+	D3DCAPS9 caps;
+	HR(gd3dDevice->GetDeviceCaps(&caps));
+
+	return caps.MaxVertexIndex > 0xffff && caps.MaxVertexIndex >= numVertices - 1;
+}
+
+void BuildTriGrid(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, bool allow32BitIndices, TriGridGeometry& grid,
+	ThreadPool* pool, int maxChunkSide, TriGridOrder order)
+{
+	grid.verts.clear();
+	grid.indices16.clear();
+	grid.indices32.clear();
+	grid.chunks.clear();
+
+	if (numVertRows < 2 || numVertCols < 2)
+		return;
+
+	DWORD numVertices  = (DWORD)numVertRows * numVertCols;
+	DWORD numTriangles = (DWORD)(numVertRows-1) * (numVertCols-1) * 2;
+
+	// Whole grid as one chunk: same layout as GenTriGrid.
+	if (numVertices <= 0x10000 || allow32BitIndices)
+	{
+		grid.verts.resize(numVertices);
+		GenTriGridVerts(numVertRows, numVertCols, dx, dz, center, &grid.verts[0], pool);
+
+		if (numVertices <= 0x10000)
+		{
+			grid.indexFormat = D3DFMT_INDEX16;
+			grid.indices16.resize(numTriangles*3);
+			WriteIndices(numVertRows, numVertCols, order, &grid.indices16[0]);
+		}
+		else
+		{
+			grid.indexFormat = D3DFMT_INDEX32;
+			grid.indices32.resize(numTriangles*3);
+			GenTriGridIndices(numVertRows, numVertCols, order, &grid.indices32[0],
+				TRIGRID_CACHE_SIZE, pool);
+		}
+
+		TriGridChunk c;
+		c.firstRow     = 0;
+		c.firstCol     = 0;
+		c.numRows      = numVertRows;
+		c.numCols      = numVertCols;
+		c.baseVertex   = 0;
+		c.numVertices  = numVertices;
+		c.startIndex   = 0;
+		c.numTriangles = numTriangles;
+		ComputeBounds(&grid.verts[0], numVertices, c.bounds);
+		grid.chunks.push_back(c);
+		return;
+	}
+
+	// Chunked 16-bit path.  Neighbouring chunks share their border row or
+	// column, so a chunk side of n vertices advances by n-1 cells.
+	if (maxChunkSide > 256) maxChunkSide = 256;
+	if (maxChunkSide < 2)   maxChunkSide = 2;
+	int step = maxChunkSide - 1;
+
+	int chunkRows = (numVertRows - 2) / step + 1;
+	int chunkCols = (numVertCols - 2) / step + 1;
+
+	DWORD vertCount  = 0;
+	DWORD indexCount = 0;
+	for (int cr = 0; cr < chunkRows; ++cr)
+	{
+		for (int cc = 0; cc < chunkCols; ++cc)
+		{
+			TriGridChunk c;
+			c.firstRow = cr * step;
+			c.firstCol = cc * step;
+			c.numRows  = (numVertRows - c.firstRow) < maxChunkSide ? (numVertRows - c.firstRow) : maxChunkSide;
+			c.numCols  = (numVertCols - c.firstCol) < maxChunkSide ? (numVertCols - c.firstCol) : maxChunkSide;
+
+			c.baseVertex   = vertCount;
+			c.numVertices  = (DWORD)c.numRows * c.numCols;
+			c.startIndex   = indexCount;
+			c.numTriangles = (DWORD)(c.numRows-1) * (c.numCols-1) * 2;
+
+			vertCount  += c.numVertices;
+			indexCount += c.numTriangles * 3;
+			grid.chunks.push_back(c);
+		}
+	}
+
+	grid.indexFormat = D3DFMT_INDEX16;
+	grid.verts.resize(vertCount);
+	grid.indices16.resize(indexCount);
+
+	std::vector<float> rowX;
+	float zOffset = GridOffsets(numVertRows, numVertCols, dx, dz, center, rowX);
+
+	auto job = [&](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			TriGridChunk& c = grid.chunks[i];
+			D3DXVECTOR3* v = &grid.verts[c.baseVertex];
+
+			WriteVertRows(c.firstRow, c.firstRow + c.numRows, c.numCols, dz, zOffset,
+				center, &rowX[c.firstCol], v);
+			WriteIndices(c.numRows, c.numCols, order, &grid.indices16[c.startIndex]);
+			ComputeBounds(v, c.numVertices, c.bounds);
+		}
+	};
+
+	if (pool)
+		pool->parallelFor((int)grid.chunks.size(), 1, job);
+	else
+		job(0, (int)grid.chunks.size());
+}
+
+void CreateTriGridIndexBuffer(const TriGridGeometry& grid, IDirect3DIndexBuffer9** ib)
+{
+	UINT indexSize = grid.indexFormat == D3DFMT_INDEX16 ? sizeof(WORD) : sizeof(DWORD);
+	UINT numBytes  = grid.numIndices() * indexSize;
+
+	HR(gd3dDevice->CreateIndexBuffer(numBytes, D3DUSAGE_WRITEONLY,
+		grid.indexFormat, D3DPOOL_MANAGED, ib, 0));
+
+	void* k = 0;
+	HR((*ib)->Lock(0, 0, &k, 0));
+	if (grid.indexFormat == D3DFMT_INDEX16)
+		memcpy(k, &grid.indices16[0], numBytes);
+	else
+		memcpy(k, &grid.indices32[0], numBytes);
+	HR((*ib)->Unlock());
+}
+
+void DrawTriGridChunk(const TriGridChunk& chunk)
+{
+	HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, chunk.baseVertex, 0,
+		chunk.numVertices, chunk.startIndex, chunk.numTriangles));
+}
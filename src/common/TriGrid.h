@@ -0,0 +1,115 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class ThreadPool;
+
+//===============================================================
+// Fast triangle grid generation.
+//
+// Produces exactly the same vertices and indices as GenTriGrid, but
+// writes straight into caller-provided buffers, builds no per-vertex
+// matrices, and uses SSE2 (AVX2 for indices when compiled with
+// /arch:AVX2) with a scalar fallback.  If a pool is given, rows are
+// split across its threads.
+//
+// verts must hold numVertRows*numVertCols elements and indices
+// (numVertRows-1)*(numVertCols-1)*6.  Either may be null to skip
+// that half of the work.
+
+void GenTriGridVerts(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, D3DXVECTOR3* verts, ThreadPool* pool = 0);
+
+void GenTriGridIndices(int numVertRows, int numVertCols, DWORD* indices, ThreadPool* pool = 0);
+
+void GenTriGrid(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, D3DXVECTOR3* verts, DWORD* indices, ThreadPool* pool = 0);
+
+//===============================================================
+// Cache-aware index orders.
+//
+// Row-major order reloads every vertex of a wide grid twice, because
+// by the time the next row reuses a vertex it has long left the
+// post-transform cache.  The other orders visit the same cells (same
+// triangles, same winding) in an order sized to a FIFO cache of
+// cacheSize entries:
+//
+//   TRIGRID_COLUMN_STRIPS - vertical strips cacheSize/2-2 cells wide,
+//                           alternately walked down and up.
+//   TRIGRID_HILBERT       - blocks of cacheSize/2-1 cells square,
+//                           visited along a Hilbert curve.
+//
+// Vertices keep GenTriGrid's layout.  Measure the result with
+// MeasureVertexCache (VertexCache.h).
+
+enum TriGridOrder
+{
+	TRIGRID_ROW_MAJOR,
+	TRIGRID_COLUMN_STRIPS,
+	TRIGRID_HILBERT
+};
+
+// Cache size BuildTriGrid orders for; conservative for DX9-class parts.
+const int TRIGRID_CACHE_SIZE = 16;
+
+// Only the row-major order is split across the pool.
+void GenTriGridIndices(int numVertRows, int numVertCols, TriGridOrder order,
+	DWORD* indices, int cacheSize = TRIGRID_CACHE_SIZE, ThreadPool* pool = 0);
+
+//===============================================================
+// Large grids.
+//
+// D3DFMT_INDEX16 can only address 65536 vertices, so casting GenTriGrid's
+// DWORD indices to WORD silently wraps on anything bigger than 256x256.
+// BuildTriGrid picks 16-bit indices whenever the whole grid fits.  If it
+// does not, it either emits 32-bit indices for the whole grid or splits
+// it into square chunks of at most maxChunkSide x maxChunkSide vertices,
+// each with its own vertex range, 16-bit indices and bounding box, so
+// chunks can be culled and drawn individually.  Chunks duplicate the
+// vertices along the edges they share with their neighbours.  order
+// picks the index order within each chunk.
+
+struct TriGridChunk
+{
+	int firstRow;             // Global vertex row/column of the chunk's
+	int firstCol;             // first vertex.
+	int numRows;              // Vertex rows/columns in the chunk.
+	int numCols;
+
+	DWORD baseVertex;         // BaseVertexIndex for DrawIndexedPrimitive.
+	DWORD numVertices;
+	DWORD startIndex;
+	DWORD numTriangles;
+
+	AABB bounds;
+};
+
+struct TriGridGeometry
+{
+	TriGridGeometry() : indexFormat(D3DFMT_INDEX16) {}
+
+	DWORD numVertices()const  { return (DWORD)verts.size(); }
+	DWORD numIndices()const   { return indexFormat == D3DFMT_INDEX16 ? (DWORD)indices16.size() : (DWORD)indices32.size(); }
+	DWORD numTriangles()const { return numIndices() / 3; }
+
+	// Vertices are stored chunk after chunk; a chunk's vertex (r, c) is
+	// verts[chunk.baseVertex + r*chunk.numCols + c].
+	std::vector<D3DXVECTOR3>  verts;
+	D3DFORMAT                 indexFormat;
+	std::vector<WORD>         indices16;   // Used with D3DFMT_INDEX16.
+	std::vector<DWORD>        indices32;   // Used with D3DFMT_INDEX32.
+	std::vector<TriGridChunk> chunks;
+};
+
+void BuildTriGrid(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, bool allow32BitIndices, TriGridGeometry& grid,
+	ThreadPool* pool = 0, int maxChunkSide = 256, TriGridOrder order = TRIGRID_ROW_MAJOR);
+
+// True if the device can draw a 32-bit index buffer addressing numVertices;
+// what to pass BuildTriGrid as allow32BitIndices.
+bool Supports32BitIndices(DWORD numVertices);
+
+void CreateTriGridIndexBuffer(const TriGridGeometry& grid, IDirect3DIndexBuffer9** ib);
+
+// Draws one chunk with the grid's vertex and index buffers already bound.
+void DrawTriGridChunk(const TriGridChunk& chunk);
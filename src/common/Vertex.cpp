@@ -4,6 +4,9 @@ IDirect3DVertexDeclaration9 *VertexPos::Decl = 0;
 IDirect3DVertexDeclaration9 *VertexCol::Decl = 0;
 IDirect3DVertexDeclaration9 *VertexPN::Decl = 0;
 IDirect3DVertexDeclaration9 *VertexPNT::Decl = 0;
+IDirect3DVertexDeclaration9 *VertexPNTQ16::Decl = 0;
+IDirect3DVertexDeclaration9 *VertexPNTQ12::Decl = 0;
+IDirect3DVertexDeclaration9 *VertexWaveTerms::Decl = 0;
 
 void InitAllVertexDeclarations()
 {
@@ -34,6 +37,36 @@ void InitAllVertexDeclarations()
 		D3DDECL_END()
 	};
 	HR(gd3dDevice->CreateVertexDeclaration(VertexPNTElems, &VertexPNT::Decl));
+
+	// SHORT2 and SHORT4 arrive in the shader as plain integers, which
+	// every device supports; half floats need a cap.
+	D3DCAPS9 caps;
+	HR(gd3dDevice->GetDeviceCaps(&caps));
+	if (caps.DeclTypes & D3DDTCAPS_FLOAT16_2)
+	{
+		D3DVERTEXELEMENT9 VertexPNTQ16Elems[] = {
+			{0, 0, D3DDECLTYPE_SHORT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+			{0, 8, D3DDECLTYPE_SHORT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL, 0},
+			{0, 12, D3DDECLTYPE_FLOAT16_2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+			D3DDECL_END()
+		};
+		HR(gd3dDevice->CreateVertexDeclaration(VertexPNTQ16Elems, &VertexPNTQ16::Decl));
+	}
+
+	D3DVERTEXELEMENT9 VertexPNTQ12Elems[] = {
+		{0, 0, D3DDECLTYPE_SHORT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+		{0, 8, D3DDECLTYPE_SHORT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+		D3DDECL_END()
+	};
+	HR(gd3dDevice->CreateVertexDeclaration(VertexPNTQ12Elems, &VertexPNTQ12::Decl));
+
+	D3DVERTEXELEMENT9 VertexWaveTermsElems[] = {
+		{0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+		{1, 0, D3DDECLTYPE_FLOAT1, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+		{1, 4, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 1},
+		D3DDECL_END()
+	};
+	HR(gd3dDevice->CreateVertexDeclaration(VertexWaveTermsElems, &VertexWaveTerms::Decl));
 }
 
 void DestroyAllVertexDeclarations()
@@ -42,4 +75,7 @@ void DestroyAllVertexDeclarations()
 	SafeRelease(VertexCol::Decl);
 	SafeRelease(VertexPN::Decl);
 	SafeRelease(VertexPNT::Decl);
+	SafeRelease(VertexPNTQ16::Decl);
+	SafeRelease(VertexPNTQ12::Decl);
+	SafeRelease(VertexWaveTerms::Decl);
 }
@@ -46,5 +46,43 @@ struct VertexPNT
 	static IDirect3DVertexDeclaration9 *Decl;
 };
 
+// Compressed forms of VertexPNT, made by CompressVertices
+// (VertexCompress.h).  Positions are 16-bit integers over the mesh's
+// bounding box and normals octahedral, so the vertex shader decodes
+// them with the mesh's VertexQuantization constants.
+
+// 16 bytes: 16-bit octahedral normal and half-float texture coordinates.
+// Decl is null on devices without D3DDTCAPS_FLOAT16_2.
+struct VertexPNTQ16
+{
+	short pos[4];     // w is 0.
+	short normal[2];
+	WORD  tex0[2];
+	static IDirect3DVertexDeclaration9 *Decl;
+};
+
+// 12 bytes: the octahedral normal, 8 bits a component, rides in the
+// position's w, and texture coordinates are 16-bit integers over the
+// mesh's texture coordinate range.
+struct VertexPNTQ12
+{
+	short pos[4];
+	short tex0[2];
+	static IDirect3DVertexDeclaration9 *Decl;
+};
+
+// Second vertex stream for the wave surface: terms of the radial sine
+// waves that never change, computed once on the CPU.  Decl describes
+// both streams together: VertexPos in stream 0 and this in stream 1.
+struct VertexWaveTerms
+{
+	VertexWaveTerms() : dist(0.0f), phase(0.0f, 0.0f) {}
+	VertexWaveTerms(float d, const D3DXVECTOR2& ph) : dist(d), phase(ph) {}
+
+	float       dist;   // sqrt(x*x + z*z)
+	D3DXVECTOR2 phase;  // k[i]*dist + p[i] for the two waves
+	static IDirect3DVertexDeclaration9 *Decl;
+};
+
 void InitAllVertexDeclarations();
 void DestroyAllVertexDeclarations();
@@ -0,0 +1,251 @@
+#include "VertexCache.h"
+#include <math.h>
+
+namespace
+{
+	template <typename Index>
+	VertexCacheStats Measure(const Index* indices, DWORD numIndices, int cacheSize)
+	{
+		VertexCacheStats stats = {0};
+		stats.numTriangles = numIndices / 3;
+		if (stats.numTriangles == 0)
+			return stats;
+
+		DWORD maxIndex = 0;
+		for (DWORD i = 0; i < numIndices; ++i)
+			if (indices[i] > maxIndex) maxIndex = indices[i];
+
+		// A vertex loaded at miss number m leaves a FIFO of cacheSize
+		// entries once cacheSize more misses have happened.
+		const DWORD NOT_LOADED = 0xffffffff;
+		std::vector<DWORD> loadedAt(maxIndex + 1, NOT_LOADED);
+
+		DWORD misses = 0;
+		for (DWORD i = 0; i < stats.numTriangles*3; ++i)
+		{
+			DWORD v = indices[i];
+			if (loadedAt[v] == NOT_LOADED)
+				++stats.numVertices;
+
+			if (loadedAt[v] == NOT_LOADED || misses - loadedAt[v] >= (DWORD)cacheSize)
+				loadedAt[v] = misses++;
+		}
+
+		stats.numTransformed = misses;
+		stats.acmr = (float)misses / stats.numTriangles;
+		stats.atvr = (float)misses / stats.numVertices;
+		return stats;
+	}
+
+	//===============================================================
+	// Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006.  Every
+	// vertex gets a score from its LRU cache position and from how many
+	// of its triangles are still to be drawn; the highest scoring
+	// triangle touching the cache goes next.
+
+	const int   MAX_CACHE_SIZE      = 64;
+	const float CACHE_DECAY_POWER   = 1.5f;
+	const float LAST_TRI_SCORE      = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	class ForsythScorer
+	{
+	public:
+		ForsythScorer(int cacheSize)
+		{
+			for (int i = 0; i < MAX_CACHE_SIZE; ++i)
+			{
+				if (i < 3)
+					mCacheScore[i] = LAST_TRI_SCORE;
+				else if (i < cacheSize)
+					mCacheScore[i] = powf(1.0f - (float)(i - 3) / (cacheSize - 3), CACHE_DECAY_POWER);
+				else
+					mCacheScore[i] = 0.0f;
+			}
+
+			for (int i = 1; i < NUM_VALENCE_SCORES; ++i)
+				mValenceScore[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+			mValenceScore[0] = 0.0f;
+		}
+
+		float score(int cachePos, DWORD valence)const
+		{
+			if (valence == 0)
+				return -1.0f;
+
+			float s = cachePos >= 0 ? mCacheScore[cachePos] : 0.0f;
+			if (valence < NUM_VALENCE_SCORES)
+				return s + mValenceScore[valence];
+			return s + VALENCE_BOOST_SCALE * powf((float)valence, -VALENCE_BOOST_POWER);
+		}
+
+	private:
+		enum { NUM_VALENCE_SCORES = 32 };
+
+		float mCacheScore[MAX_CACHE_SIZE];
+		float mValenceScore[NUM_VALENCE_SCORES];
+	};
+
+	template <typename Index>
+	void Forsyth(Index* indices, DWORD numIndices, DWORD numVertices, int cacheSize)
+	{
+		DWORD numTris = numIndices / 3;
+		if (numTris < 2)
+			return;
+
+		if (cacheSize > MAX_CACHE_SIZE) cacheSize = MAX_CACHE_SIZE;
+		if (cacheSize < 4)              cacheSize = 4;
+
+		ForsythScorer scorer(cacheSize);
+
+		// Vertex -> triangle adjacency.  The first remaining[v] entries of
+		// v's list are its triangles not yet emitted.
+		std::vector<DWORD> remaining(numVertices, 0);
+		for (DWORD i = 0; i < numTris*3; ++i)
+			++remaining[indices[i]];
+
+		std::vector<DWORD> first(numVertices + 1, 0);
+		for (DWORD v = 0; v < numVertices; ++v)
+			first[v+1] = first[v] + remaining[v];
+
+		std::vector<DWORD> vertTris(numTris*3);
+		std::vector<DWORD> fill(first.begin(), first.end() - 1);
+		for (DWORD t = 0; t < numTris; ++t)
+			for (int c = 0; c < 3; ++c)
+				vertTris[fill[indices[3*t + c]]++] = t;
+
+		std::vector<int>   cachePos(numVertices, -1);
+		std::vector<float> vertScore(numVertices);
+		for (DWORD v = 0; v < numVertices; ++v)
+			vertScore[v] = scorer.score(-1, remaining[v]);
+
+		std::vector<float> triScore(numTris);
+		std::vector<bool>  emitted(numTris, false);
+
+		int best = -1;
+		float bestScore = -1.0f;
+		for (DWORD t = 0; t < numTris; ++t)
+		{
+			triScore[t] = vertScore[indices[3*t]] + vertScore[indices[3*t+1]] + vertScore[indices[3*t+2]];
+			if (triScore[t] > bestScore)
+			{
+				bestScore = triScore[t];
+				best = (int)t;
+			}
+		}
+
+		std::vector<Index> out(numTris*3);
+		DWORD cache[MAX_CACHE_SIZE + 3];
+		int cacheCount = 0;
+		DWORD nextInOrder = 0;
+
+		for (DWORD n = 0; n < numTris; ++n)
+		{
+			// Nothing in the cache has triangles left: carry on in input
+			// order.
+			if (best < 0)
+			{
+				while (emitted[nextInOrder])
+					++nextInOrder;
+				best = (int)nextInOrder;
+			}
+
+			const Index* tri = indices + 3*best;
+			out[3*n]   = tri[0];
+			out[3*n+1] = tri[1];
+			out[3*n+2] = tri[2];
+			emitted[best] = true;
+
+			// Drop the triangle from its vertices' remaining lists.
+			for (int c = 0; c < 3; ++c)
+			{
+				DWORD v = tri[c];
+				DWORD* list = &vertTris[first[v]];
+				for (DWORD k = 0; k < remaining[v]; ++k)
+				{
+					if (list[k] == (DWORD)best)
+					{
+						list[k] = list[remaining[v] - 1];
+						list[remaining[v] - 1] = (DWORD)best;
+						--remaining[v];
+						break;
+					}
+				}
+			}
+
+			// The triangle's vertices move to the front of the LRU cache.
+			DWORD newCache[MAX_CACHE_SIZE + 3];
+			int newCount = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				bool dup = false;
+				for (int k = 0; k < newCount; ++k)
+					dup = dup || newCache[k] == tri[c];
+				if (!dup)
+					newCache[newCount++] = tri[c];
+			}
+			for (int k = 0; k < cacheCount; ++k)
+			{
+				DWORD v = cache[k];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					newCache[newCount++] = v;
+			}
+
+			// Rescore every vertex whose position changed, including those
+			// pushed out, then every triangle they still have.
+			for (int k = 0; k < newCount; ++k)
+			{
+				DWORD v = newCache[k];
+				cachePos[v]  = k < cacheSize ? k : -1;
+				vertScore[v] = scorer.score(cachePos[v], remaining[v]);
+			}
+
+			best = -1;
+			bestScore = -1.0f;
+			for (int k = 0; k < newCount; ++k)
+			{
+				DWORD v = newCache[k];
+				const DWORD* list = &vertTris[first[v]];
+				for (DWORD j = 0; j < remaining[v]; ++j)
+				{
+					DWORD t = list[j];
+					const Index* tv = indices + 3*t;
+					triScore[t] = vertScore[tv[0]] + vertScore[tv[1]] + vertScore[tv[2]];
+					if (triScore[t] > bestScore)
+					{
+						bestScore = triScore[t];
+						best = (int)t;
+					}
+				}
+			}
+
+			cacheCount = newCount < cacheSize ? newCount : cacheSize;
+			for (int k = 0; k < cacheCount; ++k)
+				cache[k] = newCache[k];
+		}
+
+		for (DWORD i = 0; i < numTris*3; ++i)
+			indices[i] = out[i];
+	}
+}
+
+VertexCacheStats MeasureVertexCache(const DWORD* indices, DWORD numIndices, int cacheSize)
+{
+	return Measure(indices, numIndices, cacheSize);
+}
+
+VertexCacheStats MeasureVertexCache(const WORD* indices, DWORD numIndices, int cacheSize)
+{
+	return Measure(indices, numIndices, cacheSize);
+}
+
+void OptimizeVertexCacheForsyth(DWORD* indices, DWORD numIndices, DWORD numVertices, int cacheSize)
+{
+	Forsyth(indices, numIndices, numVertices, cacheSize);
+}
+
+void OptimizeVertexCacheForsyth(WORD* indices, DWORD numIndices, DWORD numVertices, int cacheSize)
+{
+	Forsyth(indices, numIndices, numVertices, cacheSize);
+}
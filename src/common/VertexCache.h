@@ -0,0 +1,33 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+//===============================================================
+// Post-transform vertex cache measurement and optimization.
+//
+// ACMR (average cache miss ratio) is vertices transformed per
+// triangle: 3 is the worst case, about 0.5 the best a regular grid can
+// do.  ATVR (average transform to vertex ratio) is vertices transformed
+// per distinct vertex referenced: 1 means every vertex is transformed
+// exactly once.
+
+struct VertexCacheStats
+{
+	DWORD numTriangles;
+	DWORD numVertices;      // Distinct vertices referenced.
+	DWORD numTransformed;   // Cache misses.
+	float acmr;
+	float atvr;
+};
+
+// Simulates a FIFO cache of cacheSize entries over a triangle list, as
+// found on DX9-class hardware.
+VertexCacheStats MeasureVertexCache(const DWORD* indices, DWORD numIndices, int cacheSize = 16);
+VertexCacheStats MeasureVertexCache(const WORD* indices, DWORD numIndices, int cacheSize = 16);
+
+// Reorders the triangles of a triangle list in place with Tom Forsyth's
+// linear-speed vertex cache optimization, which models an LRU cache of
+// cacheSize entries.  The result also does well on smaller FIFO caches.
+// Vertices are not touched; numVertices must exceed every index.
+void OptimizeVertexCacheForsyth(DWORD* indices, DWORD numIndices, DWORD numVertices, int cacheSize = 32);
+void OptimizeVertexCacheForsyth(WORD* indices, DWORD numIndices, DWORD numVertices, int cacheSize = 32);
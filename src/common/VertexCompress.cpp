@@ -0,0 +1,464 @@
+#include "VertexCompress.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define VERTEXCOMPRESS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Quantization maps [min, max] onto [-32768, 32767], so a zero-sized
+	// range leaves scale at 0 and every value decodes to min.
+	void SetRange(float minValue, float maxValue, float& scale, float& bias)
+	{
+		scale = (maxValue - minValue) / 65535.0f;
+		bias  = minValue + 32768.0f * scale;
+	}
+
+	float InverseScale(float scale)
+	{
+		return scale > 0.0f ? 1.0f / scale : 0.0f;
+	}
+
+	// Every step below is done in the same order, with the same
+	// operations, by the SSE2 code, so both give the same bits.  Adding
+	// 0.5 and truncating rounds the non-negative values to nearest.
+	short QuantizeValue(float x, float bias, float invScale)
+	{
+		float u = (x - bias) * invScale + 32768.0f;
+		u = std::min(std::max(u, 0.0f), 65535.0f);
+		return (short)((int)(u + 0.5f) - 32768);
+	}
+
+	// Rounds e in [-1,1] to a signed integer in [-k,k].
+	int QuantizeSnorm(float e, float k)
+	{
+		return (int)(e * k + (k + 0.5f)) - (int)k;
+	}
+
+	void EncodeOct(float x, float y, float z, float& ex, float& ey)
+	{
+		float s = fabsf(x) + fabsf(y) + fabsf(z);
+		float r = 1.0f / (s > 0.0f ? s : 1.0f);
+		float ox = x * r;
+		float oy = y * r;
+		if (z < 0.0f)
+		{
+			ex = (1.0f - fabsf(oy)) * copysignf(1.0f, ox);
+			ey = (1.0f - fabsf(ox)) * copysignf(1.0f, oy);
+		}
+		else
+		{
+			ex = ox;
+			ey = oy;
+		}
+	}
+
+	WORD HalfBits(float f)
+	{
+		DWORD u;
+		memcpy(&u, &f, 4);
+		DWORD sign = u & 0x80000000;
+		DWORD a = u ^ sign;
+
+		DWORD o;
+		if (a >= 0x47800000)
+		{
+			// Too big for a half: infinity, or a quiet NaN.
+			o = a > 0x7f800000 ? 0x7e00 : 0x7c00;
+		}
+		else if (a < 0x38800000)
+		{
+			// A half denormal or zero.  Adding 0.5 lines the 10 mantissa
+			// bits up at the bottom of the float, rounded to nearest even
+			// by the addition itself.
+			float g;
+			memcpy(&g, &a, 4);
+			g += 0.5f;
+			memcpy(&o, &g, 4);
+			o -= 0x3f000000;
+		}
+		else
+		{
+			// Rebias the exponent and round to nearest even by hand.
+			DWORD odd = (a >> 13) & 1;
+			a += 0xc8000fff + odd;
+			o = a >> 13;
+		}
+		return (WORD)(o | (sign >> 16));
+	}
+
+	void CompressScalar(const VertexPNT& v, const VertexQuantization& q, const D3DXVECTOR3& invPos,
+		VertexPNTQ16& out)
+	{
+		out.pos[0] = QuantizeValue(v.pos.x, q.posBias.x, invPos.x);
+		out.pos[1] = QuantizeValue(v.pos.y, q.posBias.y, invPos.y);
+		out.pos[2] = QuantizeValue(v.pos.z, q.posBias.z, invPos.z);
+		out.pos[3] = 0;
+
+		float ex, ey;
+		EncodeOct(v.normal.x, v.normal.y, v.normal.z, ex, ey);
+		out.normal[0] = (short)QuantizeSnorm(ex, 32767.0f);
+		out.normal[1] = (short)QuantizeSnorm(ey, 32767.0f);
+
+		out.tex0[0] = HalfBits(v.tex0.x);
+		out.tex0[1] = HalfBits(v.tex0.y);
+	}
+
+	void CompressScalar(const VertexPNT& v, const VertexQuantization& q, const D3DXVECTOR3& invPos,
+		const D3DXVECTOR2& invTex, VertexPNTQ12& out)
+	{
+		out.pos[0] = QuantizeValue(v.pos.x, q.posBias.x, invPos.x);
+		out.pos[1] = QuantizeValue(v.pos.y, q.posBias.y, invPos.y);
+		out.pos[2] = QuantizeValue(v.pos.z, q.posBias.z, invPos.z);
+
+		// High byte signed, low byte biased to unsigned, so the shader can
+		// split the two with a floor.
+		float ex, ey;
+		EncodeOct(v.normal.x, v.normal.y, v.normal.z, ex, ey);
+		out.pos[3] = (short)(QuantizeSnorm(ex, 127.0f) * 256 + QuantizeSnorm(ey, 127.0f) + 128);
+
+		out.tex0[0] = QuantizeValue(v.tex0.x, q.texBias.x, invTex.x);
+		out.tex0[1] = QuantizeValue(v.tex0.y, q.texBias.y, invTex.y);
+	}
+
+#if defined(VERTEXCOMPRESS_SSE2)
+	// Loads four VertexPNTs as eight registers of one field each.
+	void LoadVertices4(const VertexPNT* v, __m128& px, __m128& py, __m128& pz,
+		__m128& nx, __m128& ny, __m128& nz, __m128& tu, __m128& tv)
+	{
+		px = _mm_loadu_ps(&v[0].pos.x);
+		py = _mm_loadu_ps(&v[1].pos.x);
+		pz = _mm_loadu_ps(&v[2].pos.x);
+		nx = _mm_loadu_ps(&v[3].pos.x);
+		_MM_TRANSPOSE4_PS(px, py, pz, nx);
+
+		ny = _mm_loadu_ps(&v[0].normal.y);
+		nz = _mm_loadu_ps(&v[1].normal.y);
+		tu = _mm_loadu_ps(&v[2].normal.y);
+		tv = _mm_loadu_ps(&v[3].normal.y);
+		_MM_TRANSPOSE4_PS(ny, nz, tu, tv);
+	}
+
+	__m128i QuantizeValue4(__m128 x, __m128 bias, __m128 invScale)
+	{
+		__m128 u = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, bias), invScale), _mm_set1_ps(32768.0f));
+		u = _mm_min_ps(_mm_max_ps(u, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+		return _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(u, _mm_set1_ps(0.5f))), _mm_set1_epi32(32768));
+	}
+
+	__m128i QuantizeSnorm4(__m128 e, float k)
+	{
+		__m128 u = _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(k)), _mm_set1_ps(k + 0.5f));
+		return _mm_sub_epi32(_mm_cvttps_epi32(u), _mm_set1_epi32((int)k));
+	}
+
+	void EncodeOct4(__m128 x, __m128 y, __m128 z, __m128& ex, __m128& ey)
+	{
+		__m128 signBit = _mm_set1_ps(-0.0f);
+		__m128 one = _mm_set1_ps(1.0f);
+
+		__m128 s = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, x), _mm_andnot_ps(signBit, y)), _mm_andnot_ps(signBit, z));
+		__m128 positive = _mm_cmpgt_ps(s, _mm_setzero_ps());
+		s = _mm_or_ps(_mm_and_ps(positive, s), _mm_andnot_ps(positive, one));
+		__m128 r = _mm_div_ps(one, s);
+		__m128 ox = _mm_mul_ps(x, r);
+		__m128 oy = _mm_mul_ps(y, r);
+
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, oy)), _mm_or_ps(one, _mm_and_ps(signBit, ox)));
+		__m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, ox)), _mm_or_ps(one, _mm_and_ps(signBit, oy)));
+
+		__m128 below = _mm_cmplt_ps(z, _mm_setzero_ps());
+		ex = _mm_or_ps(_mm_and_ps(below, fx), _mm_andnot_ps(below, ox));
+		ey = _mm_or_ps(_mm_and_ps(below, fy), _mm_andnot_ps(below, oy));
+	}
+
+	// HalfBits four at a time, each case computed and the right one
+	// picked per lane.
+	__m128i HalfBits4(__m128 f)
+	{
+		__m128i u = _mm_castps_si128(f);
+		__m128i sign = _mm_and_si128(u, _mm_set1_epi32((int)0x80000000));
+		__m128i a = _mm_xor_si128(u, sign);
+
+		__m128i nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f800000));
+		__m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), _mm_set1_ps(0.5f))),
+			_mm_set1_epi32(0x3f000000));
+
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(a, _mm_set1_epi32((int)0xc8000fff)), odd), 13);
+
+		__m128i isSpecial  = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x47800000 - 1));
+		__m128i isDenormal = _mm_cmplt_epi32(a, _mm_set1_epi32(0x38800000));
+		__m128i o = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+		o = _mm_or_si128(_mm_and_si128(isSpecial, special), _mm_andnot_si128(isSpecial, o));
+		return _mm_or_si128(o, _mm_srli_epi32(sign, 16));
+	}
+
+	// Two 16-bit values per 32-bit lane, lo in the low half.
+	__m128i Pack16(__m128i lo, __m128i hi)
+	{
+		return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xffff)), _mm_slli_epi32(hi, 16));
+	}
+
+	// Transposes four registers of one 32-bit field per vertex into four
+	// vertices of four fields each.
+	void Transpose4(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+	{
+		__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+		__m128 fc = _mm_castsi128_ps(c), fd = _mm_castsi128_ps(d);
+		_MM_TRANSPOSE4_PS(fa, fb, fc, fd);
+		a = _mm_castps_si128(fa);
+		b = _mm_castps_si128(fb);
+		c = _mm_castps_si128(fc);
+		d = _mm_castps_si128(fd);
+	}
+#endif
+
+	void UpdateError(float e, float& maxError, double& sum)
+	{
+		maxError = std::max(maxError, e);
+		sum += e;
+	}
+}
+
+VertexQuantization ComputeVertexQuantization(const VertexPNT* vertices, DWORD numVertices)
+{
+	AABB box;
+	D3DXVECTOR2 texMin(MY_INFINITY, MY_INFINITY), texMax(-MY_INFINITY, -MY_INFINITY);
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		const VertexPNT& v = vertices[i];
+		box.minPt.x = std::min(box.minPt.x, v.pos.x);
+		box.minPt.y = std::min(box.minPt.y, v.pos.y);
+		box.minPt.z = std::min(box.minPt.z, v.pos.z);
+		box.maxPt.x = std::max(box.maxPt.x, v.pos.x);
+		box.maxPt.y = std::max(box.maxPt.y, v.pos.y);
+		box.maxPt.z = std::max(box.maxPt.z, v.pos.z);
+		texMin.x = std::min(texMin.x, v.tex0.x);
+		texMin.y = std::min(texMin.y, v.tex0.y);
+		texMax.x = std::max(texMax.x, v.tex0.x);
+		texMax.y = std::max(texMax.y, v.tex0.y);
+	}
+
+	if (numVertices == 0)
+		return ComputeVertexQuantization(AABB());
+
+	VertexQuantization q = ComputeVertexQuantization(box);
+	SetRange(texMin.x, texMax.x, q.texScale.x, q.texBias.x);
+	SetRange(texMin.y, texMax.y, q.texScale.y, q.texBias.y);
+	return q;
+}
+
+VertexQuantization ComputeVertexQuantization(const AABB& box)
+{
+	// An empty box quantizes everything to the origin.
+	D3DXVECTOR3 minPt = box.minPt, maxPt = box.maxPt;
+	if (minPt.x > maxPt.x || minPt.y > maxPt.y || minPt.z > maxPt.z)
+		minPt = maxPt = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+
+	VertexQuantization q;
+	SetRange(minPt.x, maxPt.x, q.posScale.x, q.posBias.x);
+	SetRange(minPt.y, maxPt.y, q.posScale.y, q.posBias.y);
+	SetRange(minPt.z, maxPt.z, q.posScale.z, q.posBias.z);
+	SetRange(0.0f, 1.0f, q.texScale.x, q.texBias.x);
+	SetRange(0.0f, 1.0f, q.texScale.y, q.texBias.y);
+	return q;
+}
+
+void CompressVertices(const VertexPNT* src, DWORD numVertices, const VertexQuantization& q, VertexPNTQ16* dst)
+{
+	D3DXVECTOR3 invPos(InverseScale(q.posScale.x), InverseScale(q.posScale.y), InverseScale(q.posScale.z));
+	DWORD i = 0;
+
+#if defined(VERTEXCOMPRESS_SSE2)
+	__m128 biasX = _mm_set1_ps(q.posBias.x), invX = _mm_set1_ps(invPos.x);
+	__m128 biasY = _mm_set1_ps(q.posBias.y), invY = _mm_set1_ps(invPos.y);
+	__m128 biasZ = _mm_set1_ps(q.posBias.z), invZ = _mm_set1_ps(invPos.z);
+
+	for (; i + 4 <= numVertices; i += 4)
+	{
+		__m128 px, py, pz, nx, ny, nz, tu, tv;
+		LoadVertices4(src + i, px, py, pz, nx, ny, nz, tu, tv);
+
+		__m128 ex, ey;
+		EncodeOct4(nx, ny, nz, ex, ey);
+
+		// One vertex is exactly one register: x y | z 0 | nx ny | u v.
+		__m128i a = Pack16(QuantizeValue4(px, biasX, invX), QuantizeValue4(py, biasY, invY));
+		__m128i b = Pack16(QuantizeValue4(pz, biasZ, invZ), _mm_setzero_si128());
+		__m128i c = Pack16(QuantizeSnorm4(ex, 32767.0f), QuantizeSnorm4(ey, 32767.0f));
+		__m128i d = Pack16(HalfBits4(tu), HalfBits4(tv));
+		Transpose4(a, b, c, d);
+
+		_mm_storeu_si128((__m128i*)(dst + i),     a);
+		_mm_storeu_si128((__m128i*)(dst + i + 1), b);
+		_mm_storeu_si128((__m128i*)(dst + i + 2), c);
+		_mm_storeu_si128((__m128i*)(dst + i + 3), d);
+	}
+#endif
+
+	for (; i < numVertices; ++i)
+		CompressScalar(src[i], q, invPos, dst[i]);
+}
+
+void CompressVertices(const VertexPNT* src, DWORD numVertices, const VertexQuantization& q, VertexPNTQ12* dst)
+{
+	D3DXVECTOR3 invPos(InverseScale(q.posScale.x), InverseScale(q.posScale.y), InverseScale(q.posScale.z));
+	D3DXVECTOR2 invTex(InverseScale(q.texScale.x), InverseScale(q.texScale.y));
+	DWORD i = 0;
+
+#if defined(VERTEXCOMPRESS_SSE2)
+	__m128 biasX = _mm_set1_ps(q.posBias.x), invX = _mm_set1_ps(invPos.x);
+	__m128 biasY = _mm_set1_ps(q.posBias.y), invY = _mm_set1_ps(invPos.y);
+	__m128 biasZ = _mm_set1_ps(q.posBias.z), invZ = _mm_set1_ps(invPos.z);
+	__m128 biasU = _mm_set1_ps(q.texBias.x), invU = _mm_set1_ps(invTex.x);
+	__m128 biasV = _mm_set1_ps(q.texBias.y), invV = _mm_set1_ps(invTex.y);
+
+	for (; i + 4 <= numVertices; i += 4)
+	{
+		__m128 px, py, pz, nx, ny, nz, tu, tv;
+		LoadVertices4(src + i, px, py, pz, nx, ny, nz, tu, tv);
+
+		__m128 ex, ey;
+		EncodeOct4(nx, ny, nz, ex, ey);
+		__m128i w = _mm_add_epi32(_mm_slli_epi32(QuantizeSnorm4(ex, 127.0f), 8),
+			_mm_add_epi32(QuantizeSnorm4(ey, 127.0f), _mm_set1_epi32(128)));
+
+		// x y | z w | u v, three lanes of each vertex's four.
+		__m128i a = Pack16(QuantizeValue4(px, biasX, invX), QuantizeValue4(py, biasY, invY));
+		__m128i b = Pack16(QuantizeValue4(pz, biasZ, invZ), w);
+		__m128i c = Pack16(QuantizeValue4(tu, biasU, invU), QuantizeValue4(tv, biasV, invV));
+		__m128i d = _mm_setzero_si128();
+		Transpose4(a, b, c, d);
+
+		memcpy(dst + i,     &a, sizeof(VertexPNTQ12));
+		memcpy(dst + i + 1, &b, sizeof(VertexPNTQ12));
+		memcpy(dst + i + 2, &c, sizeof(VertexPNTQ12));
+		memcpy(dst + i + 3, &d, sizeof(VertexPNTQ12));
+	}
+#endif
+
+	for (; i < numVertices; ++i)
+		CompressScalar(src[i], q, invPos, invTex, dst[i]);
+}
+
+void DecompressVertices(const VertexPNTQ16* src, DWORD numVertices, const VertexQuantization& q, VertexPNT* dst)
+{
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		const VertexPNTQ16& v = src[i];
+		dst[i].pos.x = v.pos[0] * q.posScale.x + q.posBias.x;
+		dst[i].pos.y = v.pos[1] * q.posScale.y + q.posBias.y;
+		dst[i].pos.z = v.pos[2] * q.posScale.z + q.posBias.z;
+		dst[i].normal = DecodeOctahedral(v.normal[0] / 32767.0f, v.normal[1] / 32767.0f);
+		dst[i].tex0.x = HalfToFloat(v.tex0[0]);
+		dst[i].tex0.y = HalfToFloat(v.tex0[1]);
+	}
+}
+
+void DecompressVertices(const VertexPNTQ12* src, DWORD numVertices, const VertexQuantization& q, VertexPNT* dst)
+{
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		const VertexPNTQ12& v = src[i];
+		dst[i].pos.x = v.pos[0] * q.posScale.x + q.posBias.x;
+		dst[i].pos.y = v.pos[1] * q.posScale.y + q.posBias.y;
+		dst[i].pos.z = v.pos[2] * q.posScale.z + q.posBias.z;
+
+		float hi = floorf(v.pos[3] / 256.0f);
+		float lo = v.pos[3] - 256.0f * hi - 128.0f;
+		dst[i].normal = DecodeOctahedral(hi / 127.0f, lo / 127.0f);
+
+		dst[i].tex0.x = v.tex0[0] * q.texScale.x + q.texBias.x;
+		dst[i].tex0.y = v.tex0[1] * q.texScale.y + q.texBias.y;
+	}
+}
+
+VertexErrorStats MeasureVertexError(const VertexPNT* original, const VertexPNT* decoded, DWORD numVertices)
+{
+	VertexErrorStats s;
+	memset(&s, 0, sizeof(s));
+
+	double sumPos = 0.0, sumNormal = 0.0, sumTex = 0.0;
+	DWORD numNormals = 0;
+	for (DWORD i = 0; i < numVertices; ++i)
+	{
+		D3DXVECTOR3 dp = decoded[i].pos - original[i].pos;
+		UpdateError(D3DXVec3Length(&dp), s.maxPos, sumPos);
+
+		D3DXVECTOR2 dt = decoded[i].tex0 - original[i].tex0;
+		UpdateError(sqrtf(dt.x*dt.x + dt.y*dt.y), s.maxTex, sumTex);
+
+		// Normals that were never unit length are compared by direction,
+		// and zero ones not at all.
+		float a = D3DXVec3Length(&original[i].normal);
+		float b = D3DXVec3Length(&decoded[i].normal);
+		if (a > 0.0f && b > 0.0f)
+		{
+			float c = D3DXVec3Dot(&original[i].normal, &decoded[i].normal) / (a * b);
+			UpdateError(acosf(std::min(std::max(c, -1.0f), 1.0f)) * 180.0f / D3DX_PI, s.maxNormal, sumNormal);
+			++numNormals;
+		}
+	}
+
+	if (numVertices > 0)
+	{
+		s.meanPos = (float)(sumPos / numVertices);
+		s.meanTex = (float)(sumTex / numVertices);
+	}
+	if (numNormals > 0)
+		s.meanNormal = (float)(sumNormal / numNormals);
+	return s;
+}
+
+WORD FloatToHalf(float f)
+{
+	return HalfBits(f);
+}
+
+float HalfToFloat(WORD h)
+{
+	DWORD sign = (DWORD)(h & 0x8000) << 16;
+	DWORD e = (h >> 10) & 0x1f;
+	DWORD m = h & 0x3ff;
+
+	float f;
+	if (e == 0)
+	{
+		// Zero or denormal: m * 2^-24.
+		f = m * (1.0f / 16777216.0f);
+		DWORD u;
+		memcpy(&u, &f, 4);
+		u |= sign;
+		memcpy(&f, &u, 4);
+		return f;
+	}
+
+	DWORD u = e == 31 ? (0x7f800000 | m << 13) : ((e + 112) << 23 | m << 13);
+	u |= sign;
+	memcpy(&f, &u, 4);
+	return f;
+}
+
+void EncodeOctahedral(const D3DXVECTOR3& n, float* e)
+{
+	EncodeOct(n.x, n.y, n.z, e[0], e[1]);
+}
+
+D3DXVECTOR3 DecodeOctahedral(float ex, float ey)
+{
+	D3DXVECTOR3 n(ex, ey, 1.0f - fabsf(ex) - fabsf(ey));
+	if (n.z < 0.0f)
+	{
+		n.x = (1.0f - fabsf(ey)) * (ex >= 0.0f ? 1.0f : -1.0f);
+		n.y = (1.0f - fabsf(ex)) * (ey >= 0.0f ? 1.0f : -1.0f);
+	}
+	D3DXVec3Normalize(&n, &n);
+	return n;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "Vertex.h"
+
+//===============================================================
+// Compressed vertex formats.
+//
+// VertexPNTQ16 and VertexPNTQ12 (Vertex.h) hold a VertexPNT in half or
+// three eighths of its 32 bytes, for meshes and grids whose draws are
+// limited by vertex fetch:
+//
+//   position  16-bit integers over the mesh's bounding box.
+//   normal    Octahedral (Meyer et al., "On Floating-Point Normal
+//             Vectors", 2010): the unit sphere folded onto the square
+//             [-1,1]^2, 16 bits a component in Q16, 8 in Q12.
+//   texcoord  Half floats in Q16; in Q12, 16-bit integers over the
+//             mesh's texture coordinate range, so tiling is kept but
+//             precision depends on the range.
+//
+// The vertex shader undoes it with the VertexQuantization constants:
+//
+//   float3 p = pos.xyz * gPosScale + gPosBias;
+//   float2 e = normalQ16 / 32767.0;               // Q16
+//   float  h = floor(pos.w / 256.0);              // Q12: high byte ...
+//   float2 e = float2(h, pos.w - 256.0*h - 128.0) / 127.0;  // ... and low
+//   float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * (n.xy >= 0.0 ? 1.0 : -1.0);
+//   n = normalize(n);
+//   float2 uv = texQ12 * gTexScale + gTexBias;    // Q12; Q16 needs nothing
+
+struct VertexQuantization
+{
+	D3DXVECTOR3 posScale;  // Position = q * posScale + posBias.
+	D3DXVECTOR3 posBias;
+	D3DXVECTOR2 texScale;  // Q12 texture coordinates, the same way.
+	D3DXVECTOR2 texBias;
+};
+
+// Constants that spread the vertices' positions and texture coordinates
+// over the full 16-bit range.
+VertexQuantization ComputeVertexQuantization(const VertexPNT* vertices, DWORD numVertices);
+
+// The same from a box, e.g. one known before the vertices are, such as
+// a height grid's; texture coordinates are taken to lie in [0,1].
+VertexQuantization ComputeVertexQuantization(const AABB& box);
+
+// VertexPNT arrays to and from the compressed formats.  Compressing
+// handles four vertices at a time with SSE2 where it is available and
+// gives the same bits as the scalar code.  Values outside the
+// quantization's range are clamped to it.
+void CompressVertices(const VertexPNT* src, DWORD numVertices, const VertexQuantization& q, VertexPNTQ16* dst);
+void CompressVertices(const VertexPNT* src, DWORD numVertices, const VertexQuantization& q, VertexPNTQ12* dst);
+void DecompressVertices(const VertexPNTQ16* src, DWORD numVertices, const VertexQuantization& q, VertexPNT* dst);
+void DecompressVertices(const VertexPNTQ12* src, DWORD numVertices, const VertexQuantization& q, VertexPNT* dst);
+
+// How far decoded vertices are from the originals: positions and
+// texture coordinates in their own units, normals in degrees.
+struct VertexErrorStats
+{
+	float maxPos;
+	float meanPos;
+	float maxNormal;
+	float meanNormal;
+	float maxTex;
+	float meanTex;
+};
+
+VertexErrorStats MeasureVertexError(const VertexPNT* original, const VertexPNT* decoded, DWORD numVertices);
+
+// The scalar pieces, for one value at a time.
+WORD  FloatToHalf(float f);  // Rounds to nearest even.
+float HalfToFloat(WORD h);
+void  EncodeOctahedral(const D3DXVECTOR3& n, float* e);  // e[0], e[1] in [-1,1].
+D3DXVECTOR3 DecodeOctahedral(float ex, float ey);
@@ -0,0 +1,300 @@
+#include "WaveField.h"
+#include "TriGrid.h"
+#include "ThreadPool.h"
+#include "HeightPalette.h"
+#include <math.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define WAVEFIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const double TWO_PI_D = 6.283185307179586;
+
+	// pi split three ways (Cody-Waite) so q*PI_A and q*PI_B are exact for
+	// the small q seen here and x - q*pi loses no bits.
+	const float INV_PI = 0.31830988618f;
+	const float PI_A   = 3.140625f;
+	const float PI_B   = 0.0009675025939941406f;
+	const float PI_C   = 1.5099580252808664e-07f;
+	const float HALF_PI = 1.5707963268f;
+
+	// Taylor series of sin on [-pi/2, pi/2]; the x^13 term is below
+	// 6e-8 there, under the float rounding of the rest.
+	const float S3  = -1.6666667e-1f;
+	const float S5  =  8.3333333e-3f;
+	const float S7  = -1.9841270e-4f;
+	const float S9  =  2.7557319e-6f;
+	const float S11 = -2.5052108e-8f;
+
+	float ReducePhase(double x)
+	{
+		double r = fmod(x, TWO_PI_D);
+		return (float)(r < 0.0 ? r + TWO_PI_D : r);
+	}
+
+#if defined(WAVEFIELD_SSE2)
+	inline __m128 WaveSin4(__m128 x)
+	{
+		// sin(x) = (-1)^q sin(x - q*pi) with q the nearest integer to x/pi.
+		__m128i q  = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(INV_PI)));
+		__m128  qf = _mm_cvtepi32_ps(q);
+
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(PI_A)));
+		r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PI_B)));
+		r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(PI_C)));
+
+		__m128 r2 = _mm_mul_ps(r, r);
+		__m128 s  = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(S11), r2), _mm_set1_ps(S9));
+		s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(S7));
+		s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(S5));
+		s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(S3));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+
+		__m128 sign = _mm_castsi128_ps(_mm_slli_epi32(q, 31));
+		return _mm_xor_ps(s, sign);
+	}
+#endif
+}
+
+float WaveSin(float x)
+{
+	int   q  = (int)floorf(x * INV_PI + 0.5f);
+	float qf = (float)q;
+
+	float r  = ((x - qf*PI_A) - qf*PI_B) - qf*PI_C;
+	float r2 = r*r;
+	float s  = ((((S11*r2 + S9)*r2 + S7)*r2 + S5)*r2 + S3)*r2*r + r;
+
+	return (q & 1) ? -s : s;
+}
+
+void WaveSinCos(const float* x, int count, float* sinOut, float* cosOut)
+{
+	int i = 0;
+
+#if defined(WAVEFIELD_SSE2)
+	__m128 halfPi = _mm_set1_ps(HALF_PI);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(x + i);
+		_mm_storeu_ps(sinOut + i, WaveSin4(v));
+		_mm_storeu_ps(cosOut + i, WaveSin4(_mm_add_ps(v, halfPi)));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		sinOut[i] = WaveSin(x[i]);
+		cosOut[i] = WaveSin(x[i] + HALF_PI);
+	}
+}
+
+WaveField::WaveField(int numVertRows, int numVertCols, float dx, float dz,
+	const D3DXVECTOR3& center, ThreadPool* pool)
+	: mNumRows(numVertRows), mNumCols(numVertCols), mCenter(center), mPool(pool), mTime(0.0f)
+{
+	int n = numVertRows*numVertCols;
+
+	std::vector<D3DXVECTOR3> verts(n);
+	GenTriGridVerts(numVertRows, numVertCols, dx, dz, center, &verts[0], pool);
+
+	mX.resize(n);
+	mZ.resize(n);
+	mDirX.resize(n);
+	mDirZ.resize(n);
+	mHeight.resize(n, 0.0f);
+	mNormalX.resize(n, 0.0f);
+	mNormalZ.resize(n, 0.0f);
+
+	for (int s = 0; s < n; ++s)
+	{
+		mX[s] = verts[s].x;
+		mZ[s] = verts[s].z;
+
+		float d = sqrtf(mX[s]*mX[s] + mZ[s]*mZ[s]);
+		mDirX[s] = d > 0.0f ? mX[s] / d : 0.0f;
+		mDirZ[s] = d > 0.0f ? mZ[s] / d : 0.0f;
+	}
+
+	// The waves of color.fx.
+	const RadialWave waves[2] =
+	{
+		{ 0.8f, 1.0f, 1.0f, 0.0f },
+		{ 0.2f, 8.0f, 8.0f, 1.0f },
+	};
+	setWaves(waves, 2);
+}
+
+void WaveField::setWaves(const RadialWave* waves, int numWaves)
+{
+	mWaves.assign(waves, waves + numWaves);
+	mTimePhase.assign(numWaves, 0.0f);
+	buildPhases();
+}
+
+void WaveField::buildPhases()
+{
+	int n = getNumSamples();
+	mPhase.resize(mWaves.size() * n);
+
+	for (size_t i = 0; i < mWaves.size(); ++i)
+	{
+		const RadialWave& wave = mWaves[i];
+		float* phase = &mPhase[i*n];
+
+		for (int s = 0; s < n; ++s)
+		{
+			double d = sqrt((double)mX[s]*mX[s] + (double)mZ[s]*mZ[s]);
+			phase[s] = ReducePhase(wave.waveNumber*d + wave.phase);
+		}
+	}
+}
+
+void WaveField::update(float t, bool computeNormals)
+{
+	mTime = t;
+	for (size_t i = 0; i < mWaves.size(); ++i)
+		mTimePhase[i] = ReducePhase((double)t * mWaves[i].angularFreq);
+
+	if (mPool)
+	{
+		int grain = ITEMS_PER_CHUNK / mNumCols;
+		mPool->parallelFor(mNumRows, grain > 0 ? grain : 1, [&](int rowBegin, int rowEnd) {
+			updateRows(rowBegin, rowEnd, computeNormals);
+		});
+	}
+	else
+		updateRows(0, mNumRows, computeNormals);
+}
+
+void WaveField::updateRows(int rowBegin, int rowEnd, bool computeNormals)
+{
+	int n     = getNumSamples();
+	int begin = rowBegin*mNumCols;
+	int end   = rowEnd*mNumCols;
+	int numWaves = (int)mWaves.size();
+	int s = begin;
+
+#if defined(WAVEFIELD_SSE2)
+	__m128 halfPi = _mm_set1_ps(HALF_PI);
+
+	for (; s + 4 <= end; s += 4)
+	{
+		__m128 h = _mm_setzero_ps();
+		__m128 g = _mm_setzero_ps();
+
+		for (int i = 0; i < numWaves; ++i)
+		{
+			__m128 arg = _mm_sub_ps(_mm_loadu_ps(&mPhase[i*n + s]), _mm_set1_ps(mTimePhase[i]));
+			h = _mm_add_ps(h, _mm_mul_ps(_mm_set1_ps(mWaves[i].amplitude), WaveSin4(arg)));
+
+			if (computeNormals)
+			{
+				// dy/dd = a*k*cos(arg)
+				__m128 ak = _mm_set1_ps(mWaves[i].amplitude * mWaves[i].waveNumber);
+				g = _mm_add_ps(g, _mm_mul_ps(ak, WaveSin4(_mm_add_ps(arg, halfPi))));
+			}
+		}
+
+		_mm_storeu_ps(&mHeight[s], h);
+
+		if (computeNormals)
+		{
+			__m128 zero = _mm_setzero_ps();
+			_mm_storeu_ps(&mNormalX[s], _mm_sub_ps(zero, _mm_mul_ps(g, _mm_loadu_ps(&mDirX[s]))));
+			_mm_storeu_ps(&mNormalZ[s], _mm_sub_ps(zero, _mm_mul_ps(g, _mm_loadu_ps(&mDirZ[s]))));
+		}
+	}
+#endif
+
+	for (; s < end; ++s)
+	{
+		float h = 0.0f;
+		float g = 0.0f;
+
+		for (int i = 0; i < numWaves; ++i)
+		{
+			float arg = mPhase[i*n + s] - mTimePhase[i];
+			h += mWaves[i].amplitude * WaveSin(arg);
+
+			if (computeNormals)
+				g += mWaves[i].amplitude * mWaves[i].waveNumber * WaveSin(arg + HALF_PI);
+		}
+
+		mHeight[s] = h;
+
+		if (computeNormals)
+		{
+			mNormalX[s] = -g * mDirX[s];
+			mNormalZ[s] = -g * mDirZ[s];
+		}
+	}
+}
+
+void WaveField::writePositions(void* verts, UINT stride)const
+{
+	BYTE* dst = (BYTE*)verts;
+	for (int s = 0; s < getNumSamples(); ++s, dst += stride)
+	{
+		D3DXVECTOR3* pos = (D3DXVECTOR3*)dst;
+		pos->x = mX[s];
+		pos->y = mHeight[s] + mCenter.y;
+		pos->z = mZ[s];
+	}
+}
+
+void WaveField::writeColors(const HeightPalette& palette, D3DCOLOR* colors)const
+{
+	if (mPool)
+	{
+		mPool->parallelFor(getNumSamples(), ITEMS_PER_CHUNK, [&](int begin, int end) {
+			palette.lookup(&mHeight[begin], end - begin, colors + begin);
+		});
+	}
+	else
+		palette.lookup(&mHeight[0], getNumSamples(), colors);
+}
+
+float WaveField::heightAt(float x, float z)const
+{
+	double d = sqrt((double)x*x + (double)z*z);
+
+	float h = 0.0f;
+	for (size_t i = 0; i < mWaves.size(); ++i)
+	{
+		const RadialWave& wave = mWaves[i];
+		float arg = ReducePhase(wave.waveNumber*d + wave.phase) - mTimePhase[i];
+		h += wave.amplitude * WaveSin(arg);
+	}
+	return h;
+}
+
+D3DXVECTOR3 WaveField::normalAt(float x, float z)const
+{
+	double d = sqrt((double)x*x + (double)z*z);
+	if (d == 0.0)
+		return D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+
+	float g = 0.0f;
+	for (size_t i = 0; i < mWaves.size(); ++i)
+	{
+		const RadialWave& wave = mWaves[i];
+		float arg = ReducePhase(wave.waveNumber*d + wave.phase) - mTimePhase[i];
+		g += wave.amplitude * wave.waveNumber * WaveSin(arg + HALF_PI);
+	}
+
+	D3DXVECTOR3 n(-g * (float)(x / d), 1.0f, -g * (float)(z / d));
+	D3DXVec3Normalize(&n, &n);
+	return n;
+}
+
+float WaveField::getMaxHeightError()const
+{
+	float sum = 0.0f;
+	for (size_t i = 0; i < mWaves.size(); ++i)
+		sum += fabsf(mWaves[i].amplitude);
+	return sum * WAVE_SIN_MAX_ERROR;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+class ThreadPool;
+class HeightPalette;
+
+//===============================================================
+// CPU evaluation of the ColoredWavesDemo surface.
+//
+// Sums the same radial sine waves as color.fx,
+//
+//     y(x, z, t) = sum_i a[i]*sin(k[i]*d - t*w[i] + p[i]),  d = sqrt(x*x + z*z),
+//
+// over a grid laid out like GenTriGrid's, so gameplay code (buoyancy,
+// picking, ...) sees the surface the vertex shader draws.
+//
+// Data is kept as structure-of-arrays: one array of precomputed phases
+// k[i]*d + p[i] (reduced mod 2*pi) per wave, and one array each for the
+// heights and the normal's x and z.  update() only has to subtract the
+// per-frame term t*w[i], which is reduced in double precision, so every
+// sine argument stays in (-2*pi, 2*pi) however long the simulation runs.
+// The sines use a polynomial approximation, four samples at a time with
+// SSE2, and the grid is split into row tiles across a ThreadPool.
+//
+// Accuracy: each approximate sine term, including the float rounding of
+// its reduced argument, is within WAVE_SIN_MAX_ERROR of the exact term,
+// so every height is within getMaxHeightError() (that bound times the
+// sum of |a[i]|) of the formula evaluated in exact arithmetic, and the
+// normal's x and z within the bound times the sum of |a[i]*k[i]|.  (The
+// shader itself, working in float on the unreduced argument, is much
+// further off than that once t grows.)
+
+struct RadialWave
+{
+	float amplitude;    // a
+	float waveNumber;   // k
+	float angularFreq;  // w
+	float phase;        // p
+};
+
+const float WAVE_SIN_MAX_ERROR = 1.0e-6f;
+
+// Polynomial sine used by WaveField; within 2.5e-7 of sin(x) for
+// |x| <= 8*pi.
+float WaveSin(float x);
+
+// sin and cos of count values at once with the same polynomial, four at
+// a time with SSE2.
+void WaveSinCos(const float* x, int count, float* sinOut, float* cosOut);
+
+class WaveField
+{
+public:
+	// Grid of numVertRows x numVertCols samples with spacing dx, dz
+	// centered at center (only x and z of center are used), with the two
+	// waves from color.fx.
+	WaveField(int numVertRows, int numVertCols, float dx, float dz,
+		const D3DXVECTOR3& center, ThreadPool* pool = 0);
+
+	// Replaces the waves; the per-sample phases are rebuilt.
+	void setWaves(const RadialWave* waves, int numWaves);
+
+	int getNumWaves()const               { return (int)mWaves.size(); }
+	const RadialWave& getWave(int i)const { return mWaves[i]; }
+
+	// Evaluates every sample at time t.  Normals cost a second sine per
+	// wave and are only refreshed when asked for.
+	void update(float t, bool computeNormals = false);
+
+	float getTime()const       { return mTime; }
+	int   getNumRows()const    { return mNumRows; }
+	int   getNumCols()const    { return mNumCols; }
+	int   getNumSamples()const { return mNumRows*mNumCols; }
+
+	// Row-major results of the last update().  The normal of sample s is
+	// (normalX[s], 1, normalZ[s]), unnormalized.
+	const float* getHeights()const { return &mHeight[0]; }
+	const float* getNormalX()const { return &mNormalX[0]; }
+	const float* getNormalZ()const { return &mNormalZ[0]; }
+
+	// Writes the grid's vertices with the current heights (stride in
+	// bytes, so it can fill any vertex format that starts with a position).
+	void writePositions(void* verts, UINT stride)const;
+
+	// Colors of the current heights through a banded palette, the same
+	// lookup color.fx does with the palette texture.
+	void writeColors(const HeightPalette& palette, D3DCOLOR* colors)const;
+
+	// Point queries at any (x, z), evaluated directly from the wave sum
+	// at the time of the last update() rather than interpolated from the
+	// grid.  (x, z) is relative to the wave source, like the grid.
+	float heightAt(float x, float z)const;
+	D3DXVECTOR3 normalAt(float x, float z)const;
+
+	float getMaxHeightError()const;
+
+private:
+	void buildPhases();
+	void updateRows(int rowBegin, int rowEnd, bool computeNormals);
+
+private:
+	int   mNumRows;
+	int   mNumCols;
+	D3DXVECTOR3 mCenter;
+	ThreadPool* mPool;
+
+	std::vector<RadialWave> mWaves;
+	float mTime;
+
+	// Per-frame term t*w[i] mod 2*pi, one per wave.
+	std::vector<float> mTimePhase;
+
+	// SoA sample data.  mPhase holds numWaves arrays of numSamples.
+	std::vector<float> mX;
+	std::vector<float> mZ;
+	std::vector<float> mDirX;   // x/d, 0 at the source.
+	std::vector<float> mDirZ;   // z/d
+	std::vector<float> mPhase;
+	std::vector<float> mHeight;
+	std::vector<float> mNormalX;
+	std::vector<float> mNormalZ;
+};
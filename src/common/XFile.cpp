@@ -0,0 +1,1373 @@
+#include "XFile.h"
+#include "MappedFile.h"
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	//===========================================================
+	// Inflate (RFC 1951), for the MSZip-compressed encodings.
+
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char* data, size_t size)
+			: mP(data), mEnd(data + size), mBits(0), mNumBits(0), mPadBytes(0) {}
+
+		// Tops the buffer up to at least 56 bits, with zeros past the end.
+		void refill()
+		{
+			// Away from the end, one unaligned load fills whole bytes.
+			if (mEnd - mP >= 8)
+			{
+				unsigned long long w;
+				memcpy(&w, mP, 8);
+				mBits |= w << mNumBits;
+				mP += (63 - mNumBits) >> 3;
+				mNumBits |= 56;
+				return;
+			}
+
+			while (mNumBits < 56)
+			{
+				unsigned long long b = 0;
+				if (mP < mEnd)
+					b = *mP++;
+				else
+					++mPadBytes;
+				mBits |= b << mNumBits;
+				mNumBits += 8;
+			}
+		}
+
+		// The next n bits, without consuming them; needs refill() first.
+		unsigned peek(int n)const { return (unsigned)(mBits & ((1ull << n) - 1)); }
+		void consume(int n)        { mBits >>= n; mNumBits -= n; }
+
+		unsigned bits(int n)
+		{
+			if (mNumBits < n)
+				refill();
+			unsigned v = peek(n);
+			consume(n);
+			return v;
+		}
+
+		void alignToByte() { consume(mNumBits & 7); }
+
+		// True once more bits were consumed than the data held.
+		bool overrun()const { return mPadBytes * 8 > mNumBits; }
+
+	private:
+		const unsigned char* mP;
+		const unsigned char* mEnd;
+		unsigned long long   mBits;
+		int                  mNumBits;
+		int                  mPadBytes;
+	};
+
+	const int FAST_BITS = 10;
+	const int MAX_CODE_BITS = 15;
+
+	// Canonical Huffman code.  Codes up to FAST_BITS long decode with one
+	// lookup of the next FAST_BITS bits: fast[bits] = symbol << 4 |
+	// length, or 0 for a longer code.
+	struct Huffman
+	{
+		unsigned short fast[1 << FAST_BITS];
+		short count[MAX_CODE_BITS + 1];  // Codes of each length.
+		short symbol[288];               // Symbols in canonical order.
+	};
+
+	bool BuildHuffman(Huffman& h, const unsigned char* lengths, int n)
+	{
+		memset(h.count, 0, sizeof(h.count));
+		for (int i = 0; i < n; ++i)
+			++h.count[lengths[i]];
+		h.count[0] = 0;
+
+		// Over-subscribed codes are corrupt; incomplete ones are legal.
+		int left = 1;
+		for (int len = 1; len <= MAX_CODE_BITS; ++len)
+		{
+			left = (left << 1) - h.count[len];
+			if (left < 0)
+				return false;
+		}
+
+		short offset[MAX_CODE_BITS + 2];
+		offset[1] = 0;
+		for (int len = 1; len <= MAX_CODE_BITS; ++len)
+			offset[len + 1] = offset[len] + h.count[len];
+		for (int i = 0; i < n; ++i)
+		{
+			if (lengths[i] != 0)
+				h.symbol[offset[lengths[i]]++] = (short)i;
+		}
+
+		// Deflate sends codes most significant bit first into a stream read
+		// from the least significant end, so each table slot is the code
+		// reversed, repeated for every value of the bits past its end.
+		memset(h.fast, 0, sizeof(h.fast));
+		int code = 0, k = 0;
+		for (int len = 1; len <= FAST_BITS; ++len, code <<= 1)
+		{
+			for (int i = 0; i < h.count[len]; ++i, ++code, ++k)
+			{
+				int reversed = 0;
+				for (int b = 0; b < len; ++b)
+					reversed |= ((code >> b) & 1) << (len - 1 - b);
+
+				for (int j = reversed; j < (1 << FAST_BITS); j += 1 << len)
+					h.fast[j] = (unsigned short)(h.symbol[k] << 4 | len);
+			}
+		}
+		return true;
+	}
+
+	int DecodeSymbol(BitReader& in, const Huffman& h)
+	{
+		in.refill();
+		unsigned e = h.fast[in.peek(FAST_BITS)];
+		if (e != 0)
+		{
+			in.consume(e & 15);
+			return (int)(e >> 4);
+		}
+
+		// A code longer than FAST_BITS: walk the canonical code a bit at a
+		// time.
+		int code = 0, first = 0, index = 0;
+		for (int len = 1; len <= MAX_CODE_BITS; ++len)
+		{
+			code |= (int)in.bits(1);
+			int count = h.count[len];
+			if (code - first < count)
+				return h.symbol[index + code - first];
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+
+	const unsigned short LENGTH_BASE[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char LENGTH_EXTRA[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned short DIST_BASE[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char DIST_EXTRA[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Inflates one deflate stream into out[pos, outSize), advancing pos.
+	// out[0, pos) is history that back-references may reach into.
+	bool Inflate(BitReader& in, unsigned char* out, size_t& pos, size_t outSize)
+	{
+		Huffman lit, dist;
+		bool last = false;
+		while (!last)
+		{
+			last = in.bits(1) != 0;
+			unsigned type = in.bits(2);
+
+			if (type == 0)
+			{
+				// Stored block.
+				in.alignToByte();
+				unsigned len  = in.bits(16);
+				unsigned nlen = in.bits(16);
+				if (len != (~nlen & 0xffff) || len > outSize - pos)
+					return false;
+				for (unsigned i = 0; i < len; ++i)
+					out[pos++] = (unsigned char)in.bits(8);
+				continue;
+			}
+
+			unsigned char lengths[288 + 32];
+			int numLit = 288, numDist = 30;
+			if (type == 1)
+			{
+				// Fixed codes.
+				memset(lengths, 8, 144);
+				memset(lengths + 144, 9, 112);
+				memset(lengths + 256, 7, 24);
+				memset(lengths + 280, 8, 8);
+				memset(lengths + 288, 5, 30);
+			}
+			else if (type == 2)
+			{
+				// Dynamic codes, themselves sent with a code-length code.
+				numLit  = (int)in.bits(5) + 257;
+				numDist = (int)in.bits(5) + 1;
+				int numCodeLengths = (int)in.bits(4) + 4;
+				if (numLit > 286 || numDist > 30)
+					return false;
+
+				static const unsigned char ORDER[19] = {
+					16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+				unsigned char codeLengths[19] = { 0 };
+				for (int i = 0; i < numCodeLengths; ++i)
+					codeLengths[ORDER[i]] = (unsigned char)in.bits(3);
+
+				Huffman lengthCode;
+				if (!BuildHuffman(lengthCode, codeLengths, 19))
+					return false;
+
+				int n = 0;
+				while (n < numLit + numDist)
+				{
+					int sym = DecodeSymbol(in, lengthCode);
+					if (sym < 0)
+						return false;
+					if (sym < 16)
+					{
+						lengths[n++] = (unsigned char)sym;
+						continue;
+					}
+
+					unsigned char value = 0;
+					int repeat;
+					if (sym == 16)
+					{
+						if (n == 0)
+							return false;
+						value = lengths[n - 1];
+						repeat = 3 + (int)in.bits(2);
+					}
+					else if (sym == 17)
+						repeat = 3 + (int)in.bits(3);
+					else
+						repeat = 11 + (int)in.bits(7);
+
+					if (n + repeat > numLit + numDist)
+						return false;
+					memset(lengths + n, value, repeat);
+					n += repeat;
+				}
+				if (lengths[256] == 0)
+					return false;
+			}
+			else
+				return false;
+
+			if (!BuildHuffman(lit, lengths, numLit) || !BuildHuffman(dist, lengths + numLit, numDist))
+				return false;
+
+			for (;;)
+			{
+				int sym = DecodeSymbol(in, lit);
+				if (sym < 256)
+				{
+					if (sym < 0 || pos == outSize)
+						return false;
+					out[pos++] = (unsigned char)sym;
+					continue;
+				}
+				if (sym == 256)
+					break;
+
+				sym -= 257;
+				if (sym >= 29)
+					return false;
+				size_t len = LENGTH_BASE[sym] + in.bits(LENGTH_EXTRA[sym]);
+
+				int dsym = DecodeSymbol(in, dist);
+				if (dsym < 0 || dsym >= 30)
+					return false;
+				size_t d = DIST_BASE[dsym] + in.bits(DIST_EXTRA[dsym]);
+
+				if (d > pos || len > outSize - pos)
+					return false;
+
+				// Copies may overlap their own output, so go eight bytes at a
+				// time only when the source is at least that far back (and
+				// the last step cannot run off the buffer).
+				const unsigned char* src = out + pos - d;
+				unsigned char* dst = out + pos;
+				if (d >= 8 && outSize - pos >= len + 8)
+				{
+					for (size_t i = 0; i < len; i += 8)
+						memcpy(dst + i, src + i, 8);
+				}
+				else
+				{
+					for (size_t i = 0; i < len; ++i)
+						dst[i] = src[i];
+				}
+				pos += len;
+			}
+		}
+		return !in.overrun();
+	}
+
+	unsigned short ReadWord(const unsigned char* p)
+	{
+		return (unsigned short)(p[0] | p[1] << 8);
+	}
+
+	unsigned int ReadDword(const unsigned char* p)
+	{
+		return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+	}
+
+	// After the 16-byte header, MSZip files hold the size of the whole
+	// decompressed file (header included), then chunks of
+	//
+	//   WORD uncompressed size, WORD compressed size, "CK", deflate data
+	//
+	// where the compressed size counts the "CK".  Each chunk is a deflate
+	// stream of its own but may refer back into earlier chunks' output.
+	bool InflateMSZip(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+	{
+		if (size < 20)
+			return false;
+
+		unsigned int total = ReadDword(data + 16);
+		if (total < 16)
+			return false;
+		out.resize(total - 16);
+
+		size_t pos = 0;
+		const unsigned char* p = data + 20;
+		const unsigned char* end = data + size;
+		while (pos < out.size())
+		{
+			if (end - p < 6)
+				return false;
+			unsigned int uncompressed = ReadWord(p);
+			unsigned int compressed   = ReadWord(p + 2);
+			p += 4;
+			if (compressed < 2 || (size_t)(end - p) < compressed || p[0] != 'C' || p[1] != 'K' ||
+				uncompressed > out.size() - pos)
+				return false;
+
+			size_t chunkEnd = pos + uncompressed;
+			BitReader in(p + 2, compressed - 2);
+			if (!Inflate(in, &out[0], pos, chunkEnd) || pos != chunkEnd)
+				return false;
+			p += compressed;
+		}
+		return true;
+	}
+
+	//===========================================================
+	// Tokenizer and parser.
+
+	enum BinaryToken
+	{
+		TOKEN_NAME         = 1,
+		TOKEN_STRING       = 2,
+		TOKEN_INTEGER      = 3,
+		TOKEN_GUID         = 5,
+		TOKEN_INTEGER_LIST = 6,
+		TOKEN_FLOAT_LIST   = 7,
+		TOKEN_OBRACE       = 10,
+		TOKEN_CBRACE       = 11,
+		TOKEN_COMMA        = 19,
+		TOKEN_SEMICOLON    = 20,
+		TOKEN_TEMPLATE     = 31,
+	};
+
+	// A token in place in the file.
+	struct Token
+	{
+		const char* text;
+		size_t      length;
+
+		Token() : text(0), length(0) {}
+		Token(const char* t, size_t n) : text(t), length(n) {}
+
+		bool empty()const { return length == 0; }
+
+		bool operator==(const char* s)const
+		{
+			return strlen(s) == length && memcmp(text, s, length) == 0;
+		}
+		bool operator!=(const char* s)const { return !(*this == s); }
+
+		std::string str()const { return std::string(text, length); }
+	};
+
+	inline bool IsSeparator(char c)
+	{
+		return (unsigned char)c <= ' ' || c == ',' || c == ';';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return (unsigned)(c - '0') < 10;
+	}
+
+	// Powers of ten a double holds exactly, for ParseFloat.
+	const double POW10[23] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	// Row-major, for row vectors: p' = p*M.
+	struct Matrix
+	{
+		float m[4][4];
+	};
+
+	Matrix IdentityMatrix()
+	{
+		Matrix r;
+		memset(&r, 0, sizeof(r));
+		r.m[0][0] = r.m[1][1] = r.m[2][2] = r.m[3][3] = 1.0f;
+		return r;
+	}
+
+	Matrix Multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix r;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j] + a.m[i][3]*b.m[3][j];
+		return r;
+	}
+
+	// White, for meshes without materials and unresolved references.
+	XFileMaterial DefaultMaterial()
+	{
+		XFileMaterial m;
+		for (int i = 0; i < 4; ++i)
+			m.diffuse[i] = 1.0f;
+		m.specPower = 0.0f;
+		for (int i = 0; i < 3; ++i)
+			m.spec[i] = m.emissive[i] = 0.0f;
+		return m;
+	}
+
+	// One Mesh object as the file stores it, before it is split into
+	// vertices and triangles.
+	struct RawMesh
+	{
+		std::vector<float>        positions;    // Three per vertex.
+		std::vector<unsigned int> faceSizes;    // Corners of each polygon.
+		std::vector<unsigned int> faceIndices;  // The corners, in order.
+		std::vector<float>        normals;
+		std::vector<unsigned int> normalIndices;  // Like faceIndices.
+		std::vector<float>        texCoords;      // Two per vertex.
+		std::vector<unsigned int> faceMaterials;
+		std::vector<XFileMaterial> materials;
+		bool hasNormals;
+		bool hasMaterialList;
+	};
+
+	class XFileParser
+	{
+	public:
+		XFileParser(const char* data, size_t size, bool binary, int floatSize)
+			: mP(data), mEnd(data + size), mBinary(binary), mFloatSize(floatSize),
+			  mListCount(0), mListElementSize(0), mFailed(false), mMesh(0) {}
+
+		bool parse(XFileMesh* mesh, std::string* error);
+
+	private:
+		Token next();
+		void  skipSeparators();
+		void  fail(const char* why);
+
+		// The optional object name and '{' after a template name.
+		Token readHead();
+		// Skips to the '}' matching an already read '{'.
+		void  skipToEnd();
+		// Reads a '}' closing an object that has no more children.
+		void  readEnd();
+
+		unsigned int readInt();
+		float        readFloat();
+		Token        readString();
+		bool         startBinaryList(int token);
+		bool         checkCount(unsigned int count, size_t bytesPerItem);
+
+		void parseFrame(const Matrix& parent);
+		void parseMesh(const Matrix& world);
+		void parseMeshNormals(RawMesh& raw);
+		void parseMaterialList(RawMesh& raw);
+		// Returns the material's object name.
+		Token parseMaterial(XFileMaterial& material);
+		void emitMesh(const RawMesh& raw, const Matrix& world);
+
+	private:
+		const char* mP;
+		const char* mEnd;
+		bool        mBinary;
+		int         mFloatSize;  // 4 or 8 bytes, for binary float lists.
+
+		// Binary numbers come in lists; what is left of the current one.
+		unsigned int mListCount;
+		int          mListElementSize;
+
+		bool        mFailed;
+		std::string mError;
+
+		XFileMesh* mMesh;
+		bool mAllHaveNormals;
+		bool mAllHaveTexCoords;
+
+		// Top-level materials, which material lists may refer to by name.
+		std::vector<std::string>   mNamedMaterialNames;
+		std::vector<XFileMaterial> mNamedMaterials;
+	};
+
+	void XFileParser::fail(const char* why)
+	{
+		if (!mFailed)
+		{
+			mFailed = true;
+			mError = why;
+		}
+		// Every read from here on sees the end of the file, so all loops end.
+		mP = mEnd;
+		mListCount = 0;
+	}
+
+	void XFileParser::skipSeparators()
+	{
+		const char* p = mP;
+		for (;;)
+		{
+			while (p < mEnd && IsSeparator(*p))
+				++p;
+
+			// Comments run to the end of the line.
+			if (p < mEnd && (*p == '#' || (*p == '/' && p + 1 < mEnd && p[1] == '/')))
+			{
+				while (p < mEnd && *p != '\n')
+					++p;
+			}
+			else
+				break;
+		}
+		mP = p;
+	}
+
+	Token XFileParser::next()
+	{
+		if (mBinary)
+		{
+			// Skip whatever a data object left of its number lists.
+			if (mListCount != 0)
+			{
+				if ((size_t)(mEnd - mP) / mListElementSize < mListCount)
+				{
+					fail("unexpected end of file");
+					return Token();
+				}
+				mP += (size_t)mListCount * mListElementSize;
+				mListCount = 0;
+			}
+
+			for (;;)
+			{
+				if (mEnd - mP < 2)
+					return Token();
+
+				const unsigned char* p = (const unsigned char*)mP;
+				int token = ReadWord(p);
+				mP += 2;
+
+				size_t left = mEnd - mP;
+				switch (token)
+				{
+				case TOKEN_NAME:
+				case TOKEN_STRING:
+				{
+					// Strings end with a separator token.
+					size_t tail = token == TOKEN_STRING ? 2 : 0;
+					if (left < 4 || left - 4 < ReadDword(p + 2) + tail)
+					{
+						fail("unexpected end of file");
+						return Token();
+					}
+					size_t length = ReadDword(p + 2);
+					Token t(mP + 4, length);
+					mP += 4 + length + tail;
+					if (length == 0)
+						continue;
+					return t;
+				}
+
+				case TOKEN_INTEGER:
+				case TOKEN_GUID:
+				case TOKEN_INTEGER_LIST:
+				case TOKEN_FLOAT_LIST:
+				{
+					// Data outside any object this parser reads.
+					size_t bytes = token == TOKEN_INTEGER ? 4 : token == TOKEN_GUID ? 16 : 4;
+					if (token == TOKEN_INTEGER_LIST || token == TOKEN_FLOAT_LIST)
+					{
+						if (left < 4)
+						{
+							fail("unexpected end of file");
+							return Token();
+						}
+						size_t n = ReadDword(p + 2);
+						size_t size = token == TOKEN_INTEGER_LIST ? 4 : mFloatSize;
+						if ((left - 4) / size < n)
+						{
+							fail("unexpected end of file");
+							return Token();
+						}
+						bytes = 4 + n * size;
+					}
+					if (left < bytes)
+					{
+						fail("unexpected end of file");
+						return Token();
+					}
+					mP += bytes;
+					return Token("<data>", 6);
+				}
+
+				case TOKEN_OBRACE:   return Token("{", 1);
+				case TOKEN_CBRACE:   return Token("}", 1);
+				case TOKEN_TEMPLATE: return Token("template", 8);
+
+				case TOKEN_COMMA:
+				case TOKEN_SEMICOLON:
+					continue;
+
+				default:
+					// The other tokens only appear inside templates.
+					return Token("<token>", 7);
+				}
+			}
+		}
+
+		skipSeparators();
+		if (mP >= mEnd)
+			return Token();
+
+		const char* start = mP;
+		if (*mP == '{' || *mP == '}')
+		{
+			++mP;
+			return Token(start, 1);
+		}
+
+		if (*mP == '"')
+		{
+			const char* close = (const char*)memchr(mP + 1, '"', mEnd - mP - 1);
+			if (close == 0)
+			{
+				fail("unterminated string");
+				return Token();
+			}
+			mP = close + 1;
+			return Token(start + 1, close - start - 1);
+		}
+
+		if (*mP == '<')
+		{
+			const char* close = (const char*)memchr(mP, '>', mEnd - mP);
+			mP = close ? close + 1 : mEnd;
+			return Token(start, mP - start);
+		}
+
+		while (mP < mEnd && !IsSeparator(*mP) && *mP != '{' && *mP != '}' && *mP != '"' && *mP != '<')
+			++mP;
+		return Token(start, mP - start);
+	}
+
+	Token XFileParser::readHead()
+	{
+		Token t = next();
+		if (t == "{")
+			return Token("", 0);
+
+		Token name = t;
+		if (next() != "{")
+			fail("expected '{'");
+		return name;
+	}
+
+	void XFileParser::skipToEnd()
+	{
+		int depth = 1;
+		while (depth > 0)
+		{
+			Token t = next();
+			if (t.empty())
+			{
+				fail("unexpected end of file");
+				return;
+			}
+			if (t == "{")
+				++depth;
+			else if (t == "}")
+				--depth;
+		}
+	}
+
+	void XFileParser::readEnd()
+	{
+		if (next() != "}")
+			fail("expected '}'");
+	}
+
+	bool XFileParser::startBinaryList(int expected)
+	{
+		if (mEnd - mP < 6)
+		{
+			fail("unexpected end of file");
+			return false;
+		}
+
+		int token = ReadWord((const unsigned char*)mP);
+		if (token != expected && token != TOKEN_INTEGER)
+		{
+			fail(expected == TOKEN_INTEGER_LIST ? "expected an integer" : "expected a float");
+			return false;
+		}
+
+		if (token == TOKEN_INTEGER)
+		{
+			mListCount = 1;
+			mListElementSize = 4;
+			mP += 2;
+		}
+		else
+		{
+			mListCount = ReadDword((const unsigned char*)mP + 2);
+			mListElementSize = expected == TOKEN_INTEGER_LIST ? 4 : mFloatSize;
+			mP += 6;
+			if ((size_t)(mEnd - mP) / mListElementSize < mListCount)
+			{
+				fail("unexpected end of file");
+				return false;
+			}
+		}
+		return mListCount != 0 || startBinaryList(expected);
+	}
+
+	unsigned int XFileParser::readInt()
+	{
+		if (mBinary)
+		{
+			if (mListCount == 0 && !startBinaryList(TOKEN_INTEGER_LIST))
+				return 0;
+			if (mListElementSize != 4)
+			{
+				fail("expected an integer");
+				return 0;
+			}
+			--mListCount;
+			unsigned int v = ReadDword((const unsigned char*)mP);
+			mP += 4;
+			return v;
+		}
+
+		skipSeparators();
+		const char* p = mP;
+		bool negative = p < mEnd && *p == '-';
+		if (negative)
+			++p;
+		if (p == mEnd || !IsDigit(*p))
+		{
+			fail("expected an integer");
+			return 0;
+		}
+
+		unsigned int v = 0;
+		while (p < mEnd && IsDigit(*p))
+			v = v*10 + (*p++ - '0');
+		mP = p;
+		return negative ? 0u - v : v;
+	}
+
+	float XFileParser::readFloat()
+	{
+		if (mBinary)
+		{
+			if (mListCount == 0 && !startBinaryList(TOKEN_FLOAT_LIST))
+				return 0.0f;
+			--mListCount;
+
+			// Some exporters write integer lists where floats belong.
+			if (mListElementSize == 4 && mFloatSize == 8)
+			{
+				mP += 4;
+				return (float)(int)ReadDword((const unsigned char*)mP - 4);
+			}
+			if (mListElementSize == 8)
+			{
+				double d;
+				memcpy(&d, mP, 8);
+				mP += 8;
+				return (float)d;
+			}
+			float f;
+			memcpy(&f, mP, 4);
+			mP += 4;
+			return f;
+		}
+
+		// Text: sign, digits, fraction and exponent gathered into an
+		// integer and a power of ten, then scaled once.
+		skipSeparators();
+		const char* p = mP;
+		bool negative = false;
+		if (p < mEnd && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		unsigned long long mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool any = false;
+		for (; p < mEnd && IsDigit(*p); ++p, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa*10 + (*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+				++exponent;
+		}
+		if (p < mEnd && *p == '.')
+		{
+			for (++p; p < mEnd && IsDigit(*p); ++p, any = true)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa*10 + (*p - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+		if (!any)
+		{
+			fail("expected a float");
+			return 0.0f;
+		}
+		if (p < mEnd && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < mEnd && (*e == '-' || *e == '+'))
+				negativeExponent = *e++ == '-';
+			if (e < mEnd && IsDigit(*e))
+			{
+				int x = 0;
+				for (; e < mEnd && IsDigit(*e); ++e)
+					x = x < 10000 ? x*10 + (*e - '0') : x;
+				exponent += negativeExponent ? -x : x;
+				p = e;
+			}
+		}
+		mP = p;
+
+		double v = (double)mantissa;
+		if (exponent < 0)
+			v = exponent >= -22 ? v / POW10[-exponent] : v * pow(10.0, exponent);
+		else if (exponent > 0)
+			v = exponent <= 22 ? v * POW10[exponent] : v * pow(10.0, exponent);
+		return (float)(negative ? -v : v);
+	}
+
+	Token XFileParser::readString()
+	{
+		if (mBinary)
+		{
+			if (mEnd - mP < 2 || ReadWord((const unsigned char*)mP) != TOKEN_STRING)
+			{
+				fail("expected a string");
+				return Token();
+			}
+			return next();
+		}
+
+		skipSeparators();
+		if (mP == mEnd || *mP != '"')
+		{
+			fail("expected a string");
+			return Token();
+		}
+		return next();
+	}
+
+	// Lists must fit in what is left of the file, so a corrupt count
+	// fails here instead of in a huge allocation.
+	bool XFileParser::checkCount(unsigned int count, size_t bytesPerItem)
+	{
+		if ((size_t)(mEnd - mP) / bytesPerItem < count)
+		{
+			fail("count larger than the file");
+			return false;
+		}
+		return true;
+	}
+
+	bool XFileParser::parse(XFileMesh* mesh, std::string* error)
+	{
+		mMesh = mesh;
+		mAllHaveNormals = true;
+		mAllHaveTexCoords = true;
+		int numMeshes = 0;
+
+		Matrix identity = IdentityMatrix();
+		for (;;)
+		{
+			Token t = next();
+			if (t.empty())
+				break;
+
+			if (t == "Frame")
+				parseFrame(identity);
+			else if (t == "Mesh")
+			{
+				parseMesh(identity);
+				++numMeshes;
+			}
+			else if (t == "Material")
+			{
+				XFileMaterial m = DefaultMaterial();
+				mNamedMaterialNames.push_back(parseMaterial(m).str());
+				mNamedMaterials.push_back(m);
+			}
+			else if (t == "{")
+				skipToEnd();
+			else
+			{
+				readHead();
+				skipToEnd();
+			}
+		}
+
+		if (!mFailed && mesh->indices.empty())
+			fail("no mesh in file");
+
+		mesh->hasNormals   = mAllHaveNormals;
+		mesh->hasTexCoords = mAllHaveTexCoords;
+
+		if (mFailed && error)
+			*error = mError;
+		return !mFailed;
+	}
+
+	void XFileParser::parseFrame(const Matrix& parent)
+	{
+		readHead();
+
+		// FrameTransformMatrix comes first, and applies to everything
+		// after it in the frame.
+		Matrix world = parent;
+		for (;;)
+		{
+			Token t = next();
+			if (t.empty() || t == "}")
+				break;
+
+			if (t == "FrameTransformMatrix")
+			{
+				readHead();
+				Matrix local;
+				for (int i = 0; i < 16; ++i)
+					local.m[i / 4][i % 4] = readFloat();
+				readEnd();
+				world = Multiply(local, parent);
+			}
+			else if (t == "Frame")
+				parseFrame(world);
+			else if (t == "Mesh")
+				parseMesh(world);
+			else if (t == "{")
+				skipToEnd();  // A reference to an object defined elsewhere.
+			else
+			{
+				readHead();
+				skipToEnd();
+			}
+		}
+	}
+
+	void XFileParser::parseMesh(const Matrix& world)
+	{
+		readHead();
+
+		RawMesh raw;
+		raw.hasNormals = false;
+		raw.hasMaterialList = false;
+
+		unsigned int numVertices = readInt();
+		if (!checkCount(numVertices, 3))
+			return;
+		raw.positions.resize((size_t)numVertices * 3);
+		for (size_t i = 0; i < raw.positions.size(); ++i)
+			raw.positions[i] = readFloat();
+
+		unsigned int numFaces = readInt();
+		if (!checkCount(numFaces, 4))
+			return;
+		raw.faceSizes.resize(numFaces);
+		raw.faceIndices.reserve((size_t)numFaces * 3);
+		for (unsigned int f = 0; f < numFaces && !mFailed; ++f)
+		{
+			unsigned int n = readInt();
+			if (n < 3 || !checkCount(n, 1))
+			{
+				fail("bad face");
+				return;
+			}
+			raw.faceSizes[f] = n;
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				unsigned int index = readInt();
+				if (index >= numVertices)
+				{
+					fail("face index out of range");
+					return;
+				}
+				raw.faceIndices.push_back(index);
+			}
+		}
+
+		for (;;)
+		{
+			Token t = next();
+			if (t.empty() || t == "}")
+				break;
+
+			if (t == "MeshNormals")
+				parseMeshNormals(raw);
+			else if (t == "MeshTextureCoords")
+			{
+				readHead();
+				unsigned int numCoords = readInt();
+				if (numCoords != numVertices)
+				{
+					fail("texture coordinate count differs from vertex count");
+					return;
+				}
+				raw.texCoords.resize((size_t)numCoords * 2);
+				for (size_t i = 0; i < raw.texCoords.size(); ++i)
+					raw.texCoords[i] = readFloat();
+				readEnd();
+			}
+			else if (t == "MeshMaterialList")
+				parseMaterialList(raw);
+			else if (t == "{")
+				skipToEnd();
+			else
+			{
+				readHead();
+				skipToEnd();
+			}
+		}
+
+		if (!mFailed)
+			emitMesh(raw, world);
+	}
+
+	void XFileParser::parseMeshNormals(RawMesh& raw)
+	{
+		readHead();
+
+		unsigned int numNormals = readInt();
+		if (!checkCount(numNormals, 3))
+			return;
+		raw.normals.resize((size_t)numNormals * 3);
+		for (size_t i = 0; i < raw.normals.size(); ++i)
+			raw.normals[i] = readFloat();
+
+		// Normal faces mirror the mesh's faces corner for corner.
+		unsigned int numFaces = readInt();
+		if (numFaces != raw.faceSizes.size())
+		{
+			fail("normal face count differs from face count");
+			return;
+		}
+		raw.normalIndices.resize(raw.faceIndices.size());
+		size_t k = 0;
+		for (unsigned int f = 0; f < numFaces && !mFailed; ++f)
+		{
+			if (readInt() != raw.faceSizes[f])
+			{
+				fail("normal face size differs from face size");
+				return;
+			}
+			for (unsigned int i = 0; i < raw.faceSizes[f]; ++i, ++k)
+			{
+				raw.normalIndices[k] = readInt();
+				if (raw.normalIndices[k] >= numNormals)
+				{
+					fail("normal index out of range");
+					return;
+				}
+			}
+		}
+		raw.hasNormals = true;
+		readEnd();
+	}
+
+	void XFileParser::parseMaterialList(RawMesh& raw)
+	{
+		readHead();
+
+		unsigned int numMaterials = readInt();
+		unsigned int numFaceIndices = readInt();
+		if (!checkCount(numFaceIndices, 1))
+			return;
+
+		// Files may list fewer faces than the mesh has; the last index
+		// then applies to the rest.
+		raw.faceMaterials.resize(raw.faceSizes.size());
+		for (unsigned int f = 0; f < numFaceIndices; ++f)
+		{
+			unsigned int m = readInt();
+			if (f < raw.faceMaterials.size())
+				raw.faceMaterials[f] = m;
+		}
+		for (size_t f = numFaceIndices; f < raw.faceMaterials.size(); ++f)
+			raw.faceMaterials[f] = numFaceIndices != 0 ? raw.faceMaterials[numFaceIndices - 1] : 0;
+
+		for (;;)
+		{
+			Token t = next();
+			if (t.empty() || t == "}")
+				break;
+
+			if (t == "Material")
+			{
+				raw.materials.push_back(DefaultMaterial());
+				parseMaterial(raw.materials.back());
+			}
+			else if (t == "{")
+			{
+				// A reference to a top-level material by name.
+				Token name = next();
+				XFileMaterial m = DefaultMaterial();
+				for (size_t i = 0; i < mNamedMaterialNames.size(); ++i)
+				{
+					if (!name.empty() && name == mNamedMaterialNames[i].c_str())
+						m = mNamedMaterials[i];
+				}
+				raw.materials.push_back(m);
+				if (name != "}")
+					skipToEnd();
+			}
+			else
+			{
+				readHead();
+				skipToEnd();
+			}
+		}
+
+		if (raw.materials.size() < numMaterials)
+			raw.materials.resize(numMaterials, DefaultMaterial());
+		for (size_t f = 0; f < raw.faceMaterials.size(); ++f)
+		{
+			if (raw.faceMaterials[f] >= raw.materials.size())
+			{
+				fail("material index out of range");
+				return;
+			}
+		}
+		raw.hasMaterialList = true;
+	}
+
+	Token XFileParser::parseMaterial(XFileMaterial& material)
+	{
+		Token name = readHead();
+
+		for (int i = 0; i < 4; ++i)
+			material.diffuse[i] = readFloat();
+		material.specPower = readFloat();
+		for (int i = 0; i < 3; ++i)
+			material.spec[i] = readFloat();
+		for (int i = 0; i < 3; ++i)
+			material.emissive[i] = readFloat();
+
+		for (;;)
+		{
+			Token t = next();
+			if (t.empty() || t == "}")
+				break;
+
+			if (t == "TextureFilename" || t == "TextureFileName")
+			{
+				readHead();
+				material.textureFilename = readString().str();
+				readEnd();
+			}
+			else if (t == "{")
+				skipToEnd();
+			else
+			{
+				readHead();
+				skipToEnd();
+			}
+		}
+		return name;
+	}
+
+	void XFileParser::emitMesh(const RawMesh& raw, const Matrix& world)
+	{
+		XFileMesh& out = *mMesh;
+		mAllHaveNormals   = mAllHaveNormals && raw.hasNormals;
+		mAllHaveTexCoords = mAllHaveTexCoords && !raw.texCoords.empty();
+
+		// Materials go after those of the meshes before.
+		unsigned int firstMaterial = (unsigned int)out.materials.size();
+		if (raw.hasMaterialList && !raw.materials.empty())
+			out.materials.insert(out.materials.end(), raw.materials.begin(), raw.materials.end());
+		else
+			out.materials.push_back(DefaultMaterial());
+
+		// Normals transform by the inverse transpose of the upper 3x3,
+		// which up to scale (irrelevant once normalized) is its cofactor
+		// matrix, negated if the frame mirrors.
+		const float (*m)[4] = world.m;
+		float c[3][3];
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+				int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				c[i][j] = m[i1][j1]*m[i2][j2] - m[i1][j2]*m[i2][j1];
+			}
+		}
+		float det = m[0][0]*c[0][0] + m[0][1]*c[0][1] + m[0][2]*c[0][2];
+		float sign = det < 0.0f ? -1.0f : 1.0f;
+
+		// One vertex per distinct (position, normal) pair: firstVertex[p]
+		// starts a chain through nextVertex of the vertices made from p.
+		size_t numPositions = raw.positions.size() / 3;
+		size_t base = out.vertices.size();
+		size_t firstIndex = out.indices.size();
+		std::vector<int> firstVertex(numPositions, -1);
+		std::vector<int> nextVertex;
+		std::vector<unsigned int> vertexNormal;
+		nextVertex.reserve(numPositions);
+		vertexNormal.reserve(numPositions);
+		out.vertices.reserve(base + numPositions);
+
+		size_t numTriangles = raw.faceIndices.size() - 2 * raw.faceSizes.size();
+		out.indices.reserve(firstIndex + 3 * numTriangles);
+		out.attributes.reserve(out.attributes.size() + numTriangles);
+
+		std::vector<unsigned int> corner;
+		size_t k = 0;
+		for (size_t f = 0; f < raw.faceSizes.size(); ++f)
+		{
+			unsigned int n = raw.faceSizes[f];
+			corner.resize(n);
+			for (unsigned int i = 0; i < n; ++i, ++k)
+			{
+				unsigned int p = raw.faceIndices[k];
+				unsigned int nrm = raw.hasNormals ? raw.normalIndices[k] : 0;
+
+				int v = firstVertex[p];
+				while (v >= 0 && vertexNormal[v] != nrm)
+					v = nextVertex[v];
+
+				if (v < 0)
+				{
+					v = (int)nextVertex.size();
+					nextVertex.push_back(firstVertex[p]);
+					vertexNormal.push_back(nrm);
+					firstVertex[p] = v;
+
+					XFileVertex vertex;
+					const float* src = &raw.positions[3*p];
+					for (int j = 0; j < 3; ++j)
+						vertex.pos[j] = src[0]*m[0][j] + src[1]*m[1][j] + src[2]*m[2][j] + m[3][j];
+
+					if (raw.hasNormals)
+					{
+						const float* s = &raw.normals[3*nrm];
+						float len2 = 0.0f;
+						for (int j = 0; j < 3; ++j)
+						{
+							vertex.normal[j] = sign * (s[0]*c[0][j] + s[1]*c[1][j] + s[2]*c[2][j]);
+							len2 += vertex.normal[j]*vertex.normal[j];
+						}
+						float inv = len2 > 0.0f ? 1.0f / sqrtf(len2) : 0.0f;
+						for (int j = 0; j < 3; ++j)
+							vertex.normal[j] *= inv;
+					}
+					else
+						vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+
+					vertex.tex0[0] = raw.texCoords.empty() ? 0.0f : raw.texCoords[2*p];
+					vertex.tex0[1] = raw.texCoords.empty() ? 0.0f : raw.texCoords[2*p + 1];
+					out.vertices.push_back(vertex);
+				}
+				corner[i] = (unsigned int)(base + v);
+			}
+
+			// Polygons become fans around their first corner.
+			unsigned int attribute = firstMaterial + (raw.hasMaterialList ? raw.faceMaterials[f] : 0);
+			for (unsigned int i = 1; i + 1 < n; ++i)
+			{
+				out.indices.push_back(corner[0]);
+				out.indices.push_back(corner[i]);
+				out.indices.push_back(corner[i + 1]);
+				out.attributes.push_back(attribute);
+			}
+		}
+	}
+}
+
+bool ParseXFile(const void* data, size_t size, XFileMesh* mesh, std::string* error)
+{
+	*mesh = XFileMesh();
+
+	// "xof 0303txt 0032": magic, version, format, float bits.
+	const char* header = (const char*)data;
+	if (size < 16 || memcmp(header, "xof ", 4) != 0)
+	{
+		if (error)
+			*error = "not an .x file";
+		return false;
+	}
+
+	bool binary = memcmp(header + 8, "bin ", 4) == 0 || memcmp(header + 8, "bzip", 4) == 0;
+	bool text   = memcmp(header + 8, "txt ", 4) == 0 || memcmp(header + 8, "tzip", 4) == 0;
+	bool zip    = memcmp(header + 8, "tzip", 4) == 0 || memcmp(header + 8, "bzip", 4) == 0;
+	int floatSize = memcmp(header + 12, "0064", 4) == 0 ? 8 : 4;
+	if (!binary && !text)
+	{
+		if (error)
+			*error = "unknown .x format";
+		return false;
+	}
+
+	std::vector<unsigned char> inflated;
+	const char* body = header + 16;
+	size_t bodySize = size - 16;
+	if (zip)
+	{
+		if (!InflateMSZip((const unsigned char*)data, size, inflated))
+		{
+			if (error)
+				*error = "corrupt compressed data";
+			return false;
+		}
+		body = inflated.empty() ? body : (const char*)&inflated[0];
+		bodySize = inflated.size();
+	}
+
+	XFileParser parser(body, bodySize, binary, floatSize);
+	return parser.parse(mesh, error);
+}
+
+bool LoadXFileMesh(const std::wstring& filename, XFileMesh* mesh, std::string* error)
+{
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		if (error)
+			*error = "could not open file";
+		return false;
+	}
+	return ParseXFile(file.getData(), file.getSize(), mesh, error);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+//===============================================================
+// .x mesh parser independent of D3DX.
+//
+// Reads DirectX .x files in every encoding the format has: text
+// ("txt "), binary ("bin ") and both MSZip-compressed forms ("tzip",
+// "bzip"), with 32- or 64-bit floats.  It understands the templates
+// that make up a static mesh,
+//
+//   Frame, FrameTransformMatrix, Mesh, MeshNormals, MeshTextureCoords,
+//   MeshMaterialList, Material, TextureFilename
+//
+// and skips everything else (templates, animation, skin data) by brace
+// matching.  Like D3DXLoadMeshFromX, every mesh in the file is
+// collapsed into one, transformed by its frames, with one attribute
+// (subset) per material.  Polygons are split into triangle fans, and
+// a vertex is emitted for each distinct position/normal pair a face
+// uses.  Meshes without MeshNormals get one vertex per position with a
+// zero normal, and hasNormals is false; ComputeXFileNormals (Normals.h)
+// fills them in as LoadXFile does.  Meshes without a material list get
+// a white one.
+//
+// Uncompressed files are tokenized in place: names and strings are
+// pointers into the mapped file and numbers are converted straight from
+// its bytes, so nothing is copied before it lands in the output arrays.
+// Compressed files are inflated into one buffer first.
+//
+// The parser needs only the C++ standard library (and MappedFile), so
+// it also builds in the Linux asset pipeline.
+
+// Laid out exactly as VertexPNT, so vertices can be copied straight into
+// a VertexPNT vertex buffer.
+struct XFileVertex
+{
+	float pos[3];
+	float normal[3];
+	float tex0[2];
+};
+
+// Material as the file stores it; LoadXFile uses diffuse for ambient.
+struct XFileMaterial
+{
+	float diffuse[4];
+	float specPower;
+	float spec[3];
+	float emissive[3];
+	std::string textureFilename;  // Relative to the .x file; empty for none.
+};
+
+struct XFileMesh
+{
+	std::vector<XFileVertex>   vertices;
+	std::vector<unsigned int>  indices;     // Three per triangle.
+	std::vector<unsigned int>  attributes;  // Material of each triangle.
+	std::vector<XFileMaterial> materials;
+
+	bool hasNormals;    // Every mesh in the file had MeshNormals.
+	bool hasTexCoords;  // Every mesh in the file had MeshTextureCoords.
+
+	XFileMesh() : hasNormals(false), hasTexCoords(false) {}
+};
+
+// Parses an .x file held in memory into mesh (replacing its contents).
+// On failure returns false with a reason in *error, if given.
+bool ParseXFile(const void* data, size_t size, XFileMesh* mesh, std::string* error = 0);
+
+// Maps filename and parses it.
+bool LoadXFileMesh(const std::wstring& filename, XFileMesh* mesh, std::string* error = 0);
@@ -1,4 +1,5 @@
 #include "d3dApp.h"
+#include "TextureCache.h"
 #include <string>
 
 using namespace std;
@@ -29,10 +30,16 @@ D3DApp::D3DApp(HINSTANCE hInstance, std::wstring winCaption, D3DDEVTYPE devType,
 
 	initMainWindow();
 	initDirect3D();
+
+	gTextureCache = new TextureCache();
 }
 
 D3DApp::~D3DApp()
 {
+	// The demos have released their textures by now, so this frees
+	// them before the device goes.
+	SafeDelete(gTextureCache);
+
 	SafeRelease(md3dObject);
 	SafeRelease(gd3dDevice);
 }
@@ -1,5 +1,9 @@
 #include "d3dUtil.h"
 #include "Vertex.h"
+#include "TriGrid.h"
+#include "TextureCache.h"
+#include "MeshOptimizer.h"
+#include "Normals.h"
 #include <codecvt>
 
 void GenTriGrid(int numVertRows, int numVertCols, float dx, float dz, 
@@ -10,58 +14,20 @@ void GenTriGrid(int numVertRows, int numVertCols, float dx, float dz,
 	int numCellCols = numVertCols-1;
 
 	int numTris = numCellRows*numCellCols*2;
-	float width = (float)numCellCols * dx;
-	float depth = (float)numCellRows * dz;
 
-	// vertex generation
 	verts.resize(numVertices);
-
-	float xOffset = -width * 0.5f;
-	float zOffset =  depth * 0.5f;
-
-	int k = 0;
-	for (float i = 0; i < numVertRows; ++i)
-	{
-		for (float j = 0; j < numVertCols; ++j)
-		{
-			verts[k].x =  j * dx + xOffset;
-			verts[k].z = -i * dz + zOffset;
-			verts[k].y = 0.0f;
-
-			D3DXMATRIX T;
-			D3DXMatrixTranslation(&T, center.x, center.y, center.z);
-			D3DXVec3TransformCoord(&verts[k], &verts[k], &T);
-
-			++k;
-		}
-	}
-
-	// index generation
 	indices.resize(numTris*3);
 
-	k = 0;
-	for (DWORD i = 0; i < (DWORD)numCellRows; ++i)
-	{
-		for (DWORD j = 0; j < (DWORD)numCellCols; ++j)
-		{
-			indices[k]   =   i   * numVertCols + j;
-			indices[k+1] =   i   * numVertCols + j + 1;
-			indices[k+2] = (i+1) * numVertCols + j;
-
-			indices[k+3] = (i+1) * numVertCols + j;
-			indices[k+4] =   i   * numVertCols + j + 1;
-			indices[k+5] = (i+1) * numVertCols + j + 1;
-
-			k += 6;
-		}
-	}
+	GenTriGrid(numVertRows, numVertCols, dx, dz, center,
+		verts.empty() ? 0 : &verts[0], indices.empty() ? 0 : &indices[0]);
 }
 
 void LoadXFile(
 	const std::wstring& filename,
 	ID3DXMesh** meshOut,
 	std::vector<Material>& materials,
-	std::vector<IDirect3DTexture9*>& textures)
+	std::vector<IDirect3DTexture9*>& textures,
+	std::vector<std::string>* textureNames)
 {
 	// Step 1: Load the .x file from file into a system memory mesh.
 
@@ -111,28 +77,25 @@ void LoadXFile(
 	// Step 4: If the mesh did not have normals, generate them.
 
 	if (hasNormals == false)
-		HR(D3DXComputeNormals(meshSys, 0));
+		ComputeVertexNormals(meshSys);
 
 
-	// Step 5: Optimize the mesh.
+	// Step 5: Optimize the mesh.  D3DX only compacts it and sorts it by
+	// subset; OptimizeMesh orders each subset for the vertex cache and
+	// overdraw, and the vertices for fetching.
 	
-	HR(meshSys->Optimize(D3DXMESH_MANAGED | D3DXMESHOPT_COMPACT | D3DXMESHOPT_ATTRSORT | D3DXMESHOPT_VERTEXCACHE,
+	HR(meshSys->Optimize(D3DXMESH_MANAGED | D3DXMESHOPT_COMPACT | D3DXMESHOPT_ATTRSORT,
 		(DWORD*)adjBuffer->GetBufferPointer(), 0, 0, 0, meshOut));
 	SafeRelease(meshSys);
 	SafeRelease(adjBuffer);
 
+	OptimizeMesh(*meshOut);
+
 
 	// Step 6: Extract the materials and load the textures.
 	if (mtrlBuffer != 0 && numMtrls != 0)
 	{
-		std::wstring basepath;
-		auto pos = filename.rfind(L"/");
-		if (pos != std::string::npos)
-		{
-			basepath = filename.substr(0, pos+1);
-		}
-
-		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		std::vector<std::string> names;
 
 		D3DXMATERIAL* d3dxmtrls = (D3DXMATERIAL*)mtrlBuffer->GetBufferPointer();
 		for (DWORD i = 0; i < numMtrls; ++i)
@@ -146,22 +109,91 @@ void LoadXFile(
 			m.specPower = d3dxmtrls[i].MatD3D.Power;
 			materials.push_back(m);
 
-			// Check if the i-th material has an associative texture
-			if (d3dxmtrls[i].pTextureFilename != 0)
-			{
-				// Yes, load the texture for the i-th subset
-				IDirect3DTexture9* tex = 0;
-				std::wstring texFN = basepath + converter.from_bytes(d3dxmtrls[i].pTextureFilename);
-				HR(D3DXCreateTextureFromFile(gd3dDevice, texFN.c_str(), &tex));
-
-				textures.push_back(tex);
-			}
-			else
-			{
-				textures.push_back(nullptr);
-			}
+			// Remember the i-th material's texture, if it has one
+			names.push_back(d3dxmtrls[i].pTextureFilename != 0 ? d3dxmtrls[i].pTextureFilename : "");
 		}
+
+		LoadXFileTextures(filename, names, textures);
+		if (textureNames)
+			textureNames->insert(textureNames->end(), names.begin(), names.end());
 	}
 
 	SafeRelease(mtrlBuffer);
-}
\ No newline at end of file
+}
+
+void LoadXFileTextures(
+	const std::wstring& filename,
+	const std::vector<std::string>& textureNames,
+	std::vector<IDirect3DTexture9*>& textures)
+{
+	std::wstring basepath;
+	auto pos = filename.rfind(L"/");
+	if (pos != std::string::npos)
+	{
+		basepath = filename.substr(0, pos+1);
+	}
+
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+
+	for (size_t i = 0; i < textureNames.size(); ++i)
+	{
+		if (!textureNames[i].empty())
+		{
+			// Load the texture for the i-th subset.  Subsets sharing a
+			// texture get the same one from the cache.
+			IDirect3DTexture9* tex = 0;
+			std::wstring texFN = basepath + converter.from_bytes(textureNames[i]);
+			HR(LoadTextureCached(texFN, &tex));
+
+			textures.push_back(tex);
+		}
+		else
+		{
+			textures.push_back(nullptr);
+		}
+	}
+}
+
+void ExtractFrustumPlanes(const D3DXMATRIX& viewProj, D3DXPLANE planes[6])
+{
+	const D3DXMATRIX& M = viewProj;
+
+	// Left, right, bottom and top: -w <= x, y <= w.
+	planes[0] = D3DXPLANE(M._14 + M._11, M._24 + M._21, M._34 + M._31, M._44 + M._41);
+	planes[1] = D3DXPLANE(M._14 - M._11, M._24 - M._21, M._34 - M._31, M._44 - M._41);
+	planes[2] = D3DXPLANE(M._14 + M._12, M._24 + M._22, M._34 + M._32, M._44 + M._42);
+	planes[3] = D3DXPLANE(M._14 - M._12, M._24 - M._22, M._34 - M._32, M._44 - M._42);
+
+	// Near and far: 0 <= z <= w.
+	planes[4] = D3DXPLANE(M._13, M._23, M._33, M._43);
+	planes[5] = D3DXPLANE(M._14 - M._13, M._24 - M._23, M._34 - M._33, M._44 - M._43);
+
+	for (int i = 0; i < 6; ++i)
+		D3DXPlaneNormalize(&planes[i], &planes[i]);
+}
+
+bool AABBInFrustum(const AABB& box, const D3DXPLANE planes[6])
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		// The box corner furthest along the plane normal.
+		D3DXVECTOR3 p;
+		p.x = planes[i].a >= 0.0f ? box.maxPt.x : box.minPt.x;
+		p.y = planes[i].b >= 0.0f ? box.maxPt.y : box.minPt.y;
+		p.z = planes[i].c >= 0.0f ? box.maxPt.z : box.minPt.z;
+
+		if (D3DXPlaneDotCoord(&planes[i], &p) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool SphereInFrustum(const BoundingSphere& sphere, const D3DXPLANE planes[6])
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (D3DXPlaneDotCoord(&planes[i], &sphere.pos) < -sphere.radius)
+			return false;
+	}
+	return true;
+}
@@ -12,6 +12,12 @@
 #include <crtdbg.h>
 #endif
 
+// d3d9.h brings in windows.h; keep its min and max macros from breaking
+// std::min and std::max.
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+
 #include <d3d9.h>
 #include <d3dx9.h>
 #include "dxerr.h"
@@ -50,6 +56,19 @@ extern IDirect3DDevice9* gd3dDevice;
 void GenTriGrid(int numVertRows, int numVertCols, float dx, float dz, 
 				const D3DXVECTOR3 &center, std::vector<D3DXVECTOR3> &verts, std::vector<DWORD> &indices);
 
+// Element i of an array of vectors stride bytes apart, such as the
+// positions or normals of a vertex array.  The mesh utilities all take
+// positions this way.
+inline const D3DXVECTOR3& StridedVec3(const D3DXVECTOR3* first, DWORD stride, DWORD i)
+{
+	return *(const D3DXVECTOR3*)((const BYTE*)first + i*stride);
+}
+
+inline D3DXVECTOR3& StridedVec3(D3DXVECTOR3* first, DWORD stride, DWORD i)
+{
+	return *(D3DXVECTOR3*)((BYTE*)first + i*stride);
+}
+
 //===============================================================
 // Colors and Materials
 
@@ -82,10 +101,20 @@ struct DirLight
 //===============================================================
 // .X Files
 
+// textureNames, if given, also receives each material's texture
+// filename as stored in the file (empty for none).
 void LoadXFile(
 	const std::wstring& filename,
 	ID3DXMesh** meshOut,
 	std::vector<Material>& materials,
+	std::vector<IDirect3DTexture9*>& textures,
+	std::vector<std::string>* textureNames = 0);
+
+// Loads textures named relative to the .x file filename, appending null
+// for empty names.
+void LoadXFileTextures(
+	const std::wstring& filename,
+	const std::vector<std::string>& textureNames,
 	std::vector<IDirect3DTexture9*>& textures);
 
 //===============================================================
@@ -118,3 +147,14 @@ struct BoundingSphere
 	float radius;
 };
 
+// Extracts the six view frustum planes (left, right, bottom, top, near,
+// far) from a view*projection matrix, normalized with normals pointing
+// into the frustum.
+void ExtractFrustumPlanes(const D3DXMATRIX& viewProj, D3DXPLANE planes[6]);
+
+// Conservative test: false only if the box lies entirely behind some plane.
+bool AABBInFrustum(const AABB& box, const D3DXPLANE planes[6]);
+
+// The same for a sphere.
+bool SphereInFrustum(const BoundingSphere& sphere, const D3DXPLANE planes[6]);
+
@@ -20,6 +20,11 @@ GfxStats::GfxStats()
 	mMilliSecPerFrame = 0.0f;
 	mNumTris = 0;
 	mNumVertices = 0;
+	mNumFullResTris = 0;
+	mNumBonesUpdated = 0;
+	mNumBones = 0;
+	mNumAssetsLoaded = 0;
+	mNumAssets = 0;
 }
 
 GfxStats::~GfxStats()
@@ -43,6 +48,9 @@ void GfxStats::addTriangles(DWORD n)    { mNumTris += n;     }
 void GfxStats::subTriangles(DWORD n)    { mNumTris -= n;     }
 void GfxStats::setTriCount(DWORD n)     { mNumTris = n;      }
 void GfxStats::setVertexCount(DWORD n)  { mNumVertices = n;  }
+void GfxStats::setFullResTriCount(DWORD n) { mNumFullResTris = n; }
+void GfxStats::setBoneUpdateCount(DWORD updated, DWORD total) { mNumBonesUpdated = updated; mNumBones = total; }
+void GfxStats::setLoadProgress(DWORD loaded, DWORD total) { mNumAssetsLoaded = loaded; mNumAssets = total; }
 
 void GfxStats::update(float dt)
 {
@@ -66,11 +74,29 @@ void GfxStats::display(D3DCOLOR c)
 {
 	static char buffer[256];
 
-	sprintf_s(buffer, 256, "Frame Per Second = %.2f\n"
+	int len = sprintf_s(buffer, 256, "Frame Per Second = %.2f\n"
 		"Milliseconds Per Frame = %.4f\n"
 		"Triangle Count = %d\n"
 		"Vertex Count = %d", mFPS, mMilliSecPerFrame, mNumTris, mNumVertices);
 
+	if (mNumFullResTris != 0)
+	{
+		sprintf_s(buffer + len, 256 - len, "\nFull-Res Triangle Count = %d (%.1f%% submitted)",
+			mNumFullResTris, 100.0f * mNumTris / mNumFullResTris);
+	}
+
+	if (mNumBones != 0)
+	{
+		len = (int)strlen(buffer);
+		sprintf_s(buffer + len, 256 - len, "\nBones Updated = %d of %d", mNumBonesUpdated, mNumBones);
+	}
+
+	if (mNumAssetsLoaded < mNumAssets)
+	{
+		len = (int)strlen(buffer);
+		sprintf_s(buffer + len, 256 - len, "\nLoading Assets = %d of %d", mNumAssetsLoaded, mNumAssets);
+	}
+
 	RECT R = {5,5,0,0};
 	HR(mFont->DrawTextA(0, buffer, -1, &R, DT_NOCLIP, c));
 }
@@ -19,6 +19,18 @@ public:
 	void setTriCount(DWORD n);
 	void setVertexCount(DWORD n);
 
+	// Triangles the scene would have drawn without LOD; shown next to the
+	// submitted triangle count when nonzero.
+	void setFullResTriCount(DWORD n);
+
+	// Bones an incremental skeleton update recomputed out of the total;
+	// shown when the total is nonzero.
+	void setBoneUpdateCount(DWORD updated, DWORD total);
+
+	// Assets an AssetLoader has finished out of those requested; shown
+	// while loading is still under way.
+	void setLoadProgress(DWORD loaded, DWORD total);
+
 	void update(float dt);
 	void display(D3DCOLOR c = D3DCOLOR_XRGB(255,255,255));
 
@@ -32,4 +44,9 @@ private:
 	float mMilliSecPerFrame;
 	DWORD mNumTris;
 	DWORD mNumVertices;
+	DWORD mNumFullResTris;
+	DWORD mNumBonesUpdated;
+	DWORD mNumBones;
+	DWORD mNumAssetsLoaded;
+	DWORD mNumAssets;
 };
@@ -0,0 +1,570 @@
+//=============================================================================
+// MeshTool.cpp
+//
+// Offline mesh statistics.
+//
+// Usage: MeshTool_Release.exe acmr [-cache N] item ...
+//        MeshTool_Release.exe optimize [-cache N] file.x ...
+//        MeshTool_Release.exe startup [-runs N] file.x ...
+//        MeshTool_Release.exe textures item ...
+//        MeshTool_Release.exe compress file.x ...
+//
+//   acmr: item is either RxC, a generated grid of R x C vertices
+//   measured in every TriGridOrder, or an .x file, measured in the
+//   file's own index order, in LoadXFile's optimized order, and after a
+//   Forsyth reorder.  N is the simulated FIFO size (default 16).
+//
+//   optimize: ACMR, ATVR and overdraw (see MeshOptimizer.h) of each .x
+//   file in the file's own order, after D3DXMESHOPT_VERTEXCACHE, and
+//   after OptimizeMesh for a cache of N entries.  Both optimizers run
+//   per subset on the same compacted, attribute sorted mesh.
+//
+//   startup: times loading each .x file with LoadXFile, with
+//   LoadXFileCached and no cache (LoadXFile plus writing the cache), and
+//   with LoadXFileCached and a valid cache, each averaged over N runs
+//   (default 10), and checks the cached mesh matches LoadXFile's.  The
+//   texture loads all three include are timed on their own as well.
+//   Leaves a fresh .mcache beside each file.  Last come two AssetLoader
+//   timings: "request", what a demo constructor now spends before its
+//   first frame (creating the loader and queueing the mesh), and
+//   "async", until the mesh (from the cache left above) and its textures
+//   have all been swapped in.
+//
+//   textures: loads each item -- an .x file's textures, or an image --
+//   through one TextureCache, keeping everything loaded so later items
+//   can share it, and shows the cache's hits, misses and texture memory
+//   for each item and overall.
+//
+//   compress: bytes per vertex and vertex buffer size of each .x file
+//   as VertexPNT and in the compressed formats of VertexCompress.h, with
+//   the error each format makes in position, normal (degrees) and
+//   texture coordinates, mean and max over the vertices.
+//
+// .x files are loaded through a NULLREF device, so no GPU is needed.
+//=============================================================================
+
+#include "d3dUtil.h"
+#include "Vertex.h"
+#include "TriGrid.h"
+#include "VertexCache.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "VertexCompress.h"
+#include "XFile.h"
+#include "Normals.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+static bool CreateNullDevice()
+{
+	IDirect3D9* d3d = Direct3DCreate9(D3D_SDK_VERSION);
+	if (d3d == 0)
+		return false;
+
+	D3DPRESENT_PARAMETERS pp;
+	ZeroMemory(&pp, sizeof(pp));
+	pp.BackBufferWidth  = 1;
+	pp.BackBufferHeight = 1;
+	pp.BackBufferFormat = D3DFMT_UNKNOWN;
+	pp.SwapEffect       = D3DSWAPEFFECT_DISCARD;
+	pp.hDeviceWindow    = GetDesktopWindow();
+	pp.Windowed         = true;
+
+	HRESULT hr = d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_NULLREF, GetDesktopWindow(),
+		D3DCREATE_SOFTWARE_VERTEXPROCESSING, &pp, &gd3dDevice);
+	SafeRelease(d3d);
+
+	return SUCCEEDED(hr);
+}
+
+static void GetIndices(ID3DXMesh* mesh, std::vector<DWORD>& indices)
+{
+	indices.resize(mesh->GetNumFaces() * 3);
+
+	void* k = 0;
+	HR(mesh->LockIndexBuffer(D3DLOCK_READONLY, &k));
+	if (mesh->GetOptions() & D3DXMESH_32BIT)
+	{
+		memcpy(&indices[0], k, indices.size()*sizeof(DWORD));
+	}
+	else
+	{
+		const WORD* k16 = (const WORD*)k;
+		for (size_t i = 0; i < indices.size(); ++i)
+			indices[i] = k16[i];
+	}
+	HR(mesh->UnlockIndexBuffer());
+}
+
+static void PrintStats(const char* item, const char* order, const std::vector<DWORD>& indices, int cacheSize)
+{
+	VertexCacheStats s = MeasureVertexCache(&indices[0], (DWORD)indices.size(), cacheSize);
+	printf("%-32s %-10s %10u %10u %7.3f %7.3f\n", item, order,
+		s.numTriangles, s.numVertices, s.acmr, s.atvr);
+}
+
+static void MeasureGrid(const char* item, int numVertRows, int numVertCols, int cacheSize)
+{
+	const TriGridOrder orders[] = { TRIGRID_ROW_MAJOR, TRIGRID_COLUMN_STRIPS, TRIGRID_HILBERT };
+	const char* names[]         = { "row-major", "strips",   "hilbert" };
+
+	std::vector<DWORD> indices((size_t)(numVertRows-1) * (numVertCols-1) * 6);
+	for (int o = 0; o < 3; ++o)
+	{
+		GenTriGridIndices(numVertRows, numVertCols, orders[o], &indices[0], cacheSize);
+		PrintStats(item, names[o], indices, cacheSize);
+	}
+
+	OptimizeVertexCacheForsyth(&indices[0], (DWORD)indices.size(), (DWORD)numVertRows*numVertCols);
+	PrintStats(item, "forsyth", indices, cacheSize);
+}
+
+static void MeasureXFile(const char* item, int cacheSize)
+{
+	std::wstring filename(item, item + strlen(item));
+	std::vector<DWORD> indices;
+
+	// The file's own order.
+	ID3DXMesh* raw = 0;
+	if (FAILED(D3DXLoadMeshFromX(filename.c_str(), D3DXMESH_SYSTEMMEM, gd3dDevice, 0, 0, 0, 0, &raw)))
+	{
+		printf("%-32s could not load\n", item);
+		return;
+	}
+	GetIndices(raw, indices);
+	PrintStats(item, "file", indices, cacheSize);
+	SafeRelease(raw);
+
+	// After LoadXFile's OptimizeMesh pass.
+	ID3DXMesh* mesh = 0;
+	std::vector<Material> materials;
+	std::vector<IDirect3DTexture9*> textures;
+	LoadXFile(filename, &mesh, materials, textures);
+
+	GetIndices(mesh, indices);
+	PrintStats(item, "loadxfile", indices, cacheSize);
+
+	// Forsyth over the whole index buffer; subsets are ignored here.
+	OptimizeVertexCacheForsyth(&indices[0], (DWORD)indices.size(), mesh->GetNumVertices());
+	PrintStats(item, "forsyth", indices, cacheSize);
+
+	for (size_t i = 0; i < textures.size(); ++i)
+		SafeRelease(textures[i]);
+	SafeRelease(mesh);
+}
+
+static void PrintMeshStats(const char* item, const char* order, ID3DXMesh* mesh, int cacheSize)
+{
+	std::vector<DWORD> indices;
+	GetIndices(mesh, indices);
+	VertexCacheStats s = MeasureVertexCache(&indices[0], (DWORD)indices.size(), cacheSize);
+
+	// Every FVF mesh starts its vertices with the position.
+	void* v = 0;
+	HR(mesh->LockVertexBuffer(D3DLOCK_READONLY, &v));
+	OverdrawStats o = MeasureOverdraw(&indices[0], (DWORD)indices.size(),
+		(const D3DXVECTOR3*)v, mesh->GetNumVertices(), mesh->GetNumBytesPerVertex());
+	HR(mesh->UnlockVertexBuffer());
+
+	printf("%-32s %-10s %10u %10u %7.3f %7.3f %9.3f\n", item, order,
+		s.numTriangles, s.numVertices, s.acmr, s.atvr, o.overdraw);
+}
+
+static void MeasureOptimize(const char* item, int cacheSize)
+{
+	std::wstring filename(item, item + strlen(item));
+
+	ID3DXMesh* raw = 0;
+	ID3DXBuffer* adjBuffer = 0;
+	if (FAILED(D3DXLoadMeshFromX(filename.c_str(), D3DXMESH_SYSTEMMEM, gd3dDevice, &adjBuffer, 0, 0, 0, &raw)))
+	{
+		printf("%-32s could not load\n", item);
+		return;
+	}
+	PrintMeshStats(item, "file", raw, cacheSize);
+
+	DWORD* adjacency = (DWORD*)adjBuffer->GetBufferPointer();
+
+	ID3DXMesh* d3dx = 0;
+	HR(raw->Optimize(D3DXMESH_SYSTEMMEM | D3DXMESHOPT_COMPACT | D3DXMESHOPT_ATTRSORT | D3DXMESHOPT_VERTEXCACHE,
+		adjacency, 0, 0, 0, &d3dx));
+	PrintMeshStats(item, "d3dx", d3dx, cacheSize);
+	SafeRelease(d3dx);
+
+	ID3DXMesh* ours = 0;
+	HR(raw->Optimize(D3DXMESH_SYSTEMMEM | D3DXMESHOPT_COMPACT | D3DXMESHOPT_ATTRSORT,
+		adjacency, 0, 0, 0, &ours));
+	OptimizeMesh(ours, cacheSize);
+	PrintMeshStats(item, "optimized", ours, cacheSize);
+	SafeRelease(ours);
+
+	SafeRelease(adjBuffer);
+	SafeRelease(raw);
+}
+
+static void ReleaseLoaded(ID3DXMesh*& mesh, std::vector<Material>& materials, std::vector<IDirect3DTexture9*>& textures)
+{
+	for (size_t i = 0; i < textures.size(); ++i)
+		SafeRelease(textures[i]);
+	textures.clear();
+	materials.clear();
+	SafeRelease(mesh);
+}
+
+// Average seconds per call of load(mesh, materials, textures) over runs
+// calls, releasing what each call loads.
+template <typename F>
+static double TimeLoad(F load, int runs)
+{
+	ID3DXMesh* mesh = 0;
+	std::vector<Material> materials;
+	std::vector<IDirect3DTexture9*> textures;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < runs; ++r)
+	{
+		load(&mesh, materials, textures);
+		ReleaseLoaded(mesh, materials, textures);
+	}
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / runs;
+}
+
+// Same vertices, indices, attributes and attribute table.
+static bool SameMesh(ID3DXMesh* a, ID3DXMesh* b)
+{
+	if (a->GetNumVertices() != b->GetNumVertices() || a->GetNumFaces() != b->GetNumFaces() ||
+		a->GetNumBytesPerVertex() != b->GetNumBytesPerVertex() ||
+		(a->GetOptions() & D3DXMESH_32BIT) != (b->GetOptions() & D3DXMESH_32BIT))
+		return false;
+
+	DWORD indexSize = (a->GetOptions() & D3DXMESH_32BIT) ? sizeof(DWORD) : sizeof(WORD);
+	bool same = true;
+
+	void* p = 0;
+	void* q = 0;
+	HR(a->LockVertexBuffer(D3DLOCK_READONLY, &p));
+	HR(b->LockVertexBuffer(D3DLOCK_READONLY, &q));
+	same = same && memcmp(p, q, a->GetNumVertices() * a->GetNumBytesPerVertex()) == 0;
+	HR(a->UnlockVertexBuffer());
+	HR(b->UnlockVertexBuffer());
+
+	HR(a->LockIndexBuffer(D3DLOCK_READONLY, &p));
+	HR(b->LockIndexBuffer(D3DLOCK_READONLY, &q));
+	same = same && memcmp(p, q, a->GetNumFaces() * 3 * indexSize) == 0;
+	HR(a->UnlockIndexBuffer());
+	HR(b->UnlockIndexBuffer());
+
+	DWORD* s = 0;
+	DWORD* t = 0;
+	HR(a->LockAttributeBuffer(D3DLOCK_READONLY, &s));
+	HR(b->LockAttributeBuffer(D3DLOCK_READONLY, &t));
+	same = same && memcmp(s, t, a->GetNumFaces() * sizeof(DWORD)) == 0;
+	HR(a->UnlockAttributeBuffer());
+	HR(b->UnlockAttributeBuffer());
+
+	DWORD numA = 0, numB = 0;
+	HR(a->GetAttributeTable(0, &numA));
+	HR(b->GetAttributeTable(0, &numB));
+	if (numA != numB)
+		return false;
+	if (numA != 0)
+	{
+		std::vector<D3DXATTRIBUTERANGE> tableA(numA), tableB(numB);
+		HR(a->GetAttributeTable(&tableA[0], &numA));
+		HR(b->GetAttributeTable(&tableB[0], &numB));
+		same = same && memcmp(&tableA[0], &tableB[0], numA * sizeof(D3DXATTRIBUTERANGE)) == 0;
+	}
+	return same;
+}
+
+static void MeasureStartup(const char* item, int runs)
+{
+	std::wstring filename(item, item + strlen(item));
+	std::wstring cacheFilename = GetMeshCacheFilename(filename);
+
+	if (GetFileAttributesW(filename.c_str()) == INVALID_FILE_ATTRIBUTES)
+	{
+		printf("%-32s could not load\n", item);
+		return;
+	}
+
+	// One load of each kind to compare the results and warm the OS file
+	// cache, so every timing reads from memory.
+	ID3DXMesh* mesh = 0;
+	std::vector<Material> materials;
+	std::vector<IDirect3DTexture9*> textures;
+	std::vector<std::string> textureNames;
+	LoadXFile(filename, &mesh, materials, textures, &textureNames);
+
+	ID3DXMesh* cached = 0;
+	std::vector<Material> cachedMaterials;
+	std::vector<IDirect3DTexture9*> cachedTextures;
+	DeleteFileW(cacheFilename.c_str());
+	LoadXFileCached(filename, &cached, cachedMaterials, cachedTextures);
+	ReleaseLoaded(cached, cachedMaterials, cachedTextures);
+	LoadXFileCached(filename, &cached, cachedMaterials, cachedTextures);
+
+	bool identical = SameMesh(mesh, cached) && cachedMaterials.size() == materials.size() &&
+		(materials.empty() || memcmp(&materials[0], &cachedMaterials[0], materials.size() * sizeof(Material)) == 0);
+	DWORD numVertices = mesh->GetNumVertices();
+	DWORD numFaces = mesh->GetNumFaces();
+	ReleaseLoaded(cached, cachedMaterials, cachedTextures);
+	ReleaseLoaded(mesh, materials, textures);
+
+	double loadXFile = TimeLoad([&](ID3DXMesh** m, std::vector<Material>& mtrls, std::vector<IDirect3DTexture9*>& tex) {
+		LoadXFile(filename, m, mtrls, tex);
+	}, runs);
+
+	double cold = TimeLoad([&](ID3DXMesh** m, std::vector<Material>& mtrls, std::vector<IDirect3DTexture9*>& tex) {
+		DeleteFileW(cacheFilename.c_str());
+		LoadXFileCached(filename, m, mtrls, tex);
+	}, runs);
+
+	double warm = TimeLoad([&](ID3DXMesh** m, std::vector<Material>& mtrls, std::vector<IDirect3DTexture9*>& tex) {
+		LoadXFileCached(filename, m, mtrls, tex);
+	}, runs);
+
+	double texturesOnly = TimeLoad([&](ID3DXMesh**, std::vector<Material>&, std::vector<IDirect3DTexture9*>& tex) {
+		LoadXFileTextures(filename, textureNames, tex);
+	}, runs);
+
+	double request = 0.0, async = 0.0;
+	for (int r = 0; r < runs; ++r)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		AssetLoader* loader = new AssetLoader();
+		loader->loadMesh(filename);
+		auto requested = std::chrono::high_resolution_clock::now();
+		loader->finish();
+		auto done = std::chrono::high_resolution_clock::now();
+		SafeDelete(loader);
+
+		request += std::chrono::duration<double>(requested - start).count() / runs;
+		async   += std::chrono::duration<double>(done - start).count() / runs;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	DWORD cacheBytes = GetFileAttributesExW(cacheFilename.c_str(), GetFileExInfoStandard, &info) ? info.nFileSizeLow : 0;
+
+	printf("%-32s %8u %8u %10.2f %10.2f %10.2f %10.2f %8.1fx %9.1f %9s %10.3f %10.2f\n", item, numVertices, numFaces,
+		loadXFile * 1000.0, cold * 1000.0, warm * 1000.0, texturesOnly * 1000.0,
+		loadXFile / warm, cacheBytes / 1024.0, identical ? "yes" : "NO", request * 1000.0, async * 1000.0);
+}
+
+static void MeasureTextures(const char* item, std::vector<IDirect3DTexture9*>& held)
+{
+	std::wstring filename(item, item + strlen(item));
+	if (GetFileAttributesW(filename.c_str()) == INVALID_FILE_ATTRIBUTES)
+	{
+		printf("%-32s could not load\n", item);
+		return;
+	}
+
+	TextureCacheStats before = gTextureCache->getStats();
+	size_t first = held.size();
+
+	size_t dot = filename.rfind(L'.');
+	if (dot != std::wstring::npos && _wcsicmp(filename.c_str() + dot, L".x") == 0)
+	{
+		ID3DXMesh* mesh = 0;
+		std::vector<Material> materials;
+		LoadXFile(filename, &mesh, materials, held);
+		SafeRelease(mesh);
+	}
+	else
+	{
+		IDirect3DTexture9* tex = 0;
+		HR(LoadTextureCached(filename, &tex));
+		held.push_back(tex);
+	}
+
+	DWORD requests = 0;
+	for (size_t i = first; i < held.size(); ++i)
+	{
+		if (held[i] != 0)
+			++requests;
+	}
+
+	const TextureCacheStats& after = gTextureCache->getStats();
+	printf("%-32s %8u %8u %8u %8u %10.1f %10.1f\n", item, requests,
+		after.pathHits - before.pathHits, after.contentHits - before.contentHits, after.misses - before.misses,
+		(after.bytesCached - before.bytesCached) / 1024.0, (after.bytesSaved - before.bytesSaved) / 1024.0);
+}
+
+static void PrintCompression(const char* item, const char* format, DWORD numVertices, DWORD bytesPerVertex,
+	const VertexErrorStats& e)
+{
+	printf("%-32s %-6s %8u %6u %9.1f %10.5f %10.5f %8.3f %8.3f %10.6f %10.6f\n", item, format, numVertices,
+		bytesPerVertex, numVertices * bytesPerVertex / 1024.0, e.meanPos, e.maxPos, e.meanNormal, e.maxNormal,
+		e.meanTex, e.maxTex);
+}
+
+static void MeasureCompression(const char* item)
+{
+	std::wstring filename(item, item + strlen(item));
+
+	XFileMesh mesh;
+	std::string error;
+	if (!LoadXFileMesh(filename, &mesh, &error))
+	{
+		printf("%-32s could not load: %s\n", item, error.c_str());
+		return;
+	}
+	if (!mesh.hasNormals)
+		ComputeXFileNormals(mesh);
+
+	const VertexPNT* vertices = (const VertexPNT*)&mesh.vertices[0];
+	DWORD numVertices = (DWORD)mesh.vertices.size();
+	VertexQuantization q = ComputeVertexQuantization(vertices, numVertices);
+	std::vector<VertexPNT> decoded(numVertices);
+
+	VertexErrorStats none;
+	memset(&none, 0, sizeof(none));
+	PrintCompression(item, "pnt", numVertices, sizeof(VertexPNT), none);
+
+	std::vector<VertexPNTQ16> q16(numVertices);
+	CompressVertices(vertices, numVertices, q, &q16[0]);
+	DecompressVertices(&q16[0], numVertices, q, &decoded[0]);
+	PrintCompression(item, "q16", numVertices, sizeof(VertexPNTQ16), MeasureVertexError(vertices, &decoded[0], numVertices));
+
+	std::vector<VertexPNTQ12> q12(numVertices);
+	CompressVertices(vertices, numVertices, q, &q12[0]);
+	DecompressVertices(&q12[0], numVertices, q, &decoded[0]);
+	PrintCompression(item, "q12", numVertices, sizeof(VertexPNTQ12), MeasureVertexError(vertices, &decoded[0], numVertices));
+}
+
+static int Usage()
+{
+	printf("usage: MeshTool acmr [-cache N] <RxC | file.x> ...\n");
+	printf("       MeshTool optimize [-cache N] file.x ...\n");
+	printf("       MeshTool startup [-runs N] file.x ...\n");
+	printf("       MeshTool textures <file.x | image> ...\n");
+	printf("       MeshTool compress file.x ...\n");
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+		return Usage();
+
+	bool acmr = strcmp(argv[1], "acmr") == 0;
+	bool startup = strcmp(argv[1], "startup") == 0;
+	bool optimize = strcmp(argv[1], "optimize") == 0;
+	bool textures = strcmp(argv[1], "textures") == 0;
+	bool compress = strcmp(argv[1], "compress") == 0;
+	if (!acmr && !optimize && !startup && !textures && !compress)
+		return Usage();
+
+	int cacheSize = 16;
+	int runs = 10;
+	int first = 2;
+	if ((acmr || optimize) && strcmp(argv[first], "-cache") == 0)
+	{
+		if (argc < 5)
+			return Usage();
+		cacheSize = atoi(argv[first+1]);
+		first += 2;
+	}
+	else if (startup && strcmp(argv[first], "-runs") == 0)
+	{
+		if (argc < 5 || atoi(argv[first+1]) < 1)
+			return Usage();
+		runs = atoi(argv[first+1]);
+		first += 2;
+	}
+
+	bool deviceReady = false;
+	std::vector<IDirect3DTexture9*> heldTextures;
+
+	if (acmr)
+	{
+		printf("FIFO cache of %d entries\n", cacheSize);
+		printf("%-32s %-10s %10s %10s %7s %7s\n", "item", "order", "tris", "verts", "ACMR", "ATVR");
+	}
+	else if (optimize)
+	{
+		printf("FIFO cache of %d entries\n", cacheSize);
+		printf("%-32s %-10s %10s %10s %7s %7s %9s\n", "file", "order", "tris", "verts", "ACMR", "ATVR", "overdraw");
+	}
+	else if (textures)
+	{
+		printf("%-32s %8s %8s %8s %8s %10s %10s\n", "item", "textures", "path", "content", "misses",
+			"loaded KB", "saved KB");
+	}
+	else if (compress)
+	{
+		printf("%-32s %-6s %8s %6s %9s %10s %10s %8s %8s %10s %10s\n", "file", "format", "verts", "bytes",
+			"KB", "pos mean", "pos max", "nrm mean", "nrm max", "tex mean", "tex max");
+	}
+	else
+	{
+		printf("milliseconds per load, average of %d\n", runs);
+		printf("%-32s %8s %8s %10s %10s %10s %10s %9s %9s %9s %10s %10s\n", "file", "verts", "tris",
+			"loadxfile", "cold", "cached", "textures", "speedup", "cache KB", "identical", "request", "async");
+	}
+
+	for (int a = first; a < argc; ++a)
+	{
+		int numVertRows = 0, numVertCols = 0;
+		if (acmr && sscanf_s(argv[a], "%dx%d", &numVertRows, &numVertCols) == 2)
+		{
+			if (numVertRows >= 2 && numVertCols >= 2)
+				MeasureGrid(argv[a], numVertRows, numVertCols, cacheSize);
+			continue;
+		}
+
+		// Compression needs no device.
+		if (compress)
+		{
+			MeasureCompression(argv[a]);
+			continue;
+		}
+
+		if (!deviceReady)
+		{
+			if (!CreateNullDevice())
+			{
+				printf("could not create a NULLREF device\n");
+				return 1;
+			}
+			InitAllVertexDeclarations();
+			deviceReady = true;
+			if (textures)
+				gTextureCache = new TextureCache();
+		}
+
+		if (acmr)
+			MeasureXFile(argv[a], cacheSize);
+		else if (optimize)
+			MeasureOptimize(argv[a], cacheSize);
+		else if (textures)
+			MeasureTextures(argv[a], heldTextures);
+		else
+			MeasureStartup(argv[a], runs);
+	}
+
+	if (gTextureCache)
+	{
+		const TextureCacheStats& s = gTextureCache->getStats();
+		printf("%-32s %8u %8u %8u %8u %10.1f %10.1f\n", "total", s.pathHits + s.contentHits + s.misses,
+			s.pathHits, s.contentHits, s.misses, s.bytesCached / 1024.0, s.bytesSaved / 1024.0);
+
+		// Once every reference is released, a purge must empty the cache.
+		for (size_t i = 0; i < heldTextures.size(); ++i)
+			SafeRelease(heldTextures[i]);
+		gTextureCache->purgeUnused();
+		printf("textures left after release and purge: %u\n", gTextureCache->getStats().numTextures);
+		SafeDelete(gTextureCache);
+	}
+
+	if (deviceReady)
+	{
+		DestroyAllVertexDeclarations();
+		SafeRelease(gd3dDevice);
+	}
+	return 0;
+}